@@ -0,0 +1,81 @@
+/** @file BatchRunner2D.h
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The class declaration for BatchRunner2D, a batch scheduler for many independent 2D movies.
+ *
+ * Screening experiments produce many small movies, each of which is too short to keep all cores busy.
+ * The BatchRunner2D collects a list of (movie, configuration) jobs and processes all of their frames in a
+ * single dynamically scheduled OpenMP loop.  Jobs with identical imsize, sigma, method and sigma ratio are
+ * grouped so they share one Boxxer2D engine and one set of per-thread filter kernels.
+ */
+#ifndef BOXXER_BATCHRUNNER2D_H
+#define BOXXER_BATCHRUNNER2D_H
+
+#include <cstdint>
+#include <vector>
+#include <armadillo>
+#include "Boxxer/Boxxer2D.h"
+
+namespace boxxer {
+
+template<class FloatT=float, class IdxT=uint32_t>
+class BatchRunner2D
+{
+public:
+    using BoxxerT = Boxxer2D<FloatT,IdxT>;
+    using IVecT = typename BoxxerT::IVecT;
+    using IMatT = typename BoxxerT::IMatT;
+    using VecT = typename BoxxerT::VecT;
+    using MatT = typename BoxxerT::MatT;
+    using ImageStackT = typename BoxxerT::ImageStackT;
+
+    /** Throughput statistics for the last run() */
+    struct Stats
+    {
+        IdxT nJobs=0;
+        IdxT nGroups=0;
+        std::size_t nFrames=0;
+        std::size_t nMaxima=0;
+        double seconds=0;
+        double frames_per_second=0;
+        double pixels_per_second=0;
+    };
+
+    /**
+     * Add a job.  The image stack is not copied and must stay valid until run() returns.
+     * @returns The job index into the results of run().
+     */
+    IdxT addJob(const ImageStackT &im, const MatT &sigma, bool use_DoG=true, FloatT sigma_ratio=BoxxerT::DefaultSigmaRatio,
+                IdxT neighborhood_size=3, IdxT scale_neighborhood_size=3);
+    IdxT nJobs() const { return static_cast<IdxT>(jobs.size()); }
+    IdxT nGroups() const { return static_cast<IdxT>(groups.size()); }
+    void clear();
+
+    /**
+     * Process all jobs.
+     * @param maxima [out] size:[nJobs] Each element is 4xN maxima for that job as returned by scaleSpaceDoGMaxima.
+     * @param max_vals [out] size:[nJobs] Each element is the corresponding maxima values.
+     */
+    Stats run(arma::field<IMatT> &maxima, arma::field<VecT> &max_vals) const;
+
+private:
+    struct Job
+    {
+        const ImageStackT *im;
+        IdxT group;
+        IdxT neighborhood_size;
+        IdxT scale_neighborhood_size;
+    };
+    struct Group
+    {
+        BoxxerT engine;
+        bool use_DoG;
+    };
+
+    std::vector<Job> jobs;
+    std::vector<Group> groups;
+};
+
+} /* namespace boxxer */
+
+#endif /* BOXXER_BATCHRUNNER2D_H */
@@ -8,11 +8,25 @@
 #define BOXXER_BOXXER2D_H
 
 #include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <vector>
 #include <armadillo>
 #include "Boxxer/Hypercube/Hypercube.h"
+#include "Boxxer/GaussFilter.h"
+#include "Boxxer/Maxima.h"
+#include "Boxxer/GaussCache.h"
+#include "Boxxer/DefectMap.h"
+#include "Boxxer/ScalePruner.h"
+#include "Boxxer/TemporalBinning.h"
 
 namespace boxxer {
 
+template<class FloatT, class IdxT> class BatchRunner2D;
+template<class FloatT, class IdxT> class Mosaic2D;
+template<int Dim, class FloatT, class IdxT> class PSFBoxxer;
+
 /**
  * @class Boxxer2D
  * 
@@ -41,39 +55,260 @@ public:
     using ImageStackT = arma::Cube<FloatT>;
     using ScaledImageT = arma::Cube<FloatT>;
     using ScaledImageStackT = hypercube::Hypercube<FloatT>;
+    using InterleavedImageT = arma::Cube<FloatT>; // [nScales x nrows x ncols] scales innermost
+    using GaussCacheT = GaussCache<ImageT,FloatT,IdxT>;
+    using MaskT = arma::Mat<uint8_t>;
+    using DefectMapT = DefectMap2D<FloatT,IdxT>;
+    using ScalePrunerT = ScalePruner<FloatT,IdxT>;
+    using AdaptiveScaleParams = typename ScalePrunerT::Params;
+    using AdaptiveScaleStats = typename ScalePrunerT::Stats;
+    using TemporalBinningT = TemporalBinning<IdxT>;
  
     static const FloatT DefaultSigmaRatio;
+    static const IdxT DefaultWaveletFirstLevel;
+    static const IdxT MaskTileSize; //Tile size for skipping unmasked regions
     static const IdxT dim;
-    
+
     IdxT nScales;
     IVecT imsize; // [nrows x ncols] size of an individual frame
     MatT sigma; // size: [2 x nScales] row1=sigmaX (rows), row2=sigmaY (cols)
     FloatT sigma_ratio;
+    IdxT wavelet_first_level; // Wavelet scales are the a trous levels wavelet_first_level ... +nScales-1
     Boxxer2D(const IVecT &imsize, const MatT &sigma);
+    /* Copies get their own empty Gaussian cache with the same memory bound, so engines copied into a Mosaic2D,
+     * BatchRunner2D or server never share cached frames */
+    Boxxer2D(const Boxxer2D &o);
+    Boxxer2D& operator=(const Boxxer2D &o);
+    Boxxer2D(Boxxer2D &&) = default;
+    Boxxer2D& operator=(Boxxer2D &&) = default;
 
     void setDoGSigmaRatio(FloatT sigma_ratio);
+    void setWaveletFirstLevel(IdxT level);
+
+    /* Gaussian cache for interactive DoG tuning.  When enabled the DoG methods reuse cached Gaussian frames */
+    void enableGaussCache(std::size_t max_bytes);
+    void disableGaussCache();
+    void clearGaussCache();
+    bool hasGaussCache() const { return static_cast<bool>(gauss_cache); }
+    typename GaussCacheT::Stats gaussCacheStats() const;
+
+    /* Defect pixel suppression.  All non-static methods read frames with the flagged pixels replaced by the median
+     * of their unflagged neighbors.  See DefectMap.h */
+    void setDefectMap(const MaskT &defects);
+    void clearDefectMap();
+    bool hasDefectMap() const { return static_cast<bool>(defect_map); }
+    MaskT getDefectMap() const;
+    IdxT detectDefectMap(const ImageStackT &im, IdxT nWarmupFrames, FloatT threshold=DefectMapT::DefaultThreshold,
+                         FloatT min_fraction=DefectMapT::DefaultMinFraction);
 
     void filterScaledLoG(const ImageStackT &im, ScaledImageStackT &fim) const;
     void filterScaledDoG(const ImageStackT &im, ScaledImageStackT &fim) const;
+    void filterScaledWavelet(const ImageStackT &im, ScaledImageStackT &fim) const;
+    /* As filterScaledLoG/DoG with fim in the interleaved [nScales x nrows x ncols x nT] layout */
+    void filterScaledLoGInterleaved(const ImageStackT &im, ScaledImageStackT &fim) const;
+    void filterScaledDoGInterleaved(const ImageStackT &im, ScaledImageStackT &fim) const;
+    /* Keep only the maxima of frame isim [nScales x nrows x ncols] of an interleaved stack with no larger value at any
+     * scale in their scale_neighborhood_size window, as the scaleSpace*Maxima methods do for the planar layout */
+    IdxT scaleSpaceFrameMaximaRefineInterleaved(const InterleavedImageT &isim, IMatT &maxima, VecT &max_vals,
+                                                IdxT scale_neighborhood_size) const;
     IdxT scaleSpaceLoGMaxima(const ImageStackT &im, IMatT &maxima, VecT &max_vals, IdxT neighborhood_size, IdxT scale_neighborhood_size) const;
     IdxT scaleSpaceDoGMaxima(const ImageStackT &im, IMatT &maxima, VecT &max_vals, IdxT neighborhood_size, IdxT scale_neighborhood_size) const;
+    IdxT scaleSpaceWaveletMaxima(const ImageStackT &im, IMatT &maxima, VecT &max_vals, IdxT neighborhood_size, IdxT scale_neighborhood_size) const;
+
+    /* Shape metrics at LoG maxima.  hessian_ratio(n) is the smaller over the larger eigenvalue of the scale normalized
+     * Hessian at the scale of maxima n: 1 for round blobs, near 0 for lines and edges and <0 for saddles.  The
+     * optional gradient is the scale normalized gradient magnitude, which is large for off-center maxima. */
+    IdxT scaleSpaceLoGMaximaShape(const ImageStackT &im, IMatT &maxima, VecT &max_vals, VecT &hessian_ratio,
+                                  IdxT neighborhood_size, IdxT scale_neighborhood_size, VecT *gradient=nullptr) const;
+    IdxT scaleSpaceDoGMaximaSweep(const ImageStackT &im, const VecT &sigma_ratios, const IVecT &neighborhood_sizes,
+                                  const IVecT &scale_neighborhood_sizes, const VecT &thresholds,
+                                  MatT &sweep_params, arma::field<IMatT> &maxima, arma::field<VecT> &max_vals) const;
+
+    /* Mask restricted detection.  Only maxima at nonzero mask pixels are returned, and cost scales with the masked area */
+    MaskT makeROIMask(const IMatT &rois) const;
+    IdxT scaleSpaceLoGMaximaMasked(const ImageStackT &im, const MaskT &mask, IMatT &maxima, VecT &max_vals,
+                                   IdxT neighborhood_size, IdxT scale_neighborhood_size) const;
+    IdxT scaleSpaceDoGMaximaMasked(const ImageStackT &im, const MaskT &mask, IMatT &maxima, VecT &max_vals,
+                                   IdxT neighborhood_size, IdxT scale_neighborhood_size) const;
+
+    /* Temporal change skipping.  Only maxima >threshold are returned, and tiles that provably have none are skipped */
+    struct TemporalSkipStats
+    {
+        std::size_t nTileFrames=0;
+        std::size_t nSkipped=0;
+    };
+    IdxT scaleSpaceLoGMaximaTemporal(const ImageStackT &im, FloatT threshold, IMatT &maxima, VecT &max_vals,
+                                     IdxT neighborhood_size, IdxT scale_neighborhood_size, TemporalSkipStats *stats=nullptr) const;
+    IdxT scaleSpaceDoGMaximaTemporal(const ImageStackT &im, FloatT threshold, IMatT &maxima, VecT &max_vals,
+                                     IdxT neighborhood_size, IdxT scale_neighborhood_size, TemporalSkipStats *stats=nullptr) const;
+
+    /* Dark frame rejection.  Only maxima >threshold are returned, and frames that provably have none are skipped */
+    IdxT scaleSpaceLoGMaximaThreshold(const ImageStackT &im, FloatT threshold, IMatT &maxima, VecT &max_vals,
+                                      IdxT neighborhood_size, IdxT scale_neighborhood_size, IdxT *nSkippedFrames=nullptr) const;
+    IdxT scaleSpaceDoGMaximaThreshold(const ImageStackT &im, FloatT threshold, IMatT &maxima, VecT &max_vals,
+                                      IdxT neighborhood_size, IdxT scale_neighborhood_size, IdxT *nSkippedFrames=nullptr) const;
+
+    /* Adaptive scale pruning.  Only maxima >threshold are returned, and scales whose recent peak response was well
+     * below threshold are skipped, with periodic full rechecks.  Approximate, see ScalePruner.h */
+    IdxT scaleSpaceLoGMaximaAdaptive(const ImageStackT &im, FloatT threshold, IMatT &maxima, VecT &max_vals,
+                                     IdxT neighborhood_size, IdxT scale_neighborhood_size,
+                                     const AdaptiveScaleParams &params=AdaptiveScaleParams(),
+                                     AdaptiveScaleStats *stats=nullptr) const;
+    IdxT scaleSpaceDoGMaximaAdaptive(const ImageStackT &im, FloatT threshold, IMatT &maxima, VecT &max_vals,
+                                     IdxT neighborhood_size, IdxT scale_neighborhood_size,
+                                     const AdaptiveScaleParams &params=AdaptiveScaleParams(),
+                                     AdaptiveScaleStats *stats=nullptr) const;
+
+    /* Temporal binning for dim samples.  Maxima of the sums (or means) of groups of frames, formed as they are
+     * filtered.  The frame row of maxima is the first frame of the bin.  See TemporalBinning.h */
+    IdxT scaleSpaceLoGMaximaBinned(const ImageStackT &im, const TemporalBinningT &binning, IMatT &maxima,
+                                   VecT &max_vals, IdxT neighborhood_size, IdxT scale_neighborhood_size) const;
+    IdxT scaleSpaceDoGMaximaBinned(const ImageStackT &im, const TemporalBinningT &binning, IMatT &maxima,
+                                   VecT &max_vals, IdxT neighborhood_size, IdxT scale_neighborhood_size) const;
+
+    /* Connected components of the pixels with maximum response over scales >threshold, for extended objects.
+     * Columns of components are [x_lo y_lo x_hi y_hi peak_x peak_y peak_scale area frame].  See Components.h */
+    IdxT scaleSpaceLoGComponents(const ImageStackT &im, FloatT threshold, IMatT &components, VecT &integrated,
+                                 VecT &peak_vals) const;
+    IdxT scaleSpaceDoGComponents(const ImageStackT &im, FloatT threshold, IMatT &components, VecT &integrated,
+                                 VecT &peak_vals) const;
+
+    /**
+     * Per-thread scale-space filtering for frame loops.  Filters have internal storage, so each thread keeps its own
+     * FrameFilter.  The filter of a scale is built the first time that scale is used, and all are rebuilt only when
+     * the input size or the engine's sigma or sigma_ratio change, so windowed loops should keep one FrameFilter per
+     * window size.  Frames are read with the engine's defect map applied, except by filterPatched.
+     */
+    class FrameFilter
+    {
+    public:
+        using KeepT = std::function<bool(IdxT,IdxT)>;
+
+        FrameFilter(const Boxxer2D &engine, bool use_DoG);
+        const Boxxer2D& engine() const { return *_engine; }
+        bool useDoG() const { return use_DoG; }
+
+        /** Filter the whole frame at all scales, or only at the given scales */
+        const ScaledImageT& filter(const ImageT &frame);
+        const ScaledImageT& filter(const ImageT &frame, const std::vector<IdxT> &scales);
+        /** Filter the window of frame at [x0,y0] of size win_size */
+        const ScaledImageT& filterWindow(const ImageT &frame, IdxT x0, IdxT y0, const IVecT &win_size);
+        const ScaledImageT& filterWindow(const ImageT &frame, IdxT x0, IdxT y0, const IVecT &win_size,
+                                         const std::vector<IdxT> &scales);
+        /** Filter an already defect free frame, or window of the frame at [x0,y0], such as a binned frame */
+        const ScaledImageT& filterPatched(const ImageT &im, IdxT x0=0, IdxT y0=0);
+
+        /** The last filtered response.  Slice k is scale scales()[k]. */
+        const ScaledImageT& response() const { return sim; }
+        const std::vector<IdxT>& scales() const { return _scales; }
+
+        /**
+         * Scale-space maxima of the last response as scaleSpaceLoG/DoGMaxima finds them for one frame.  Rows of maxima
+         * are [x y scale] in frame coordinates.  If keep is given, only maxima with keep(x,y) are returned.
+         */
+        IdxT maxima(IMatT &maxima, VecT &max_vals, IdxT neighborhood_size, IdxT scale_neighborhood_size,
+                    const KeepT &keep=KeepT());
+
+    private:
+        const Boxxer2D *_engine;
+        bool use_DoG;
+        IVecT size; //Input size of the filters
+        MatT filter_sigma; //Engine sigma and sigma_ratio the filters were built for
+        FloatT filter_sigma_ratio;
+        std::vector<std::unique_ptr<DoGFilter2D<FloatT,IdxT>>> dog_filters;
+        std::vector<std::unique_ptr<LoGFilter2D<FloatT,IdxT>>> log_filters;
+        std::unique_ptr<Maxima2D<FloatT,IdxT>> maxima2D;
+        std::vector<IdxT> all_scales, _scales;
+        IdxT origin[2]; //Frame coordinates of response(0,0)
+        ImageT window;
+        ScaledImageT sim;
+
+        const std::vector<IdxT>& allScales();
+        const ScaledImageT& filterScales(const ImageT &im, const std::vector<IdxT> &scales);
+    };
+    /** Per-thread FrameFilters, indexed by omp_get_thread_num().  Empty entries are filled as they are needed. */
+    using FrameFilterPool = std::vector<std::unique_ptr<FrameFilter>>;
+    /** Returns frame n, which may be read into buffer.  Called concurrently with a per-thread buffer. */
+    using FrameSourceT = std::function<const ImageT&(IdxT n, ImageT &buffer)>;
+
+    /**
+     * As scaleSpaceLoG/DoGMaxima for nT frames read from a frame source, such as a decoder.  The filters of the pool
+     * are reused across calls.  The Gaussian cache is keyed by frame memory, so it is not used.
+     */
+    IdxT scaleSpaceMaxima(IdxT nT, const FrameSourceT &frames, bool use_DoG, FrameFilterPool &pool, IMatT &maxima,
+                          VecT &max_vals, IdxT neighborhood_size, IdxT scale_neighborhood_size) const;
 
     ImageT make_image() const { return ImageT(imsize(0),imsize(1)); }
     ImageStackT make_image_stack(IdxT nT) const { return ImageStackT(imsize(0),imsize(1),nT); }
     ScaledImageT make_scaled_image() const { return ScaledImageT(imsize(0),imsize(1),nScales); }
     ScaledImageStackT make_scaled_image_stack(IdxT nT) const { return ScaledImageStackT(imsize(0),imsize(1),nScales,nT); }
+    ScaledImageStackT make_interleaved_scaled_image_stack(IdxT nT) const { return ScaledImageStackT(nScales,imsize(0),imsize(1),nT); }
 
     /* Static Methods */
     static void filterLoG(const ImageStackT &im, ImageStackT &fim, const VecT &sigma);
     static void filterDoG(const ImageStackT &im, ImageStackT &fim, const VecT &sigma, FloatT sigma_ratio);
     static void filterGauss(const ImageStackT &im, ImageStackT &fim, const VecT &sigma);
+    static void filterWavelet(const ImageStackT &im, ImageStackT &fim, IdxT level);
     static void checkMaxima(const ImageStackT &im, IMatT &maxima, VecT &max_vals);
     static IdxT enumerateImageMaxima(const ImageStackT &im, IMatT &maxima, VecT &max_vals, IdxT neighborhood_size);
+    /* Fused single-scale detection.  Identical to filterLoG/DoG/Gauss followed by enumerateImageMaxima, keeping only
+     * maxima >threshold, but each frame is filtered into a per-thread buffer so the filtered stack is never stored */
+    static IdxT detectLoG(const ImageStackT &im, const VecT &sigma, IMatT &maxima, VecT &max_vals,
+                          IdxT neighborhood_size, FloatT threshold=-std::numeric_limits<FloatT>::infinity());
+    static IdxT detectDoG(const ImageStackT &im, const VecT &sigma, FloatT sigma_ratio, IMatT &maxima, VecT &max_vals,
+                          IdxT neighborhood_size, FloatT threshold=-std::numeric_limits<FloatT>::infinity());
+    static IdxT detectGauss(const ImageStackT &im, const VecT &sigma, IMatT &maxima, VecT &max_vals,
+                            IdxT neighborhood_size, FloatT threshold=-std::numeric_limits<FloatT>::infinity());
+    /* The window [win_lo,win_lo+win_size) filtered for exact values in the box [lo,hi) of a frame, given the maxima
+     * margin and kernel half-widths hw.  Shared by the masked, mosaic and tiled view paths, and by Boxxer3D */
+    static void filterWindowBounds(const IdxT lo[], const IdxT hi[], const IVecT &frame_size, IdxT margin,
+                                   const IVecT &hw, IdxT win_lo[], IdxT win_size[]);
 
 private:
+    friend class BatchRunner2D<FloatT,IdxT>; //Merges the frame maxima of many engines with combine_maxima
+    friend class Mosaic2D<FloatT,IdxT>; //Gathers defect free windows across the tiles of a mosaic
+    friend class PSFBoxxer<2,FloatT,IdxT>; //Measured PSF filters in place of LoG/DoG
+    std::shared_ptr<GaussCacheT> gauss_cache;
+    std::shared_ptr<const DefectMapT> defect_map;
+
+    const ImageT& defectFreeFrame(const ImageT &frame, ImageT &buffer) const;
+    const ImageT& binnedFrame(const ImageStackT &im, const TemporalBinningT &binning, IdxT b,
+                              ImageT &bin_buffer, ImageT &frame_buffer) const;
+
+    std::shared_ptr<GaussCacheT> copyGaussCache() const;
+    std::shared_ptr<const ImageT> cachedGaussFrame(uint64_t source, IdxT n, const ImageT &frame, const VecT &sigma,
+                                                   const IVecT &hw) const;
+    void filterFrameDoGCached(uint64_t source, IdxT n, const ImageT &frame, ScaledImageT &sim) const;
+    void filterFrameDoGCached(uint64_t source, IdxT n, const ImageT &frame, FloatT *out, IdxT pixel_stride,
+                              std::size_t scale_stride) const;
+    void checkInterleavedSize(const ScaledImageStackT &fim, IdxT nT) const;
+    IVecT maxKernelHW() const;
+    struct MaskTile; //A tile of the frame and its filtering window
+    std::vector<MaskTile> makeMaskTiles(const MaskT *mask, IdxT neighborhood_size, IdxT scale_neighborhood_size) const;
+    FloatT scaleSpaceTileMaxima(const ImageT &frame, const MaskTile &tile, const MaskT *mask, FrameFilter &ff,
+                                IMatT &maxima, VecT &max_vals, IdxT neighborhood_size, IdxT scale_neighborhood_size) const;
+    IdxT scaleSpaceMaximaMasked(const ImageStackT &im, const MaskT &mask, bool use_DoG, IMatT &maxima, VecT &max_vals,
+                                IdxT neighborhood_size, IdxT scale_neighborhood_size) const;
+    IdxT scaleSpaceMaximaTemporal(const ImageStackT &im, bool use_DoG, FloatT threshold, IMatT &maxima, VecT &max_vals,
+                                  IdxT neighborhood_size, IdxT scale_neighborhood_size, TemporalSkipStats *stats) const;
+    IdxT scaleSpaceMaximaThreshold(const ImageStackT &im, bool use_DoG, FloatT threshold, IMatT &maxima, VecT &max_vals,
+                                   IdxT neighborhood_size, IdxT scale_neighborhood_size, IdxT *nSkippedFrames) const;
+    IdxT scaleSpaceMaximaBinned(const ImageStackT &im, bool use_DoG, const TemporalBinningT &binning, IMatT &maxima,
+                                VecT &max_vals, IdxT neighborhood_size, IdxT scale_neighborhood_size) const;
+    IdxT scaleSpaceMaximaAdaptive(const ImageStackT &im, bool use_DoG, FloatT threshold, IMatT &maxima, VecT &max_vals,
+                                  IdxT neighborhood_size, IdxT scale_neighborhood_size,
+                                  const AdaptiveScaleParams &params, AdaptiveScaleStats *stats) const;
+    IdxT scaleSpaceComponents(const ImageStackT &im, bool use_DoG, FloatT threshold, IMatT &components,
+                              VecT &integrated, VecT &peak_vals) const;
+    double kernelL1(IdxT s, bool use_DoG) const;
     IdxT scaleSpaceFrameMaximaRefine(const ScaledImageT &im, IMatT &maxima, VecT &max_vals, IdxT scale_neighborhood_size) const;
     IdxT scaleSpaceFrameMaxima(const ScaledImageT &im, IMatT &maxima, VecT &max_vals,
                                    IdxT neighborhood_size, IdxT scale_neighborhood_size) const;
+    static void thresholdMaxima(const IMatT &maxima, const VecT &max_vals, FloatT threshold,
+                                IMatT &thresh_maxima, VecT &thresh_max_vals);
+    template<class FilterT, class... FilterArgs>
+    static IdxT detectFrames(const ImageStackT &im, IMatT &maxima, VecT &max_vals, IdxT neighborhood_size,
+                             FloatT threshold, const FilterArgs&... filter_args);
     static IdxT combine_maxima(const arma::field<IMatT> &frame_maxima, const arma::field<VecT> &frame_max_vals,
                        IMatT &maxima, VecT &max_vals);
     static void computeDoGSigmas(const MatT &sigma, FloatT sigma_ratio, MatT &gauss_sigmaE, MatT &gauss_sigmaI);
@@ -8,11 +8,22 @@
 #define BOXXER_BOXXER3D_H
 
 #include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <vector>
 #include <armadillo>
 #include "Boxxer/Hypercube/Hypercube.h"
+#include "Boxxer/GaussFilter.h"
+#include "Boxxer/Maxima.h"
+#include "Boxxer/DefectMap.h"
+#include "Boxxer/ScalePruner.h"
+#include "Boxxer/TemporalBinning.h"
 
 namespace boxxer {
 
+template<int Dim, class FloatT, class IdxT> class PSFBoxxer;
+
 /** A box finding algorithm for 3D hyper-spectral microscopy data.
  *
  * Estimates the center coordinates of Gaussian blobs with anisotropic sigmas.
@@ -34,8 +45,18 @@ public:
     using ImageT = arma::Cube<FloatT>;
     using ImageStackT = hypercube::Hypercube<FloatT>;
     using ScaledImageT = hypercube::Hypercube<FloatT>;
+    using InterleavedImageT = hypercube::Hypercube<FloatT>; // [nScales x nrows x ncols x nslices] scales innermost
+    using DefectMapT = DefectMap3D<FloatT,IdxT>;
+    using DefectMaskT = typename DefectMapT::MaskT;
+    using MaskT = arma::Cube<uint8_t>;
+    using ScalePrunerT = ScalePruner<FloatT,IdxT>;
+    using AdaptiveScaleParams = typename ScalePrunerT::Params;
+    using AdaptiveScaleStats = typename ScalePrunerT::Stats;
+    using TemporalBinningT = TemporalBinning<IdxT>;
 
     static const FloatT DefaultSigmaRatio;
+    static const IdxT DefaultWaveletFirstLevel;
+    static const IdxT MaskTileSize; //Tile size for skipping unmasked regions
     static const IdxT dim;
 
     IdxT nScales;
@@ -43,32 +64,185 @@ public:
     MatT sigma; // sized: [2 x nScales].  Rows are [psf_L, psf_y, psf_x] cols are the different scales 
                 //CRITICAL: the order of sigma rows must match the order of dimension in imsize.
     FloatT sigma_ratio;
+    IdxT wavelet_first_level; // Wavelet scales are the a trous levels wavelet_first_level ... +nScales-1
     Boxxer3D(const IVecT &size, const MatT &sigma);
     
     void setDoGSigmaRatio(FloatT sigma_ratio);
+    void setWaveletFirstLevel(IdxT level);
+
+    /* Defect voxel suppression.  See Boxxer2D::setDefectMap */
+    void setDefectMap(const DefectMaskT &defects);
+    void clearDefectMap() { defect_map.reset(); }
+    bool hasDefectMap() const { return static_cast<bool>(defect_map); }
+    DefectMaskT getDefectMap() const;
+    IdxT detectDefectMap(const ImageStackT &im, IdxT nWarmupFrames, FloatT threshold=DefectMapT::DefaultThreshold,
+                         FloatT min_fraction=DefectMapT::DefaultMinFraction);
 
     void filterScaledLoG(const ImageT &im, ScaledImageT &fim);
     void filterScaledDoG(const ImageT &im, ScaledImageT &fim);
+    void filterScaledWavelet(const ImageT &im, ScaledImageT &fim);
+    /* As filterScaledLoG/DoG with fim in the interleaved [nScales x nrows x ncols x nslices] layout */
+    void filterScaledLoGInterleaved(const ImageT &im, InterleavedImageT &fim);
+    void filterScaledDoGInterleaved(const ImageT &im, InterleavedImageT &fim);
+    /* Cross-scale refinement of maxima in an interleaved scaled image.  See Boxxer2D */
+    IdxT scaleSpaceFrameMaximaRefineInterleaved(const InterleavedImageT &isim, IMatT &maxima, VecT &max_vals,
+                                                IdxT scale_neighborhood_size) const;
     IdxT scaleSpaceLoGMaxima(const ImageStackT &im, IMatT &maxima, VecT &max_vals, IdxT neighborhood_size, IdxT scale_neighborhood_size);
     IdxT scaleSpaceDoGMaxima(const ImageStackT &im, IMatT &maxima, VecT &max_vals, IdxT neighborhood_size, IdxT scale_neighborhood_size);
+    IdxT scaleSpaceWaveletMaxima(const ImageStackT &im, IMatT &maxima, VecT &max_vals, IdxT neighborhood_size, IdxT scale_neighborhood_size);
+    /* Shape metrics at LoG maxima.  See Boxxer2D::scaleSpaceLoGMaximaShape.  In 3D hessian_ratio is the smallest
+     * over the largest eigenvalue, so it is near 0 for both filaments and membranes. */
+    IdxT scaleSpaceLoGMaximaShape(const ImageStackT &im, IMatT &maxima, VecT &max_vals, VecT &hessian_ratio,
+                                  IdxT neighborhood_size, IdxT scale_neighborhood_size, VecT *gradient=nullptr);
+    /* Adaptive scale pruning.  See Boxxer2D::scaleSpaceLoGMaximaAdaptive */
+    IdxT scaleSpaceLoGMaximaAdaptive(const ImageStackT &im, FloatT threshold, IMatT &maxima, VecT &max_vals,
+                                     IdxT neighborhood_size, IdxT scale_neighborhood_size,
+                                     const AdaptiveScaleParams &params=AdaptiveScaleParams(),
+                                     AdaptiveScaleStats *stats=nullptr);
+    IdxT scaleSpaceDoGMaximaAdaptive(const ImageStackT &im, FloatT threshold, IMatT &maxima, VecT &max_vals,
+                                     IdxT neighborhood_size, IdxT scale_neighborhood_size,
+                                     const AdaptiveScaleParams &params=AdaptiveScaleParams(),
+                                     AdaptiveScaleStats *stats=nullptr);
+    /* Temporal binning.  See Boxxer2D::scaleSpaceLoGMaximaBinned */
+    IdxT scaleSpaceLoGMaximaBinned(const ImageStackT &im, const TemporalBinningT &binning, IMatT &maxima,
+                                   VecT &max_vals, IdxT neighborhood_size, IdxT scale_neighborhood_size);
+    IdxT scaleSpaceDoGMaximaBinned(const ImageStackT &im, const TemporalBinningT &binning, IMatT &maxima,
+                                   VecT &max_vals, IdxT neighborhood_size, IdxT scale_neighborhood_size);
+
+    /* Spectral projection cascade for sparse hyperspectral frames.  Frames are projected along spectral_dim and
+     * searched with the 2D scale-space detector, and the 3D scale-space maxima are found only in windows spanning
+     * spectral_dim around the 2D maxima >projection_threshold.  See scaleSpaceMaximaCascade */
+    struct SpectralCascadeParams
+    {
+        IdxT spectral_dim=0; //Dimension projected out.  0 is L for [L Y X] frames.
+        bool use_max=false; //Project by maximum rather than sum
+        FloatT projection_threshold=0; //Threshold for the 2D maxima of the projection response
+        IdxT box_radius=0; //Half width of the box kept around each 2D maxima.  0 for ceil(2*max spatial sigma)
+    };
+    struct SpectralCascadeStats
+    {
+        std::size_t nHits=0; //2D maxima of the projections
+        std::size_t nWindowVoxels=0; //Voxels filtered at each scale, summed over windows
+    };
+    IdxT scaleSpaceLoGMaximaCascade(const ImageStackT &im, const SpectralCascadeParams &params, IMatT &maxima,
+                                    VecT &max_vals, IdxT neighborhood_size, IdxT scale_neighborhood_size,
+                                    SpectralCascadeStats *stats=nullptr) const;
+    IdxT scaleSpaceDoGMaximaCascade(const ImageStackT &im, const SpectralCascadeParams &params, IMatT &maxima,
+                                    VecT &max_vals, IdxT neighborhood_size, IdxT scale_neighborhood_size,
+                                    SpectralCascadeStats *stats=nullptr) const;
+
+    /* Mask restricted detection.  See Boxxer2D::scaleSpaceLoGMaximaMasked.  ROI rows are [x0 y0 z0 nx ny nz] */
+    MaskT makeROIMask(const IMatT &rois) const;
+    IdxT scaleSpaceLoGMaximaMasked(const ImageStackT &im, const MaskT &mask, IMatT &maxima, VecT &max_vals,
+                                   IdxT neighborhood_size, IdxT scale_neighborhood_size) const;
+    IdxT scaleSpaceDoGMaximaMasked(const ImageStackT &im, const MaskT &mask, IMatT &maxima, VecT &max_vals,
+                                   IdxT neighborhood_size, IdxT scale_neighborhood_size) const;
+
+    /* Connected components of the thresholded response.  See Boxxer2D::scaleSpaceLoGComponents.  Columns of
+     * components are [x_lo y_lo z_lo x_hi y_hi z_hi peak_x peak_y peak_z peak_scale area frame]. */
+    IdxT scaleSpaceLoGComponents(const ImageStackT &im, FloatT threshold, IMatT &components, VecT &integrated, VecT &peak_vals);
+    IdxT scaleSpaceDoGComponents(const ImageStackT &im, FloatT threshold, IMatT &components, VecT &integrated, VecT &peak_vals);
+
+    /**
+     * Per-thread scale-space filtering for frame loops.  See Boxxer2D::FrameFilter.  The defect map only patches
+     * whole frames, so windows are cut by the caller from a defect free frame and passed to filterPatched.
+     */
+    class FrameFilter
+    {
+    public:
+        using KeepT = std::function<bool(IdxT,IdxT,IdxT)>;
+
+        FrameFilter(const Boxxer3D &engine, bool use_DoG);
+        const Boxxer3D& engine() const { return *_engine; }
+        bool useDoG() const { return use_DoG; }
+
+        /** Filter the whole frame at all scales, or only at the given scales */
+        const ScaledImageT& filter(const ImageT &frame);
+        const ScaledImageT& filter(const ImageT &frame, const std::vector<IdxT> &scales);
+        /** Filter an already defect free frame, or window of the frame at [x0,y0,z0] */
+        const ScaledImageT& filterPatched(const ImageT &im, IdxT x0=0, IdxT y0=0, IdxT z0=0);
+
+        /** The last filtered response.  Hyperslice k is scale scales()[k]. */
+        const ScaledImageT& response() const { return *sim; }
+        const std::vector<IdxT>& scales() const { return _scales; }
+
+        /**
+         * Scale-space maxima of the last response.  Rows of maxima are [x y z scale] in frame coordinates.  If keep
+         * is given, only maxima with keep(x,y,z) are returned.
+         */
+        IdxT maxima(IMatT &maxima, VecT &max_vals, IdxT neighborhood_size, IdxT scale_neighborhood_size,
+                    const KeepT &keep=KeepT());
+
+    private:
+        const Boxxer3D *_engine;
+        bool use_DoG;
+        IVecT size; //Input size of the filters
+        MatT filter_sigma; //Engine sigma and sigma_ratio the filters were built for
+        FloatT filter_sigma_ratio;
+        std::vector<std::unique_ptr<DoGFilter3D<FloatT,IdxT>>> dog_filters;
+        std::vector<std::unique_ptr<LoGFilter3D<FloatT,IdxT>>> log_filters;
+        std::unique_ptr<Maxima3D<FloatT,IdxT>> maxima3D;
+        std::vector<IdxT> all_scales, _scales;
+        IdxT origin[3]; //Frame coordinates of response(0,0,0)
+        ImageT frame_buf;
+        std::unique_ptr<ScaledImageT> sim;
+
+        const std::vector<IdxT>& allScales();
+        const ScaledImageT& filterScales(const ImageT &im, const std::vector<IdxT> &scales);
+    };
 
     ImageT make_image() const { return ImageT(imsize(0),imsize(1),imsize(2)); }
     ImageStackT make_image_stack(IdxT nT) const { return ImageStackT(imsize(0),imsize(1),imsize(2),nT); }
     ScaledImageT make_scaled_image() const { return ScaledImageT(imsize(0),imsize(1),imsize(2),nScales); }
+    InterleavedImageT make_interleaved_scaled_image() const { return InterleavedImageT(nScales,imsize(0),imsize(1),imsize(2)); }
 
     /* Static Methods */
     static void filterLoG(const ImageStackT &im, ImageStackT &fim, const VecT &sigma);
     static void filterDoG(const ImageStackT &im, ImageStackT &fim, const VecT &sigma, FloatT sigma_ratio);
     static void filterGauss(const ImageStackT &im, ImageStackT &fim, const VecT &sigma);
+    static void filterWavelet(const ImageStackT &im, ImageStackT &fim, IdxT level);
     static void checkMaxima(const ImageStackT &im, IMatT &maxima, VecT &max_vals);
     static IdxT enumerateImageMaxima(const ImageStackT &im, IMatT &maxima, VecT &max_vals, IdxT neighborhood_size);
+    /* Fused single-scale detection.  See Boxxer2D::detectLoG */
+    static IdxT detectLoG(const ImageStackT &im, const VecT &sigma, IMatT &maxima, VecT &max_vals,
+                          IdxT neighborhood_size, FloatT threshold=-std::numeric_limits<FloatT>::infinity());
+    static IdxT detectDoG(const ImageStackT &im, const VecT &sigma, FloatT sigma_ratio, IMatT &maxima, VecT &max_vals,
+                          IdxT neighborhood_size, FloatT threshold=-std::numeric_limits<FloatT>::infinity());
+    static IdxT detectGauss(const ImageStackT &im, const VecT &sigma, IMatT &maxima, VecT &max_vals,
+                            IdxT neighborhood_size, FloatT threshold=-std::numeric_limits<FloatT>::infinity());
 
 private:
+    friend class PSFBoxxer<3,FloatT,IdxT>; //Measured PSF filters in place of LoG/DoG
+    std::shared_ptr<const DefectMapT> defect_map;
+
+    const ImageT& defectFreeFrame(const ImageT &frame, ImageT &buffer) const;
+    const ImageT& binnedFrame(const ImageStackT &im, const TemporalBinningT &binning, IdxT b,
+                              ImageT &bin_buffer, ImageT &frame_buffer) const;
     IdxT scaleSpaceFrameMaximaRefine(const ScaledImageT &im, IMatT &maxima, VecT &max_vals, IdxT scale_neighborhood_size) const;
+    void checkInterleavedSize(const InterleavedImageT &fim) const;
     IdxT scaleSpaceFrameMaxima(const ScaledImageT &im, IMatT &maxima, VecT &max_vals,
                               IdxT neighborhood_size, IdxT scale_neighborhood_size) const;
+    IdxT scaleSpaceMaximaBinned(const ImageStackT &im, bool use_DoG, const TemporalBinningT &binning, IMatT &maxima,
+                                VecT &max_vals, IdxT neighborhood_size, IdxT scale_neighborhood_size);
+    IdxT scaleSpaceMaximaCascade(const ImageStackT &im, bool use_DoG, const SpectralCascadeParams &params,
+                                 IMatT &maxima, VecT &max_vals, IdxT neighborhood_size, IdxT scale_neighborhood_size,
+                                 SpectralCascadeStats *stats) const;
+    struct MaskTile; //A tile of the frame and its filtering window
+    std::vector<MaskTile> makeMaskTiles(const MaskT &mask, IdxT neighborhood_size, IdxT scale_neighborhood_size) const;
+    IdxT scaleSpaceMaximaMasked(const ImageStackT &im, const MaskT &mask, bool use_DoG, IMatT &maxima, VecT &max_vals,
+                                IdxT neighborhood_size, IdxT scale_neighborhood_size) const;
+    IdxT scaleSpaceMaximaAdaptive(const ImageStackT &im, bool use_DoG, FloatT threshold, IMatT &maxima, VecT &max_vals,
+                                  IdxT neighborhood_size, IdxT scale_neighborhood_size,
+                                  const AdaptiveScaleParams &params, AdaptiveScaleStats *stats);
+    IdxT scaleSpaceComponents(const ImageStackT &im, bool use_DoG, FloatT threshold, IMatT &components,
+                              VecT &integrated, VecT &peak_vals);
     static IdxT combine_maxima(const arma::field<IMatT> &frame_maxima, const arma::field<VecT> &frame_max_vals,
                               IMatT &maxima, VecT &max_vals);
+    static void thresholdMaxima(const IMatT &maxima, const VecT &max_vals, FloatT threshold,
+                                IMatT &thresh_maxima, VecT &thresh_max_vals);
+    template<class FilterT, class... FilterArgs>
+    static IdxT detectFrames(const ImageStackT &im, IMatT &maxima, VecT &max_vals, IdxT neighborhood_size,
+                             FloatT threshold, const FilterArgs&... filter_args);
     void initialize_log_scale_filters();
     void initialize_dog_scale_filters();
 };
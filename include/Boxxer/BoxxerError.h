@@ -41,6 +41,13 @@ struct NumericalError : public BoxxerError
     NumericalError(std::string message) : BoxxerError("NumericalError",message) {}
 };
 
+/** @brief An external worker process or its I/O failed.
+ */
+struct ProcessError : public BoxxerError
+{
+    ProcessError(std::string message) : BoxxerError("ProcessError",message) {}
+};
+
 } /* namespace boxxer */
 
 #endif /* BOXXER_BOXXER_ERROR_H */
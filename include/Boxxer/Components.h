@@ -0,0 +1,82 @@
+/** @file Components.h
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The class declarations for connected-component labeling of thresholded scale-space responses.
+ *
+ * Aggregates and other extended objects are poorly represented by point maxima.  The labelers take a frame's
+ * scale-space filter response, reduce it to the maximum over scales at each pixel, and find the connected components
+ * of the pixels with response strictly greater than a threshold, using full connectivity (8 neighbors in 2D, 26 in
+ * 3D) like bwlabeln.
+ *
+ * Labeling uses union-find.  The frame is split into tiles along its last dimension that are labeled independently,
+ * in parallel when called outside of a parallel region, and then merged across the tile boundaries, which costs only
+ * the boundary size.  Roots are always the first pixel of their component in column-major order, so components are
+ * numbered the same for any number of tiles.
+ *
+ * Each component is summarized as a column of components: its bounding box, the position and scale of its peak
+ * response, and its area in pixels, together with its integrated response and peak response.  Like the filters these
+ * are per-thread worker objects.
+ */
+#ifndef BOXXER_COMPONENTS_H
+#define BOXXER_COMPONENTS_H
+
+#include <cstdint>
+#include <vector>
+#include <armadillo>
+#include "Boxxer/Hypercube/Hypercube.h"
+
+namespace boxxer {
+
+template<class FloatT=float, class IdxT=uint32_t>
+class ComponentLabeler2D
+{
+public:
+    using IVecT = arma::Col<IdxT>;
+    using IMatT = arma::Mat<IdxT>;
+    using VecT = arma::Col<FloatT>;
+    using ScaledImageT = arma::Cube<FloatT>;
+    static const IdxT NRows; //Rows of components: [x_lo y_lo x_hi y_hi peak_x peak_y peak_scale area]
+
+    IVecT size; //[nrows, ncols]
+
+    explicit ComponentLabeler2D(const IVecT &size);
+
+    /**
+     * @param sim Scale-space response of one frame.  Slices are scales.
+     * @param threshold Pixels with maximum response over scales >threshold are foreground
+     * @param components [out] size:[NRows x nComponents] component summaries
+     * @param integrated [out] Sum of the maximum response over scales over each component
+     * @param peak_vals [out] Peak response of each component
+     * @returns The number of components
+     */
+    IdxT label(const ScaledImageT &sim, FloatT threshold, IMatT &components, VecT &integrated, VecT &peak_vals);
+private:
+    std::vector<FloatT> response;
+    std::vector<IdxT> peak_scale;
+    std::vector<IdxT> parent;
+};
+
+template<class FloatT=float, class IdxT=uint32_t>
+class ComponentLabeler3D
+{
+public:
+    using IVecT = arma::Col<IdxT>;
+    using IMatT = arma::Mat<IdxT>;
+    using VecT = arma::Col<FloatT>;
+    using ScaledImageT = hypercube::Hypercube<FloatT>;
+    static const IdxT NRows; //[x_lo y_lo z_lo x_hi y_hi z_hi peak_x peak_y peak_z peak_scale area]
+
+    IVecT size;
+
+    explicit ComponentLabeler3D(const IVecT &size);
+
+    IdxT label(const ScaledImageT &sim, FloatT threshold, IMatT &components, VecT &integrated, VecT &peak_vals);
+private:
+    std::vector<FloatT> response;
+    std::vector<IdxT> peak_scale;
+    std::vector<IdxT> parent;
+};
+
+} /* namespace boxxer */
+
+#endif /* BOXXER_COMPONENTS_H */
@@ -0,0 +1,102 @@
+/** @file CompressedMovieFile.h
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The class declaration for CompressedMovieFile, a memory mapped read-only losslessly compressed movie file.
+ *
+ * Raw camera movies are highly compressible, and on network storage reading them limits the detection rate.  A
+ * compressed movie file is a small fixed header, an index of the file offsets of each frame, and one independently
+ * compressed block per frame.  A block holds the bytes of the single-precision frame split into four byte planes
+ * (all first bytes, then all second bytes, ...), which groups the slowly varying sign and exponent bytes, compressed
+ * in the LZ4 block format.  A frame that does not compress is stored as is, and is recognized by its block size.
+ * The header and index are checked against the file size on open, and a corrupt block throws rather than reading
+ * or writing out of bounds.
+ *
+ * The scaleSpace methods process the frames with the frame loop of a Boxxer2D engine.  Each
+ * thread decompresses its frame into its own buffer, which is still in cache for the first filter pass, so the
+ * movie is only ever read compressed.
+ *
+ * POSIX only.
+ */
+#ifndef BOXXER_COMPRESSEDMOVIEFILE_H
+#define BOXXER_COMPRESSEDMOVIEFILE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <armadillo>
+#include "Boxxer/Boxxer2D.h"
+
+namespace boxxer {
+
+class CompressedMovieFile
+{
+public:
+    using FloatT = float;
+    using IdxT = uint32_t;
+    using BoxxerT = Boxxer2D<FloatT,IdxT>;
+    using IVecT = BoxxerT::IVecT;
+    using IMatT = BoxxerT::IMatT;
+    using VecT = BoxxerT::VecT;
+    using ImageT = BoxxerT::ImageT;
+    using ImageStackT = BoxxerT::ImageStackT;
+
+    /** On-disk header.  The uint64 index of nframes+1 block offsets follows, then the blocks. */
+    struct Header
+    {
+        char magic[8];
+        uint64_t nrows;
+        uint64_t ncols;
+        uint64_t nframes;
+        uint64_t codec; //Codec::ShuffleLZ4
+    };
+    enum class Codec : uint64_t { ShuffleLZ4=1 };
+    static const char Magic[8];
+
+    explicit CompressedMovieFile(const std::string &path);
+    ~CompressedMovieFile();
+    CompressedMovieFile(const CompressedMovieFile&) = delete;
+    CompressedMovieFile& operator=(const CompressedMovieFile&) = delete;
+
+    const std::string& path() const { return _path; }
+    IVecT imsize() const { return {_nrows, _ncols}; }
+    IdxT nFrames() const { return _nframes; }
+    std::size_t compressedBytes() const { return map_len; }
+    double compressionRatio() const;
+
+    /** Decompress frame n into frame, which is resized to [nrows x ncols] */
+    void readFrame(IdxT n, ImageT &frame) const;
+    /** Decompress frames [begin, end) */
+    ImageStackT frames(IdxT begin, IdxT end) const;
+
+    /** As engine.scaleSpaceLoG/DoGMaxima(frames(0,nFrames()),...) without decompressing the whole movie */
+    IdxT scaleSpaceLoGMaxima(const BoxxerT &engine, IMatT &maxima, VecT &max_vals, IdxT neighborhood_size,
+                             IdxT scale_neighborhood_size) const;
+    IdxT scaleSpaceDoGMaxima(const BoxxerT &engine, IMatT &maxima, VecT &max_vals, IdxT neighborhood_size,
+                             IdxT scale_neighborhood_size) const;
+
+    static void write(const std::string &path, const ImageStackT &im);
+
+    /* The frame codec */
+    static std::size_t compressBound(std::size_t nbytes) { return nbytes + nbytes/255 + 16; }
+    static std::size_t compressFrame(const FloatT *frame, std::size_t nElem, std::vector<uint8_t> &shuffled,
+                                     std::vector<uint8_t> &block);
+    static void decompressFrame(const uint8_t *block, std::size_t nbytes, std::size_t nElem,
+                                std::vector<uint8_t> &shuffled, FloatT *frame);
+
+private:
+    std::string _path;
+    IdxT _nrows, _ncols, _nframes;
+    void *map_addr = nullptr;
+    std::size_t map_len = 0;
+    const uint64_t *index = nullptr;
+
+    std::size_t frameElems() const { return static_cast<std::size_t>(_nrows)*_ncols; }
+    const uint8_t* block(IdxT n) const { return static_cast<const uint8_t*>(map_addr)+index[n]; }
+    std::size_t blockBytes(IdxT n) const { return index[n+1]-index[n]; }
+    IdxT scaleSpaceMaxima(const BoxxerT &engine, bool use_DoG, IMatT &maxima, VecT &max_vals,
+                          IdxT neighborhood_size, IdxT scale_neighborhood_size) const;
+};
+
+} /* namespace boxxer */
+
+#endif /* BOXXER_COMPRESSEDMOVIEFILE_H */
@@ -0,0 +1,91 @@
+/** @file DefectMap.h
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The class declarations for defect pixel maps.
+ *
+ * Hot, dead, and otherwise defective camera pixels produce strong isolated filter responses in every frame.  A
+ * defect map flags these pixels, and frames are patched by replacing each flagged pixel with the median of its
+ * unflagged neighbors (8 in 2D, 26 in 3D) as the frame is read for filtering.  Pixels with no unflagged neighbors
+ * are left as is.
+ *
+ * Maps can be given directly or detected as persistent outliers over the first frames of a movie: a pixel is flagged
+ * when its absolute difference from the median of its neighbors exceeds threshold robust standard deviations of that
+ * difference over the frame in at least min_fraction of the frames.  Emitters blink and move, so they are not
+ * flagged for any reasonable min_fraction.
+ */
+#ifndef BOXXER_DEFECTMAP_H
+#define BOXXER_DEFECTMAP_H
+
+#include <cstdint>
+#include <vector>
+#include <armadillo>
+#include "Boxxer/Hypercube/Hypercube.h"
+
+namespace boxxer {
+
+template<class FloatT=float, class IdxT=uint32_t>
+class DefectMap2D
+{
+public:
+    using IMatT = arma::Mat<IdxT>;
+    using ImageT = arma::Mat<FloatT>;
+    using ImageStackT = arma::Cube<FloatT>;
+    using MaskT = arma::Mat<uint8_t>;
+    static const FloatT DefaultThreshold;
+    static const FloatT DefaultMinFraction;
+
+    MaskT mask; //Nonzero at defects
+    IMatT pixels; //size:[2 x nDefects] coordinates of the defects sorted by column then row
+
+    explicit DefectMap2D(const MaskT &mask);
+    IdxT nDefects() const { return static_cast<IdxT>(pixels.n_cols); }
+
+    /**
+     * Patch the defects within a window of frame.
+     * @param frame The raw frame.  Neighbors are read from here, so they may lie outside the window.
+     * @param window [in,out] A copy of the frame region starting at [x0,y0].  Defects inside it are replaced.
+     */
+    void patch(const ImageT &frame, ImageT &window, IdxT x0=0, IdxT y0=0) const;
+    /**
+     * Extend a bound on the absolute difference and value of two patched frames over the window [x0,x1]x[y0,y1]
+     * to cover the defects in it.  The caller bounds the unflagged pixels directly.
+     */
+    void diff_bound(const ImageT &a, const ImageT &b, IdxT x0, IdxT x1, IdxT y0, IdxT y1,
+                    double &max_diff, double &max_abs) const;
+    /** The value of frame(x,y) after patching */
+    FloatT patched_value(const ImageT &frame, IdxT x, IdxT y) const;
+
+    static MaskT detect(const ImageStackT &im, IdxT nFrames, FloatT threshold, FloatT min_fraction);
+private:
+    std::vector<IdxT> col_start; //size:[ncols+1] index in pixels of the first defect of each column
+
+    template<class Func>
+    void for_each_in(IdxT x0, IdxT x1, IdxT y0, IdxT y1, Func &&func) const;
+};
+
+template<class FloatT=float, class IdxT=uint32_t>
+class DefectMap3D
+{
+public:
+    using IMatT = arma::Mat<IdxT>;
+    using ImageT = arma::Cube<FloatT>;
+    using ImageStackT = hypercube::Hypercube<FloatT>;
+    using MaskT = arma::Cube<uint8_t>;
+    static const FloatT DefaultThreshold;
+    static const FloatT DefaultMinFraction;
+
+    MaskT mask;
+    IMatT pixels; //size:[3 x nDefects]
+
+    explicit DefectMap3D(const MaskT &mask);
+    IdxT nDefects() const { return static_cast<IdxT>(pixels.n_cols); }
+
+    /** Patch the defects of frame into out, which must already hold a copy of frame */
+    void patch(const ImageT &frame, ImageT &out) const;
+
+    static MaskT detect(const ImageStackT &im, IdxT nFrames, FloatT threshold, FloatT min_fraction);
+};
+
+} /* namespace boxxer */
+
+#endif /* BOXXER_DEFECTMAP_H */
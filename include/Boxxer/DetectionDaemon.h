@@ -0,0 +1,172 @@
+/** @file DetectionDaemon.h
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The class declarations for DetectionServer and DetectionClient, a local detection daemon.
+ *
+ * A single long-running DetectionServer owns the OpenMP thread pool and a cache of warm Boxxer2D engines
+ * for every client process on the workstation.  Clients talk to the server over a Unix-domain socket
+ * control channel, and exchange frames and maxima through a POSIX shared-memory ring buffer that the
+ * client creates and the server maps.  A client fills a ring slot in place, submits it, and reads the
+ * maxima back from the same slot, so no frame data is copied between processes.
+ *
+ * All detection requests from all clients are executed in turn on one server thread, so the cores are
+ * scheduled globally rather than by several competing OpenMP pools.  The engine cache is least recently used
+ * with a fixed capacity, and each cached engine keeps its per-thread frame filters warm between requests.
+ *
+ * The control socket is only accessible to the server's user, or also to its group with group_access.  The
+ * ring header sent by a client is checked against the size of the shared memory before it is used.
+ *
+ * POSIX only.
+ */
+#ifndef BOXXER_DETECTIONDAEMON_H
+#define BOXXER_DETECTIONDAEMON_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <armadillo>
+#include "Boxxer/Boxxer2D.h"
+
+namespace boxxer {
+
+class DetectionServer
+{
+public:
+    using FloatT = float;
+    using IdxT = uint32_t;
+    using BoxxerT = Boxxer2D<FloatT,IdxT>;
+
+    /** Maximum number of scales in a client configuration */
+    static const IdxT MaxScales;
+    /** Default capacity of the engine cache */
+    static const IdxT DefaultMaxEngines;
+
+    /**
+     * @param socket_path Path of the Unix-domain control socket.  An existing socket file is replaced.
+     * @param nThreads OpenMP threads used for detection.  0 uses the OpenMP default.
+     * @param max_engines Capacity of the engine cache.  The least recently configured engine is dropped.
+     * @param group_access Socket mode 0660 instead of 0600.
+     */
+    DetectionServer(const std::string &socket_path, IdxT nThreads=0, IdxT max_engines=DefaultMaxEngines,
+                    bool group_access=false);
+    ~DetectionServer();
+    DetectionServer(const DetectionServer&) = delete;
+    DetectionServer& operator=(const DetectionServer&) = delete;
+
+    void start();
+    void stop();
+    bool running() const { return _running; }
+    const std::string& socketPath() const { return socket_path; }
+    std::size_t nEngines() const;
+
+private:
+    struct EngineKey
+    {
+        std::vector<IdxT> imsize;
+        std::vector<FloatT> sigma;
+        FloatT sigma_ratio;
+        bool use_DoG;
+        bool operator<(const EngineKey &o) const
+        {
+            if(imsize != o.imsize) return imsize < o.imsize;
+            if(sigma != o.sigma) return sigma < o.sigma;
+            if(sigma_ratio != o.sigma_ratio) return sigma_ratio < o.sigma_ratio;
+            return use_DoG < o.use_DoG;
+        }
+    };
+    struct CachedEngine;
+    struct Connection;
+    using EngineLRU = std::list<std::pair<EngineKey, std::shared_ptr<CachedEngine>>>;
+
+    std::string socket_path;
+    IdxT nThreads;
+    IdxT max_engines;
+    bool group_access;
+    int listen_fd = -1;
+    std::atomic<bool> _running{false};
+    std::thread accept_thread;
+    std::thread worker_thread;
+
+    mutable std::mutex conn_mtx;
+    std::vector<std::shared_ptr<Connection>> connections;
+
+    mutable std::mutex engine_mtx;
+    EngineLRU engine_lru; //Most recently used first
+    std::map<EngineKey, EngineLRU::iterator> engines;
+
+    std::mutex job_mtx;
+    std::condition_variable job_cv;
+    std::deque<std::function<void()>> jobs;
+    bool jobs_stop = false;
+
+    void acceptLoop();
+    void workerLoop();
+    void serveConnection(std::shared_ptr<Connection> conn);
+    void runJob(std::function<void()> job);
+    std::shared_ptr<CachedEngine> getEngine(const arma::Col<IdxT> &imsize, const arma::Mat<FloatT> &sigma, bool use_DoG,
+                                            FloatT sigma_ratio);
+};
+
+class DetectionClient
+{
+public:
+    using FloatT = float;
+    using IdxT = uint32_t;
+    using IVecT = arma::Col<IdxT>;
+    using IMatT = arma::Mat<IdxT>;
+    using VecT = arma::Col<FloatT>;
+    using MatT = arma::Mat<FloatT>;
+    using ImageStackT = arma::Cube<FloatT>;
+
+    /**
+     * Create a shared-memory ring and attach it to the server.
+     * @param socket_path Server control socket.
+     * @param nSlots Number of ring slots, i.e., the number of submissions that can be in flight.
+     * @param max_frame_elems Capacity of each slot in pixels over all frames.
+     * @param max_maxima Capacity of each slot in maxima.
+     */
+    DetectionClient(const std::string &socket_path, IdxT nSlots, std::size_t max_frame_elems, std::size_t max_maxima);
+    ~DetectionClient();
+    DetectionClient(const DetectionClient&) = delete;
+    DetectionClient& operator=(const DetectionClient&) = delete;
+
+    void configure(const IVecT &imsize, const MatT &sigma, bool use_DoG, FloatT sigma_ratio,
+                   IdxT neighborhood_size, IdxT scale_neighborhood_size);
+
+    IdxT nSlots() const { return _nSlots; }
+    /** Writable view of nT frames of a ring slot.  Fill it in place, then submit() it. */
+    ImageStackT slotFrames(IdxT slot, IdxT nT);
+    void submit(IdxT slot, IdxT nT);
+    /** Wait for the oldest submitted slot and read its maxima.  @returns the slot index */
+    IdxT collect(IMatT &maxima, VecT &max_vals);
+    /** Copy a stack into a free slot, submit it and wait for the maxima */
+    IdxT detect(const ImageStackT &im, IMatT &maxima, VecT &max_vals);
+
+private:
+    int sock_fd = -1;
+    void *ring_addr = nullptr;
+    std::size_t ring_len = 0;
+    IdxT _nSlots;
+    std::size_t max_frame_elems;
+    std::size_t max_maxima;
+    std::size_t slot_bytes;
+    std::size_t maxima_offset;
+    std::size_t vals_offset;
+    IVecT imsize;
+    std::deque<IdxT> pending;
+
+    char* slotPtr(IdxT slot) const;
+};
+
+} /* namespace boxxer */
+
+#endif /* BOXXER_DETECTIONDAEMON_H */
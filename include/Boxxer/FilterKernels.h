@@ -108,6 +108,71 @@ template <class FloatT=float, class IntT=int32_t>
 void gaussFIR_3Dz_small(const arma::Cube<FloatT> &data, arma::Cube<FloatT> &fdata, const arma::Col<FloatT> &kernel);
 /**@}*/
 
+/** @name N-D Gauss FIR Filters
+ *
+ * The single-axis pass under the 2D and 3D filters, for arrays of any rank.
+ *//**@{*/
+/** Filter along one axis of a column-major array [stride x size x outer], as atrousFIR_axis.  Axes of size<=2hw+1
+ * use the same direct sums as the _small filters; the rest give the same results as gaussFIR_1D along each line. */
+template <class FloatT=float, class IntT=int32_t>
+void gaussFIR_axis(IntT size, IntT stride, IntT outer, const FloatT data[], FloatT fdata[], IntT hw, const FloatT kernel[]);
+/**@}*/
+
+/** @name A trous B-spline FIR Filters
+ *
+ * The cubic B-spline kernel [1 4 6 4 1]/16 with step-1 zeros (holes) between the taps, as used by the undecimated
+ * "a trous" wavelet transform, where step=2^(level-1).  Only the 5 non-zero taps are applied, so the cost is
+ * independent of the level.  Boundary conditions are the same mirroring as the Gauss FIR filters, repeated for taps
+ * beyond a single reflection, so every tap reads the image and the kernel sums to 1 at every level and image size.
+ *//**@{*/
+/** Filter along one axis of a column-major array with the given element stride between axis neighbors.
+ * The array is [stride x size x outer]. */
+template <class FloatT=float, class IntT=int32_t>
+void atrousFIR_axis(IntT size, IntT stride, IntT outer, const FloatT data[], FloatT fdata[], IntT step);
+
+template <class FloatT=float, class IntT=int32_t>
+void atrousFIR_2Dx(const arma::Mat<FloatT> &data, arma::Mat<FloatT> &fdata, IntT step);
+
+template <class FloatT=float, class IntT=int32_t>
+void atrousFIR_2Dy(const arma::Mat<FloatT> &data, arma::Mat<FloatT> &fdata, IntT step);
+
+template <class FloatT=float, class IntT=int32_t>
+void atrousFIR_3Dx(const arma::Cube<FloatT> &data, arma::Cube<FloatT> &fdata, IntT step);
+
+template <class FloatT=float, class IntT=int32_t>
+void atrousFIR_3Dy(const arma::Cube<FloatT> &data, arma::Cube<FloatT> &fdata, IntT step);
+
+template <class FloatT=float, class IntT=int32_t>
+void atrousFIR_3Dz(const arma::Cube<FloatT> &data, arma::Cube<FloatT> &fdata, IntT step);
+/**@}*/
+
+/** @name Odd FIR Filters
+ *
+ * Correlation with an antisymmetric kernel k(-r)=-k(r), given by its half kernel [k(0) ... k(hw)] like the Gauss FIR
+ * filters (k(0) is ignored), and added to fdata: fdata(x) += sum_r k(r)*(data(x+r)-data(x-r)).  A gaussFIR_* pass
+ * with the even half of a kernel followed by an oddFIR_* pass with its odd half filters with the general kernel.
+ * Boundary conditions are the same mirroring as the Gauss FIR filters, repeated for kernels longer than the axis.
+ *//**@{*/
+/** Filter along one axis of a column-major array [stride x size x outer], as atrousFIR_axis */
+template <class FloatT=float, class IntT=int32_t>
+void oddFIR_axis(IntT size, IntT stride, IntT outer, const FloatT data[], FloatT fdata[], IntT hw, const FloatT kernel[]);
+
+template <class FloatT=float, class IntT=int32_t>
+void oddFIR_2Dx(const arma::Mat<FloatT> &data, arma::Mat<FloatT> &fdata, const arma::Col<FloatT> &kernel);
+
+template <class FloatT=float, class IntT=int32_t>
+void oddFIR_2Dy(const arma::Mat<FloatT> &data, arma::Mat<FloatT> &fdata, const arma::Col<FloatT> &kernel);
+
+template <class FloatT=float, class IntT=int32_t>
+void oddFIR_3Dx(const arma::Cube<FloatT> &data, arma::Cube<FloatT> &fdata, const arma::Col<FloatT> &kernel);
+
+template <class FloatT=float, class IntT=int32_t>
+void oddFIR_3Dy(const arma::Cube<FloatT> &data, arma::Cube<FloatT> &fdata, const arma::Col<FloatT> &kernel);
+
+template <class FloatT=float, class IntT=int32_t>
+void oddFIR_3Dz(const arma::Cube<FloatT> &data, arma::Cube<FloatT> &fdata, const arma::Col<FloatT> &kernel);
+/**@}*/
+
 } /* namespace boxxer::kernels */
 
 } /* namespace boxxer */
@@ -0,0 +1,65 @@
+/**
+ * @file FilterND.h
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The class declaration for FilterND, the rank-templated separable Gauss, DoG, and LoG filters.
+ *
+ * Images are flat column-major arrays of size SizeT=std::array<IdxT,Rank>.  Every pass is a kernels::gaussFIR_axis
+ * call, the same pass under the 2D and 3D filters, and the passes are ordered as in GaussFilter2D/3D, DoGFilter2D/3D
+ * and LoGFilter2D/3D, so for Rank 2 and 3 the results are identical to those filters.
+ */
+#ifndef BOXXER_FILTERND_H
+#define BOXXER_FILTERND_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <armadillo>
+
+namespace boxxer {
+
+template<int Rank, class FloatT=float, class IdxT=uint32_t>
+class FilterND
+{
+    static_assert(Rank>=1, "FilterND Rank must be positive");
+public:
+    using SizeT = std::array<IdxT,Rank>;
+    using SigmaT = std::array<FloatT,Rank>;
+    using VecT = arma::Col<FloatT>;
+    static const FloatT DefaultSigmaRatio;
+
+    SizeT size;
+    SigmaT sigma;
+    SizeT hw; //Kernel half widths.  Default ceil(3*sigma)
+    FloatT sigma_ratio; //Inhibitory sigma of the DoG filter over sigma
+
+    FilterND(const SizeT &size, const SigmaT &sigma, FloatT sigma_ratio=DefaultSigmaRatio);
+    FilterND(const SizeT &size, const SigmaT &sigma, const SizeT &kernel_hw, FloatT sigma_ratio=DefaultSigmaRatio);
+
+    std::size_t nelem() const { return temp_im0.size(); }
+
+    /** Gaussian filter.  Axes are filtered in ascending order. im and out must not alias. */
+    void gauss(const FloatT *im, FloatT *out);
+    /** Difference of Gaussians: G(sigma)-G(sigma*sigma_ratio) */
+    void DoG(const FloatT *im, FloatT *out);
+    /** Laplacian of Gaussian: the sum over axes d of G''(d) times G on the other axes, in descending axis order */
+    void LoG(const FloatT *im, FloatT *out);
+
+    /** Filter along one axis of an array of the given size with a half kernel [k(0) ... k(hw)] */
+    static void filter_axis(const SizeT &size, int axis, const FloatT *data, FloatT *fdata, const VecT &kernel);
+private:
+    using KernelsT = std::array<VecT,Rank>;
+    KernelsT gauss_kernels;
+    KernelsT inhibit_kernels;
+    KernelsT LoG_kernels;
+    std::vector<FloatT> temp_im0, temp_im1, temp_im2;
+
+    void initialize();
+    /** One separable filter: axis a uses *kernels[a], with the last pass writing to out */
+    void separable(const FloatT *im, FloatT *out, const std::array<const VecT*,Rank> &kernels, bool descending);
+};
+
+} /* namespace boxxer */
+
+#endif /* BOXXER_FILTERND_H */
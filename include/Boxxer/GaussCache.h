@@ -0,0 +1,191 @@
+/** @file GaussCache.h
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The class declaration and inline definitions for GaussCache, an LRU cache of Gaussian filtered frames.
+ *
+ * Interactive parameter tuning repeatedly filters the same frames with a handful of Gaussian kernels.
+ * The GaussCache keeps Gaussian smoothed frames keyed by (source, frame, sigma, hw) so that only the
+ * kernels that actually changed need to be recomputed.  The source is a fingerprint() of the image stack, so frames
+ * of different stacks never alias, even when several threads filter different stacks through one cache.  The total
+ * memory used by the cached frames is bounded, and the least-recently-used frames are evicted first.
+ *
+ * The cache is thread-safe.  Cached frames are handed out as shared pointers to const data, so an evicted
+ * frame stays valid until the last reader releases it.
+ *
+ * The key type is a template parameter, so the same LRU can hold other filtered images, e.g., the scale-space tiles
+ * of ScaleSpaceView2D.  Keys need only be ordered.
+ */
+#ifndef BOXXER_GAUSSCACHE_H
+#define BOXXER_GAUSSCACHE_H
+
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <armadillo>
+
+namespace boxxer {
+
+/** A Gaussian frame cache key.  The kernel half-width is part of the key as it changes the filtered result. */
+template<class FloatT=float, class IdxT=uint32_t>
+struct GaussCacheKey
+{
+    uint64_t source;
+    IdxT frame;
+    std::vector<FloatT> sigma;
+    std::vector<IdxT> hw;
+
+    bool operator<(const GaussCacheKey &o) const
+    {
+        if(source != o.source) return source < o.source;
+        if(frame != o.frame) return frame < o.frame;
+        if(sigma != o.sigma) return sigma < o.sigma;
+        return hw < o.hw;
+    }
+};
+
+template<class ImageT, class FloatT=float, class IdxT=uint32_t, class KeyT=GaussCacheKey<FloatT,IdxT>>
+class GaussCache
+{
+public:
+    using ImagePtrT = std::shared_ptr<const ImageT>;
+    using Key = KeyT;
+
+    /** Cache usage statistics */
+    struct Stats
+    {
+        std::size_t hits=0;
+        std::size_t misses=0;
+        std::size_t evictions=0;
+        std::size_t n_entries=0;
+        std::size_t bytes=0;
+        std::size_t max_bytes=0;
+    };
+
+    explicit GaussCache(std::size_t max_bytes) : max_bytes(max_bytes) { }
+
+    static GaussCacheKey<FloatT,IdxT> make_key(uint64_t source, IdxT frame, const arma::Col<FloatT> &sigma,
+                                               const arma::Col<IdxT> &hw)
+    {
+        return GaussCacheKey<FloatT,IdxT>{source, frame, std::vector<FloatT>(sigma.memptr(), sigma.memptr()+sigma.n_elem),
+                          std::vector<IdxT>(hw.memptr(), hw.memptr()+hw.n_elem)};
+    }
+
+    /** A 64-bit fingerprint of the contents of a source image stack.
+     *
+     * Buffers are often reused for new data, e.g., by MATLAB, so a data pointer alone does not identify a stack.
+     * Hashing the stack is a single pass that is cheap next to filtering it with even one kernel.
+     */
+    static uint64_t fingerprint(const void *data, std::size_t nbytes)
+    {
+        const uint64_t prime = 0x100000001b3ULL;
+        uint64_t h = 0xcbf29ce484222325ULL ^ nbytes;
+        const unsigned char *bytes = static_cast<const unsigned char*>(data);
+        std::size_t nwords = nbytes/sizeof(uint64_t);
+        for(std::size_t i=0; i<nwords; i++) {
+            uint64_t w;
+            std::memcpy(&w, bytes+i*sizeof(uint64_t), sizeof(w));
+            h = (h ^ w) * prime;
+            h ^= h >> 29;
+        }
+        for(std::size_t i=nwords*sizeof(uint64_t); i<nbytes; i++) h = (h ^ bytes[i]) * prime;
+        return h;
+    }
+
+    /** @returns The cached frame for key or nullptr if not cached.  A hit makes the frame most-recently-used. */
+    ImagePtrT find(const Key &key)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = index.find(key);
+        if(it == index.end()) {
+            stats.misses++;
+            return nullptr;
+        }
+        stats.hits++;
+        lru.splice(lru.begin(), lru, it->second);
+        return it->second->second;
+    }
+
+    /** @returns True if key is cached.  Unlike find(), neither the statistics nor the LRU order change. */
+    bool contains(const Key &key) const
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        return index.count(key)>0;
+    }
+
+    /** Insert a new frame as the most-recently-used entry, evicting old entries to stay under max_bytes.
+     * Frames larger than max_bytes are never cached.
+     */
+    void insert(const Key &key, ImagePtrT im)
+    {
+        std::size_t nbytes = im->n_elem*sizeof(FloatT);
+        std::lock_guard<std::mutex> lock(mtx);
+        if(nbytes > max_bytes) return;
+        auto it = index.find(key);
+        if(it != index.end()) {
+            lru.splice(lru.begin(), lru, it->second);
+            return;
+        }
+        while(!lru.empty() && stats.bytes+nbytes > max_bytes) evict_lru();
+        lru.emplace_front(key, std::move(im));
+        index[key] = lru.begin();
+        stats.bytes += nbytes;
+        stats.n_entries++;
+    }
+
+    void set_max_bytes(std::size_t new_max_bytes)
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        max_bytes = new_max_bytes;
+        while(!lru.empty() && stats.bytes > max_bytes) evict_lru();
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        clear_locked();
+    }
+
+    Stats get_stats() const
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        Stats s = stats;
+        s.max_bytes = max_bytes;
+        return s;
+    }
+
+private:
+    using EntryT = std::pair<Key, ImagePtrT>;
+    using ListT = std::list<EntryT>;
+
+    std::size_t max_bytes;
+    ListT lru; //front is most-recently-used
+    std::map<Key, typename ListT::iterator> index;
+    Stats stats;
+    mutable std::mutex mtx;
+
+    void evict_lru()
+    {
+        auto &entry = lru.back();
+        stats.bytes -= entry.second->n_elem*sizeof(FloatT);
+        stats.n_entries--;
+        stats.evictions++;
+        index.erase(entry.first);
+        lru.pop_back();
+    }
+
+    void clear_locked()
+    {
+        lru.clear();
+        index.clear();
+        stats.bytes = 0;
+        stats.n_entries = 0;
+    }
+};
+
+} /* namespace boxxer */
+
+#endif /* BOXXER_GAUSSCACHE_H */
@@ -34,8 +34,10 @@ public:
 
     virtual void set_kernel_hw(const IVecT &kernel_half_width)=0;
 
+    static IVecT default_kernel_hw(const VecT &sigma);
     static VecT compute_Gauss_FIR_kernel(FloatT sigma, IdxT hw);
     static VecT compute_LoG_FIR_kernel(FloatT sigma, IdxT hw);
+    static VecT compute_dGauss_FIR_kernel(FloatT sigma, IdxT hw);
 protected:
     static const IdxT max_kernel_hw;
     static const FloatT default_sigma_hw_ratio;
@@ -83,6 +85,8 @@ public:
     ImageT make_image() const { return ImageT(this->size(0),this->size(1)); }
 
     void filter(const ImageT &im, ImageT &out);
+    /** As filter(), writing the response at pixel k to out[k*stride], e.g., one scale of an interleaved scale stack */
+    void filter(const ImageT &im, FloatT *out, IdxT stride);
     void test_filter(const ImageT &im);
 
     template<class FloatT_, class IdxT_>
@@ -90,6 +94,7 @@ public:
 private:
     ImageT temp_im0;
     ImageT temp_im1;
+    ImageT temp_im2; //Sized only by the strided filter()
     arma::field<VecT> excite_kernels;
     arma::field<VecT> inhibit_kernels;
 };
@@ -108,15 +113,25 @@ public:
     ImageT make_image() const { return ImageT(this->size(0),this->size(1)); }
 
     void filter(const ImageT &im, ImageT &out);
+    /** As filter(), writing the response at pixel k to out[k*stride], e.g., one scale of an interleaved scale stack */
+    void filter(const ImageT &im, FloatT *out, IdxT stride);
+    /** As filter(), also keeping the x term G''(x)G(y).  The y term is out-dxx. */
+    void filter(const ImageT &im, ImageT &out, ImageT &dxx);
     void test_filter(const ImageT &im);
 
+    /* Point evaluations at a single pixel, normalized like the LoG terms, i.e., the LoG x term is -sigma_x*d2/dx2 */
+    FloatT hessian_cross(const ImageT &im, IdxT x, IdxT y) const; // -sqrt(sigma_x*sigma_y)*d2/dxdy
+    FloatT gradient_norm(const ImageT &im, IdxT x, IdxT y) const; // |[sigma_x*d/dx, sigma_y*d/dy]|
+
     template<class FloatT_, class IdxT_>
     friend std::ostream& operator<<(std::ostream &out, const LoGFilter2D<FloatT_,IdxT_> &filt);
 private:
     ImageT temp_im0;
     ImageT temp_im1;
+    ImageT temp_im2; //Sized only by the strided filter()
     arma::field<VecT>  gauss_kernels;
     arma::field<VecT>  LoG_kernels;
+    arma::field<VecT>  dgauss_kernels; //Antisymmetric half-kernels of the first derivative, used only at points
 };
 /**@}*/
 
@@ -163,6 +178,9 @@ public:
     ImageT make_image() const { return ImageT(this->size(0),this->size(1),this->size(2)); }
 
     void filter(const ImageT &im, ImageT &out);
+    /** As filter(), writing the response at pixel k of z-slice z to slice_out[z][k*stride], e.g., one scale of an
+     * interleaved scaled image whose z-slices are separately allocated */
+    void filter(const ImageT &im, FloatT *const slice_out[], IdxT stride);
     void test_filter(const ImageT &im);
 
     template<class FloatT_, class IdxT_>
@@ -170,6 +188,7 @@ public:
 private:
     ImageT temp_im0;
     ImageT temp_im1;
+    ImageT temp_im2; //Sized only by the strided filter()
     arma::field<VecT> excite_kernels;
     arma::field<VecT> inhibit_kernels;
 };
@@ -188,14 +207,25 @@ public:
     ImageT make_image() const { return ImageT(this->size(0),this->size(1),this->size(2)); }
 
     void filter(const ImageT &im, ImageT &out);
+    /** As filter(), writing the response at pixel k of z-slice z to slice_out[z][k*stride], e.g., one scale of an
+     * interleaved scaled image whose z-slices are separately allocated */
+    void filter(const ImageT &im, FloatT *const slice_out[], IdxT stride);
+    /** As filter(), also keeping the x and y terms.  The z term is out-dxx-dyy. */
+    void filter(const ImageT &im, ImageT &out, ImageT &dxx, ImageT &dyy);
     void test_filter(const ImageT &im);
 
+    /* Point evaluations at a single pixel, normalized like the LoG terms */
+    VecT hessian_cross(const ImageT &im, IdxT x, IdxT y, IdxT z) const; // [xy, xz, yz]
+    FloatT gradient_norm(const ImageT &im, IdxT x, IdxT y, IdxT z) const;
+
     template<class FloatT_, class IdxT_>
     friend std::ostream& operator<<(std::ostream &out, const LoGFilter3D<FloatT_,IdxT_> &filt);
 private:
     ImageT temp_im0, temp_im1;
+    ImageT temp_im2; //Sized only by the strided filter()
     arma::field<VecT> gauss_kernels;
     arma::field<VecT> LoG_kernels;
+    arma::field<VecT> dgauss_kernels;
 };
 /**@}*/
 
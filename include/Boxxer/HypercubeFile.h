@@ -0,0 +1,106 @@
+/** @file HypercubeFile.h
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The class declaration for HypercubeFile, a memory mapped file-backed 4D [x y S t] array.
+ *
+ * The full filterScaledLoG/DoG output of a long movie is nScales times larger than the movie and need not fit in RAM.
+ * A HypercubeFile is a small fixed header followed by the column-major 4D array, stored either as single-precision
+ * floats or as IEEE half-precision (fp16) values at half the size.  The filter methods write into the memory mapped
+ * file directly, in chunks of frames.  Writeback of a chunk starts as soon as it is filtered, and it is committed
+ * with msync and dropped from the process with madvise(MADV_DONTNEED) once the next chunk is filtered, so at most
+ * two chunks are resident, the current one and the one being written back, not the whole movie.  Float16 files also
+ * hold one chunk of single-precision output in a conversion buffer.
+ *
+ * The static Boxxer2D filters (filterLoG, filterDoG, filterGauss) write a [x y 1 t] HypercubeFile.
+ *
+ * Only Boxxer2D output is supported; there is no Boxxer3D equivalent, and the class has no MEX binding.
+ *
+ * POSIX only.
+ */
+#ifndef BOXXER_HYPERCUBEFILE_H
+#define BOXXER_HYPERCUBEFILE_H
+
+#include <cstdint>
+#include <string>
+#include <armadillo>
+#include "Boxxer/Boxxer2D.h"
+
+namespace boxxer {
+
+class HypercubeFile
+{
+public:
+    using FloatT = float;
+    using IdxT = uint32_t;
+    using BoxxerT = Boxxer2D<FloatT,IdxT>;
+    using VecT = BoxxerT::VecT;
+    using ImageStackT = BoxxerT::ImageStackT;
+    using ScaledImageT = BoxxerT::ScaledImageT;
+    using ScaledImageStackT = BoxxerT::ScaledImageStackT;
+
+    enum class Precision {
+        Float32, ///< single-precision, can be wrapped as a Hypercube without copying
+        Float16  ///< IEEE half-precision, converted on write and read
+    };
+
+    /** On-disk header.  The array data starts immediately after at a 64-byte aligned offset */
+    struct Header
+    {
+        char magic[8];
+        uint64_t size[4]; //[sX, sY, sZ, sN]
+        uint64_t elem_bytes; //4 or 2
+        uint64_t reserved[2];
+    };
+    static const char Magic[8];
+    static const std::size_t DefaultChunkBytes; //Output bytes per committed chunk of frames
+
+    /** Create a new file of size [sX x sY x sZ x sN], mapped read-write.  An existing file is replaced. */
+    HypercubeFile(const std::string &path, IdxT sX, IdxT sY, IdxT sZ, IdxT sN, Precision precision=Precision::Float32);
+    /** Open an existing file, mapped read-only */
+    explicit HypercubeFile(const std::string &path);
+    ~HypercubeFile();
+    HypercubeFile(const HypercubeFile&) = delete;
+    HypercubeFile& operator=(const HypercubeFile&) = delete;
+
+    const std::string& path() const { return _path; }
+    IdxT size(IdxT d) const { return _size[d]; }
+    IdxT nFrames() const { return _size[3]; }
+    Precision precision() const { return _precision; }
+    bool writable() const { return _writable; }
+
+    /** Wrap frames [begin, end) of a Float32 file as a Hypercube using the mapped memory directly.
+     * The Hypercube must not outlive this object.  Call commit() once the frames are written. */
+    ScaledImageStackT frames(IdxT begin, IdxT end);
+    /** Copy frame n into out, converting from fp16 if necessary.  out is resized to [sX x sY x sZ]. */
+    void readFrame(IdxT n, ScaledImageT &out) const;
+    /** Flush frames [begin, end) to the file and release their pages from this process */
+    void commit(IdxT begin, IdxT end);
+
+    /** Scale-space filter im with engine into this [imsize(0) x imsize(1) x nScales x nFrames] file.
+     * @param chunk_frames Frames per committed chunk.  0 chooses about DefaultChunkBytes per chunk. */
+    void filterScaledLoG(const BoxxerT &engine, const ImageStackT &im, IdxT chunk_frames=0);
+    void filterScaledDoG(const BoxxerT &engine, const ImageStackT &im, IdxT chunk_frames=0);
+    /** As Boxxer2D::filterLoG, filterDoG, and filterGauss, into this [nRows x nCols x 1 x nFrames] file */
+    void filterLoG(const ImageStackT &im, const VecT &sigma, IdxT chunk_frames=0);
+    void filterDoG(const ImageStackT &im, const VecT &sigma, FloatT sigma_ratio, IdxT chunk_frames=0);
+    void filterGauss(const ImageStackT &im, const VecT &sigma, IdxT chunk_frames=0);
+
+private:
+    std::string _path;
+    IdxT _size[4];
+    Precision _precision;
+    bool _writable;
+    void *map_addr = nullptr;
+    std::size_t map_len = 0;
+    char *_data = nullptr;
+
+    std::size_t frameElems() const { return static_cast<std::size_t>(_size[0])*_size[1]*_size[2]; }
+    std::size_t elemBytes() const { return _precision==Precision::Float32 ? sizeof(FloatT) : sizeof(uint16_t); }
+    void checkFrameRange(IdxT begin, IdxT end) const;
+    template<class FilterF>
+    void writeChunks(const ImageStackT &im, IdxT nScales, IdxT chunk_frames, FilterF filter);
+};
+
+} /* namespace boxxer */
+
+#endif /* BOXXER_HYPERCUBEFILE_H */
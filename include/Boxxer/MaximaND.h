@@ -0,0 +1,70 @@
+/**
+ * @file MaximaND.h
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The class declaration for MaximaND, the rank-templated local maxima finder under Maxima2D and Maxima3D.
+ *
+ * Images are flat column-major arrays of size SizeT=std::array<IdxT,Rank>.  A maxima is strictly greater than every
+ * in-bounds neighbor in its 3^Rank box.  The neighbor displacements are generated at compile time, so the interior
+ * check is a fixed-length loop over precomputed linear offsets, and only pixels on the image boundary pay for bounds
+ * checks.  Larger neighborhoods refine the 3^Rank maxima: no pixel of the (truncated) box may be larger.
+ */
+#ifndef BOXXER_MAXIMAND_H
+#define BOXXER_MAXIMAND_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <armadillo>
+
+namespace boxxer {
+
+/** 3^n, the size of the 3x3x... box at rank n */
+constexpr int pow3(int n) { return n<=0 ? 1 : 3*pow3(n-1); }
+
+template<int Rank, class FloatT=float, class IdxT=uint32_t>
+class MaximaND
+{
+    static_assert(Rank>=1, "MaximaND Rank must be positive");
+public:
+    using SizeT = std::array<IdxT,Rank>;
+    using IMatT = arma::Mat<IdxT>;
+    using VecT = arma::Col<FloatT>;
+    static const IdxT MinBoxsize;
+    static constexpr int NNeighbors = pow3(Rank)-1;
+
+    SizeT size;
+    IdxT boxsize;
+
+    MaximaND(const SizeT &size, IdxT boxsize=MinBoxsize);
+
+    /**
+     * Find the maxima of im over boxsize neighborhoods.  Maxima are in column-major order of their position.
+     * @returns Number of maxima, which are retrieved with read_maxima()
+     */
+    IdxT find_maxima(const FloatT *im);
+    IdxT find_maxima(const FloatT *im, IMatT &maxima_out, VecT &max_vals_out);
+    void read_maxima(IMatT &maxima_out, VecT &max_vals_out) const;
+    IdxT refine_maxima(const FloatT *im, IMatT &maxima_io, VecT &max_vals_io, IdxT neighborhood_size) const;
+    /** True if the pixel at coords is strictly greater than every other pixel of its truncated neighborhood */
+    bool check_maxima(const FloatT *im, const IdxT coords[], IdxT neighborhood_size=MinBoxsize) const;
+
+private:
+    using OffsetT = std::ptrdiff_t;
+    SizeT stride;
+    std::size_t nelem;
+    std::array<OffsetT,NNeighbors-2> offsets; //Linear offsets of the neighbors off axis 0
+    IdxT Nmaxima=0;
+    std::vector<IdxT> maxima; //[Rank x Nmaxima] flat
+    std::vector<FloatT> max_vals;
+
+    void maxima_3x3(const FloatT *im);
+    IdxT maxima_nxn(const FloatT *im, IdxT neighborhood_size);
+    bool boundary_maxima(const FloatT *im, const SizeT &coords, FloatT val) const;
+    void record_maxima(const SizeT &coords, FloatT val);
+};
+
+} /* namespace boxxer */
+
+#endif /* BOXXER_MAXIMAND_H */
@@ -0,0 +1,76 @@
+/** @file Mosaic2D.h
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The class declaration for Mosaic2D, scale-space maxima for mosaics of overlapping 2D tiles.
+ *
+ * Slide scanners acquire a grid of overlapping fields of view.  Rather than running a Boxxer2D on each tile and
+ * removing duplicate maxima in the overlaps afterwards, the Mosaic2D assigns every mosaic pixel to exactly one
+ * owning tile: of the tiles covering it, the one with the nearest center, with ties going to the lower tile index.
+ * For a regular grid this splits each overlap down its middle.
+ *
+ * Each tile then filters only the bounding box of the pixels it owns, plus a halo for the filter kernels and the
+ * maxima neighborhoods, exactly as the masked tiles of Boxxer2D do.  Halo and overlap pixels are read from their
+ * owning tile, so every pixel is filtered from the same data whichever tile reads it, and each overlap is filtered
+ * once rather than once per covering tile.  Only maxima at owned pixels are kept, so each is reported exactly once.
+ * The result is identical to running the engine on the whole mosaic stitched by ownership.  Mosaic pixels not
+ * covered by any tile are filled from the nearest pixel of the tile being processed.
+ */
+#ifndef BOXXER_MOSAIC2D_H
+#define BOXXER_MOSAIC2D_H
+
+#include <cstdint>
+#include <vector>
+#include <armadillo>
+#include "Boxxer/Boxxer2D.h"
+
+namespace boxxer {
+
+template<class FloatT=float, class IdxT=uint32_t>
+class Mosaic2D
+{
+public:
+    using BoxxerT = Boxxer2D<FloatT,IdxT>;
+    using IVecT = typename BoxxerT::IVecT;
+    using IMatT = typename BoxxerT::IMatT;
+    using VecT = typename BoxxerT::VecT;
+    using ImageT = typename BoxxerT::ImageT;
+    using ImageStackT = typename BoxxerT::ImageStackT;
+
+    BoxxerT engine; //engine.imsize is the tile size.  Shared by all tiles.
+    IMatT positions; //size:[2 x nTiles] Mosaic [x,y] of each tile's pixel (0,0)
+    IVecT mosaic_size; //Extent of the tiles in the mosaic
+
+    Mosaic2D(const BoxxerT &engine, const IMatT &positions);
+
+    IdxT nTiles() const { return static_cast<IdxT>(positions.n_cols); }
+    /** The tile owning mosaic pixel (x,y), or nTiles() if no tile covers it */
+    IdxT owner(IdxT x, IdxT y) const;
+
+    /**
+     * Scale-space maxima of the mosaic.
+     * @param tiles Stack of nTiles engine.imsize shaped tiles, in the order of positions.
+     * @param maxima [out] size:[4 x N] rows=[x, y, scale, tile] in mosaic coordinates, ordered by tile.
+     */
+    IdxT scaleSpaceLoGMaxima(const ImageStackT &tiles, IMatT &maxima, VecT &max_vals,
+                             IdxT neighborhood_size, IdxT scale_neighborhood_size) const;
+    IdxT scaleSpaceDoGMaxima(const ImageStackT &tiles, IMatT &maxima, VecT &max_vals,
+                             IdxT neighborhood_size, IdxT scale_neighborhood_size) const;
+
+private:
+    struct OwnedRegion
+    {
+        bool empty;
+        IdxT lo[2], hi[2]; //Bounding box of the owned pixels [lo,hi) in mosaic coordinates
+        std::vector<IdxT> overlaps; //Tiles intersecting this tile, including itself
+    };
+    std::vector<OwnedRegion> regions;
+
+    IdxT owner(IdxT x, IdxT y, const std::vector<IdxT> &candidates) const;
+    bool covers(IdxT tile, IdxT x, IdxT y) const;
+    IdxT scaleSpaceMaxima(const ImageStackT &tiles, bool use_DoG, IMatT &maxima, VecT &max_vals,
+                          IdxT neighborhood_size, IdxT scale_neighborhood_size) const;
+};
+
+} /* namespace boxxer */
+
+#endif /* BOXXER_MOSAIC2D_H */
@@ -0,0 +1,65 @@
+/** @file MovieFile.h
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The class declaration for MovieFile, a memory mapped read-only movie file.
+ *
+ * A Boxxer movie file is a small fixed header followed by the raw single-precision frames in column-major
+ * order, i.e., exactly the memory layout of an arma::Cube<float> of size [nrows x ncols x nframes].
+ * The file is memory mapped, so any contiguous range of frames can be wrapped as a Cube without copying,
+ * and several processes can share the same pages from the OS page cache.
+ *
+ * POSIX only.
+ */
+#ifndef BOXXER_MOVIEFILE_H
+#define BOXXER_MOVIEFILE_H
+
+#include <cstdint>
+#include <string>
+#include <armadillo>
+
+namespace boxxer {
+
+class MovieFile
+{
+public:
+    using FloatT = float;
+    using IdxT = uint32_t;
+    using IVecT = arma::Col<IdxT>;
+    using ImageStackT = arma::Cube<FloatT>;
+
+    /** On-disk header.  The frame data starts immediately after at a 32-byte aligned offset */
+    struct Header
+    {
+        char magic[8];
+        uint64_t nrows;
+        uint64_t ncols;
+        uint64_t nframes;
+    };
+    static const char Magic[8];
+
+    explicit MovieFile(const std::string &path);
+    ~MovieFile();
+    MovieFile(const MovieFile&) = delete;
+    MovieFile& operator=(const MovieFile&) = delete;
+
+    const std::string& path() const { return _path; }
+    IVecT imsize() const { return {_nrows, _ncols}; }
+    IdxT nFrames() const { return _nframes; }
+    const FloatT* data() const { return _data; }
+
+    /** Wrap frames [begin, end) as a Cube using the mapped memory directly.  The Cube must not outlive this object. */
+    const ImageStackT frames(IdxT begin, IdxT end) const;
+
+    static void write(const std::string &path, const ImageStackT &im);
+
+private:
+    std::string _path;
+    IdxT _nrows, _ncols, _nframes;
+    void *map_addr = nullptr;
+    std::size_t map_len = 0;
+    FloatT *_data = nullptr;
+};
+
+} /* namespace boxxer */
+
+#endif /* BOXXER_MOVIEFILE_H */
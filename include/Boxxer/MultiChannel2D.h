@@ -0,0 +1,83 @@
+/** @file MultiChannel2D.h
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The class declaration for MultiChannel2D, scale-space maxima for multi-channel 2D movies.
+ *
+ * Multi-color experiments record several camera channels of the same size.  Rather than running a separate
+ * Boxxer2D per channel, the MultiChannel2D processes every (frame, channel) pair in one OpenMP loop.  All channels
+ * share one Boxxer2D engine, so the filter kernels and per-thread temporaries are built once, not once per channel.
+ *
+ * Detections may then be matched across channels.  Each channel's coordinates are mapped into a common reference
+ * frame with an affine registration, and maxima in the same frame within a radius of each other are coincident.
+ * Matching uses a uniform grid with cell size equal to the radius, so only the 3x3 surrounding cells are searched.
+ */
+#ifndef BOXXER_MULTICHANNEL2D_H
+#define BOXXER_MULTICHANNEL2D_H
+
+#include <cstdint>
+#include <armadillo>
+#include "Boxxer/Boxxer2D.h"
+
+namespace boxxer {
+
+template<class FloatT=float, class IdxT=uint32_t>
+class MultiChannel2D
+{
+public:
+    using BoxxerT = Boxxer2D<FloatT,IdxT>;
+    using IVecT = typename BoxxerT::IVecT;
+    using IMatT = typename BoxxerT::IMatT;
+    using VecT = typename BoxxerT::VecT;
+    using MatT = typename BoxxerT::MatT;
+    using ImageStackT = typename BoxxerT::ImageStackT;
+
+    /** How channels are arranged along the slice axis of a single image stack */
+    enum class Layout {
+        Interleaved, ///< slice = t*nChannels + c, e.g., alternating excitation
+        Sequential   ///< slice = c*nT + t, i.e., whole channel stacks concatenated
+    };
+
+    BoxxerT engine; //Shared by all channels
+    IdxT nChannels;
+    Layout layout;
+
+    MultiChannel2D(const BoxxerT &engine, IdxT nChannels, Layout layout=Layout::Interleaved);
+
+    IdxT nFrames(const ImageStackT &im) const;
+
+    /**
+     * Scale-space maxima of every channel.  Results for each channel are identical to calling scaleSpaceLoGMaxima or
+     * scaleSpaceDoGMaxima on that channel's stack alone.
+     * @param maxima [out] size:[5 x N] rows=[x, y, scale, frame, channel], ordered by frame then channel.
+     */
+    IdxT scaleSpaceLoGMaxima(const ImageStackT &im, IMatT &maxima, VecT &max_vals,
+                             IdxT neighborhood_size, IdxT scale_neighborhood_size) const;
+    IdxT scaleSpaceDoGMaxima(const ImageStackT &im, IMatT &maxima, VecT &max_vals,
+                             IdxT neighborhood_size, IdxT scale_neighborhood_size) const;
+
+    /**
+     * Count, for each maxima, the number of other channels with a maxima in the same frame within radius.
+     * @param maxima size:[5 x N] as returned by scaleSpace*Maxima.
+     * @param registration size:[2 x 3 x nChannels] Affine map for each channel from its (x,y) into the reference
+     *                     frame as [x';y'] = R(:,0:1)*[x;y] + R(:,2).  An empty cube means identity for all channels.
+     * @param radius Coincidence radius in reference frame pixels.  Must be >0.
+     * @param nCoincident [out] size:[N] Number of other channels with a coincident maxima.
+     */
+    void coincidence(const IMatT &maxima, const arma::Cube<FloatT> &registration, FloatT radius, IVecT &nCoincident) const;
+    /**
+     * Keep only maxima that are found in at least min_channels channels (counting their own), preserving order.
+     * @returns New number of maxima
+     */
+    IdxT filterCoincident(IMatT &maxima, VecT &max_vals, const arma::Cube<FloatT> &registration, FloatT radius,
+                          IdxT min_channels=2) const;
+
+private:
+    IdxT scaleSpaceMaxima(const ImageStackT &im, bool use_DoG, IMatT &maxima, VecT &max_vals,
+                          IdxT neighborhood_size, IdxT scale_neighborhood_size) const;
+    IdxT sliceIndex(IdxT t, IdxT c, IdxT nT) const
+    { return layout==Layout::Interleaved ? t*nChannels+c : c*nT+t; }
+};
+
+} /* namespace boxxer */
+
+#endif /* BOXXER_MULTICHANNEL2D_H */
@@ -0,0 +1,80 @@
+/** @file PSFBoxxer.h
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The class declaration for PSFBoxxer, scale-space maxima with measured PSF matched filters.
+ *
+ * PSFBoxxer replaces the LoG or DoG filter of Boxxer2D and Boxxer3D with low-rank separable matched filters
+ * built from a list of measured PSFs (see PSFFilter.h).  Each PSF plays the role of a scale, e.g., the focal
+ * planes of an astigmatic PSF model, so the same Maxima2D/Maxima3D search and scale refinement apply and the
+ * maxima scale row is the index of the best matching PSF.  Matched filter responses are positive at spots.
+ *
+ * The PSF decompositions are computed once on construction and copied to each thread.
+ */
+#ifndef BOXXER_PSFBOXXER_H
+#define BOXXER_PSFBOXXER_H
+
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+#include <armadillo>
+#include "Boxxer/Boxxer2D.h"
+#include "Boxxer/Boxxer3D.h"
+#include "Boxxer/PSFFilter.h"
+
+namespace boxxer {
+
+template<int Dim, class FloatT=float, class IdxT=uint32_t>
+class PSFBoxxer
+{
+    static_assert(Dim==2 || Dim==3, "PSFBoxxer Dim must be 2 or 3");
+public:
+    using BoxxerT = typename std::conditional<Dim==2, Boxxer2D<FloatT,IdxT>, Boxxer3D<FloatT,IdxT>>::type;
+    using FilterT = typename std::conditional<Dim==2, PSFFilter2D<FloatT,IdxT>, PSFFilter3D<FloatT,IdxT>>::type;
+    using IVecT = typename BoxxerT::IVecT;
+    using IMatT = typename BoxxerT::IMatT;
+    using VecT = typename BoxxerT::VecT;
+    using MatT = typename BoxxerT::MatT;
+    using PSFT = typename FilterT::ImageT;
+    using ImageStackT = typename BoxxerT::ImageStackT;
+
+    BoxxerT engine; //nScales = number of PSFs.  sigma is the RMS width of each PSF.
+
+    /**
+     * @param imsize Frame size
+     * @param psfs Measured PSFs, each odd sized and centered.
+     * @param rank Maximum number of separable terms per PSF.
+     */
+    PSFBoxxer(const IVecT &imsize, const arma::field<PSFT> &psfs, IdxT rank);
+
+    IdxT nPSFs() const { return engine.nScales; }
+    IVecT ranks() const;
+    /** @returns size:[nPSFs] Relative l2 error of each PSF's low-rank approximation */
+    VecT approximationErrors() const;
+    /** @returns size:[nPSFs] Relative l2-norm of the antisymmetric part of each PSF, matched by odd filter passes */
+    VecT symmetryErrors() const;
+    /**
+     * Approximation error against rank.
+     * @returns size:[maxTerms+1 x nPSFs] Column p, row r is the relative l2 error of the leading r terms of PSF p.
+     *          Rows beyond the number of terms of a PSF are 0.
+     */
+    MatT rankErrors() const;
+
+    /**
+     * @param maxima [out] size:[Dim+2 x N] rows=[coords..., psf, frame]
+     */
+    IdxT scaleSpaceMaxima(const ImageStackT &im, IMatT &maxima, VecT &max_vals,
+                          IdxT neighborhood_size, IdxT scale_neighborhood_size) const;
+
+    static MatT psfSigma(const arma::field<PSFT> &psfs);
+private:
+    std::vector<FilterT> filters; //Prototypes copied to each thread
+};
+
+template<class FloatT=float, class IdxT=uint32_t>
+using PSFBoxxer2D = PSFBoxxer<2,FloatT,IdxT>;
+template<class FloatT=float, class IdxT=uint32_t>
+using PSFBoxxer3D = PSFBoxxer<3,FloatT,IdxT>;
+
+} /* namespace boxxer */
+
+#endif /* BOXXER_PSFBOXXER_H */
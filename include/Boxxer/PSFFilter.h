@@ -0,0 +1,100 @@
+/** @file PSFFilter.h
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The class declarations for low-rank separable matched filters of measured PSFs.
+ *
+ * A measured PSF image is used as a matched filter by approximating it with a short sum of separable terms,
+ * each a product of 1D kernels, so filtering costs a few 1D passes per term rather than a dense 2D or 3D
+ * convolution.  The 1D passes use the same half-kernel gaussFIR_* routines and mirror boundary conditions as the
+ * Gaussian filters for the even part of each factor, and an oddFIR_* pass for its odd part where it has one.
+ *
+ * Preparation of the PSF template:
+ *  - The PSF must have odd size in each dimension and be centered at the middle pixel.
+ *  - It is not symmetrized, so coma and other asymmetric aberrations are matched.  Astigmatic and defocused PSFs
+ *    with axes aligned to the camera are mirror-symmetric and need no odd passes; the relative size of the
+ *    antisymmetric part is reported as symmetry_error.
+ *  - The mean is subtracted, so a constant background gives zero response as with LoG and DoG, and the template
+ *    is scaled to unit l2-norm, so responses of different PSFs are comparable across scales.
+ *
+ * In 2D the separable terms are the SVD of the template.  In 3D the template is unfolded along x and the
+ * right singular vectors are decomposed again by SVD, giving orthogonal rank-1 terms ordered by weight.  This may
+ * need more terms than a canonical polyadic decomposition, e.g., 4 rather than 2 for a Gaussian minus its mean, but
+ * it is deterministic and its error is exact.
+ * In both cases the relative l2 (Frobenius) approximation error of the leading r terms is exactly
+ * rank_error(r) = sqrt(sum of squared weights of the terms not kept).
+ *
+ * Like the Gaussian filters these are meant to be per-thread worker objects.  Copies share no storage.
+ */
+#ifndef BOXXER_PSFFILTER_H
+#define BOXXER_PSFFILTER_H
+
+#include <cstdint>
+#include <armadillo>
+
+namespace boxxer {
+
+template<class FloatT=float, class IdxT=uint32_t>
+class PSFFilter2D
+{
+public:
+    using IVecT = arma::Col<IdxT>;
+    using VecT = arma::Col<FloatT>;
+    using ImageT = arma::Mat<FloatT>;
+
+    IVecT size; //[nrows, ncols]
+    IVecT hw; //PSF half width in each dimension
+    IdxT rank; //Number of separable terms used
+    FloatT symmetry_error; //Relative l2-norm of the antisymmetric part of the PSF
+    VecT rank_error; //size:[nTerms+1] rank_error(r) is the relative l2 error of the leading r terms
+
+    /**
+     * @param size Image size [nrows, ncols]
+     * @param psf Measured PSF, odd sized and centered.
+     * @param rank Maximum number of separable terms to use.  Clamped to the number available.
+     */
+    PSFFilter2D(const IVecT &size, const ImageT &psf, IdxT rank);
+    ImageT make_image() const { return ImageT(size(0),size(1)); }
+    FloatT approximation_error() const { return rank_error(rank); }
+
+    void filter(const ImageT &im, ImageT &out);
+
+    /** The rank_error and symmetry_error for a PSF without building a filter */
+    static VecT rankErrors(const ImageT &psf, FloatT *symmetry_error=nullptr);
+private:
+    ImageT temp_im0;
+    ImageT temp_im1;
+    arma::field<VecT> kernels; //size:[2 x rank] Even half-kernels per term.  The term weight is folded into row 0.
+    arma::field<VecT> odd_kernels; //size:[2 x rank] Odd half-kernels per term, empty for even factors
+};
+
+template<class FloatT=float, class IdxT=uint32_t>
+class PSFFilter3D
+{
+public:
+    using IVecT = arma::Col<IdxT>;
+    using VecT = arma::Col<FloatT>;
+    using ImageT = arma::Cube<FloatT>;
+
+    IVecT size;
+    IVecT hw;
+    IdxT rank;
+    FloatT symmetry_error;
+    VecT rank_error;
+
+    PSFFilter3D(const IVecT &size, const ImageT &psf, IdxT rank);
+    ImageT make_image() const { return ImageT(size(0),size(1),size(2)); }
+    FloatT approximation_error() const { return rank_error(rank); }
+
+    void filter(const ImageT &im, ImageT &out);
+
+    static VecT rankErrors(const ImageT &psf, FloatT *symmetry_error=nullptr);
+private:
+    ImageT temp_im0;
+    ImageT temp_im1;
+    arma::field<VecT> kernels; //size:[3 x rank]
+    arma::field<VecT> odd_kernels; //size:[3 x rank]
+};
+
+} /* namespace boxxer */
+
+#endif /* BOXXER_PSFFILTER_H */
@@ -0,0 +1,80 @@
+/** @file ScalePruner.h
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The class declaration for ScalePruner, the adaptive scale selection of the Boxxer2D/3D Adaptive methods.
+ *
+ * With many scales, most frames of a movie only have maxima above the detection threshold at a few of them.  The
+ * pruner tracks the peak filter response of each scale over a moving window of frames.  A scale whose peak stayed at
+ * or below a bound a margin under the threshold could neither produce a returned maxima nor reject one at another
+ * scale in any of those frames, and it is skipped for the following frames.
+ *
+ * Frames are processed in periods of recheck_period frames with a fixed set of scales.  The first frame of each
+ * period is always filtered at every scale, so a skipped scale whose response grows is restored at the next period,
+ * and the window always holds a full frame.  The first window frames are filtered at every scale.  The active scales
+ * depend only on the frames, not on the number of threads, so results are reproducible.
+ *
+ * Unlike the Threshold and Temporal methods, this is a heuristic: a skipped scale can exceed the bound between
+ * rechecks.  A maxima it would have produced is then lost, or one it would have rejected is kept, until the next
+ * period.  The margin trades this risk against the work saved.
+ */
+#ifndef BOXXER_SCALEPRUNER_H
+#define BOXXER_SCALEPRUNER_H
+
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <armadillo>
+
+namespace boxxer {
+
+template<class FloatT=float, class IdxT=uint32_t>
+class ScalePruner
+{
+public:
+    using VecT = arma::Col<FloatT>;
+    using MatT = arma::Mat<FloatT>;
+
+    struct Params
+    {
+        IdxT window=64; //Frames of peak responses kept.  At least recheck_period.
+        IdxT recheck_period=16; //Frames per period.  Frames within a period are processed in parallel.
+        FloatT margin=0.25; //Scales are skipped when their peak was <= threshold-margin*|threshold|
+    };
+
+    struct Stats
+    {
+        std::size_t nFrames=0;
+        std::size_t nFullFrames=0; //Frames filtered at every scale
+        std::size_t nScaleFrames=0; //Frame-scales filtered
+        std::size_t nSkippedScaleFrames=0;
+        std::vector<std::size_t> nSkippedByScale;
+    };
+
+    ScalePruner(IdxT nScales, FloatT threshold, const Params &params);
+
+    IdxT recheckPeriod() const { return params.recheck_period; }
+    bool isFullFrame(IdxT n) const { return n%params.recheck_period==0 || full_scan; }
+    const std::vector<IdxT>& activeScales() const { return active; }
+    const std::vector<IdxT>& allScales() const { return all; }
+    const Stats& stats() const { return stats_; }
+
+    /**
+     * Record the peak response of each scale in a period of frames and choose the active scales for the next period.
+     * @param peaks size:[nScales x nFrames] -infinity for skipped scales
+     */
+    void update(const MatT &peaks);
+
+private:
+    IdxT nScales;
+    FloatT bound;
+    Params params;
+    std::deque<VecT> window_peaks;
+    std::vector<IdxT> all;
+    std::vector<IdxT> active;
+    bool full_scan; //Every frame is full until the window is filled
+    Stats stats_;
+};
+
+} /* namespace boxxer */
+
+#endif /* BOXXER_SCALEPRUNER_H */
@@ -0,0 +1,107 @@
+/** @file ScaleSpaceView2D.h
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The class declaration for ScaleSpaceView2D, a lazily computed view of the scale-space of a 2D movie.
+ *
+ * Visual inspection only ever looks at a few frames and scales of a movie, so filtering the whole stack with
+ * filterScaledLoG or filterScaledDoG wastes nearly all of its work.  The ScaleSpaceView2D instead computes the
+ * scale-space response of a (frame, scale, region) request on demand.  Frames are split into fixed tiles, and only the
+ * tiles intersecting the region are filtered, each from a window extended by the kernel half-width and subject to the
+ * same minimum size rule as the masked tiles of Boxxer2D, so values are identical to those of the whole-frame filters.
+ *
+ * Filtered tiles are kept in a GaussCache, so memory is bounded and the least-recently-used tiles are evicted first.
+ * After each request a background thread prefetches the same tiles of the neighboring frames, as browsing usually
+ * steps through frames one at a time.  Each new request replaces any outstanding prefetch work.
+ */
+#ifndef BOXXER_SCALESPACEVIEW2D_H
+#define BOXXER_SCALESPACEVIEW2D_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <armadillo>
+#include "Boxxer/Boxxer2D.h"
+#include "Boxxer/GaussCache.h"
+
+namespace boxxer {
+
+template<class FloatT=float, class IdxT=uint32_t>
+class ScaleSpaceView2D
+{
+public:
+    using BoxxerT = Boxxer2D<FloatT,IdxT>;
+    using IVecT = typename BoxxerT::IVecT;
+    using ImageT = typename BoxxerT::ImageT;
+    using ImageStackT = typename BoxxerT::ImageStackT;
+
+    /** A cached tile: the response of one scale of one frame over [tx,tx+TileSize)x[ty,ty+TileSize) */
+    struct TileKey
+    {
+        IdxT frame, scale, tx, ty;
+        bool operator<(const TileKey &o) const
+        {
+            if(frame != o.frame) return frame < o.frame;
+            if(scale != o.scale) return scale < o.scale;
+            if(tx != o.tx) return tx < o.tx;
+            return ty < o.ty;
+        }
+    };
+    using TileCacheT = GaussCache<ImageT,FloatT,IdxT,TileKey>;
+
+    static const IdxT TileSize;
+    static const std::size_t DefaultMaxBytes;
+
+    const BoxxerT engine;
+    const bool use_DoG;
+    IdxT nPrefetch; //Neighboring frames to prefetch on each side of a request
+
+    /**
+     * @param movie The movie, shared with the background thread.  It must not be modified while the view exists.
+     * @param use_DoG Use the DoG response in place of the LoG.
+     */
+    ScaleSpaceView2D(const BoxxerT &engine, std::shared_ptr<const ImageStackT> movie, bool use_DoG=false,
+                     std::size_t max_bytes=DefaultMaxBytes, IdxT nPrefetch=1);
+    ScaleSpaceView2D(const ScaleSpaceView2D&) = delete;
+    ScaleSpaceView2D& operator=(const ScaleSpaceView2D&) = delete;
+    ~ScaleSpaceView2D();
+
+    IdxT nFrames() const { return static_cast<IdxT>(movie->n_slices); }
+
+    /**
+     * The scale-space response of a region of one frame.
+     * @param lo,hi The region [lo,hi) as [x,y] pairs.
+     * @param out [out] size:hi-lo
+     */
+    void view(IdxT frame, IdxT scale, const IVecT &lo, const IVecT &hi, ImageT &out);
+    /** The scale-space response of a whole frame */
+    void view(IdxT frame, IdxT scale, ImageT &out);
+
+    typename TileCacheT::Stats cacheStats() const { return cache.get_stats(); }
+    void setCacheMaxBytes(std::size_t max_bytes) { cache.set_max_bytes(max_bytes); }
+    void clearCache() { cache.clear(); }
+    /** Block until all outstanding prefetch work is done */
+    void waitPrefetch();
+
+private:
+    std::shared_ptr<const ImageStackT> movie;
+    TileCacheT cache;
+
+    std::thread prefetch_thread;
+    std::mutex prefetch_mtx;
+    std::condition_variable prefetch_cv;
+    std::condition_variable idle_cv;
+    std::deque<TileKey> prefetch_queue;
+    bool prefetch_busy = false;
+    bool prefetch_stop = false;
+
+    typename TileCacheT::ImagePtrT computeTile(const TileKey &key) const;
+    void prefetchLoop();
+};
+
+} /* namespace boxxer */
+
+#endif /* BOXXER_SCALESPACEVIEW2D_H */
@@ -0,0 +1,89 @@
+/** @file ShardRunner.h
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The class declaration for ShardRunner, a multi-process frame-range sharded Boxxer2D driver.
+ *
+ * The ShardRunner splits a MovieFile into disjoint contiguous frame ranges and launches one local worker
+ * process per shard.  Each worker has its own OpenMP thread pool pinned to the CPUs of one NUMA node,
+ * processes its frames with Boxxer2D, and writes its maxima to a per-shard file.  The shard files are then
+ * merged in frame order.  As every frame is processed independently, the merged result is identical to a
+ * single-process scaleSpaceLoGMaxima / scaleSpaceDoGMaxima call on the whole movie.
+ *
+ * Workers are started with posix_spawn rather than fork so that no OpenMP runtime state is inherited.
+ *
+ * POSIX only.
+ */
+#ifndef BOXXER_SHARDRUNNER_H
+#define BOXXER_SHARDRUNNER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <armadillo>
+
+namespace boxxer {
+
+class ShardRunner
+{
+public:
+    using FloatT = float;
+    using IdxT = uint32_t;
+    using IMatT = arma::Mat<IdxT>;
+    using VecT = arma::Col<FloatT>;
+    using MatT = arma::Mat<FloatT>;
+
+    /** Scale-space detection parameters passed to each worker */
+    struct Params
+    {
+        MatT sigma; // size: [2 x nScales]
+        bool use_DoG = true;
+        FloatT sigma_ratio = 1.1;
+        IdxT neighborhood_size = 3;
+        IdxT scale_neighborhood_size = 3;
+    };
+
+    /**
+     * @param worker_path Path to the boxxerShardWorker executable.
+     * @param nShards Number of worker processes.
+     * @param threads_per_shard OpenMP threads per worker.  0 uses all CPUs assigned to the shard.
+     * @param numa_bind Pin each worker to the CPUs of a single NUMA node.
+     */
+    ShardRunner(const std::string &worker_path, IdxT nShards, IdxT threads_per_shard=0, bool numa_bind=true);
+
+    IdxT scaleSpaceMaxima(const std::string &movie_path, const Params &params, const std::string &work_dir,
+                          IMatT &maxima, VecT &max_vals) const;
+
+    /* Per-shard work, run inside the worker process */
+    static IdxT runShard(const std::string &movie_path, IdxT frame_begin, IdxT frame_end, const Params &params,
+                         const std::string &out_path);
+
+    /* Worker command line encoding */
+    static std::vector<std::string> encodeWorkerArgs(const std::string &movie_path, IdxT frame_begin, IdxT frame_end,
+                                                     const Params &params, const std::string &out_path,
+                                                     IdxT nThreads, const std::string &cpu_list);
+    static int workerMain(int argc, char **argv);
+
+    /* Maxima files */
+    static void writeMaximaFile(const std::string &path, const IMatT &maxima, const VecT &max_vals);
+    static void readMaximaFile(const std::string &path, IMatT &maxima, VecT &max_vals);
+
+    /* CPU topology */
+    static std::vector<std::vector<int>> numaNodeCpus();
+    static std::vector<int> parseCpuList(const std::string &cpu_list);
+    static std::string formatCpuList(const std::vector<int> &cpus);
+
+private:
+    std::string worker_path;
+    IdxT nShards;
+    IdxT threads_per_shard;
+    bool numa_bind;
+
+    std::vector<std::vector<int>> assignShardCpus(IdxT nActiveShards) const;
+    static std::string makeRunDir(const std::string &work_dir);
+    static void removeDir(const std::string &dir_path);
+    static void removeStaleShardFiles(const std::string &work_dir);
+};
+
+} /* namespace boxxer */
+
+#endif /* BOXXER_SHARDRUNNER_H */
@@ -0,0 +1,43 @@
+/** @file TemporalBinning.h
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The TemporalBinning parameters of the Boxxer2D/3D Binned methods.
+ *
+ * Dim samples are detected on the sum of bin_size consecutive frames.  Bin b covers frames
+ * [b*stride, b*stride+bin_size), so a stride of bin_size gives disjoint bins and a smaller stride gives a sliding
+ * window.  Trailing frames that do not fill a bin are not used.  The binned frames are formed one at a time in a
+ * per-thread buffer as they are filtered, and the frame of each maxima is reported as the first frame of its bin.
+ */
+#ifndef BOXXER_TEMPORALBINNING_H
+#define BOXXER_TEMPORALBINNING_H
+
+#include <cstdint>
+#include <sstream>
+#include "Boxxer/BoxxerError.h"
+
+namespace boxxer {
+
+template<class IdxT=uint32_t>
+struct TemporalBinning
+{
+    IdxT bin_size=1; //Frames summed into each bin
+    IdxT stride=0; //Frames between the starts of bins.  0 for bin_size.
+    bool mean=false; //Average rather than sum the frames of a bin
+
+    IdxT step() const { return stride ? stride : bin_size; }
+    IdxT nBins(IdxT nT) const { return nT<bin_size ? 0 : (nT-bin_size)/step()+1; }
+    IdxT firstFrame(IdxT b) const { return b*step(); }
+
+    void check() const
+    {
+        if(bin_size<1 || step()>bin_size) {
+            std::ostringstream msg;
+            msg<<"Got bin_size: "<<bin_size<<" stride: "<<stride<<" expected 1<=stride<=bin_size";
+            throw ParameterValueError(msg.str());
+        }
+    }
+};
+
+} /* namespace boxxer */
+
+#endif /* BOXXER_TEMPORALBINNING_H */
@@ -0,0 +1,73 @@
+/** @file WaveletFilter.h
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The class declarations for the undecimated B-spline ("a trous") wavelet filters.
+ *
+ * The smooth approximations are V_0 = image and V_j = V_{j-1} filtered along each axis with the B-spline kernel
+ * [1 4 6 4 1]/16 with holes of step 2^(j-1).  The wavelet planes W_j = V_{j-1} - V_j are band-pass responses that
+ * are positive at spots, like DoG, with a scale of roughly 2^(j-1) pixels.
+ *
+ * Each level is computed from the previous one with 5 taps per axis, so computing a run of consecutive levels
+ * costs little more than computing the last of them alone.  Like the Gaussian filters, these are meant to be
+ * per-thread worker classes.
+ */
+#ifndef BOXXER_WAVELETFILTER_H
+#define BOXXER_WAVELETFILTER_H
+
+#include <cstdint>
+#include <armadillo>
+#include "Boxxer/Hypercube/Hypercube.h"
+
+namespace boxxer {
+
+template<class FloatT=float, class IdxT=uint32_t>
+class AtrousFilter2D
+{
+public:
+    using IVecT = arma::Col<IdxT>;
+    using ImageT = arma::Mat<FloatT>;
+    using ScaledImageT = arma::Cube<FloatT>;
+    static const IdxT MaxLevel;
+
+    IVecT size; //[nrows, ncols]
+    IdxT first_level; //Levels start at 1
+    IdxT nLevels;
+
+    AtrousFilter2D(const IVecT &size, IdxT first_level, IdxT nLevels=1);
+    ImageT make_image() const { return ImageT(size(0),size(1)); }
+
+    /** Wavelet planes W_{first_level} ... W_{first_level+nLevels-1} into slices of out */
+    void filter(const ImageT &im, ScaledImageT &out);
+    /** The single wavelet plane W_{first_level} */
+    void filter(const ImageT &im, ImageT &out);
+private:
+    ImageT v_prev, v_next, temp_im;
+    template<class PlaneF> void filter_levels(const ImageT &im, PlaneF plane);
+};
+
+template<class FloatT=float, class IdxT=uint32_t>
+class AtrousFilter3D
+{
+public:
+    using IVecT = arma::Col<IdxT>;
+    using ImageT = arma::Cube<FloatT>;
+    using ScaledImageT = hypercube::Hypercube<FloatT>;
+    static const IdxT MaxLevel;
+
+    IVecT size;
+    IdxT first_level;
+    IdxT nLevels;
+
+    AtrousFilter3D(const IVecT &size, IdxT first_level, IdxT nLevels=1);
+    ImageT make_image() const { return ImageT(size(0),size(1),size(2)); }
+
+    void filter(const ImageT &im, ScaledImageT &out);
+    void filter(const ImageT &im, ImageT &out);
+private:
+    ImageT v_prev, v_next, temp_im0, temp_im1;
+    template<class PlaneF> void filter_levels(const ImageT &im, PlaneF plane);
+};
+
+} /* namespace boxxer */
+
+#endif /* BOXXER_WAVELETFILTER_H */
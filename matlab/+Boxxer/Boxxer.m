@@ -65,6 +65,52 @@ classdef Boxxer < MexIFace.MexIFaceMixin
             obj.call('setDoGSigmaRatio',sigma_ratio);
         end
 
+        function setWaveletFirstLevel(obj, level)
+            % Set the a trous wavelet level used as scale 1.  Scales are levels level ... level+nScales-1 and level
+            % j has a scale of about 2^(j-1) pixels.  The default level 2 skips the noise dominated level 1.
+            if ~isscalar(level) || level<1 || level~=round(level)
+                error('Boxxer:ParamValue','level should be an integer >=1');
+            end
+            obj.call('setWaveletFirstLevel',uint32(level));
+        end
+
+        function setDefectMap(obj, defects)
+            % Set the map of defective (hot, dead, or stuck) pixels.  Flagged pixels are replaced by the median of
+            % their unflagged neighbors before filtering in all non-static methods.
+            %  [in] defects: imsize shaped logical map.  All false disables defect patching.
+            if ~isequal(size(defects), reshape(double(obj.imsize),1,[]))
+                error('Boxxer:ParamValue','defects should be size: %s',mat2str(obj.imsize'));
+            end
+            obj.call('setDefectMap',uint8(defects~=0));
+        end
+
+        function defects=getDefectMap(obj)
+            %  [out] defects: imsize shaped logical map of defective pixels
+            defects=logical(obj.call('getDefectMap'));
+        end
+
+        function nDefects=detectDefectMap(obj, image, nWarmupFrames, threshold, minFraction)
+            % Detect and set the defect map from the pixels that are outliers from the median of their neighbors in
+            % nearly every one of the leading frames.  Moving or blinking emitters are not flagged.
+            %  [in] image: a single stack of imsize shaped frames, last dimension is time
+            %  [in] nWarmupFrames: [optional] number of leading frames to examine (default=all)
+            %  [in] threshold: [optional] outlier threshold in robust standard deviations (default=8)
+            %  [in] minFraction: [optional] fraction of frames a pixel must be an outlier in (default=0.9)
+            %  [out] nDefects: number of defective pixels flagged
+            obj.checkImage(image);
+            if nargin<5
+                minFraction=0.9;
+            end
+            if nargin<4
+                threshold=8;
+            end
+            if nargin<3
+                nWarmupFrames=size(image,obj.dim+1);
+            end
+            nDefects=double(obj.call('detectDefectMap', image, uint32(nWarmupFrames), ...
+                                     obj.datacaster(threshold), obj.datacaster(minFraction)));
+        end
+
         function fimage=filterScaledLoG(obj, image)
             % fimage=obj.filterLoG(image)
             % Filter using a Laplacian of Gaussian filter to detect blobs of size (scale)
@@ -84,6 +130,15 @@ classdef Boxxer < MexIFace.MexIFaceMixin
             fimage=obj.call('filterScaledDoG', image);
         end
 
+        function fimage=filterScaledWavelet(obj, image)
+            % fimage=obj.filterScaledWavelet(image)
+            % Filter using the a trous B-spline wavelet planes as scales.  Sigma is not used.
+            %  [in] image: a single stack of imsize shaped frames, last dimension is time
+            %  [out] fimage:a single hyperstack of imsizeY x imsizeX x nScales x nFrames shaped filtered frames
+            obj.checkImage(image);
+            fimage=obj.call('filterScaledWavelet', image);
+        end
+
         function [maxima, max_vals] = scaleSpaceLoGMaxima(obj, image, neighborhoodSize, scaleNeighborhoodSize)
             % Filter using a seperable LoG implementation at multiple scales
             %  [in] image: a single stack of imsize shaped frames, last dimension is time
@@ -126,6 +181,197 @@ classdef Boxxer < MexIFace.MexIFaceMixin
             maxima=maxima+1; %correct for 0-based C++ coords to 1-based Matlab coords;
         end
 
+        function [maxima, max_vals] = scaleSpaceWaveletMaxima(obj, image, neighborhoodSize, scaleNeighborhoodSize)
+            % Filter using the a trous B-spline wavelet planes as scales
+            %  [in] image: a single stack of imsize shaped frames, last dimension is time
+            %  [in] neighborhoodSize: The size of the neighborhood for local maxima finding (use: 3 or 5)
+            %  [in] scaleNeighborhoodSize: The size of the neighborhood for maxima finding  over scales(use: 3 or 5)
+            %  [out] maxima: 4xN matrix of maxima rows are [xpos, ypos, scale, frame].  Scales and frames are
+            %                1-based indexes
+            %  [out] max_vals: 1xN vector of maxima values at each local maxima found.
+            obj.checkImage(image);
+            if nargin<4
+                scaleNeighborhoodSize=3;
+            end
+            if nargin<3
+                neighborhoodSize=5;
+            end
+            
+            [maxima, max_vals] = obj.call('scaleSpaceWaveletMaxima', image, int32(neighborhoodSize),...
+                                                                int32(scaleNeighborhoodSize));
+            maxima=maxima+1; %correct for 0-based C++ coords to 1-based Matlab coords;
+        end
+
+        function [maxima, max_vals, hessian_ratio, gradient] = scaleSpaceLoGMaximaShape(obj, image, neighborhoodSize, scaleNeighborhoodSize)
+            % scaleSpaceLoGMaxima with shape metrics at each maxima, so elongated structures can be rejected before
+            % box extraction, e.g., keep=hessian_ratio>=0.3.
+            %  [in] image: a single stack of imsize shaped frames, last dimension is time
+            %  [in] neighborhoodSize: The size of the neighborhood for local maxima finding (use: 3 or 5)
+            %  [in] scaleNeighborhoodSize: The size of the neighborhood for maxima finding  over scales(use: 3 or 5)
+            %  [out] maxima: 4xN matrix of maxima rows are [xpos, ypos, scale, frame].  Scales and frames are
+            %                1-based indexes
+            %  [out] max_vals: 1xN vector of maxima values at each local maxima found.
+            %  [out] hessian_ratio: 1xN ratio of the smallest to largest eigenvalue of the scale normalized
+            %                Hessian at the maxima scale.  1 for round blobs, near 0 for lines, edges and
+            %                membranes and <0 for saddles.
+            %  [out] gradient: 1xN scale normalized gradient magnitude.  Only computed if requested.
+            obj.checkImage(image);
+            if nargin<4
+                scaleNeighborhoodSize=3;
+            end
+            if nargin<3
+                neighborhoodSize=5;
+            end
+            [maxima, max_vals, hessian_ratio, gradient] = obj.call('scaleSpaceLoGMaximaShape', image, ...
+                        int32(neighborhoodSize), int32(scaleNeighborhoodSize), uint32(nargout>=4));
+            maxima=maxima+1; %correct for 0-based C++ coords to 1-based Matlab coords;
+        end
+
+        function [maxima, max_vals, stats] = scaleSpaceLoGMaximaAdaptive(obj, image, threshold, neighborhoodSize, scaleNeighborhoodSize, window, recheckPeriod, margin)
+            % scaleSpaceLoGMaxima keeping only maxima strictly greater than threshold, and skipping the scales whose
+            % peak response stayed at or below threshold-margin*|threshold| over the last window frames.  Every
+            % recheckPeriod-th frame is filtered at all scales so skipped scales are restored when they become
+            % active.  This is approximate: a skipped scale can change the maxima of the frames until the next
+            % recheck.
+            %  [in] image: a single stack of imsize shaped frames, last dimension is time
+            %  [in] threshold: detection threshold
+            %  [in] neighborhoodSize: The size of the neighborhood for local maxima finding (default=5)
+            %  [in] scaleNeighborhoodSize: The size of the neighborhood for maxima finding over scales (default=3)
+            %  [in] window: frames of peak responses used to choose the scales (default=64)
+            %  [in] recheckPeriod: period of the full frames, at most window (default=16)
+            %  [in] margin: fraction of |threshold| below threshold a scale's peak must stay (default=0.25)
+            %  [out] maxima: (dim+2)xN matrix of maxima rows are [pos, scale, frame].
+            %  [out] max_vals: 1xN vector of maxima values at each local maxima found.
+            %  [out] stats: struct with the counts of frames, full frames, and frame-scales filtered and skipped
+            obj.checkImage(image);
+            if nargin<8
+                margin=0.25;
+            end
+            if nargin<7
+                recheckPeriod=16;
+            end
+            if nargin<6
+                window=64;
+            end
+            if nargin<5
+                scaleNeighborhoodSize=3;
+            end
+            if nargin<4
+                neighborhoodSize=5;
+            end
+            [maxima, max_vals, counts, skippedByScale] = obj.call('scaleSpaceLoGMaximaAdaptive', image, ...
+                obj.datacaster(threshold), int32(neighborhoodSize), int32(scaleNeighborhoodSize), ...
+                int32(window), int32(recheckPeriod), obj.datacaster(margin));
+            maxima=maxima+1; %correct for 0-based C++ coords to 1-based Matlab coords;
+            stats = obj.adaptiveStatsToMatlab(counts, skippedByScale);
+        end
+
+        function [maxima, max_vals, stats] = scaleSpaceDoGMaximaAdaptive(obj, image, threshold, neighborhoodSize, scaleNeighborhoodSize, window, recheckPeriod, margin)
+            % scaleSpaceLoGMaximaAdaptive using the DoG response.
+            obj.checkImage(image);
+            if nargin<8
+                margin=0.25;
+            end
+            if nargin<7
+                recheckPeriod=16;
+            end
+            if nargin<6
+                window=64;
+            end
+            if nargin<5
+                scaleNeighborhoodSize=3;
+            end
+            if nargin<4
+                neighborhoodSize=5;
+            end
+            [maxima, max_vals, counts, skippedByScale] = obj.call('scaleSpaceDoGMaximaAdaptive', image, ...
+                obj.datacaster(threshold), int32(neighborhoodSize), int32(scaleNeighborhoodSize), ...
+                int32(window), int32(recheckPeriod), obj.datacaster(margin));
+            maxima=maxima+1; %correct for 0-based C++ coords to 1-based Matlab coords;
+            stats = obj.adaptiveStatsToMatlab(counts, skippedByScale);
+        end
+
+        function [maxima, max_vals] = scaleSpaceLoGMaximaBinned(obj, image, binSize, stride, useMean, neighborhoodSize, scaleNeighborhoodSize)
+            % [maxima, max_vals] = obj.scaleSpaceLoGMaximaBinned(image, binSize, stride, useMean, neighborhoodSize, scaleNeighborhoodSize)
+            % The scale-space maxima of the movie binned in time, for dim samples.  Bin b sums (or averages) the
+            % binSize frames starting at frame (b-1)*stride+1.  The bins are formed as they are filtered so no
+            % binned copy of the movie is made, and trailing frames that do not fill a bin are not used.
+            %  [in] image: a single stack of imsize shaped frames, last dimension is time
+            %  [in] binSize: frames in each bin
+            %  [in] stride: [optional] frames between the starts of bins, at most binSize (default=binSize)
+            %  [in] useMean: [optional] average rather than sum the frames of each bin (default=false)
+            %  [in] neighborhoodSize: The size of the neighborhood for local maxima finding (default=5)
+            %  [in] scaleNeighborhoodSize: The size of the neighborhood for maxima finding over scales (default=3)
+            %  [out] maxima: (dim+2)xN matrix of maxima rows are [pos, scale, frame].  frame is the first movie
+            %                frame of the bin.
+            %  [out] max_vals: 1xN vector of maxima values at each local maxima found.
+            obj.checkImage(image);
+            if nargin<7
+                scaleNeighborhoodSize=3;
+            end
+            if nargin<6
+                neighborhoodSize=5;
+            end
+            if nargin<5
+                useMean=false;
+            end
+            if nargin<4 || isempty(stride)
+                stride=binSize;
+            end
+            if ~isscalar(binSize) || binSize<1 || stride<1 || stride>binSize
+                error('Boxxer:BadParameter','Got binSize: %i stride: %i expected 1<=stride<=binSize', binSize, stride);
+            end
+            [maxima, max_vals] = obj.call('scaleSpaceLoGMaximaBinned', image, int32(binSize), int32(stride), ...
+                int32(useMean), int32(neighborhoodSize), int32(scaleNeighborhoodSize));
+            maxima=maxima+1; %correct for 0-based C++ coords to 1-based Matlab coords;
+        end
+
+        function [maxima, max_vals] = scaleSpaceDoGMaximaBinned(obj, image, binSize, stride, useMean, neighborhoodSize, scaleNeighborhoodSize)
+            % scaleSpaceLoGMaximaBinned using the DoG response.
+            obj.checkImage(image);
+            if nargin<7
+                scaleNeighborhoodSize=3;
+            end
+            if nargin<6
+                neighborhoodSize=5;
+            end
+            if nargin<5
+                useMean=false;
+            end
+            if nargin<4 || isempty(stride)
+                stride=binSize;
+            end
+            if ~isscalar(binSize) || binSize<1 || stride<1 || stride>binSize
+                error('Boxxer:BadParameter','Got binSize: %i stride: %i expected 1<=stride<=binSize', binSize, stride);
+            end
+            [maxima, max_vals] = obj.call('scaleSpaceDoGMaximaBinned', image, int32(binSize), int32(stride), ...
+                int32(useMean), int32(neighborhoodSize), int32(scaleNeighborhoodSize));
+            maxima=maxima+1; %correct for 0-based C++ coords to 1-based Matlab coords;
+        end
+
+        function [components, integrated, peakVals] = scaleSpaceLoGComponents(obj, image, threshold)
+            % Connected components (like bwlabeln) of the pixels where the maximum LoG response over scales is
+            % >threshold.  For aggregates and extended objects where point maxima are the wrong summary.  The
+            % scaled response is labeled as it is computed, so it is never returned to Matlab.
+            %  [in] image: a single stack of imsize shaped frames, last dimension is time
+            %  [in] threshold: foreground response threshold
+            %  [out] components: (3*dim+3)xN matrix.  Rows are [bounding box low corner (dim), bounding box high
+            %                corner (dim), peak position (dim), peak scale, area, frame].  Positions, scales and
+            %                frames are 1-based indexes.
+            %  [out] integrated: 1xN sum of the response over each component
+            %  [out] peakVals: 1xN peak response of each component
+            obj.checkImage(image);
+            [components, integrated, peakVals] = obj.call('scaleSpaceLoGComponents', image, obj.datacaster(threshold));
+            components = obj.componentsToMatlab(components);
+        end
+
+        function [components, integrated, peakVals] = scaleSpaceDoGComponents(obj, image, threshold)
+            % scaleSpaceLoGComponents using the DoG response.
+            obj.checkImage(image);
+            [components, integrated, peakVals] = obj.call('scaleSpaceDoGComponents', image, obj.datacaster(threshold));
+            components = obj.componentsToMatlab(components);
+        end
+
         function fimage=filterLoG(obj, image, sigma)
             % fimage=obj.filterLoG(image)
             % Filter using a Laplacian of Gaussian filter to detect blobs of size (scale)
@@ -176,6 +422,22 @@ classdef Boxxer < MexIFace.MexIFaceMixin
             fimage=obj.callstatic('filterDoG', image, sigma, single(sigmaRatio));
         end
 
+        function fimage=filterWavelet(obj, image, level)
+            % fimage=obj.filterWavelet(image, level)
+            % Filter with a single a trous B-spline wavelet plane W_level = V_{level-1} - V_level.
+            %  [in] image: a single stack of imsize shaped frames, last dimension is time
+            %  [in] level: [optional] wavelet level >=1.  Level j has scale about 2^(j-1) pixels. [Default=2].
+            %  [out] fimage: a single stack of imsize shaped filtered frames
+            obj.checkImage(image);
+            if nargin<3
+                level=2;
+            end
+            if ~isscalar(level) || level<1 || level~=round(level)
+                error('Boxxer:filterWavelet','level should be an integer >=1');
+            end
+            fimage=obj.callstatic('filterWavelet', image, uint32(level));
+        end
+
         function fimage=filterGauss(obj, image, sigma)
             % fimage=obj.filterGauss(image)
             % Filter using a Gaussian to smooth image
@@ -216,6 +478,70 @@ classdef Boxxer < MexIFace.MexIFaceMixin
             maxima=maxima+1; %correct for 0-based C++ coords to 1-based Matlab coords;
         end
       
+        function [maxima, max_vals]=detectLoG(obj, image, sigma, neighborhoodSize, threshold)
+            % [maxima, max_vals]=obj.detectLoG(image, sigma, neighborhoodSize, threshold)
+            % The maxima of filterLoG(image, sigma), as from enumerateImageMaxima, but each frame is filtered and
+            % searched in turn so the filtered stack is never stored.
+            %  [in] image: a single stack of imsize shaped frames, last dimension is time
+            %  [in] sigma: [optional] [nDim x 1] vector of sigmas to use [Default=obj.sigma(:,1)]
+            %  [in] neighborhoodSize: [optional] an odd integer (default=3)
+            %  [in] threshold: [optional] only maxima strictly greater than threshold are returned (default=-Inf)
+            %  [out] maxima: a (dim+1)xN matrix of maxima where rows are X, Y, ..., T.
+            %  [out] max_vals; a Nx1 Vector giving the value at each maxima.
+            if nargin<5
+                threshold=-Inf;
+            end
+            if nargin<4
+                neighborhoodSize=obj.ValidMaximaNeighborhoodSizes(1);
+            end
+            if nargin<3 || isempty(sigma)
+                sigma=obj.sigma(:,1);
+            end
+            [image, sigma, neighborhoodSize] = obj.checkDetectArgs(image, sigma, neighborhoodSize);
+            [maxima, max_vals]=obj.callstatic('detectLoG', image, sigma, neighborhoodSize, single(threshold));
+            maxima=maxima+1; %correct for 0-based C++ coords to 1-based Matlab coords;
+        end
+
+        function [maxima, max_vals]=detectDoG(obj, image, sigma, sigmaRatio, neighborhoodSize, threshold)
+            % [maxima, max_vals]=obj.detectDoG(image, sigma, sigmaRatio, neighborhoodSize, threshold)
+            % detectLoG using filterDoG.  sigmaRatio defaults to 1.1.
+            if nargin<6
+                threshold=-Inf;
+            end
+            if nargin<5
+                neighborhoodSize=obj.ValidMaximaNeighborhoodSizes(1);
+            end
+            if nargin<4
+                sigmaRatio=1.1;
+            end
+            if nargin<3 || isempty(sigma)
+                sigma=obj.sigma(:,1);
+            end
+            if ~isscalar(sigmaRatio) || sigmaRatio<=1
+                error('Boxxer:detectDoG','Sigma ratio must be a scalar >1.');
+            end
+            [image, sigma, neighborhoodSize] = obj.checkDetectArgs(image, sigma, neighborhoodSize);
+            [maxima, max_vals]=obj.callstatic('detectDoG', image, sigma, single(sigmaRatio), neighborhoodSize, single(threshold));
+            maxima=maxima+1; %correct for 0-based C++ coords to 1-based Matlab coords;
+        end
+
+        function [maxima, max_vals]=detectGauss(obj, image, sigma, neighborhoodSize, threshold)
+            % [maxima, max_vals]=obj.detectGauss(image, sigma, neighborhoodSize, threshold)
+            % detectLoG using filterGauss.
+            if nargin<5
+                threshold=-Inf;
+            end
+            if nargin<4
+                neighborhoodSize=obj.ValidMaximaNeighborhoodSizes(1);
+            end
+            if nargin<3 || isempty(sigma)
+                sigma=obj.sigma(:,1);
+            end
+            [image, sigma, neighborhoodSize] = obj.checkDetectArgs(image, sigma, neighborhoodSize);
+            [maxima, max_vals]=obj.callstatic('detectGauss', image, sigma, neighborhoodSize, single(threshold));
+            maxima=maxima+1; %correct for 0-based C++ coords to 1-based Matlab coords;
+        end
+
         function box_coords = generateBoxCoords(obj, maxima, Nframes, optimalBoxSize)
             %
             % [out] box_coords -
@@ -239,6 +565,34 @@ classdef Boxxer < MexIFace.MexIFaceMixin
                 error('Boxxer:filterLoG','Got incorrect sized image %s',mat2str(input_size));
             end
         end
+
+        function [image, sigma, neighborhoodSize]=checkDetectArgs(obj, image, sigma, neighborhoodSize)
+            obj.checkImage(image);
+            sigma=single(sigma(:));
+            if length(sigma)~=obj.dim
+                error('Boxxer:BadParameter','Sigma value must be size: %ix1',obj.dim);
+            end
+            neighborhoodSize=int32(neighborhoodSize);
+            if mod(neighborhoodSize,2)~=1 || neighborhoodSize<3
+                error('Boxxer:ParmaValue','Got invalid neighborhoodSize: %i',neighborhoodSize);
+            end
+        end
+
+        function stats=adaptiveStatsToMatlab(~, counts, skippedByScale)
+            stats.nFrames = counts(1);
+            stats.nFullFrames = counts(2);
+            stats.nScaleFrames = counts(3);
+            stats.nSkippedScaleFrames = counts(4);
+            stats.skippedByScale = skippedByScale(:)';
+        end
+
+        function components=componentsToMatlab(obj, components)
+            % Convert 0-based C++ component indexes to 1-based.  The area row is a count.
+            area_row = 3*obj.dim+2;
+            components = double(components);
+            rows = setdiff(1:size(components,1), area_row);
+            components(rows,:) = components(rows,:)+1;
+        end
     end
 
     methods (Access=public, Abstract=true)
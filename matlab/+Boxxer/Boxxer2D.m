@@ -17,6 +17,329 @@ classdef Boxxer2D < Boxxer.Boxxer
             success = initialize@Boxxer.Boxxer(obj, imsize, sigma);
         end
 
+        function enableGaussCache(obj, maxMBytes)
+            % Cache Gaussian filtered frames between DoG calls on the same image stack.  Changing the
+            % DoG sigma ratio then only recomputes the missing inhibitory Gaussians.
+            %  [in] maxMBytes: memory bound for the cache in MB (default=1024)
+            if nargin<2
+                maxMBytes=1024;
+            end
+            if ~isscalar(maxMBytes) || maxMBytes<=0
+                error('Boxxer2D:ParamValue','maxMBytes should be >0');
+            end
+            obj.call('enableGaussCache', uint32(maxMBytes));
+        end
+
+        function disableGaussCache(obj)
+            % Stop caching Gaussian filtered frames and release the cache memory.
+            obj.call('disableGaussCache');
+        end
+
+        function clearGaussCache(obj)
+            obj.call('clearGaussCache');
+        end
+
+        function [sweepParams, maxima, max_vals] = scaleSpaceDoGMaximaSweep(obj, image, sigmaRatios, neighborhoodSizes, scaleNeighborhoodSizes, thresholds)
+            % Evaluate scaleSpaceDoGMaxima for all combinations of parameters in a single pass over the image.
+            %  [in] image: a single stack of imsize shaped frames, last dimension is time
+            %  [in] sigmaRatios: vector of DoG sigma ratios >1
+            %  [in] neighborhoodSizes: vector of odd neighborhood sizes (default=[3 5 7])
+            %  [in] scaleNeighborhoodSizes: vector of odd scale neighborhood sizes (default=3)
+            %  [in] thresholds: vector of thresholds.  Maxima must be strictly greater. (default=-inf)
+            %  [out] sweepParams: 4xC matrix.  Rows are [sigmaRatio, neighborhoodSize, scaleNeighborhoodSize, threshold]
+            %  [out] maxima: Cx1 cell array of 4xN maxima as returned by scaleSpaceDoGMaxima
+            %  [out] max_vals: Cx1 cell array of maxima values
+            obj.checkImage(image);
+            if nargin<6
+                thresholds=-inf;
+            end
+            if nargin<5
+                scaleNeighborhoodSizes=3;
+            end
+            if nargin<4
+                neighborhoodSizes=[3 5 7];
+            end
+            [sweepParams, allMaxima, allVals] = obj.call('scaleSpaceDoGMaximaSweep', image, single(sigmaRatios(:)),...
+                                                uint32(neighborhoodSizes(:)), uint32(scaleNeighborhoodSizes(:)), single(thresholds(:)));
+            nCombos = size(sweepParams,2);
+            maxima = cell(nCombos,1);
+            max_vals = cell(nCombos,1);
+            for c=1:nCombos
+                idx = allMaxima(end,:)==c-1;
+                maxima{c} = allMaxima(1:end-1,idx)+1; %correct for 0-based C++ coords to 1-based Matlab coords;
+                max_vals{c} = allVals(idx);
+            end
+        end
+
+        function [maxima, max_vals] = scaleSpaceLoGMaximaMasked(obj, image, mask, neighborhoodSize, scaleNeighborhoodSize)
+            % scaleSpaceLoGMaxima restricted to the nonzero pixels of mask.  Regions of the frame far from
+            % the mask are not filtered at all, so the cost scales with the masked area.
+            %  [in] image: a single stack of imsize shaped frames, last dimension is time
+            %  [in] mask: imsize shaped logical mask.  Use makeROIMask to build one from bounding boxes.
+            %  [in] neighborhoodSize: The size of the neighborhood for local maxima finding (default=5)
+            %  [in] scaleNeighborhoodSize: The size of the neighborhood for maxima finding over scales (default=3)
+            %  [out] maxima: 4xN matrix of maxima rows are [xpos, ypos, scale, frame].
+            %  [out] max_vals: 1xN vector of maxima values at each local maxima found.
+            obj.checkImage(image);
+            if nargin<5
+                scaleNeighborhoodSize=3;
+            end
+            if nargin<4
+                neighborhoodSize=5;
+            end
+            [maxima, max_vals] = obj.call('scaleSpaceLoGMaximaMasked', image, obj.checkMask(mask), ...
+                                          int32(neighborhoodSize), int32(scaleNeighborhoodSize));
+            maxima=maxima+1; %correct for 0-based C++ coords to 1-based Matlab coords;
+        end
+
+        function [maxima, max_vals] = scaleSpaceDoGMaximaMasked(obj, image, mask, neighborhoodSize, scaleNeighborhoodSize)
+            % scaleSpaceDoGMaxima restricted to the nonzero pixels of mask.  Regions of the frame far from
+            % the mask are not filtered at all, so the cost scales with the masked area.
+            %  [in] image: a single stack of imsize shaped frames, last dimension is time
+            %  [in] mask: imsize shaped logical mask.  Use makeROIMask to build one from bounding boxes.
+            %  [in] neighborhoodSize: The size of the neighborhood for local maxima finding (default=5)
+            %  [in] scaleNeighborhoodSize: The size of the neighborhood for maxima finding over scales (default=3)
+            %  [out] maxima: 4xN matrix of maxima rows are [xpos, ypos, scale, frame].
+            %  [out] max_vals: 1xN vector of maxima values at each local maxima found.
+            obj.checkImage(image);
+            if nargin<5
+                scaleNeighborhoodSize=3;
+            end
+            if nargin<4
+                neighborhoodSize=5;
+            end
+            [maxima, max_vals] = obj.call('scaleSpaceDoGMaximaMasked', image, obj.checkMask(mask), ...
+                                          int32(neighborhoodSize), int32(scaleNeighborhoodSize));
+            maxima=maxima+1; %correct for 0-based C++ coords to 1-based Matlab coords;
+        end
+
+        function [maxima, max_vals, skipFraction] = scaleSpaceDoGMaximaTemporal(obj, image, threshold, neighborhoodSize, scaleNeighborhoodSize)
+            % scaleSpaceDoGMaxima keeping only maxima strictly greater than threshold.  Tiles whose input has changed
+            % too little since they were last processed to produce any such maxima are skipped.  The result is
+            % identical to thresholding the output of scaleSpaceDoGMaxima.
+            %  [in] image: a single stack of imsize shaped frames, last dimension is time
+            %  [in] threshold: detection threshold
+            %  [in] neighborhoodSize: The size of the neighborhood for local maxima finding (default=5)
+            %  [in] scaleNeighborhoodSize: The size of the neighborhood for maxima finding over scales (default=3)
+            %  [out] maxima: 4xN matrix of maxima rows are [xpos, ypos, scale, frame].
+            %  [out] max_vals: 1xN vector of maxima values at each local maxima found.
+            %  [out] skipFraction: fraction of tile-frames skipped
+            obj.checkImage(image);
+            if nargin<5
+                scaleNeighborhoodSize=3;
+            end
+            if nargin<4
+                neighborhoodSize=5;
+            end
+            [maxima, max_vals, skipFraction] = obj.call('scaleSpaceDoGMaximaTemporal', image, single(threshold), ...
+                                                        int32(neighborhoodSize), int32(scaleNeighborhoodSize));
+            maxima=maxima+1; %correct for 0-based C++ coords to 1-based Matlab coords;
+        end
+
+        function [maxima, max_vals, skipFraction] = scaleSpaceLoGMaximaTemporal(obj, image, threshold, neighborhoodSize, scaleNeighborhoodSize)
+            % scaleSpaceLoGMaxima keeping only maxima strictly greater than threshold, skipping unchanged tiles.
+            % See scaleSpaceDoGMaximaTemporal.
+            obj.checkImage(image);
+            if nargin<5
+                scaleNeighborhoodSize=3;
+            end
+            if nargin<4
+                neighborhoodSize=5;
+            end
+            [maxima, max_vals, skipFraction] = obj.call('scaleSpaceLoGMaximaTemporal', image, single(threshold), ...
+                                                        int32(neighborhoodSize), int32(scaleNeighborhoodSize));
+            maxima=maxima+1; %correct for 0-based C++ coords to 1-based Matlab coords;
+        end
+
+        function [maxima, max_vals, nSkippedFrames] = scaleSpaceDoGMaximaThreshold(obj, image, threshold, neighborhoodSize, scaleNeighborhoodSize)
+            % scaleSpaceDoGMaxima keeping only maxima strictly greater than threshold.  Frames whose pixel range
+            % proves that no filtered value can exceed threshold, e.g., dark or shutter-closed frames, are skipped
+            % without filtering.  The result is identical to thresholding the output of scaleSpaceDoGMaxima.
+            %  [in] image: a single stack of imsize shaped frames, last dimension is time
+            %  [in] threshold: detection threshold
+            %  [in] neighborhoodSize: The size of the neighborhood for local maxima finding (default=5)
+            %  [in] scaleNeighborhoodSize: The size of the neighborhood for maxima finding over scales (default=3)
+            %  [out] maxima: 4xN matrix of maxima rows are [xpos, ypos, scale, frame].
+            %  [out] max_vals: 1xN vector of maxima values at each local maxima found.
+            %  [out] nSkippedFrames: number of frames skipped
+            obj.checkImage(image);
+            if nargin<5
+                scaleNeighborhoodSize=3;
+            end
+            if nargin<4
+                neighborhoodSize=5;
+            end
+            [maxima, max_vals, nSkippedFrames] = obj.call('scaleSpaceDoGMaximaThreshold', image, single(threshold), ...
+                                                          int32(neighborhoodSize), int32(scaleNeighborhoodSize));
+            maxima=maxima+1; %correct for 0-based C++ coords to 1-based Matlab coords;
+        end
+
+        function [maxima, max_vals, nSkippedFrames] = scaleSpaceLoGMaximaThreshold(obj, image, threshold, neighborhoodSize, scaleNeighborhoodSize)
+            % scaleSpaceLoGMaxima keeping only maxima strictly greater than threshold, skipping frames that provably
+            % have none.  See scaleSpaceDoGMaximaThreshold.
+            obj.checkImage(image);
+            if nargin<5
+                scaleNeighborhoodSize=3;
+            end
+            if nargin<4
+                neighborhoodSize=5;
+            end
+            [maxima, max_vals, nSkippedFrames] = obj.call('scaleSpaceLoGMaximaThreshold', image, single(threshold), ...
+                                                          int32(neighborhoodSize), int32(scaleNeighborhoodSize));
+            maxima=maxima+1; %correct for 0-based C++ coords to 1-based Matlab coords;
+        end
+
+        function [maxima, max_vals] = scaleSpaceDoGMaximaMultiChannel(obj, image, nChannels, interleaved, neighborhoodSize, scaleNeighborhoodSize)
+            % scaleSpaceDoGMaxima for a stack holding several camera channels.  All channels are processed in one
+            % pass sharing the same filters.  Each channel's maxima are identical to processing it alone.
+            %  [in] image: stack of imsize shaped frames with nChannels channels along the last dimension
+            %  [in] nChannels: number of channels
+            %  [in] interleaved: true if slices alternate channels [t1c1, t1c2, t2c1, ...], false if the channel
+            %                    stacks are concatenated [c1 frames, c2 frames, ...] (default=true)
+            %  [in] neighborhoodSize: The size of the neighborhood for local maxima finding (default=5)
+            %  [in] scaleNeighborhoodSize: The size of the neighborhood for maxima finding over scales (default=3)
+            %  [out] maxima: 5xN matrix of maxima rows are [xpos, ypos, scale, frame, channel].
+            %  [out] max_vals: 1xN vector of maxima values at each local maxima found.
+            obj.checkImage(image);
+            if nargin<6
+                scaleNeighborhoodSize=3;
+            end
+            if nargin<5
+                neighborhoodSize=5;
+            end
+            if nargin<4
+                interleaved=true;
+            end
+            [maxima, max_vals] = obj.call('scaleSpaceDoGMaximaMultiChannel', image, uint32(nChannels), uint32(logical(interleaved)), ...
+                                          int32(neighborhoodSize), int32(scaleNeighborhoodSize));
+            maxima=maxima+1; %correct for 0-based C++ coords to 1-based Matlab coords;
+        end
+
+        function [maxima, max_vals] = scaleSpaceLoGMaximaMultiChannel(obj, image, nChannels, interleaved, neighborhoodSize, scaleNeighborhoodSize)
+            % scaleSpaceLoGMaxima for a stack holding several camera channels.  See scaleSpaceDoGMaximaMultiChannel.
+            obj.checkImage(image);
+            if nargin<6
+                scaleNeighborhoodSize=3;
+            end
+            if nargin<5
+                neighborhoodSize=5;
+            end
+            if nargin<4
+                interleaved=true;
+            end
+            [maxima, max_vals] = obj.call('scaleSpaceLoGMaximaMultiChannel', image, uint32(nChannels), uint32(logical(interleaved)), ...
+                                          int32(neighborhoodSize), int32(scaleNeighborhoodSize));
+            maxima=maxima+1; %correct for 0-based C++ coords to 1-based Matlab coords;
+        end
+
+        function nCoincident = coincidentMaxima(obj, maxima, nChannels, registration, radius)
+            % Count for each maxima the number of other channels with a maxima in the same frame within radius.
+            %  [in] maxima: 5xN matrix from scaleSpace*MaximaMultiChannel.
+            %  [in] nChannels: number of channels
+            %  [in] registration: 2x3xnChannels affine maps of each channel's [x;y] into the reference frame as
+            %                     A(:,1:2)*[x;y]+A(:,3), or [] for identity.
+            %  [in] radius: coincidence radius in pixels
+            %  [out] nCoincident: 1xN number of other channels with a coincident maxima.
+            %                     Use maxima(:,nCoincident>0) to keep only coincident maxima.
+            registration = single(registration);
+            if ~isempty(registration)
+                for c = 1:size(registration,3) %Convert the translations to 0-based C++ coords
+                    registration(:,3,c) = registration(:,3,c) + sum(registration(:,1:2,c),2) - 1;
+                end
+            end
+            nCoincident = obj.call('coincidentMaxima', uint32(maxima-1), uint32(nChannels), registration, single(radius));
+        end
+
+        function [maxima, max_vals] = scaleSpaceLoGMaximaMosaic(obj, tiles, positions, neighborhoodSize, scaleNeighborhoodSize)
+            % scaleSpaceLoGMaxima of a mosaic of overlapping imsize shaped tiles, in mosaic coordinates.  Each
+            % mosaic pixel is owned by the covering tile with the nearest center, so each overlap is filtered once
+            % and every maxima is reported exactly once, as if the mosaic had been stitched first.
+            %  [in] tiles: stack of imsize shaped tiles, one per slice
+            %  [in] positions: 2xnTiles mosaic [x;y] of pixel (1,1) of each tile.  Minimum 1.
+            %  [in] neighborhoodSize: The size of the neighborhood for local maxima finding (default=5)
+            %  [in] scaleNeighborhoodSize: The size of the neighborhood for maxima finding over scales (default=3)
+            %  [out] maxima: 4xN matrix of maxima rows are [xpos, ypos, scale, tile] in mosaic coordinates.
+            %  [out] max_vals: 1xN vector of maxima values at each local maxima found.
+            obj.checkImage(tiles);
+            if nargin<5
+                scaleNeighborhoodSize=3;
+            end
+            if nargin<4
+                neighborhoodSize=5;
+            end
+            if size(positions,1)~=2 || size(positions,2)~=size(tiles,3) || any(positions(:)<1)
+                error('Boxxer:ParamValue','positions should be 2xnTiles with values >=1');
+            end
+            [maxima, max_vals] = obj.call('scaleSpaceLoGMaximaMosaic', tiles, uint32(positions-1), ...
+                                          int32(neighborhoodSize), int32(scaleNeighborhoodSize));
+            maxima=maxima+1; %correct for 0-based C++ coords to 1-based Matlab coords;
+        end
+
+        function [maxima, max_vals] = scaleSpaceDoGMaximaMosaic(obj, tiles, positions, neighborhoodSize, scaleNeighborhoodSize)
+            % scaleSpaceDoGMaxima of a mosaic of overlapping tiles.  See scaleSpaceLoGMaximaMosaic.
+            obj.checkImage(tiles);
+            if nargin<5
+                scaleNeighborhoodSize=3;
+            end
+            if nargin<4
+                neighborhoodSize=5;
+            end
+            if size(positions,1)~=2 || size(positions,2)~=size(tiles,3) || any(positions(:)<1)
+                error('Boxxer:ParamValue','positions should be 2xnTiles with values >=1');
+            end
+            [maxima, max_vals] = obj.call('scaleSpaceDoGMaximaMosaic', tiles, uint32(positions-1), ...
+                                          int32(neighborhoodSize), int32(scaleNeighborhoodSize));
+            maxima=maxima+1; %correct for 0-based C++ coords to 1-based Matlab coords;
+        end
+
+        function [maxima, max_vals, rankErrors, symmetryErrors] = scaleSpacePSFMaxima(obj, image, psfs, rank, neighborhoodSize, scaleNeighborhoodSize)
+            % Scale-space maxima using measured PSFs as matched filters in place of LoG/DoG.  Each PSF is
+            % approximated by a sum of rank separable terms, and takes the place of a scale.
+            %  [in] image: a single stack of imsize shaped frames, last dimension is time
+            %  [in] psfs: stack of odd sized PSFs centered on the middle pixel, one per slice
+            %  [in] rank: maximum number of separable terms per PSF (default=3)
+            %  [in] neighborhoodSize: The size of the neighborhood for local maxima finding (default=5)
+            %  [in] scaleNeighborhoodSize: The size of the neighborhood for maxima finding over PSFs (default=3)
+            %  [out] maxima: 4xN matrix of maxima rows are [xpos, ypos, psf, frame].
+            %  [out] max_vals: 1xN vector of maxima values at each local maxima found.
+            %  [out] rankErrors: (maxTerms+1)xnPSFs.  Row r+1 is the relative l2 error of the rank r approximation.
+            %  [out] symmetryErrors: 1xnPSFs relative l2-norm of the part of each PSF not symmetric about its axes,
+            %                     which is matched with odd 1D filter passes.
+            obj.checkImage(image);
+            if nargin<6
+                scaleNeighborhoodSize=3;
+            end
+            if nargin<5
+                neighborhoodSize=5;
+            end
+            if nargin<4
+                rank=3;
+            end
+            [maxima, max_vals, rankErrors, symmetryErrors] = obj.call('scaleSpacePSFMaxima', image, single(psfs), ...
+                                        uint32(rank), int32(neighborhoodSize), int32(scaleNeighborhoodSize));
+            maxima=maxima+1; %correct for 0-based C++ coords to 1-based Matlab coords;
+        end
+
+        function mask = makeROIMask(obj, rois)
+            % Make a mask from a list of bounding boxes.
+            %  [in] rois: 4xN matrix.  Rows are [x, y, width, height] with 1-based origin [x, y].
+            %  [out] mask: imsize shaped logical mask.
+            mask = false(obj.imsize(:)');
+            for n=1:size(rois,2)
+                x = max(1,rois(1,n)):min(obj.imsize(1),rois(1,n)+rois(3,n)-1);
+                y = max(1,rois(2,n)):min(obj.imsize(2),rois(2,n)+rois(4,n)-1);
+                mask(x,y) = true;
+            end
+        end
+
+        function mask = checkMask(obj, mask)
+            input_size=size(mask);
+            if numel(input_size)~=2 || ~all(input_size==obj.imsize')
+                error('Boxxer2D:checkMask','Got incorrect sized mask %s',mat2str(input_size));
+            end
+            mask = uint8(mask~=0);
+        end
+
         function checkMaxima(obj, image, maxima, max_vals)
             Nmaxima=length(max_vals);
             for n=1:Nmaxima
@@ -11,6 +11,63 @@ classdef Boxxer3D < Boxxer.Boxxer
 %             success=initialize@Boxxer(obj, imsize, sigma);
 %         end
 
+        function [maxima, max_vals, stats] = scaleSpaceLoGMaximaCascade(obj, image, projectionThreshold, spectralDim, useMax, boxRadius, neighborhoodSize, scaleNeighborhoodSize)
+            % [maxima, max_vals, stats] = obj.scaleSpaceLoGMaximaCascade(image, projectionThreshold, spectralDim, useMax, boxRadius, neighborhoodSize, scaleNeighborhoodSize)
+            % Scale-space maxima of sparse hyperspectral frames.  Each frame is projected along spectralDim and
+            % searched in 2D, and the full 3D scale-space maxima are found only in windows spanning spectralDim
+            % around the 2D maxima with response >projectionThreshold.  The result is the scaleSpaceLoGMaxima
+            % maxima within boxRadius of those 2D maxima.
+            %  [in] image: a single stack of imsize shaped frames, last dimension is time
+            %  [in] projectionThreshold: threshold on the 2D response of the projected frames
+            %  [in] spectralDim: [optional] the spectral dimension, 1 for [L Y X] frames (default=1)
+            %  [in] useMax: [optional] project by maximum rather than sum (default=false)
+            %  [in] boxRadius: [optional] half width of the box searched around each 2D maxima.  0 for
+            %                  ceil(2*max spatial sigma) (default=0)
+            %  [in] neighborhoodSize: The size of the neighborhood for local maxima finding (default=5)
+            %  [in] scaleNeighborhoodSize: The size of the neighborhood for maxima finding over scales (default=3)
+            %  [out] maxima: (dim+2)xN matrix of maxima rows are [pos, scale, frame].
+            %  [out] max_vals: 1xN vector of maxima values at each local maxima found.
+            %  [out] stats: struct with the number of 2D maxima and the voxels filtered at each scale
+            if nargin<8
+                scaleNeighborhoodSize=3;
+            end
+            if nargin<7
+                neighborhoodSize=5;
+            end
+            if nargin<6
+                boxRadius=0;
+            end
+            if nargin<5
+                useMax=false;
+            end
+            if nargin<4
+                spectralDim=1;
+            end
+            [maxima, max_vals, stats] = obj.callCascade('scaleSpaceLoGMaximaCascade', image, projectionThreshold, ...
+                spectralDim, useMax, boxRadius, neighborhoodSize, scaleNeighborhoodSize);
+        end
+
+        function [maxima, max_vals, stats] = scaleSpaceDoGMaximaCascade(obj, image, projectionThreshold, spectralDim, useMax, boxRadius, neighborhoodSize, scaleNeighborhoodSize)
+            % scaleSpaceLoGMaximaCascade using the DoG response.
+            if nargin<8
+                scaleNeighborhoodSize=3;
+            end
+            if nargin<7
+                neighborhoodSize=5;
+            end
+            if nargin<6
+                boxRadius=0;
+            end
+            if nargin<5
+                useMax=false;
+            end
+            if nargin<4
+                spectralDim=1;
+            end
+            [maxima, max_vals, stats] = obj.callCascade('scaleSpaceDoGMaximaCascade', image, projectionThreshold, ...
+                spectralDim, useMax, boxRadius, neighborhoodSize, scaleNeighborhoodSize);
+        end
+
         function checkMaxima(obj, image, maxima, max_vals)
             Nmaxima = length(max_vals);
             for n=1:Nmaxima
@@ -26,4 +83,19 @@ classdef Boxxer3D < Boxxer.Boxxer
         end
         
     end
+
+    methods (Access=protected)
+        function [maxima, max_vals, stats] = callCascade(obj, method, image, projectionThreshold, spectralDim, useMax, boxRadius, neighborhoodSize, scaleNeighborhoodSize)
+            obj.checkImage(image);
+            if ~any(spectralDim==1:obj.dim)
+                error('Boxxer:BadParameter','Got spectralDim: %i expected 1..%i', spectralDim, obj.dim);
+            end
+            [maxima, max_vals, counts] = obj.call(method, image, obj.datacaster(projectionThreshold), ...
+                int32(spectralDim-1), int32(useMax), int32(boxRadius), int32(neighborhoodSize), ...
+                int32(scaleNeighborhoodSize));
+            maxima=maxima+1; %correct for 0-based C++ coords to 1-based Matlab coords;
+            stats.nHits = counts(1);
+            stats.nWindowVoxels = counts(2);
+        end
+    end
 end %classdef
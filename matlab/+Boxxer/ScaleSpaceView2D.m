@@ -0,0 +1,99 @@
+% ScaleSpaceView2D.m - A lazily computed view of the scale-space of a 2D movie
+%
+% Only the tiles of the requested frame, scale, and region are filtered, and filtered tiles are kept in a bounded
+% LRU cache.  After each request the same tiles of the neighboring frames are prefetched in the background, so
+% browsing a huge movie costs in proportion to what is actually viewed.  Values are identical to those of
+% Boxxer2D.filterScaledLoG and filterScaledDoG.
+%
+% The movie is copied into the C++ object when the view is constructed, as the background prefetch continues
+% between calls.
+
+classdef ScaleSpaceView2D < MexIFace.MexIFaceMixin
+    properties (SetAccess=protected)
+        imsize;
+        sigma;
+        nScales;
+        nFrames;
+        useDoG;
+    end
+
+    methods
+        function obj = ScaleSpaceView2D(boxxer, movie, useDoG, maxMBytes, nPrefetch, sigmaRatio)
+            % [in] boxxer: A Boxxer.Boxxer2D object.  Its imsize, sigma and defect map are used.
+            % [in] movie: a single stack of imsize shaped frames, last dimension is time
+            % [in] useDoG: View the DoG response in place of the LoG (default=false)
+            % [in] maxMBytes: memory bound for the tile cache in MB (default=256)
+            % [in] nPrefetch: neighboring frames to prefetch on each side of a request (default=1)
+            % [in] sigmaRatio: DoG sigma ratio >1 (default=1.1)
+            obj = obj@MexIFace.MexIFaceMixin(@ScaleSpaceView2D_IFace);
+            if nargin<6
+                sigmaRatio=1.1;
+            end
+            if nargin<5
+                nPrefetch=1;
+            end
+            if nargin<4
+                maxMBytes=256;
+            end
+            if nargin<3
+                useDoG=false;
+            end
+            if ~isa(boxxer,'Boxxer.Boxxer2D')
+                error('ScaleSpaceView2D:ParamValue','boxxer should be a Boxxer.Boxxer2D');
+            end
+            if size(movie,1)~=boxxer.imsize(1) || size(movie,2)~=boxxer.imsize(2)
+                error('ScaleSpaceView2D:ParamValue','movie frames should be size: %s',mat2str(boxxer.imsize'));
+            end
+            if ~isscalar(sigmaRatio) || sigmaRatio<=1
+                error('ScaleSpaceView2D:ParamValue','sigmaRatio should be >1');
+            end
+            if ~isscalar(maxMBytes) || maxMBytes<=0
+                error('ScaleSpaceView2D:ParamValue','maxMBytes should be >0');
+            end
+            obj.imsize = boxxer.imsize;
+            obj.sigma = boxxer.sigma;
+            obj.nScales = boxxer.nScales;
+            obj.nFrames = size(movie,3);
+            obj.useDoG = logical(useDoG);
+            obj.openIFace(obj.imsize, obj.sigma, single(sigmaRatio), uint8(boxxer.getDefectMap()), single(movie),...
+                          uint32(obj.useDoG), uint32(maxMBytes), uint32(nPrefetch));
+        end
+
+        function out = view(obj, frame, scale, lo, hi)
+            % The scale-space response of a region of one frame.
+            %  [in] frame: 1-based frame index
+            %  [in] scale: 1-based scale index
+            %  [in] lo: [x,y] first pixel of the region (default=[1,1])
+            %  [in] hi: [x,y] last pixel of the region (default=imsize)
+            %  [out] out: The response over lo:hi
+            if nargin<5
+                hi=obj.imsize;
+            end
+            if nargin<4
+                lo=[1,1];
+            end
+            if frame<1 || frame>obj.nFrames || scale<1 || scale>obj.nScales
+                error('ScaleSpaceView2D:ParamValue','frame should be in [1,%i] and scale in [1,%i]',obj.nFrames,obj.nScales);
+            end
+            if any(lo(:)<1) || any(hi(:)<lo(:)) || any(hi(:)>double(obj.imsize(:)))
+                error('ScaleSpaceView2D:ParamValue','Bad region lo:%s hi:%s',mat2str(lo),mat2str(hi));
+            end
+            out = obj.call('view', uint32(frame-1), uint32(scale-1), uint32(lo(:)-1), uint32(hi(:)));
+        end
+
+        function stats = cacheStats(obj)
+            % [out] stats: struct with fields hits, misses, evictions, nEntries, MBytes, maxMBytes
+            s = obj.call('cacheStats');
+            stats = struct('hits',s(1),'misses',s(2),'evictions',s(3),'nEntries',s(4),'MBytes',s(5),'maxMBytes',s(6));
+        end
+
+        function clearCache(obj)
+            obj.call('clearCache');
+        end
+
+        function waitPrefetch(obj)
+            % Block until the background prefetch of neighboring frames is done
+            obj.call('waitPrefetch');
+        end
+    end
+end
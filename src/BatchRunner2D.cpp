@@ -0,0 +1,123 @@
+/**
+ * @file BatchRunner2D.cpp
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The BatchRunner2D class definition
+ */
+
+#include <chrono>
+#include <memory>
+#include <omp.h>
+#include "OMPExceptionCatcher/OMPExceptionCatcher.h"
+#include "Boxxer/BoxxerError.h"
+#include "Boxxer/BatchRunner2D.h"
+
+namespace boxxer {
+
+template<class FloatT, class IdxT>
+IdxT BatchRunner2D<FloatT,IdxT>::addJob(const ImageStackT &im, const MatT &sigma, bool use_DoG, FloatT sigma_ratio,
+                                        IdxT neighborhood_size, IdxT scale_neighborhood_size)
+{
+    IVecT imsize = {static_cast<IdxT>(im.n_rows), static_cast<IdxT>(im.n_cols)};
+    IdxT g = 0;
+    for(; g<groups.size(); g++) {
+        const auto &engine = groups[g].engine;
+        if(groups[g].use_DoG==use_DoG && arma::all(engine.imsize==imsize) &&
+           engine.sigma.n_cols==sigma.n_cols && arma::all(arma::vectorise(engine.sigma==sigma)) &&
+           (!use_DoG || engine.sigma_ratio==sigma_ratio)) break;
+    }
+    if(g==groups.size()) {
+        Group group{BoxxerT(imsize, sigma), use_DoG};
+        if(use_DoG) group.engine.setDoGSigmaRatio(sigma_ratio);
+        groups.push_back(group);
+    }
+    jobs.push_back(Job{&im, g, neighborhood_size, scale_neighborhood_size});
+    return static_cast<IdxT>(jobs.size()-1);
+}
+
+template<class FloatT, class IdxT>
+void BatchRunner2D<FloatT,IdxT>::clear()
+{
+    jobs.clear();
+    groups.clear();
+}
+
+/**
+ * All (job, frame) pairs are flattened into one dynamically scheduled loop, so short jobs and the tail of
+ * long jobs are spread over every thread.  Each thread lazily builds the filters for a group the first time it
+ * sees one of the group's frames, and then reuses them for every frame of every job in that group.
+ */
+template<class FloatT, class IdxT>
+typename BatchRunner2D<FloatT,IdxT>::Stats
+BatchRunner2D<FloatT,IdxT>::run(arma::field<IMatT> &maxima, arma::field<VecT> &max_vals) const
+{
+    auto start = std::chrono::steady_clock::now();
+    IdxT nJobs = static_cast<IdxT>(jobs.size());
+    IdxT nGroups = static_cast<IdxT>(groups.size());
+    std::vector<std::size_t> job_offset(nJobs+1,0);
+    std::size_t nPixels = 0;
+    for(IdxT j=0; j<nJobs; j++) {
+        job_offset[j+1] = job_offset[j] + jobs[j].im->n_slices;
+        nPixels += jobs[j].im->n_elem;
+    }
+    std::size_t nItems = job_offset[nJobs];
+    arma::field<IMatT> frame_maxima(nItems); //These will come back 3xN
+    arma::field<VecT> frame_max_vals(nItems);
+
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel
+    {
+        //Filters have internal storage, so each thread has its own per-group frame filter
+        std::vector<std::unique_ptr<typename BoxxerT::FrameFilter>> filters(nGroups);
+        IdxT j = 0;
+        #pragma omp for schedule(dynamic)
+        for(std::size_t item=0; item<nItems; item++) {
+            catcher.run([&]{
+                while(job_offset[j+1]<=item) j++; //Items are visited in increasing order by each thread
+                while(job_offset[j]>item) j--;
+                const Job &job = jobs[j];
+                const Group &group = groups[job.group];
+                auto &ff = filters[job.group];
+                if(!ff) ff.reset(new typename BoxxerT::FrameFilter(group.engine, group.use_DoG));
+                IdxT n = static_cast<IdxT>(item - job_offset[j]);
+                ff->filter(job.im->slice(n));
+                ff->maxima(frame_maxima(item), frame_max_vals(item), job.neighborhood_size, job.scale_neighborhood_size);
+            });
+        }
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+
+    Stats stats;
+    maxima.set_size(nJobs);
+    max_vals.set_size(nJobs);
+    for(IdxT j=0; j<nJobs; j++) {
+        IdxT nT = static_cast<IdxT>(jobs[j].im->n_slices);
+        if(nT==0) {
+            maxima(j).set_size(4,0);
+            max_vals(j).reset();
+            continue;
+        }
+        arma::field<IMatT> job_maxima(nT);
+        arma::field<VecT> job_max_vals(nT);
+        for(IdxT n=0; n<nT; n++) {
+            job_maxima(n) = std::move(frame_maxima(job_offset[j]+n));
+            job_max_vals(n) = std::move(frame_max_vals(job_offset[j]+n));
+        }
+        stats.nMaxima += BoxxerT::combine_maxima(job_maxima, job_max_vals, maxima(j), max_vals(j));
+    }
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+    stats.nJobs = nJobs;
+    stats.nGroups = nGroups;
+    stats.nFrames = nItems;
+    if(stats.seconds>0) {
+        stats.frames_per_second = nItems/stats.seconds;
+        stats.pixels_per_second = nPixels/stats.seconds;
+    }
+    return stats;
+}
+
+/* Explicit Template Instantiation */
+template class BatchRunner2D<float,uint32_t>;
+template class BatchRunner2D<double,uint32_t>;
+
+} /* namespace boxxer */
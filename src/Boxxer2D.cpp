@@ -5,25 +5,63 @@
  * @brief The Boxxer2D class definition
  */
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
 #include <omp.h>
 #include "OMPExceptionCatcher/OMPExceptionCatcher.h"
 #include "Boxxer/BoxxerError.h"
 #include "Boxxer/GaussFilter.h"
+#include "Boxxer/WaveletFilter.h"
 #include "Boxxer/Maxima.h"
+#include "Boxxer/Components.h"
 #include "Boxxer/Boxxer2D.h"
 
 namespace boxxer {
 
+namespace {
+/**
+ * Eigenvalue ratio of the symmetric matrix [a b; b c], smaller over larger.  The LoG terms are the negated Hessian,
+ * so both eigenvalues are positive at bright blobs.  Clamped to [-1,1], and -1 when neither is positive.
+ */
+template<class FloatT>
+FloatT hessianRatio2D(FloatT a, FloatT b, FloatT c)
+{
+    FloatT mean = (a+c)/2;
+    FloatT r = std::sqrt((a-c)*(a-c)/4 + b*b);
+    FloatT l_max = mean+r;
+    if(!(l_max>0)) return -1;
+    return std::max((mean-r)/l_max, FloatT(-1));
+}
+
+template<class VecT>
+void concat_frame_values(const arma::field<VecT> &frame_vals, VecT &vals)
+{
+    arma::uword N = 0;
+    for(arma::uword n=0; n<frame_vals.n_elem; n++) N += frame_vals(n).n_elem;
+    vals.set_size(N);
+    arma::uword k = 0;
+    for(arma::uword n=0; n<frame_vals.n_elem; n++)
+        for(arma::uword i=0; i<frame_vals(n).n_elem; i++) vals(k++) = frame_vals(n)(i);
+}
+} /* namespace */
+
 /* Static member variables */
 template<class FloatT, class IdxT>
 const IdxT Boxxer2D<FloatT,IdxT>::dim = 2;
 template<class FloatT, class IdxT>
 const FloatT Boxxer2D<FloatT,IdxT>::DefaultSigmaRatio = 1.1;
+template<class FloatT, class IdxT>
+const IdxT Boxxer2D<FloatT,IdxT>::DefaultWaveletFirstLevel = 2; //Level 1 is dominated by pixel noise
+template<class FloatT, class IdxT>
+const IdxT Boxxer2D<FloatT,IdxT>::MaskTileSize = 32;
 
 
 template<class FloatT, class IdxT>
 Boxxer2D<FloatT,IdxT>::Boxxer2D(const IVecT &imsize, const MatT &_sigma)
-    : nScales(_sigma.n_cols), imsize(imsize), sigma(_sigma), sigma_ratio(DefaultSigmaRatio)
+    : nScales(_sigma.n_cols), imsize(imsize), sigma(_sigma), sigma_ratio(DefaultSigmaRatio),
+      wavelet_first_level(DefaultWaveletFirstLevel)
 {
     if(nScales<1) throw ParameterValueError("Non-positive number of scales.");
     if(imsize.n_elem!=dim){
@@ -39,103 +77,1424 @@ Boxxer2D<FloatT,IdxT>::Boxxer2D(const IVecT &imsize, const MatT &_sigma)
 }
 
 template<class FloatT, class IdxT>
-void Boxxer2D<FloatT,IdxT>::setDoGSigmaRatio(FloatT _sigma_ratio)
+Boxxer2D<FloatT,IdxT>::Boxxer2D(const Boxxer2D &o)
+    : nScales(o.nScales), imsize(o.imsize), sigma(o.sigma), sigma_ratio(o.sigma_ratio),
+      wavelet_first_level(o.wavelet_first_level), gauss_cache(o.copyGaussCache()), defect_map(o.defect_map)
+{ }
+
+template<class FloatT, class IdxT>
+Boxxer2D<FloatT,IdxT>& Boxxer2D<FloatT,IdxT>::operator=(const Boxxer2D &o)
+{
+    if(this==&o) return *this;
+    nScales = o.nScales;
+    imsize = o.imsize;
+    sigma = o.sigma;
+    sigma_ratio = o.sigma_ratio;
+    wavelet_first_level = o.wavelet_first_level;
+    gauss_cache = o.copyGaussCache();
+    defect_map = o.defect_map; //Immutable once set, so it is safe to share
+    return *this;
+}
+
+/** A new empty cache with the memory bound of this object's cache, or nullptr if caching is disabled. */
+template<class FloatT, class IdxT>
+std::shared_ptr<typename Boxxer2D<FloatT,IdxT>::GaussCacheT>
+Boxxer2D<FloatT,IdxT>::copyGaussCache() const
+{
+    if(!gauss_cache) return nullptr;
+    return std::make_shared<GaussCacheT>(gauss_cache->get_stats().max_bytes);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D<FloatT,IdxT>::setDoGSigmaRatio(FloatT _sigma_ratio)
+{
+    if(!(_sigma_ratio>1) || !std::isfinite(_sigma_ratio)) { //Rejects NaN
+        std::ostringstream msg;
+        msg<<"Got bad sigma ratio: "<<_sigma_ratio;
+        throw ParameterShapeError(msg.str());
+    }
+    sigma_ratio=_sigma_ratio;
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D<FloatT,IdxT>::setWaveletFirstLevel(IdxT level)
+{
+    if(level<1 || level+nScales-1>AtrousFilter2D<FloatT,IdxT>::MaxLevel) {
+        std::ostringstream msg;
+        msg<<"Got bad wavelet first level: "<<level<<" for nScales: "<<nScales;
+        throw ParameterValueError(msg.str());
+    }
+    wavelet_first_level=level;
+}
+
+/**
+ * Enable a per-object cache of Gaussian filtered frames for the DoG methods.
+ *
+ * Each DoG scale is the difference of an excitatory and inhibitory Gaussian.  With the cache enabled these
+ * Gaussians are kept between calls, keyed by (source, frame, sigma, hw), so changing the sigma ratio only computes
+ * the missing inhibitory Gaussians.  The source is a fingerprint of the image stack computed on each call, so a
+ * different or modified stack never matches stale frames, even from concurrent calls.  The cache belongs to this
+ * object; copies start with their own empty cache.
+ *
+ * @param max_bytes Memory bound for the cached frames.  Least-recently-used frames are evicted first.
+ */
+template<class FloatT, class IdxT>
+void Boxxer2D<FloatT,IdxT>::enableGaussCache(std::size_t max_bytes)
+{
+    if(max_bytes==0) throw ParameterValueError("Gauss cache max_bytes must be positive.");
+    if(gauss_cache) gauss_cache->set_max_bytes(max_bytes);
+    else gauss_cache = std::make_shared<GaussCacheT>(max_bytes);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D<FloatT,IdxT>::disableGaussCache()
+{
+    gauss_cache.reset();
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D<FloatT,IdxT>::clearGaussCache()
+{
+    if(gauss_cache) gauss_cache->clear();
+}
+
+template<class FloatT, class IdxT>
+typename Boxxer2D<FloatT,IdxT>::GaussCacheT::Stats
+Boxxer2D<FloatT,IdxT>::gaussCacheStats() const
+{
+    if(!gauss_cache) return typename GaussCacheT::Stats();
+    return gauss_cache->get_stats();
+}
+
+/**
+ * Set the defect pixel map, nonzero at defects.  A map without defects disables suppression.  Cached Gaussian
+ * frames were computed from differently patched frames, so the cache is cleared.
+ */
+template<class FloatT, class IdxT>
+void Boxxer2D<FloatT,IdxT>::setDefectMap(const MaskT &defects)
+{
+    if(defects.n_rows!=imsize(0) || defects.n_cols!=imsize(1)) {
+        std::ostringstream msg;
+        msg<<"Got defect map of size: ["<<defects.n_rows<<","<<defects.n_cols<<"] expected imsize: "<<imsize.t();
+        throw ParameterValueError(msg.str());
+    }
+    auto map = std::make_shared<const DefectMapT>(defects);
+    if(map->nDefects()>0) defect_map = map;
+    else defect_map.reset();
+    clearGaussCache();
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D<FloatT,IdxT>::clearDefectMap()
+{
+    defect_map.reset();
+    clearGaussCache();
+}
+
+template<class FloatT, class IdxT>
+typename Boxxer2D<FloatT,IdxT>::MaskT
+Boxxer2D<FloatT,IdxT>::getDefectMap() const
+{
+    if(defect_map) return defect_map->mask;
+    MaskT none(imsize(0),imsize(1));
+    none.zeros();
+    return none;
+}
+
+/**
+ * Detect and set the defect map from the persistent outliers of the first nWarmupFrames frames.
+ * @returns The number of defects
+ */
+template<class FloatT, class IdxT>
+IdxT Boxxer2D<FloatT,IdxT>::detectDefectMap(const ImageStackT &im, IdxT nWarmupFrames, FloatT threshold, FloatT min_fraction)
+{
+    if(im.n_rows!=imsize(0) || im.n_cols!=imsize(1)) {
+        std::ostringstream msg;
+        msg<<"Got image stack of frame size: ["<<im.n_rows<<","<<im.n_cols<<"] expected imsize: "<<imsize.t();
+        throw ParameterValueError(msg.str());
+    }
+    setDefectMap(DefectMapT::detect(im, nWarmupFrames, threshold, min_fraction));
+    return defect_map ? defect_map->nDefects() : 0;
+}
+
+/**
+ * The frame as the filters should read it.  Without a defect map this is the frame itself, otherwise it is a
+ * patched copy in the per-thread buffer, which is still in cache for the first filter pass.  The copy is one
+ * streaming pass against the 2*nScales FIR passes that follow, and it keeps the filters, the Gauss cache, and the
+ * drivers reading a plain frame rather than each substituting the defects as they read.
+ */
+template<class FloatT, class IdxT>
+const typename Boxxer2D<FloatT,IdxT>::ImageT&
+Boxxer2D<FloatT,IdxT>::defectFreeFrame(const ImageT &frame, ImageT &buffer) const
+{
+    if(!defect_map) return frame;
+    buffer = frame;
+    defect_map->patch(frame, buffer);
+    return buffer;
+}
+
+/**
+ * Bin b of the movie as the filters should read it.  Frames are patched for defects before they are summed.  A
+ * bin of one frame is the defect free frame itself.
+ */
+template<class FloatT, class IdxT>
+const typename Boxxer2D<FloatT,IdxT>::ImageT&
+Boxxer2D<FloatT,IdxT>::binnedFrame(const ImageStackT &im, const TemporalBinningT &binning, IdxT b,
+                                ImageT &bin_buffer, ImageT &frame_buffer) const
+{
+    IdxT first = binning.firstFrame(b);
+    if(binning.bin_size==1) return defectFreeFrame(im.slice(first), frame_buffer);
+    bin_buffer = defectFreeFrame(im.slice(first), frame_buffer);
+    for(IdxT k=1; k<binning.bin_size; k++) bin_buffer += defectFreeFrame(im.slice(first+k), frame_buffer);
+    if(binning.mean) bin_buffer /= static_cast<FloatT>(binning.bin_size);
+    return bin_buffer;
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D<FloatT,IdxT>::filterScaledLoG(const ImageStackT &im, ScaledImageStackT &fim) const
+{
+    IdxT nT=static_cast<IdxT>(fim.n_slices);
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel
+    {
+        //Each LoGFilter2D object has internal storage and so each thread must have its own copy.
+        std::vector<LoGFilter2D<FloatT,IdxT>> filters;
+        for(IdxT s=0; s<nScales; s++) filters.push_back(LoGFilter2D<FloatT,IdxT>(imsize,sigma.col(s)));
+        ImageT frame_buf;
+        #pragma omp for
+        for(IdxT n=0; n<nT; n++)
+            catcher.run([&]{
+                const ImageT &frame = defectFreeFrame(im.slice(n), frame_buf);
+                for(IdxT s=0; s<nScales; s++) filters[s].filter(frame,fim.slice(n).slice(s));
+            });
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D<FloatT,IdxT>::filterScaledDoG(const ImageStackT &im, ScaledImageStackT &fim) const
+{
+    IdxT nT=static_cast<IdxT>(fim.n_slices);
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    if(gauss_cache) {
+        uint64_t source = GaussCacheT::fingerprint(im.memptr(), im.n_elem*sizeof(FloatT));
+        #pragma omp parallel
+        {
+            ImageT frame_buf;
+            #pragma omp for
+            for(IdxT n=0; n<nT; n++)
+                catcher.run([&]{
+                    filterFrameDoGCached(source, n, defectFreeFrame(im.slice(n), frame_buf), fim.slice(n));
+                });
+        }
+        catcher.rethrow(); //Rethrow any caught exceptions
+        return;
+    }
+    #pragma omp parallel
+    {
+        //Each LoGFilter2D object has internal storage and so each thread must have its own copy.
+        std::vector<DoGFilter2D<FloatT,IdxT>> filters;
+        for(IdxT s=0; s<nScales; s++)
+            filters.push_back(DoGFilter2D<FloatT,IdxT>(imsize,sigma.col(s),sigma_ratio));
+        ImageT frame_buf;
+        #pragma omp for
+        for(IdxT n=0; n<nT; n++)
+            catcher.run([&]{
+                const ImageT &frame = defectFreeFrame(im.slice(n), frame_buf);
+                for(IdxT s=0; s<nScales; s++) filters[s].filter(frame,fim.slice(n).slice(s));
+            });
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+}
+
+/**
+ * Each scale filter writes its final combine pass straight into the interleaved frame with stride nScales, so there
+ * is no planar scaled image and no transpose.  Frames are split between threads, so each thread writes its own
+ * slices of fim.
+ */
+template<class FloatT, class IdxT>
+void Boxxer2D<FloatT,IdxT>::filterScaledLoGInterleaved(const ImageStackT &im, ScaledImageStackT &fim) const
+{
+    checkInterleavedSize(fim, static_cast<IdxT>(im.n_slices));
+    IdxT nT=static_cast<IdxT>(fim.sN);
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel
+    {
+        std::vector<LoGFilter2D<FloatT,IdxT>> filters;
+        for(IdxT s=0; s<nScales; s++) filters.push_back(LoGFilter2D<FloatT,IdxT>(imsize,sigma.col(s)));
+        ImageT frame_buf;
+        #pragma omp for
+        for(IdxT n=0; n<nT; n++)
+            catcher.run([&]{
+                const ImageT &frame = defectFreeFrame(im.slice(n), frame_buf);
+                FloatT *out = fim.slice(n).memptr();
+                for(IdxT s=0; s<nScales; s++) filters[s].filter(frame, out+s, nScales);
+            });
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D<FloatT,IdxT>::filterScaledDoGInterleaved(const ImageStackT &im, ScaledImageStackT &fim) const
+{
+    checkInterleavedSize(fim, static_cast<IdxT>(im.n_slices));
+    IdxT nT=static_cast<IdxT>(fim.sN);
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    uint64_t source = gauss_cache ? GaussCacheT::fingerprint(im.memptr(), im.n_elem*sizeof(FloatT)) : 0;
+    #pragma omp parallel
+    {
+        std::vector<DoGFilter2D<FloatT,IdxT>> filters;
+        if(!gauss_cache) for(IdxT s=0; s<nScales; s++)
+            filters.push_back(DoGFilter2D<FloatT,IdxT>(imsize,sigma.col(s),sigma_ratio));
+        ImageT frame_buf;
+        #pragma omp for
+        for(IdxT n=0; n<nT; n++)
+            catcher.run([&]{
+                const ImageT &frame = defectFreeFrame(im.slice(n), frame_buf);
+                FloatT *out = fim.slice(n).memptr();
+                if(gauss_cache) filterFrameDoGCached(source, n, frame, out, nScales, 1);
+                else for(IdxT s=0; s<nScales; s++) filters[s].filter(frame, out+s, nScales);
+            });
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+}
+
+/**
+ * The a trous wavelet planes W_j for levels j = wavelet_first_level ... wavelet_first_level+nScales-1 as scales.
+ * Levels are computed incrementally, so all scales together cost about as much as the last one alone.
+ */
+template<class FloatT, class IdxT>
+void Boxxer2D<FloatT,IdxT>::filterScaledWavelet(const ImageStackT &im, ScaledImageStackT &fim) const
+{
+    IdxT nT=static_cast<IdxT>(fim.n_slices);
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel
+    {
+        AtrousFilter2D<FloatT,IdxT> filter(imsize, wavelet_first_level, nScales);
+        ImageT frame_buf;
+        #pragma omp for
+        for(IdxT n=0; n<nT; n++)
+            catcher.run([&]{
+                filter.filter(defectFreeFrame(im.slice(n), frame_buf),fim.slice(n));
+            });
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+}
+
+/**
+ * 
+ * Get the maxima over all scales and all frames.  Scale and maxfind on each frame individually to
+ * cut down on memory size (otherwise it would be easier to decouple the filtering and maxfinding.
+ */
+template<class FloatT, class IdxT>
+IdxT Boxxer2D<FloatT,IdxT>::scaleSpaceLoGMaxima(const ImageStackT &im, IMatT &maxima, VecT &max_vals,
+                                   IdxT neighborhood_size, IdxT scale_neighborhood_size) const
+{
+    IdxT nT=static_cast<IdxT>(im.n_slices);
+    arma::field<IMatT> frame_maxima(nT); //These will come back 3xN
+    arma::field<VecT> frame_max_vals(nT);
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel
+    {
+        std::vector<LoGFilter2D<FloatT,IdxT>> filters;
+        for(IdxT s=0; s<nScales; s++) filters.push_back(LoGFilter2D<FloatT,IdxT>(imsize,sigma.col(s)));
+        auto sim = make_scaled_image();
+        ImageT frame_buf;
+        #pragma omp for
+        for(IdxT n=0; n<nT; n++) {
+            catcher.run([&]{
+                const ImageT &frame = defectFreeFrame(im.slice(n), frame_buf);
+                for(IdxT s=0; s<nScales; s++) filters[s].filter(frame,sim.slice(s));
+                    scaleSpaceFrameMaxima(sim, frame_maxima(n), frame_max_vals(n), neighborhood_size, scale_neighborhood_size);
+            });
+        }
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+    return combine_maxima(frame_maxima, frame_max_vals, maxima, max_vals);
+}
+
+/**
+ * scaleSpaceLoGMaxima with the Hessian eigenvalue ratio at each maxima.  The LoG filters already compute the two
+ * second derivative terms separately, so the x term is kept for each scale and the y term is the LoG minus it.  Only
+ * the cross term, and optionally the gradient, are evaluated directly, and only at the maxima.
+ */
+template<class FloatT, class IdxT>
+IdxT Boxxer2D<FloatT,IdxT>::scaleSpaceLoGMaximaShape(const ImageStackT &im, IMatT &maxima, VecT &max_vals,
+                                   VecT &hessian_ratio, IdxT neighborhood_size, IdxT scale_neighborhood_size,
+                                   VecT *gradient) const
+{
+    IdxT nT=static_cast<IdxT>(im.n_slices);
+    arma::field<IMatT> frame_maxima(nT); //These will come back 3xN
+    arma::field<VecT> frame_max_vals(nT);
+    arma::field<VecT> frame_ratio(nT);
+    arma::field<VecT> frame_gradient(gradient ? nT : 0);
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel
+    {
+        std::vector<LoGFilter2D<FloatT,IdxT>> filters;
+        for(IdxT s=0; s<nScales; s++) filters.push_back(LoGFilter2D<FloatT,IdxT>(imsize,sigma.col(s)));
+        auto sim = make_scaled_image();
+        auto dxx = make_scaled_image();
+        ImageT frame_buf;
+        #pragma omp for
+        for(IdxT n=0; n<nT; n++) {
+            catcher.run([&]{
+                const ImageT &frame = defectFreeFrame(im.slice(n), frame_buf);
+                for(IdxT s=0; s<nScales; s++) filters[s].filter(frame,sim.slice(s),dxx.slice(s));
+                IdxT nMaxima = scaleSpaceFrameMaxima(sim, frame_maxima(n), frame_max_vals(n), neighborhood_size, scale_neighborhood_size);
+                const IMatT &fmaxima = frame_maxima(n);
+                frame_ratio(n).set_size(nMaxima);
+                if(gradient) frame_gradient(n).set_size(nMaxima);
+                for(IdxT k=0; k<nMaxima; k++) {
+                    IdxT x = fmaxima(0,k), y = fmaxima(1,k), s = fmaxima(2,k);
+                    FloatT a = dxx(x,y,s);
+                    FloatT b = filters[s].hessian_cross(frame, x, y);
+                    frame_ratio(n)(k) = hessianRatio2D(a, b, sim(x,y,s)-a);
+                    if(gradient) frame_gradient(n)(k) = filters[s].gradient_norm(frame, x, y);
+                }
+            });
+        }
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+    concat_frame_values(frame_ratio, hessian_ratio);
+    if(gradient) concat_frame_values(frame_gradient, *gradient);
+    return combine_maxima(frame_maxima, frame_max_vals, maxima, max_vals);
+}
+
+template<class FloatT, class IdxT>
+IdxT Boxxer2D<FloatT,IdxT>::scaleSpaceDoGMaxima(const ImageStackT &im, IMatT &maxima, VecT &max_vals,
+                                      IdxT neighborhood_size, IdxT scale_neighborhood_size) const
+{
+    IdxT nT=static_cast<IdxT>(im.n_slices);
+    arma::field<IMatT> frame_maxima(nT); //These will come back 3xN
+    arma::field<VecT> frame_max_vals(nT);
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    if(gauss_cache) {
+        uint64_t source = GaussCacheT::fingerprint(im.memptr(), im.n_elem*sizeof(FloatT));
+        #pragma omp parallel
+        {
+            auto sim = make_scaled_image();
+            ImageT frame_buf;
+            #pragma omp for
+            for(IdxT n=0; n<nT; n++) {
+                catcher.run([&]{
+                    filterFrameDoGCached(source, n, defectFreeFrame(im.slice(n), frame_buf), sim);
+                    scaleSpaceFrameMaxima(sim, frame_maxima(n), frame_max_vals(n), neighborhood_size, scale_neighborhood_size);
+                });
+            }
+        }
+        catcher.rethrow(); //Rethrow any caught exceptions
+        return combine_maxima(frame_maxima, frame_max_vals, maxima, max_vals);
+    }
+    #pragma omp parallel
+    {
+        std::vector<DoGFilter2D<FloatT,IdxT>> filters;
+        for(IdxT s=0; s<nScales; s++) filters.push_back(DoGFilter2D<FloatT,IdxT>(imsize,sigma.col(s),sigma_ratio));
+        auto sim = make_scaled_image();
+        ImageT frame_buf;
+        #pragma omp for
+        for(IdxT n=0; n<nT; n++) {
+            catcher.run([&]{
+                const ImageT &frame = defectFreeFrame(im.slice(n), frame_buf);
+                for(IdxT s=0; s<nScales; s++) filters[s].filter(frame,sim.slice(s));
+                    scaleSpaceFrameMaxima(sim, frame_maxima(n), frame_max_vals(n), neighborhood_size, scale_neighborhood_size);
+            });
+        }
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+    return combine_maxima(frame_maxima, frame_max_vals, maxima, max_vals);
+}
+
+template<class FloatT, class IdxT>
+IdxT Boxxer2D<FloatT,IdxT>::scaleSpaceWaveletMaxima(const ImageStackT &im, IMatT &maxima, VecT &max_vals,
+                                      IdxT neighborhood_size, IdxT scale_neighborhood_size) const
+{
+    IdxT nT=static_cast<IdxT>(im.n_slices);
+    arma::field<IMatT> frame_maxima(nT); //These will come back 3xN
+    arma::field<VecT> frame_max_vals(nT);
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel
+    {
+        AtrousFilter2D<FloatT,IdxT> filter(imsize, wavelet_first_level, nScales);
+        auto sim = make_scaled_image();
+        ImageT frame_buf;
+        #pragma omp for
+        for(IdxT n=0; n<nT; n++) {
+            catcher.run([&]{
+                filter.filter(defectFreeFrame(im.slice(n), frame_buf),sim);
+                scaleSpaceFrameMaxima(sim, frame_maxima(n), frame_max_vals(n), neighborhood_size, scale_neighborhood_size);
+            });
+        }
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+    return combine_maxima(frame_maxima, frame_max_vals, maxima, max_vals);
+}
+
+/**
+ * Evaluate the DoG scale-space maxima for every combination of sigma ratio, neighborhood size,
+ * scale neighborhood size and threshold in a single pass over the image stack.
+ *
+ * Each frame is filtered once per distinct Gaussian kernel: the excitatory Gaussians are shared by all
+ * sigma ratios and only the inhibitory Gaussians are computed per ratio.  The 3x3 maxima of each scale are
+ * found once per ratio, and larger neighborhood and scale neighborhood sizes are derived incrementally
+ * from the smaller ones, as the maxima over a larger neighborhood are a subset of those over a smaller one.
+ * Thresholds are applied last and keep maxima with value strictly greater than the threshold.
+ *
+ * For a threshold of -inf the result for each combination is identical to calling setDoGSigmaRatio() and
+ * scaleSpaceDoGMaxima() with the corresponding parameters.
+ *
+ * Combinations are ordered with threshold fastest, then scale_neighborhood_size, neighborhood_size,
+ * and sigma_ratio slowest, i.e., c = t + nThresh*(q + nScaleNbhd*(k + nNbhd*r)).
+ *
+ * @param im Image stack
+ * @param sigma_ratios DoG sigma ratios to evaluate.  Each must be >1.
+ * @param neighborhood_sizes Odd spatial neighborhood sizes >=3.
+ * @param scale_neighborhood_sizes Odd scale neighborhood sizes.
+ * @param thresholds Detection thresholds.
+ * @param sweep_params [out] size:[4 x nCombinations] rows=[sigma_ratio, neighborhood_size, scale_neighborhood_size, threshold]
+ * @param maxima [out] size:[nCombinations] Each element is 4xN maxima as returned by scaleSpaceDoGMaxima.
+ * @param max_vals [out] size:[nCombinations] Each element is the corresponding maxima values.
+ * @returns Number of combinations evaluated.
+ */
+template<class FloatT, class IdxT>
+IdxT Boxxer2D<FloatT,IdxT>::scaleSpaceDoGMaximaSweep(const ImageStackT &im, const VecT &sigma_ratios,
+                                      const IVecT &neighborhood_sizes, const IVecT &scale_neighborhood_sizes,
+                                      const VecT &thresholds, MatT &sweep_params,
+                                      arma::field<IMatT> &maxima, arma::field<VecT> &max_vals) const
+{
+    IdxT nR = static_cast<IdxT>(sigma_ratios.n_elem);
+    IdxT nK = static_cast<IdxT>(neighborhood_sizes.n_elem);
+    IdxT nQ = static_cast<IdxT>(scale_neighborhood_sizes.n_elem);
+    IdxT nTh = static_cast<IdxT>(thresholds.n_elem);
+    if(nR==0 || nK==0 || nQ==0 || nTh==0) throw ParameterShapeError("Empty sweep parameter vector.");
+    for(IdxT r=0; r<nR; r++) if(!(sigma_ratios(r)>1)) {
+        std::ostringstream msg;
+        msg<<"Got bad sigma ratio: "<<sigma_ratios(r);
+        throw ParameterValueError(msg.str());
+    }
+    for(IdxT k=0; k<nK; k++) if(neighborhood_sizes(k)<3 || neighborhood_sizes(k)%2==0) {
+        std::ostringstream msg;
+        msg<<"Neighborhood size must be odd and >=3 got: "<<neighborhood_sizes(k);
+        throw ParameterValueError(msg.str());
+    }
+    for(IdxT q=0; q<nQ; q++) if(scale_neighborhood_sizes(q)%2==0) {
+        std::ostringstream msg;
+        msg<<"Scale neighborhood size must be odd got: "<<scale_neighborhood_sizes(q);
+        throw ParameterValueError(msg.str());
+    }
+    //Process neighborhood sizes in increasing order so each refinement starts from the previous survivors
+    auto increasing_order = [](const IVecT &v) {
+        std::vector<IdxT> order(v.n_elem);
+        for(IdxT i=0; i<v.n_elem; i++) order[i]=i;
+        std::stable_sort(order.begin(), order.end(), [&](IdxT a, IdxT b){ return v(a)<v(b); });
+        return order;
+    };
+    auto k_order = increasing_order(neighborhood_sizes);
+    auto q_order = increasing_order(scale_neighborhood_sizes);
+
+    IdxT nCombos = nR*nK*nQ*nTh;
+    auto combo_idx = [=](IdxT r, IdxT k, IdxT q, IdxT t) { return t + nTh*(q + nQ*(k + nK*r)); };
+    sweep_params.set_size(4,nCombos);
+    for(IdxT r=0; r<nR; r++) for(IdxT k=0; k<nK; k++) for(IdxT q=0; q<nQ; q++) for(IdxT t=0; t<nTh; t++) {
+        IdxT c = combo_idx(r,k,q,t);
+        sweep_params(0,c) = sigma_ratios(r);
+        sweep_params(1,c) = neighborhood_sizes(k);
+        sweep_params(2,c) = scale_neighborhood_sizes(q);
+        sweep_params(3,c) = thresholds(t);
+    }
+
+    IdxT nT=static_cast<IdxT>(im.n_slices);
+    arma::field<IMatT> frame_maxima(nCombos,nT);
+    arma::field<VecT> frame_max_vals(nCombos,nT);
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel
+    {
+        //Gauss filters have internal storage so each thread must have its own copies
+        std::vector<GaussFilter2D<FloatT,IdxT>> excite_filters;
+        std::vector<GaussFilter2D<FloatT,IdxT>> inhibit_filters; //index: s + nScales*r
+        for(IdxT s=0; s<nScales; s++) {
+            VecT excite_sigma = sigma.col(s);
+            excite_filters.push_back(GaussFilter2D<FloatT,IdxT>(imsize, excite_sigma,
+                                            GaussFIRFilter<FloatT,IdxT>::default_kernel_hw(excite_sigma)));
+        }
+        for(IdxT r=0; r<nR; r++) for(IdxT s=0; s<nScales; s++) {
+            VecT excite_sigma = sigma.col(s);
+            VecT inhibit_sigma = excite_sigma*sigma_ratios(r);
+            inhibit_filters.push_back(GaussFilter2D<FloatT,IdxT>(imsize, inhibit_sigma,
+                                            GaussFIRFilter<FloatT,IdxT>::default_kernel_hw(excite_sigma)));
+        }
+        Maxima2D<FloatT,IdxT> maxima3x3(imsize, 3);
+        auto excite = make_scaled_image();
+        auto inhibit = make_image();
+        auto sim = make_scaled_image();
+        arma::field<IMatT> scale_maxima(nScales);
+        arma::field<VecT> scale_max_vals(nScales);
+        IMatT fmaxima;
+        VecT fmax_vals;
+        ImageT frame_buf;
+        #pragma omp for
+        for(IdxT n=0; n<nT; n++) {
+            catcher.run([&]{
+                const ImageT &frame = defectFreeFrame(im.slice(n), frame_buf);
+                for(IdxT s=0; s<nScales; s++) excite_filters[s].filter(frame, excite.slice(s));
+                for(IdxT r=0; r<nR; r++) {
+                    for(IdxT s=0; s<nScales; s++) {
+                        inhibit_filters[s+nScales*r].filter(frame, inhibit);
+                        sim.slice(s) = excite.slice(s) - inhibit;
+                        maxima3x3.find_maxima(sim.slice(s), scale_maxima(s), scale_max_vals(s));
+                    }
+                    for(IdxT k: k_order) {
+                        if(neighborhood_sizes(k)>3) for(IdxT s=0; s<nScales; s++)
+                            maxima3x3.refine_maxima(sim.slice(s), scale_maxima(s), scale_max_vals(s), neighborhood_sizes(k));
+                        combine_maxima(scale_maxima, scale_max_vals, fmaxima, fmax_vals);
+                        for(IdxT q: q_order) {
+                            scaleSpaceFrameMaximaRefine(sim, fmaxima, fmax_vals, scale_neighborhood_sizes(q));
+                            for(IdxT t=0; t<nTh; t++) {
+                                IdxT c = combo_idx(r,k,q,t);
+                                thresholdMaxima(fmaxima, fmax_vals, thresholds(t), frame_maxima(c,n), frame_max_vals(c,n));
+                            }
+                        }
+                    }
+                }
+            });
+        }
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+    maxima.set_size(nCombos);
+    max_vals.set_size(nCombos);
+    arma::field<IMatT> combo_maxima(nT);
+    arma::field<VecT> combo_max_vals(nT);
+    for(IdxT c=0; c<nCombos; c++) {
+        for(IdxT n=0; n<nT; n++) {
+            combo_maxima(n) = std::move(frame_maxima(c,n));
+            combo_max_vals(n) = std::move(frame_max_vals(c,n));
+        }
+        combine_maxima(combo_maxima, combo_max_vals, maxima(c), max_vals(c));
+    }
+    return nCombos;
+}
+
+/**
+ * Get the Gaussian filtered frame n of the stack with fingerprint source from the cache, or compute and cache it.
+ */
+template<class FloatT, class IdxT>
+std::shared_ptr<const typename Boxxer2D<FloatT,IdxT>::ImageT>
+Boxxer2D<FloatT,IdxT>::cachedGaussFrame(uint64_t source, IdxT n, const ImageT &frame, const VecT &gsigma,
+                                        const IVecT &hw) const
+{
+    auto key = GaussCacheT::make_key(source, n, gsigma, hw);
+    auto cached = gauss_cache->find(key);
+    if(cached) return cached;
+    GaussFilter2D<FloatT,IdxT> filter(imsize, gsigma, hw);
+    auto gim = std::make_shared<ImageT>(imsize(0),imsize(1));
+    filter.filter(frame, *gim);
+    gauss_cache->insert(key, gim);
+    return gim;
+}
+
+/**
+ * Make a mask from a list of rectangular regions of interest.
+ *
+ * @param rois size:[4 x nROI] Rows are [x0, y0, nx, ny], the 0-based origin and size of each region.  Regions
+ *             are clipped to the frame.
+ */
+template<class FloatT, class IdxT>
+typename Boxxer2D<FloatT,IdxT>::MaskT
+Boxxer2D<FloatT,IdxT>::makeROIMask(const IMatT &rois) const
+{
+    if(rois.n_rows!=4 && rois.n_elem>0) {
+        std::ostringstream msg;
+        msg<<"Got ROI list with #rows: "<<rois.n_rows<<" expected 4";
+        throw ParameterShapeError(msg.str());
+    }
+    MaskT mask(imsize(0),imsize(1));
+    mask.zeros();
+    for(IdxT r=0; r<rois.n_cols; r++) {
+        IdxT x0 = std::min(rois(0,r),imsize(0));
+        IdxT y0 = std::min(rois(1,r),imsize(1));
+        IdxT x1 = std::min(x0+rois(2,r),imsize(0));
+        IdxT y1 = std::min(y0+rois(3,r),imsize(1));
+        for(IdxT y=y0; y<y1; y++) for(IdxT x=x0; x<x1; x++) mask(x,y) = 1;
+    }
+    return mask;
+}
+
+template<class FloatT, class IdxT>
+IdxT Boxxer2D<FloatT,IdxT>::scaleSpaceLoGMaximaMasked(const ImageStackT &im, const MaskT &mask, IMatT &maxima, VecT &max_vals,
+                                      IdxT neighborhood_size, IdxT scale_neighborhood_size) const
+{
+    return scaleSpaceMaximaMasked(im, mask, false, maxima, max_vals, neighborhood_size, scale_neighborhood_size);
+}
+
+template<class FloatT, class IdxT>
+IdxT Boxxer2D<FloatT,IdxT>::scaleSpaceDoGMaximaMasked(const ImageStackT &im, const MaskT &mask, IMatT &maxima, VecT &max_vals,
+                                      IdxT neighborhood_size, IdxT scale_neighborhood_size) const
+{
+    return scaleSpaceMaximaMasked(im, mask, true, maxima, max_vals, neighborhood_size, scale_neighborhood_size);
+}
+
+template<class FloatT, class IdxT>
+IdxT Boxxer2D<FloatT,IdxT>::scaleSpaceLoGMaximaTemporal(const ImageStackT &im, FloatT threshold, IMatT &maxima, VecT &max_vals,
+                                      IdxT neighborhood_size, IdxT scale_neighborhood_size, TemporalSkipStats *stats) const
+{
+    return scaleSpaceMaximaTemporal(im, false, threshold, maxima, max_vals, neighborhood_size, scale_neighborhood_size, stats);
+}
+
+template<class FloatT, class IdxT>
+IdxT Boxxer2D<FloatT,IdxT>::scaleSpaceDoGMaximaTemporal(const ImageStackT &im, FloatT threshold, IMatT &maxima, VecT &max_vals,
+                                      IdxT neighborhood_size, IdxT scale_neighborhood_size, TemporalSkipStats *stats) const
+{
+    return scaleSpaceMaximaTemporal(im, true, threshold, maxima, max_vals, neighborhood_size, scale_neighborhood_size, stats);
+}
+
+/* A tile of the frame and the window it is filtered in */
+template<class FloatT, class IdxT>
+struct Boxxer2D<FloatT,IdxT>::MaskTile
+{
+    IdxT lo[2], hi[2]; //Tile pixels [lo,hi)
+    IdxT win_lo[2], win_size[2]; //Filtering window
+};
+
+/**
+ * The window a box [lo,hi) of a frame is filtered in, for exact filtered values in the box.
+ *
+ * The window extends the box by a halo: margin, e.g., the NMS and scale neighborhood half-width so every maxima test
+ * of a box pixel sees exact filtered values, plus the kernel half-width hw, so those values see all the input they
+ * need.  Windows are clipped to the frame, so the mirroring boundary conditions apply only at the real frame edges.
+ * Windows are never narrower than the filters' 2*hw+2 direct-convolution limit unless the frame is, so the
+ * windowed filters take the same code path as the full-frame filters and give identical results.
+ *
+ * The arrays have one element per dimension of frame_size, so the same rules serve the 3D windows of Boxxer3D.
+ */
+template<class FloatT, class IdxT>
+void Boxxer2D<FloatT,IdxT>::filterWindowBounds(const IdxT lo[], const IdxT hi[], const IVecT &frame_size,
+                                               IdxT margin, const IVecT &hw, IdxT win_lo[], IdxT win_size[])
+{
+    for(IdxT d=0; d<frame_size.n_elem; d++) {
+        IdxT halo = margin+hw(d);
+        IdxT wlo = lo[d]<halo ? 0 : lo[d]-halo;
+        IdxT whi = std::min(hi[d]+halo, frame_size(d));
+        IdxT min_size = 2*hw(d)+2;
+        if(frame_size(d)>=min_size && whi-wlo<min_size) {
+            whi = std::min(wlo+min_size, frame_size(d));
+            wlo = whi-min_size;
+        }
+        win_lo[d] = wlo;
+        win_size[d] = whi-wlo;
+    }
+}
+
+/** The largest kernel half-width of any scale along each dimension */
+template<class FloatT, class IdxT>
+typename Boxxer2D<FloatT,IdxT>::IVecT Boxxer2D<FloatT,IdxT>::maxKernelHW() const
+{
+    IVecT hw_max = {0,0};
+    for(IdxT s=0; s<nScales; s++) {
+        IVecT hw = GaussFIRFilter<FloatT,IdxT>::default_kernel_hw(sigma.col(s));
+        for(IdxT d=0; d<2; d++) hw_max(d) = std::max(hw_max(d), hw(d));
+    }
+    return hw_max;
+}
+
+/**
+ * Divide the frame into MaskTileSize square tiles, and compute the filtering window of each with
+ * filterWindowBounds(), using the largest kernel of any scale.
+ *
+ * @param mask If non-null, tiles without any nonzero mask pixels are omitted.
+ */
+template<class FloatT, class IdxT>
+std::vector<typename Boxxer2D<FloatT,IdxT>::MaskTile>
+Boxxer2D<FloatT,IdxT>::makeMaskTiles(const MaskT *mask, IdxT neighborhood_size, IdxT scale_neighborhood_size) const
+{
+    if(mask && (mask->n_rows!=imsize(0) || mask->n_cols!=imsize(1))) {
+        std::ostringstream msg;
+        msg<<"Got mask of size ["<<mask->n_rows<<","<<mask->n_cols<<"] expected imsize: "<<imsize.t();
+        throw ParameterShapeError(msg.str());
+    }
+    IdxT margin = std::max(std::max((neighborhood_size-1)/2, IdxT(1)), (scale_neighborhood_size-1)/2);
+    IVecT hw_max = maxKernelHW();
+    std::vector<MaskTile> tiles;
+    for(IdxT ty=0; ty<imsize(1); ty+=MaskTileSize) for(IdxT tx=0; tx<imsize(0); tx+=MaskTileSize) {
+        MaskTile tile;
+        tile.lo[0] = tx;
+        tile.lo[1] = ty;
+        tile.hi[0] = std::min(tx+MaskTileSize, imsize(0));
+        tile.hi[1] = std::min(ty+MaskTileSize, imsize(1));
+        if(mask) {
+            bool active = false;
+            for(IdxT y=tile.lo[1]; y<tile.hi[1] && !active; y++)
+                for(IdxT x=tile.lo[0]; x<tile.hi[0]; x++) if((*mask)(x,y)) { active=true; break; }
+            if(!active) continue;
+        }
+        filterWindowBounds(tile.lo, tile.hi, imsize, margin, hw_max, tile.win_lo, tile.win_size);
+        tiles.push_back(tile);
+    }
+    return tiles;
+}
+
+/**
+ * Filter one tile of a frame at all scales and find its scale-space maxima.
+ *
+ * @param mask If non-null only maxima at nonzero mask pixels are kept.
+ * @param ff The frame filter for the tile's window size.
+ * @param maxima [out] 3xN maxima in frame coordinates.  Rows are [x, y, scale].
+ * @returns The largest filtered value over the tile pixels and all scales.
+ */
+template<class FloatT, class IdxT>
+FloatT Boxxer2D<FloatT,IdxT>::scaleSpaceTileMaxima(const ImageT &frame, const MaskTile &tile, const MaskT *mask,
+                                      FrameFilter &ff, IMatT &maxima, VecT &max_vals,
+                                      IdxT neighborhood_size, IdxT scale_neighborhood_size) const
+{
+    const ScaledImageT &sim = ff.filterWindow(frame, tile.win_lo[0], tile.win_lo[1], {tile.win_size[0], tile.win_size[1]});
+    FloatT tile_max = -std::numeric_limits<FloatT>::infinity();
+    for(IdxT s=0; s<nScales; s++)
+        for(IdxT y=tile.lo[1]; y<tile.hi[1]; y++) for(IdxT x=tile.lo[0]; x<tile.hi[0]; x++)
+            tile_max = std::max(tile_max, sim(x-tile.win_lo[0], y-tile.win_lo[1], s));
+    //Keep only the maxima in the tile and the mask
+    ff.maxima(maxima, max_vals, neighborhood_size, scale_neighborhood_size, [&](IdxT x, IdxT y) {
+        return x>=tile.lo[0] && x<tile.hi[0] && y>=tile.lo[1] && y<tile.hi[1] && (!mask || (*mask)(x,y));
+    });
+    return tile_max;
+}
+
+/**
+ * Scale-space maxima restricted to the nonzero pixels of a mask.
+ *
+ * Tiles without any mask pixels are skipped entirely, so the cost scales with the masked area.  The result is
+ * identical to the unmasked method followed by discarding maxima outside the mask.
+ */
+template<class FloatT, class IdxT>
+IdxT Boxxer2D<FloatT,IdxT>::scaleSpaceMaximaMasked(const ImageStackT &im, const MaskT &mask, bool use_DoG,
+                                      IMatT &maxima, VecT &max_vals,
+                                      IdxT neighborhood_size, IdxT scale_neighborhood_size) const
+{
+    IdxT nT=static_cast<IdxT>(im.n_slices);
+    auto tiles = makeMaskTiles(&mask, neighborhood_size, scale_neighborhood_size);
+    IdxT nTiles = static_cast<IdxT>(tiles.size());
+    std::size_t nItems = static_cast<std::size_t>(nTiles)*nT;
+    if(nItems==0) {
+        maxima.set_size(4,0);
+        max_vals.reset();
+        return 0;
+    }
+    arma::field<IMatT> item_maxima(nItems); //These will come back 3xN
+    arma::field<VecT> item_max_vals(nItems);
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel
+    {
+        //Filters have internal storage sized to the window, so each thread keeps one frame filter per window size
+        std::map<std::pair<IdxT,IdxT>, FrameFilter> filters;
+        #pragma omp for schedule(dynamic)
+        for(std::size_t item=0; item<nItems; item++) {
+            catcher.run([&]{
+                const MaskTile &tile = tiles[item%nTiles];
+                IdxT n = static_cast<IdxT>(item/nTiles);
+                auto &ff = filters.emplace(std::make_pair(tile.win_size[0],tile.win_size[1]),
+                                           FrameFilter(*this, use_DoG)).first->second;
+                scaleSpaceTileMaxima(im.slice(n), tile, &mask, ff, item_maxima(item), item_max_vals(item),
+                                     neighborhood_size, scale_neighborhood_size);
+            });
+        }
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+    IdxT Nmaxima = combine_maxima(item_maxima, item_max_vals, maxima, max_vals);
+    for(IdxT k=0; k<Nmaxima; k++) maxima(3,k) /= nTiles; //Item index to frame index
+    return Nmaxima;
+}
+
+/**
+ * Scale-space maxima with value strictly greater than threshold, skipping tiles whose input has not changed enough
+ * to produce any.
+ *
+ * Each tile keeps a reference frame, the last frame it was fully processed in, and the largest filtered value M over
+ * its pixels and all scales in that frame.  The filters are linear, so for any frame n the filtered tile values are
+ * bounded by M + L1*D, where L1 is the largest l1-norm of the 2D kernels over the scales, and D is the largest
+ * absolute input difference between frame n and the reference frame over the tile's filtering window.  Mirroring
+ * only ever drops kernel taps, so the bound holds at the frame edges too.  When the bound, padded by a floating point
+ * summation error term, is not above threshold the tile cannot contain maxima above threshold and it is skipped.
+ * Otherwise the tile is processed normally and the frame becomes its new reference.
+ *
+ * The result is identical to the unskipped method followed by discarding maxima with value <= threshold.
+ *
+ * @param stats [out] Optional.  Counts of processed and skipped tile-frames.
+ */
+template<class FloatT, class IdxT>
+IdxT Boxxer2D<FloatT,IdxT>::scaleSpaceMaximaTemporal(const ImageStackT &im, bool use_DoG, FloatT threshold,
+                                      IMatT &maxima, VecT &max_vals,
+                                      IdxT neighborhood_size, IdxT scale_neighborhood_size, TemporalSkipStats *stats) const
+{
+    IdxT nT=static_cast<IdxT>(im.n_slices);
+    auto tiles = makeMaskTiles(nullptr, neighborhood_size, scale_neighborhood_size);
+    IdxT nTiles = static_cast<IdxT>(tiles.size());
+    //Largest l1-norm of the 2D kernels over scales, and the number of taps summed per pixel
+    double kernel_l1 = 0;
+    IdxT nTaps = 0;
+    for(IdxT s=0; s<nScales; s++) {
+        IVecT hw = GaussFIRFilter<FloatT,IdxT>::default_kernel_hw(sigma.col(s));
+        kernel_l1 = std::max(kernel_l1, kernelL1(s, use_DoG));
+        nTaps = std::max(nTaps, 2*(hw(0)+hw(1)+1));
+    }
+    const double round_err = 4.0*nTaps*std::numeric_limits<FloatT>::epsilon();
+
+    arma::field<IMatT> item_maxima(static_cast<std::size_t>(nTiles)*nT); //Frame-major items, 3xN
+    arma::field<VecT> item_max_vals(item_maxima.n_elem);
+    std::size_t nSkipped = 0;
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel reduction(+:nSkipped)
+    {
+        std::map<std::pair<IdxT,IdxT>, FrameFilter> filters;
+        #pragma omp for schedule(dynamic)
+        for(IdxT t=0; t<nTiles; t++) {
+            catcher.run([&]{
+                //Frames are processed in order for each tile, as the skip test depends on the reference frame
+                const MaskTile &tile = tiles[t];
+                auto &ff = filters.emplace(std::make_pair(tile.win_size[0],tile.win_size[1]),
+                                           FrameFilter(*this, use_DoG)).first->second;
+                auto rows = arma::span(tile.win_lo[0], tile.win_lo[0]+tile.win_size[0]-1);
+                auto cols = arma::span(tile.win_lo[1], tile.win_lo[1]+tile.win_size[1]-1);
+                IdxT ref = 0;
+                double ref_max = 0;
+                for(IdxT n=0; n<nT; n++) {
+                    std::size_t item = static_cast<std::size_t>(n)*nTiles+t;
+                    if(n>0) {
+                        double max_diff = 0, max_abs = 0;
+                        for(IdxT y=cols.a; y<=cols.b; y++) {
+                            const FloatT *cur = im.slice(n).colptr(y);
+                            const FloatT *prev = im.slice(ref).colptr(y);
+                            const uint8_t *defect = defect_map ? defect_map->mask.colptr(y) : nullptr;
+                            for(IdxT x=rows.a; x<=rows.b; x++) {
+                                if(defect && defect[x]) continue; //Bounded by their neighbors below
+                                max_diff = std::max(max_diff, static_cast<double>(std::abs(cur[x]-prev[x])));
+                                max_abs = std::max(max_abs, static_cast<double>(std::max(std::abs(cur[x]),std::abs(prev[x]))));
+                            }
+                        }
+                        if(defect_map) defect_map->diff_bound(im.slice(n), im.slice(ref), rows.a, rows.b, cols.a, cols.b,
+                                                              max_diff, max_abs);
+                        double bound = ref_max + kernel_l1*(max_diff + 2*round_err*max_abs);
+                        if(bound<=threshold) {
+                            item_maxima(item).set_size(3,0);
+                            item_max_vals(item).reset();
+                            nSkipped++;
+                            continue;
+                        }
+                    }
+                    ref = n;
+                    ref_max = scaleSpaceTileMaxima(im.slice(n), tile, nullptr, ff, item_maxima(item), item_max_vals(item),
+                                                   neighborhood_size, scale_neighborhood_size);
+                    IMatT thresh_maxima;
+                    VecT thresh_max_vals;
+                    thresholdMaxima(item_maxima(item), item_max_vals(item), threshold, thresh_maxima, thresh_max_vals);
+                    item_maxima(item) = std::move(thresh_maxima);
+                    item_max_vals(item) = std::move(thresh_max_vals);
+                }
+            });
+        }
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+    if(stats) {
+        stats->nTileFrames = item_maxima.n_elem;
+        stats->nSkipped = nSkipped;
+    }
+    if(item_maxima.n_elem==0) {
+        maxima.set_size(4,0);
+        max_vals.reset();
+        return 0;
+    }
+    IdxT Nmaxima = combine_maxima(item_maxima, item_max_vals, maxima, max_vals);
+    for(IdxT k=0; k<Nmaxima; k++) maxima(3,k) /= nTiles; //Item index to frame index
+    return Nmaxima;
+}
+
+/**
+ * The l1-norm of the full 2D LoG or DoG kernel of scale s.
+ *
+ * For any input, |filtered value| <= l1*max|input|.  This also holds at the frame edges, as mirroring only merges
+ * kernel taps onto the same pixel or drops them.
+ */
+template<class FloatT, class IdxT>
+double Boxxer2D<FloatT,IdxT>::kernelL1(IdxT s, bool use_DoG) const
+{
+    VecT sig = sigma.col(s);
+    IVecT hw = GaussFIRFilter<FloatT,IdxT>::default_kernel_hw(sig);
+    auto full = [](const VecT &half) {
+        IdxT k_hw = static_cast<IdxT>(half.n_elem)-1;
+        arma::Col<double> k(2*k_hw+1);
+        for(IdxT r=0; r<=k_hw; r++) k(k_hw+r) = k(k_hw-r) = half(r);
+        return k;
+    };
+    arma::Col<double> ax, ay, bx, by; //Kernel is ax*ay' + sign*bx*by'
+    double sign;
+    if(use_DoG) {
+        ax = full(GaussFIRFilter<FloatT,IdxT>::compute_Gauss_FIR_kernel(sig(0),hw(0)));
+        ay = full(GaussFIRFilter<FloatT,IdxT>::compute_Gauss_FIR_kernel(sig(1),hw(1)));
+        bx = full(GaussFIRFilter<FloatT,IdxT>::compute_Gauss_FIR_kernel(sig(0)*sigma_ratio,hw(0)));
+        by = full(GaussFIRFilter<FloatT,IdxT>::compute_Gauss_FIR_kernel(sig(1)*sigma_ratio,hw(1)));
+        sign = -1;
+    } else {
+        ax = full(GaussFIRFilter<FloatT,IdxT>::compute_LoG_FIR_kernel(sig(0),hw(0)));
+        ay = full(GaussFIRFilter<FloatT,IdxT>::compute_Gauss_FIR_kernel(sig(1),hw(1)));
+        bx = full(GaussFIRFilter<FloatT,IdxT>::compute_Gauss_FIR_kernel(sig(0),hw(0)));
+        by = full(GaussFIRFilter<FloatT,IdxT>::compute_LoG_FIR_kernel(sig(1),hw(1)));
+        sign = 1;
+    }
+    double l1 = 0;
+    for(IdxT j=0; j<ay.n_elem; j++) for(IdxT i=0; i<ax.n_elem; i++) l1 += std::abs(ax(i)*ay(j) + sign*bx(i)*by(j));
+    return l1;
+}
+
+template<class FloatT, class IdxT>
+IdxT Boxxer2D<FloatT,IdxT>::scaleSpaceLoGMaximaThreshold(const ImageStackT &im, FloatT threshold, IMatT &maxima, VecT &max_vals,
+                                      IdxT neighborhood_size, IdxT scale_neighborhood_size, IdxT *nSkippedFrames) const
+{
+    return scaleSpaceMaximaThreshold(im, false, threshold, maxima, max_vals, neighborhood_size, scale_neighborhood_size, nSkippedFrames);
+}
+
+template<class FloatT, class IdxT>
+IdxT Boxxer2D<FloatT,IdxT>::scaleSpaceDoGMaximaThreshold(const ImageStackT &im, FloatT threshold, IMatT &maxima, VecT &max_vals,
+                                      IdxT neighborhood_size, IdxT scale_neighborhood_size, IdxT *nSkippedFrames) const
+{
+    return scaleSpaceMaximaThreshold(im, true, threshold, maxima, max_vals, neighborhood_size, scale_neighborhood_size, nSkippedFrames);
+}
+
+/**
+ * Scale-space maxima with value strictly greater than threshold, skipping frames that provably have none.
+ *
+ * Write each frame as x = m + r, where m is the midpoint of the frame's pixel range and |r| <= h, its half-width.
+ * The filters are linear, so at every pixel and scale F(x) = m*F(1) + F(r) <= m*F(1) + h*L1, where F(1) is the
+ * frame-independent response to a constant image, precomputed once per call, and L1 is the kernel l1-norm.  When this
+ * bound, padded by a floating point summation error term, is not above threshold for any scale, the frame is skipped
+ * with a single min/max pass and none of its scales are filtered.  Otherwise the frame is processed normally.
+ *
+ * The result is identical to the unskipped method followed by discarding maxima with value <= threshold.
+ *
+ * @param nSkippedFrames [out] Optional.  Number of frames rejected by the bound.
+ */
+template<class FloatT, class IdxT>
+IdxT Boxxer2D<FloatT,IdxT>::scaleSpaceMaximaThreshold(const ImageStackT &im, bool use_DoG, FloatT threshold,
+                                      IMatT &maxima, VecT &max_vals,
+                                      IdxT neighborhood_size, IdxT scale_neighborhood_size, IdxT *nSkippedFrames) const
+{
+    IdxT nT=static_cast<IdxT>(im.n_slices);
+    //Frame independent bound terms for each scale
+    arma::Col<double> one_max(nScales), one_min(nScales), l1(nScales);
+    IdxT nTaps = 0;
+    {
+        ImageT ones = make_image();
+        ones.ones();
+        ImageT fones = make_image();
+        for(IdxT s=0; s<nScales; s++) {
+            if(use_DoG) DoGFilter2D<FloatT,IdxT>(imsize,sigma.col(s),sigma_ratio).filter(ones,fones);
+            else LoGFilter2D<FloatT,IdxT>(imsize,sigma.col(s)).filter(ones,fones);
+            one_max(s) = fones.max();
+            one_min(s) = fones.min();
+            l1(s) = kernelL1(s, use_DoG);
+            IVecT hw = GaussFIRFilter<FloatT,IdxT>::default_kernel_hw(sigma.col(s));
+            nTaps = std::max(nTaps, 2*(hw(0)+hw(1)+1));
+        }
+    }
+    const double round_err = 4.0*nTaps*std::numeric_limits<FloatT>::epsilon();
+
+    arma::field<IMatT> frame_maxima(nT); //These will come back 3xN
+    arma::field<VecT> frame_max_vals(nT);
+    IdxT nSkipped = 0;
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel reduction(+:nSkipped)
+    {
+        FrameFilter ff(*this, use_DoG);
+        #pragma omp for schedule(dynamic)
+        for(IdxT n=0; n<nT; n++) {
+            catcher.run([&]{
+                //The range of a patched frame is within the range of its unflagged pixels
+                const FloatT *frame = im.slice(n).memptr();
+                const uint8_t *defect = defect_map ? defect_map->mask.memptr() : nullptr;
+                FloatT lo = std::numeric_limits<FloatT>::infinity(), hi = -lo;
+                for(IdxT i=0; i<imsize(0)*imsize(1); i++) {
+                    if(defect && defect[i]) continue;
+                    lo = std::min(lo, frame[i]);
+                    hi = std::max(hi, frame[i]);
+                }
+                double m = 0.5*(static_cast<double>(lo)+hi);
+                double h = 0.5*(static_cast<double>(hi)-lo);
+                double max_abs = std::max(std::abs(static_cast<double>(lo)), std::abs(static_cast<double>(hi)));
+                bool reject = true;
+                for(IdxT s=0; s<nScales && reject; s++) {
+                    double bound = std::max(m*one_max(s), m*one_min(s)) + h*l1(s) + 2*round_err*l1(s)*max_abs;
+                    if(!(bound<=threshold)) reject = false;
+                }
+                if(reject) {
+                    frame_maxima(n).set_size(3,0);
+                    frame_max_vals(n).reset();
+                    nSkipped++;
+                    return;
+                }
+                ff.filter(im.slice(n));
+                IMatT scale_maxima;
+                VecT scale_max_vals;
+                ff.maxima(scale_maxima, scale_max_vals, neighborhood_size, scale_neighborhood_size);
+                thresholdMaxima(scale_maxima, scale_max_vals, threshold, frame_maxima(n), frame_max_vals(n));
+            });
+        }
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+    if(nSkippedFrames) *nSkippedFrames = nSkipped;
+    if(nT==0) {
+        maxima.set_size(4,0);
+        max_vals.reset();
+        return 0;
+    }
+    return combine_maxima(frame_maxima, frame_max_vals, maxima, max_vals);
+}
+
+template<class FloatT, class IdxT>
+IdxT Boxxer2D<FloatT,IdxT>::scaleSpaceLoGMaximaBinned(const ImageStackT &im, const TemporalBinningT &binning,
+                                      IMatT &maxima, VecT &max_vals, IdxT neighborhood_size,
+                                      IdxT scale_neighborhood_size) const
 {
-    if(_sigma_ratio<=1) {
-        std::ostringstream msg;
-        msg<<"Got bad sigma ratio: "<<_sigma_ratio;
-        throw ParameterShapeError(msg.str());
-    }
-    sigma_ratio=_sigma_ratio;
+    return scaleSpaceMaximaBinned(im, false, binning, maxima, max_vals, neighborhood_size, scale_neighborhood_size);
 }
 
 template<class FloatT, class IdxT>
-void Boxxer2D<FloatT,IdxT>::filterScaledLoG(const ImageStackT &im, ScaledImageStackT &fim) const
+IdxT Boxxer2D<FloatT,IdxT>::scaleSpaceDoGMaximaBinned(const ImageStackT &im, const TemporalBinningT &binning,
+                                      IMatT &maxima, VecT &max_vals, IdxT neighborhood_size,
+                                      IdxT scale_neighborhood_size) const
 {
-    IdxT nT=static_cast<IdxT>(fim.n_slices);
-    omp_exception_catcher::OMPExceptionCatcher catcher;
-    #pragma omp parallel
-    {
-        //Each LoGFilter2D object has internal storage and so each thread must have its own copy.
-        std::vector<LoGFilter2D<FloatT,IdxT>> filters;
-        for(IdxT s=0; s<nScales; s++) filters.push_back(LoGFilter2D<FloatT,IdxT>(imsize,sigma.col(s)));
-        #pragma omp for
-        for(IdxT n=0; n<nT; n++) for(IdxT s=0; s<nScales; s++)
-            catcher.run([&]{
-                filters[s].filter(im.slice(n),fim.slice(n).slice(s));
-            });
-    }
-    catcher.rethrow(); //Rethrow any caught exceptions
+    return scaleSpaceMaximaBinned(im, true, binning, maxima, max_vals, neighborhood_size, scale_neighborhood_size);
 }
 
+/**
+ * Scale-space maxima of a temporally binned movie.
+ *
+ * Each thread sums the frames of a bin into its own buffer and filters it immediately, so the binned stack is never
+ * stored.  The DoG Gaussian cache is keyed by movie frame and is not used.  Results are identical to
+ * scaleSpaceLoG/DoGMaxima of the binned stack, with frame b of the binned stack reported as its first movie frame.
+ */
 template<class FloatT, class IdxT>
-void Boxxer2D<FloatT,IdxT>::filterScaledDoG(const ImageStackT &im, ScaledImageStackT &fim) const
+IdxT Boxxer2D<FloatT,IdxT>::scaleSpaceMaximaBinned(const ImageStackT &im, bool use_DoG, const TemporalBinningT &binning,
+                                      IMatT &maxima, VecT &max_vals, IdxT neighborhood_size,
+                                      IdxT scale_neighborhood_size) const
 {
-    IdxT nT=static_cast<IdxT>(fim.n_slices);
+    binning.check();
+    IdxT nB = binning.nBins(static_cast<IdxT>(im.n_slices));
+    if(nB==0) {
+        maxima.set_size(4,0);
+        max_vals.reset();
+        return 0;
+    }
+    arma::field<IMatT> frame_maxima(nB); //These will come back 3xN
+    arma::field<VecT> frame_max_vals(nB);
     omp_exception_catcher::OMPExceptionCatcher catcher;
     #pragma omp parallel
     {
-        //Each LoGFilter2D object has internal storage and so each thread must have its own copy.
-        std::vector<DoGFilter2D<FloatT,IdxT>> filters;
-        for(IdxT s=0; s<nScales; s++)
-            filters.push_back(DoGFilter2D<FloatT,IdxT>(imsize,sigma.col(s),sigma_ratio));
+        FrameFilter ff(*this, use_DoG);
+        ImageT bin_buf, frame_buf;
         #pragma omp for
-        for(IdxT n=0; n<nT; n++) for(IdxT s=0; s<nScales; s++)
+        for(IdxT b=0; b<nB; b++) {
             catcher.run([&]{
-                filters[s].filter(im.slice(n),fim.slice(n).slice(s));
+                ff.filterPatched(binnedFrame(im, binning, b, bin_buf, frame_buf));
+                ff.maxima(frame_maxima(b), frame_max_vals(b), neighborhood_size, scale_neighborhood_size);
             });
+        }
     }
     catcher.rethrow(); //Rethrow any caught exceptions
+    IdxT Nmaxima = combine_maxima(frame_maxima, frame_max_vals, maxima, max_vals);
+    for(IdxT n=0; n<Nmaxima; n++) maxima(3,n) = binning.firstFrame(maxima(3,n)); //Report movie frames
+    return Nmaxima;
+}
+
+template<class FloatT, class IdxT>
+IdxT Boxxer2D<FloatT,IdxT>::scaleSpaceLoGMaximaAdaptive(const ImageStackT &im, FloatT threshold, IMatT &maxima,
+                                      VecT &max_vals, IdxT neighborhood_size, IdxT scale_neighborhood_size,
+                                      const AdaptiveScaleParams &params, AdaptiveScaleStats *stats) const
+{
+    return scaleSpaceMaximaAdaptive(im, false, threshold, maxima, max_vals, neighborhood_size, scale_neighborhood_size,
+                                    params, stats);
+}
+
+template<class FloatT, class IdxT>
+IdxT Boxxer2D<FloatT,IdxT>::scaleSpaceDoGMaximaAdaptive(const ImageStackT &im, FloatT threshold, IMatT &maxima,
+                                      VecT &max_vals, IdxT neighborhood_size, IdxT scale_neighborhood_size,
+                                      const AdaptiveScaleParams &params, AdaptiveScaleStats *stats) const
+{
+    return scaleSpaceMaximaAdaptive(im, true, threshold, maxima, max_vals, neighborhood_size, scale_neighborhood_size,
+                                    params, stats);
 }
 
 /**
- * 
- * Get the maxima over all scales and all frames.  Scale and maxfind on each frame individually to
- * cut down on memory size (otherwise it would be easier to decouple the filtering and maxfinding.
+ * Scale-space maxima with value strictly greater than threshold, filtering only the scales chosen by a ScalePruner.
+ *
+ * The periods of the pruner are processed in order, with the frames of each period shared among the threads.  The
+ * skipped scales are left out of the scaled image entirely, so the cross-scale refinement compares only the filtered
+ * scales.  Full frames give the same maxima as scaleSpaceLoG/DoGMaximaThreshold.
+ *
+ * @param stats [out] Optional.  Counts of the frame-scales filtered and skipped.
  */
 template<class FloatT, class IdxT>
-IdxT Boxxer2D<FloatT,IdxT>::scaleSpaceLoGMaxima(const ImageStackT &im, IMatT &maxima, VecT &max_vals,
-                                   IdxT neighborhood_size, IdxT scale_neighborhood_size) const
+IdxT Boxxer2D<FloatT,IdxT>::scaleSpaceMaximaAdaptive(const ImageStackT &im, bool use_DoG, FloatT threshold,
+                                      IMatT &maxima, VecT &max_vals, IdxT neighborhood_size,
+                                      IdxT scale_neighborhood_size, const AdaptiveScaleParams &params,
+                                      AdaptiveScaleStats *stats) const
 {
     IdxT nT=static_cast<IdxT>(im.n_slices);
+    ScalePrunerT pruner(nScales, threshold, params);
+    IdxT period = pruner.recheckPeriod();
+    MatT peaks(nScales, nT);
+    peaks.fill(-std::numeric_limits<FloatT>::infinity());
     arma::field<IMatT> frame_maxima(nT); //These will come back 3xN
     arma::field<VecT> frame_max_vals(nT);
     omp_exception_catcher::OMPExceptionCatcher catcher;
     #pragma omp parallel
     {
-        std::vector<LoGFilter2D<FloatT,IdxT>> filters;
-        for(IdxT s=0; s<nScales; s++) filters.push_back(LoGFilter2D<FloatT,IdxT>(imsize,sigma.col(s)));
-        auto sim = make_scaled_image();
-        #pragma omp for
-        for(IdxT n=0; n<nT; n++) {
-            catcher.run([&]{
-                for(IdxT s=0; s<nScales; s++) filters[s].filter(im.slice(n),sim.slice(s));
-                    scaleSpaceFrameMaxima(sim, frame_maxima(n), frame_max_vals(n), neighborhood_size, scale_neighborhood_size);
-            });
+        FrameFilter ff(*this, use_DoG);
+        for(IdxT first=0; first<nT; first+=period) {
+            IdxT last = std::min(first+period, nT);
+            #pragma omp for schedule(dynamic)
+            for(IdxT n=first; n<last; n++) {
+                catcher.run([&]{
+                    const std::vector<IdxT> &scales = pruner.isFullFrame(n) ? pruner.allScales() : pruner.activeScales();
+                    if(scales.empty()) {
+                        frame_maxima(n).set_size(3,0);
+                        return;
+                    }
+                    const ScaledImageT &sim = ff.filter(im.slice(n), scales);
+                    for(IdxT k=0; k<scales.size(); k++) peaks(scales[k],n) = sim.slice(k).max();
+                    IMatT all_maxima;
+                    VecT all_max_vals;
+                    ff.maxima(all_maxima, all_max_vals, neighborhood_size, scale_neighborhood_size);
+                    thresholdMaxima(all_maxima, all_max_vals, threshold, frame_maxima(n), frame_max_vals(n));
+                });
+            }
+            #pragma omp single
+            catcher.run([&]{ pruner.update(peaks.cols(first,last-1)); });
         }
     }
     catcher.rethrow(); //Rethrow any caught exceptions
+    if(stats) *stats = pruner.stats();
+    if(nT==0) {
+        maxima.set_size(4,0);
+        max_vals.reset();
+        return 0;
+    }
     return combine_maxima(frame_maxima, frame_max_vals, maxima, max_vals);
 }
 
 template<class FloatT, class IdxT>
-IdxT Boxxer2D<FloatT,IdxT>::scaleSpaceDoGMaxima(const ImageStackT &im, IMatT &maxima, VecT &max_vals,
-                                      IdxT neighborhood_size, IdxT scale_neighborhood_size) const
+void Boxxer2D<FloatT,IdxT>::checkInterleavedSize(const ScaledImageStackT &fim, IdxT nT) const
 {
-    IdxT nT=static_cast<IdxT>(im.n_slices);
+    if(fim.sX!=nScales || fim.sY!=imsize(0) || fim.sZ!=imsize(1) || fim.sN!=nT) {
+        std::ostringstream msg;
+        msg<<"Got interleaved scaled image stack of size: ["<<fim.sX<<","<<fim.sY<<","<<fim.sZ<<","<<fim.sN
+           <<"] expected: ["<<nScales<<","<<imsize(0)<<","<<imsize(1)<<","<<nT<<"]";
+        throw ParameterShapeError(msg.str());
+    }
+}
+
+/**
+ * DoG filter frame n at all scales using cached Gaussians.
+ *
+ * Uses the same kernels as DoGFilter2D, so the results are identical to the uncached DoG methods.
+ */
+template<class FloatT, class IdxT>
+void Boxxer2D<FloatT,IdxT>::filterFrameDoGCached(uint64_t source, IdxT n, const ImageT &frame,
+                                                 ScaledImageT &sim) const
+{
+    filterFrameDoGCached(source, n, frame, sim.memptr(), 1, static_cast<std::size_t>(sim.n_elem_slice));
+}
+
+/**
+ * As above, writing the response of scale s at pixel k to out[s*scale_stride + k*pixel_stride], so the same pass
+ * fills a planar (1, frame size) or an interleaved (nScales, 1) scaled frame.
+ */
+template<class FloatT, class IdxT>
+void Boxxer2D<FloatT,IdxT>::filterFrameDoGCached(uint64_t source, IdxT n, const ImageT &frame, FloatT *out,
+                                                 IdxT pixel_stride, std::size_t scale_stride) const
+{
+    for(IdxT s=0; s<nScales; s++) {
+        VecT excite_sigma = sigma.col(s);
+        VecT inhibit_sigma = excite_sigma*sigma_ratio;
+        IVecT hw = GaussFIRFilter<FloatT,IdxT>::default_kernel_hw(excite_sigma);
+        auto excite = cachedGaussFrame(source, n, frame, excite_sigma, hw);
+        auto inhibit = cachedGaussFrame(source, n, frame, inhibit_sigma, hw);
+        const FloatT *e = excite->memptr();
+        const FloatT *in = inhibit->memptr();
+        FloatT *scale_out = out + s*scale_stride;
+        for(std::size_t k=0; k<excite->n_elem; k++) scale_out[k*pixel_stride] = e[k]-in[k];
+    }
+}
+
+template<class FloatT, class IdxT>
+Boxxer2D<FloatT,IdxT>::FrameFilter::FrameFilter(const Boxxer2D &engine, bool use_DoG)
+    : _engine(&engine), use_DoG(use_DoG), size({0,0}), filter_sigma_ratio(0), origin{0,0}
+{ }
+
+template<class FloatT, class IdxT>
+const typename Boxxer2D<FloatT,IdxT>::ScaledImageT&
+Boxxer2D<FloatT,IdxT>::FrameFilter::filter(const ImageT &frame)
+{
+    return filter(frame, allScales());
+}
+
+template<class FloatT, class IdxT>
+const typename Boxxer2D<FloatT,IdxT>::ScaledImageT&
+Boxxer2D<FloatT,IdxT>::FrameFilter::filter(const ImageT &frame, const std::vector<IdxT> &scales)
+{
+    origin[0] = origin[1] = 0;
+    return filterScales(_engine->defectFreeFrame(frame, window), scales);
+}
+
+template<class FloatT, class IdxT>
+const typename Boxxer2D<FloatT,IdxT>::ScaledImageT&
+Boxxer2D<FloatT,IdxT>::FrameFilter::filterWindow(const ImageT &frame, IdxT x0, IdxT y0, const IVecT &win_size)
+{
+    return filterWindow(frame, x0, y0, win_size, allScales());
+}
+
+template<class FloatT, class IdxT>
+const typename Boxxer2D<FloatT,IdxT>::ScaledImageT&
+Boxxer2D<FloatT,IdxT>::FrameFilter::filterWindow(const ImageT &frame, IdxT x0, IdxT y0, const IVecT &win_size,
+                                                 const std::vector<IdxT> &scales)
+{
+    if(win_size.n_elem!=2 || x0+win_size(0)>frame.n_rows || y0+win_size(1)>frame.n_cols ||
+       win_size(0)==0 || win_size(1)==0) {
+        std::ostringstream msg;
+        msg<<"Got window at ["<<x0<<","<<y0<<"] of size: "<<win_size.t()<<" for frame of size: ["
+           <<frame.n_rows<<","<<frame.n_cols<<"]";
+        throw ParameterValueError(msg.str());
+    }
+    window = frame(arma::span(x0, x0+win_size(0)-1), arma::span(y0, y0+win_size(1)-1));
+    if(_engine->defect_map) _engine->defect_map->patch(frame, window, x0, y0);
+    origin[0] = x0;
+    origin[1] = y0;
+    return filterScales(window, scales);
+}
+
+template<class FloatT, class IdxT>
+const typename Boxxer2D<FloatT,IdxT>::ScaledImageT&
+Boxxer2D<FloatT,IdxT>::FrameFilter::filterPatched(const ImageT &im, IdxT x0, IdxT y0)
+{
+    origin[0] = x0;
+    origin[1] = y0;
+    return filterScales(im, allScales());
+}
+
+template<class FloatT, class IdxT>
+const std::vector<IdxT>& Boxxer2D<FloatT,IdxT>::FrameFilter::allScales()
+{
+    if(all_scales.size()!=_engine->nScales) {
+        all_scales.resize(_engine->nScales);
+        for(IdxT s=0; s<_engine->nScales; s++) all_scales[s] = s;
+    }
+    return all_scales;
+}
+
+/**
+ * Filter im at the given scales into consecutive slices of the response, building the filters that are missing.
+ */
+template<class FloatT, class IdxT>
+const typename Boxxer2D<FloatT,IdxT>::ScaledImageT&
+Boxxer2D<FloatT,IdxT>::FrameFilter::filterScales(const ImageT &im, const std::vector<IdxT> &scales)
+{
+    const Boxxer2D &engine = *_engine;
+    if(im.n_rows!=size(0) || im.n_cols!=size(1) || filter_sigma.n_cols!=engine.sigma.n_cols ||
+       !arma::all(arma::vectorise(filter_sigma==engine.sigma)) || (use_DoG && filter_sigma_ratio!=engine.sigma_ratio)) {
+        size = {static_cast<IdxT>(im.n_rows), static_cast<IdxT>(im.n_cols)};
+        filter_sigma = engine.sigma;
+        filter_sigma_ratio = engine.sigma_ratio;
+        dog_filters.clear();
+        log_filters.clear();
+        dog_filters.resize(engine.nScales);
+        log_filters.resize(engine.nScales);
+        maxima2D.reset();
+    }
+    IdxT S = static_cast<IdxT>(scales.size());
+    sim.set_size(size(0), size(1), S);
+    for(IdxT k=0; k<S; k++) {
+        IdxT s = scales[k];
+        if(s>=engine.nScales) {
+            std::ostringstream msg;
+            msg<<"Got scale: "<<s<<" expected <"<<engine.nScales;
+            throw ParameterValueError(msg.str());
+        }
+        if(use_DoG) {
+            if(!dog_filters[s]) dog_filters[s].reset(new DoGFilter2D<FloatT,IdxT>(size, engine.sigma.col(s), engine.sigma_ratio));
+            dog_filters[s]->filter(im, sim.slice(k));
+        } else {
+            if(!log_filters[s]) log_filters[s].reset(new LoGFilter2D<FloatT,IdxT>(size, engine.sigma.col(s)));
+            log_filters[s]->filter(im, sim.slice(k));
+        }
+    }
+    _scales = scales;
+    return sim;
+}
+
+/**
+ * Maxima are found in each slice of the response and those not kept are dropped before the cross-scale refinement,
+ * which tests each maxima independently.  A window response only matches the whole frame response away from the
+ * window edges that are not frame edges, so for windows keep should reject pixels within the maxima neighborhoods
+ * and kernel half-width of those edges.
+ */
+template<class FloatT, class IdxT>
+IdxT Boxxer2D<FloatT,IdxT>::FrameFilter::maxima(IMatT &maxima, VecT &max_vals, IdxT neighborhood_size,
+                                                IdxT scale_neighborhood_size, const KeepT &keep)
+{
+    if(!maxima2D || maxima2D->boxsize!=neighborhood_size || maxima2D->size(0)!=size(0) || maxima2D->size(1)!=size(1))
+        maxima2D.reset(new Maxima2D<FloatT,IdxT>(size, neighborhood_size));
+    arma::field<IMatT> scale_maxima(_engine->nScales);
+    arma::field<VecT> scale_max_vals(_engine->nScales);
+    for(IdxT s=0; s<_engine->nScales; s++) scale_maxima(s).set_size(2,0);
+    for(IdxT k=0; k<_scales.size(); k++) {
+        IMatT &sm = scale_maxima(_scales[k]);
+        VecT &sv = scale_max_vals(_scales[k]);
+        maxima2D->find_maxima(sim.slice(k), sm, sv);
+        if(!keep) continue;
+        IdxT nKeep = 0;
+        for(IdxT n=0; n<sv.n_elem; n++) {
+            if(!keep(sm(0,n)+origin[0], sm(1,n)+origin[1])) continue;
+            sm.col(nKeep) = sm.col(n);
+            sv(nKeep) = sv(n);
+            nKeep++;
+        }
+        sm.resize(2,nKeep);
+        sv.resize(nKeep);
+    }
+    combine_maxima(scale_maxima, scale_max_vals, maxima, max_vals);
+    IdxT Nmaxima = _engine->scaleSpaceFrameMaximaRefine(sim, maxima, max_vals, scale_neighborhood_size);
+    for(IdxT n=0; n<Nmaxima; n++) {
+        maxima(0,n) += origin[0];
+        maxima(1,n) += origin[1];
+    }
+    return Nmaxima;
+}
+
+/**
+ * Each thread takes the pool entry of its thread number, replacing it if it was made for a different engine or
+ * method.  Frames are scheduled dynamically as sources such as decoders vary in cost.
+ */
+template<class FloatT, class IdxT>
+IdxT Boxxer2D<FloatT,IdxT>::scaleSpaceMaxima(IdxT nT, const FrameSourceT &frames, bool use_DoG, FrameFilterPool &pool,
+                                   IMatT &maxima, VecT &max_vals, IdxT neighborhood_size, IdxT scale_neighborhood_size) const
+{
+    if(nT==0) {
+        maxima.set_size(4,0);
+        max_vals.reset();
+        return 0;
+    }
+    if(pool.size()<static_cast<std::size_t>(omp_get_max_threads())) pool.resize(omp_get_max_threads());
     arma::field<IMatT> frame_maxima(nT); //These will come back 3xN
     arma::field<VecT> frame_max_vals(nT);
     omp_exception_catcher::OMPExceptionCatcher catcher;
     #pragma omp parallel
     {
-        std::vector<DoGFilter2D<FloatT,IdxT>> filters;
-        for(IdxT s=0; s<nScales; s++) filters.push_back(DoGFilter2D<FloatT,IdxT>(imsize,sigma.col(s),sigma_ratio));
-        auto sim = make_scaled_image();
-        #pragma omp for
+        auto &ff = pool[omp_get_thread_num()];
+        catcher.run([&]{
+            if(!ff || &ff->engine()!=this || ff->useDoG()!=use_DoG) ff.reset(new FrameFilter(*this, use_DoG));
+        });
+        ImageT frame_buf;
+        #pragma omp for schedule(dynamic)
         for(IdxT n=0; n<nT; n++) {
             catcher.run([&]{
-                for(IdxT s=0; s<nScales; s++) filters[s].filter(im.slice(n),sim.slice(s));
-                    scaleSpaceFrameMaxima(sim, frame_maxima(n), frame_max_vals(n), neighborhood_size, scale_neighborhood_size);
+                if(!ff) return; //Construction failed and was caught
+                ff->filter(frames(n, frame_buf));
+                ff->maxima(frame_maxima(n), frame_max_vals(n), neighborhood_size, scale_neighborhood_size);
             });
         }
     }
@@ -143,7 +1502,6 @@ IdxT Boxxer2D<FloatT,IdxT>::scaleSpaceDoGMaxima(const ImageStackT &im, IMatT &ma
     return combine_maxima(frame_maxima, frame_max_vals, maxima, max_vals);
 }
 
-
 /**
  * Get the scale maxima for a single frame
  */
@@ -175,17 +1533,20 @@ Boxxer2D<FloatT,IdxT>::scaleSpaceFrameMaximaRefine(const ScaledImageT &im, IMatT
     IdxT nMaxima = static_cast<IdxT>(maxima.n_cols);
     IdxT nNewMaxima=0;
     IdxT delta = static_cast<IdxT>((scale_neighborhood_size-1)/2);
+    IdxT sizeX = static_cast<IdxT>(im.n_rows); //The scaled image may be a window of the frame
+    IdxT sizeY = static_cast<IdxT>(im.n_cols);
+    IdxT S = static_cast<IdxT>(im.n_slices); //or a subset of the scales
     for(IdxT n=0; n<nMaxima; n++) {
         IVecT mx = maxima.col(n);
         FloatT mxv = max_vals(n);
-        if ( (mx(0) < delta || mx(0)+delta>=imsize(0)) ||
-             (mx(1) < delta || mx(1)+delta>=imsize(1))) {
-            for(IdxT s=0; s<nScales; s++)
-                for(IdxT j = (mx(1)<=delta ? 0 : mx(1)-delta); j<imsize(1) && j<=mx(1)+delta; j++)
-                    for(IdxT i = (mx(0)<=delta ? 0 : mx(0)-delta); i<imsize(0) && i<=mx(0)+delta; i++)
+        if ( (mx(0) < delta || mx(0)+delta>=sizeX) ||
+             (mx(1) < delta || mx(1)+delta>=sizeY)) {
+            for(IdxT s=0; s<S; s++)
+                for(IdxT j = (mx(1)<=delta ? 0 : mx(1)-delta); j<sizeY && j<=mx(1)+delta; j++)
+                    for(IdxT i = (mx(0)<=delta ? 0 : mx(0)-delta); i<sizeX && i<=mx(0)+delta; i++)
                         if( im(i,j,s) > mxv)  goto scale_maxima_reject;
         } else {
-            for(IdxT s=0; s<nScales; s++)
+            for(IdxT s=0; s<S; s++)
                 for(IdxT j=mx(1)-delta; j<=mx(1)+delta; j++)
                     for(IdxT i=mx(0)-delta; i<=mx(0)+delta; i++)
                         if( im(i,j,s) > mxv) goto scale_maxima_reject;
@@ -206,6 +1567,63 @@ scale_maxima_reject: ;//Go here when scale maxima is not valid
 }
 
 
+/**
+ * The cross-scale refinement of scaleSpaceFrameMaximaRefine for maxima of one frame of an interleaved stack.  All
+ * scales of a pixel are contiguous, so each row of a neighborhood is a single run of memory, which is scanned
+ * without early exit so the comparison vectorizes across scales.
+ */
+template<class FloatT, class IdxT>
+IdxT
+Boxxer2D<FloatT,IdxT>::scaleSpaceFrameMaximaRefineInterleaved(const InterleavedImageT &isim, IMatT &maxima,
+                                                              VecT &max_vals, IdxT scale_neighborhood_size) const
+{
+    using std::min;
+    IdxT S = static_cast<IdxT>(isim.n_rows);
+    IdxT sizeX = static_cast<IdxT>(isim.n_cols);
+    IdxT sizeY = static_cast<IdxT>(isim.n_slices);
+    if(maxima.n_rows!=dim || maxima.n_cols!=max_vals.n_elem) {
+        std::ostringstream msg;
+        msg<<"Got maxima of size: ["<<maxima.n_rows<<","<<maxima.n_cols<<"] with "<<max_vals.n_elem
+           <<" values.  Expected ["<<dim<<" x nMaxima]";
+        throw ParameterShapeError(msg.str());
+    }
+    IMatT new_maxima(maxima.n_rows, maxima.n_cols);
+    VecT new_max_vals(max_vals.n_elem);
+    IdxT nMaxima = static_cast<IdxT>(maxima.n_cols);
+    IdxT nNewMaxima=0;
+    IdxT delta = static_cast<IdxT>((scale_neighborhood_size-1)/2);
+    for(IdxT n=0; n<nMaxima; n++) {
+        IdxT x = maxima(0,n);
+        IdxT y = maxima(1,n);
+        FloatT mxv = max_vals(n);
+        if(x>=sizeX || y>=sizeY) {
+            std::ostringstream msg;
+            msg<<"Maxima "<<n<<" at ["<<x<<","<<y<<"] is outside the interleaved frame of size ["<<sizeX<<","<<sizeY<<"]";
+            throw ParameterValueError(msg.str());
+        }
+        IdxT i0 = x<=delta ? 0 : x-delta;
+        IdxT run = (min(x+delta, sizeX-1)-i0+1)*S;
+        bool reject = false;
+        for(IdxT j = (y<=delta ? 0 : y-delta); j<sizeY && j<=y+delta && !reject; j++) {
+            const FloatT *p = isim.slice_memptr(j) + static_cast<std::size_t>(i0)*S;
+            for(IdxT k=0; k<run; k++) reject |= p[k] > mxv;
+        }
+        if(reject) continue;
+        new_maxima(0,nNewMaxima) = x;
+        new_maxima(1,nNewMaxima) = y;
+        new_max_vals(nNewMaxima) = mxv;
+        nNewMaxima++;
+    }
+    if(nNewMaxima==0) {
+        maxima.set_size(maxima.n_rows,0);
+        max_vals.reset();
+    } else {
+        maxima = new_maxima(arma::span::all, arma::span(0,nNewMaxima-1));
+        max_vals = new_max_vals(arma::span(0,nNewMaxima-1));
+    }
+    return nNewMaxima;
+}
+
 /* Static Methods */
 
 template<class FloatT, class IdxT>
@@ -262,6 +1680,27 @@ void Boxxer2D<FloatT,IdxT>::filterGauss(const ImageStackT &im, ImageStackT &fim,
     catcher.rethrow(); //Rethrow any caught exceptions
 }
 
+/**
+ * The single a trous wavelet plane W_level of each frame.
+ */
+template<class FloatT, class IdxT>
+void Boxxer2D<FloatT,IdxT>::filterWavelet(const ImageStackT &im, ImageStackT &fim, IdxT level)
+{
+    IdxT nT=static_cast<IdxT>(im.n_slices);
+    IVecT imsize={static_cast<IdxT>(im.n_rows),static_cast<IdxT>(im.n_cols)};
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel
+    {
+        AtrousFilter2D<FloatT,IdxT> filter(imsize,level);
+        #pragma omp for
+        for(IdxT n=0; n<nT; n++)
+            catcher.run([&]{
+                filter.filter(im.slice(n),fim.slice(n));
+            });
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+}
+
 /**
  * This finds local maxima over an image stack in parallel.
  */
@@ -286,6 +1725,139 @@ IdxT Boxxer2D<FloatT,IdxT>::enumerateImageMaxima(const ImageStackT &im, IMatT &m
     return combine_maxima(frame_maxima, frame_max_vals, maxima, max_vals);
 }
 
+template<class FloatT, class IdxT>
+IdxT Boxxer2D<FloatT,IdxT>::detectLoG(const ImageStackT &im, const VecT &sigma, IMatT &maxima, VecT &max_vals,
+                                      IdxT neighborhood_size, FloatT threshold)
+{
+    return detectFrames<LoGFilter2D<FloatT,IdxT>>(im, maxima, max_vals, neighborhood_size, threshold, sigma);
+}
+
+template<class FloatT, class IdxT>
+IdxT Boxxer2D<FloatT,IdxT>::detectDoG(const ImageStackT &im, const VecT &sigma, FloatT sigma_ratio, IMatT &maxima,
+                                      VecT &max_vals, IdxT neighborhood_size, FloatT threshold)
+{
+    return detectFrames<DoGFilter2D<FloatT,IdxT>>(im, maxima, max_vals, neighborhood_size, threshold, sigma, sigma_ratio);
+}
+
+template<class FloatT, class IdxT>
+IdxT Boxxer2D<FloatT,IdxT>::detectGauss(const ImageStackT &im, const VecT &sigma, IMatT &maxima, VecT &max_vals,
+                                        IdxT neighborhood_size, FloatT threshold)
+{
+    return detectFrames<GaussFilter2D<FloatT,IdxT>>(im, maxima, max_vals, neighborhood_size, threshold, sigma);
+}
+
+/**
+ * Filter each frame with a FilterT(imsize, filter_args...) into a per-thread buffer and find its maxima while the
+ * frame is still in cache.  The thresholding is skipped for the default -infinity threshold, so the result is
+ * exactly that of enumerateImageMaxima on the filtered stack.
+ */
+template<class FloatT, class IdxT>
+template<class FilterT, class... FilterArgs>
+IdxT Boxxer2D<FloatT,IdxT>::detectFrames(const ImageStackT &im, IMatT &maxima, VecT &max_vals,
+                                         IdxT neighborhood_size, FloatT threshold, const FilterArgs&... filter_args)
+{
+    IdxT nT=static_cast<IdxT>(im.n_slices);
+    arma::field<IMatT> frame_maxima(nT);
+    arma::field<VecT> frame_max_vals(nT);
+    IVecT imsize={static_cast<IdxT>(im.n_rows),static_cast<IdxT>(im.n_cols)};
+    bool use_threshold = threshold > -std::numeric_limits<FloatT>::infinity();
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel
+    {
+        FilterT filter(imsize, filter_args...);
+        Maxima2D<FloatT,IdxT> maxima2D(imsize, neighborhood_size);
+        ImageT fframe(imsize(0), imsize(1));
+        IMatT fm;
+        VecT fv;
+        #pragma omp for
+        for(IdxT n=0; n<nT; n++)
+            catcher.run([&]{
+                filter.filter(im.slice(n), fframe);
+                if(!use_threshold) {
+                    maxima2D.find_maxima(fframe, frame_maxima(n), frame_max_vals(n));
+                    return;
+                }
+                maxima2D.find_maxima(fframe, fm, fv);
+                thresholdMaxima(fm, fv, threshold, frame_maxima(n), frame_max_vals(n));
+            });
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+    if(nT==0) {
+        maxima.set_size(3,0);
+        max_vals.reset();
+        return 0;
+    }
+    return combine_maxima(frame_maxima, frame_max_vals, maxima, max_vals);
+}
+
+/**
+ * Select the maxima with value strictly greater than threshold, preserving order.
+ */
+template<class FloatT, class IdxT>
+void Boxxer2D<FloatT,IdxT>::thresholdMaxima(const IMatT &maxima, const VecT &max_vals, FloatT threshold,
+                                            IMatT &thresh_maxima, VecT &thresh_max_vals)
+{
+    IdxT Nmaxima = static_cast<IdxT>(max_vals.n_elem);
+    IdxT Nkeep = 0;
+    for(IdxT n=0; n<Nmaxima; n++) if(max_vals(n)>threshold) Nkeep++;
+    thresh_maxima.set_size(maxima.n_rows, Nkeep);
+    thresh_max_vals.set_size(Nkeep);
+    for(IdxT n=0, i=0; n<Nmaxima; n++) if(max_vals(n)>threshold) {
+        thresh_maxima.col(i) = maxima.col(n);
+        thresh_max_vals(i) = max_vals(n);
+        i++;
+    }
+}
+
+template<class FloatT, class IdxT>
+IdxT Boxxer2D<FloatT,IdxT>::scaleSpaceLoGComponents(const ImageStackT &im, FloatT threshold, IMatT &components,
+                                                    VecT &integrated, VecT &peak_vals) const
+{
+    return scaleSpaceComponents(im, false, threshold, components, integrated, peak_vals);
+}
+
+template<class FloatT, class IdxT>
+IdxT Boxxer2D<FloatT,IdxT>::scaleSpaceDoGComponents(const ImageStackT &im, FloatT threshold, IMatT &components,
+                                                    VecT &integrated, VecT &peak_vals) const
+{
+    return scaleSpaceComponents(im, true, threshold, components, integrated, peak_vals);
+}
+
+/**
+ * Components are labeled in the frame loop right after filtering, so the scaled frames are never stored.  Frames are
+ * processed in parallel.  A single frame is filtered by one thread and its labeling tiles run in parallel instead.
+ */
+template<class FloatT, class IdxT>
+IdxT Boxxer2D<FloatT,IdxT>::scaleSpaceComponents(const ImageStackT &im, bool use_DoG, FloatT threshold,
+                                                 IMatT &components, VecT &integrated, VecT &peak_vals) const
+{
+    IdxT nT=static_cast<IdxT>(im.n_slices);
+    if(nT==0) {
+        components.set_size(ComponentLabeler2D<FloatT,IdxT>::NRows+1,0);
+        integrated.reset();
+        peak_vals.reset();
+        return 0;
+    }
+    arma::field<IMatT> frame_components(nT); //These will come back NRows x N
+    arma::field<VecT> frame_integrated(nT);
+    arma::field<VecT> frame_peak_vals(nT);
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel if(nT>1)
+    {
+        FrameFilter ff(*this, use_DoG);
+        ComponentLabeler2D<FloatT,IdxT> labeler(imsize);
+        #pragma omp for
+        for(IdxT n=0; n<nT; n++) {
+            catcher.run([&]{
+                labeler.label(ff.filter(im.slice(n)), threshold, frame_components(n), frame_integrated(n), frame_peak_vals(n));
+            });
+        }
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+    concat_frame_values(frame_peak_vals, peak_vals);
+    return combine_maxima(frame_components, frame_integrated, components, integrated);
+}
+
 template<class FloatT, class IdxT>
 IdxT Boxxer2D<FloatT,IdxT>::combine_maxima(const arma::field<IMatT> &frame_maxima,
                                      const arma::field<VecT> &frame_max_vals,
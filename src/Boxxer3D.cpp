@@ -5,24 +5,78 @@
  * @brief The class method definitions for Boxxer3D.
  */
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <memory>
 #include <omp.h>
 #include "OMPExceptionCatcher/OMPExceptionCatcher.h"
 #include "Boxxer/BoxxerError.h"
 #include "Boxxer/GaussFilter.h"
+#include "Boxxer/WaveletFilter.h"
 #include "Boxxer/Maxima.h"
+#include "Boxxer/Components.h"
+#include "Boxxer/Boxxer2D.h"
 #include "Boxxer/Boxxer3D.h"
 
 namespace boxxer {
 
+namespace {
+/**
+ * Ratio of the smallest to the largest eigenvalue of the symmetric matrix [a d e; d b f; e f c], using the closed
+ * form for symmetric 3x3 eigenvalues.  The LoG terms are the negated Hessian, so all eigenvalues are positive at
+ * bright blobs.  Clamped to [-1,1], and -1 when none is positive.
+ */
+template<class FloatT>
+FloatT hessianRatio3D(double a, double b, double c, double d, double e, double f)
+{
+    double off = d*d + e*e + f*f;
+    double q = (a+b+c)/3;
+    double l_max, l_min;
+    double p2 = (a-q)*(a-q) + (b-q)*(b-q) + (c-q)*(c-q) + 2*off;
+    if(p2 <= 0) {
+        l_max = l_min = q;
+    } else {
+        double p = std::sqrt(p2/6);
+        double ba = (a-q)/p, bb = (b-q)/p, bc = (c-q)/p, bd = d/p, be = e/p, bf = f/p;
+        double r = (ba*(bb*bc-bf*bf) - bd*(bd*bc-bf*be) + be*(bd*bf-bb*be))/2;
+        r = std::min(1., std::max(-1., r));
+        double phi = std::acos(r)/3;
+        l_max = q + 2*p*std::cos(phi);
+        l_min = q + 2*p*std::cos(phi + 2*arma::Datum<double>::pi/3);
+    }
+    if(!(l_max>0)) return -1;
+    return static_cast<FloatT>(std::max(l_min/l_max, -1.));
+}
+
+template<class VecT>
+void concat_frame_values(const arma::field<VecT> &frame_vals, VecT &vals)
+{
+    arma::uword N = 0;
+    for(arma::uword n=0; n<frame_vals.n_elem; n++) N += frame_vals(n).n_elem;
+    vals.set_size(N);
+    arma::uword k = 0;
+    for(arma::uword n=0; n<frame_vals.n_elem; n++)
+        for(arma::uword i=0; i<frame_vals(n).n_elem; i++) vals(k++) = frame_vals(n)(i);
+}
+} /* namespace */
+
 /* Static member variables */
 template<class FloatT, class IdxT>
 const IdxT Boxxer3D<FloatT,IdxT>::dim = 3;
 template<class FloatT, class IdxT>
 const FloatT Boxxer3D<FloatT,IdxT>::DefaultSigmaRatio = 1.1;
+template<class FloatT, class IdxT>
+const IdxT Boxxer3D<FloatT,IdxT>::DefaultWaveletFirstLevel = 2; //Level 1 is dominated by pixel noise
+template<class FloatT, class IdxT>
+const IdxT Boxxer3D<FloatT,IdxT>::MaskTileSize = 32;
 
 template<class FloatT, class IdxT>
 Boxxer3D<FloatT,IdxT>::Boxxer3D(const IVecT &imsize, const MatT &_sigma)
-    : nScales(_sigma.n_cols),imsize(imsize), sigma(_sigma), sigma_ratio(DefaultSigmaRatio)
+    : nScales(_sigma.n_cols),imsize(imsize), sigma(_sigma), sigma_ratio(DefaultSigmaRatio),
+      wavelet_first_level(DefaultWaveletFirstLevel)
 {
     if(nScales<1) throw ParameterValueError("Non-positive number of scales.");
     if(imsize.n_elem!=dim){
@@ -40,7 +94,7 @@ Boxxer3D<FloatT,IdxT>::Boxxer3D(const IVecT &imsize, const MatT &_sigma)
 template<class FloatT, class IdxT>
 void Boxxer3D<FloatT,IdxT>::setDoGSigmaRatio(FloatT _sigma_ratio)
 {
-    if(_sigma_ratio<=1) {
+    if(!(_sigma_ratio>1) || !std::isfinite(_sigma_ratio)) { //Rejects NaN
         std::ostringstream msg;
         msg<<"Got bad sigma ratio: "<<_sigma_ratio;
         throw ParameterShapeError(msg.str());
@@ -49,8 +103,84 @@ void Boxxer3D<FloatT,IdxT>::setDoGSigmaRatio(FloatT _sigma_ratio)
 }
 
 template<class FloatT, class IdxT>
-void Boxxer3D<FloatT,IdxT>::filterScaledLoG(const ImageT &im, ScaledImageT &fim)
+void Boxxer3D<FloatT,IdxT>::setWaveletFirstLevel(IdxT level)
+{
+    if(level<1 || level+nScales-1>AtrousFilter3D<FloatT,IdxT>::MaxLevel) {
+        std::ostringstream msg;
+        msg<<"Got bad wavelet first level: "<<level<<" for nScales: "<<nScales;
+        throw ParameterValueError(msg.str());
+    }
+    wavelet_first_level=level;
+}
+
+template<class FloatT, class IdxT>
+void Boxxer3D<FloatT,IdxT>::setDefectMap(const DefectMaskT &defects)
+{
+    if(defects.n_rows!=imsize(0) || defects.n_cols!=imsize(1) || defects.n_slices!=imsize(2)) {
+        std::ostringstream msg;
+        msg<<"Got defect map of size: ["<<defects.n_rows<<","<<defects.n_cols<<","<<defects.n_slices
+           <<"] expected imsize: "<<imsize.t();
+        throw ParameterValueError(msg.str());
+    }
+    auto map = std::make_shared<const DefectMapT>(defects);
+    if(map->nDefects()>0) defect_map = map;
+    else defect_map.reset();
+}
+
+template<class FloatT, class IdxT>
+typename Boxxer3D<FloatT,IdxT>::DefectMaskT
+Boxxer3D<FloatT,IdxT>::getDefectMap() const
+{
+    if(defect_map) return defect_map->mask;
+    DefectMaskT none(imsize(0),imsize(1),imsize(2));
+    none.zeros();
+    return none;
+}
+
+template<class FloatT, class IdxT>
+IdxT Boxxer3D<FloatT,IdxT>::detectDefectMap(const ImageStackT &im, IdxT nWarmupFrames, FloatT threshold, FloatT min_fraction)
+{
+    if(im.sX!=imsize(0) || im.sY!=imsize(1) || im.sZ!=imsize(2)) {
+        std::ostringstream msg;
+        msg<<"Got image stack of frame size: ["<<im.sX<<","<<im.sY<<","<<im.sZ<<"] expected imsize: "<<imsize.t();
+        throw ParameterValueError(msg.str());
+    }
+    setDefectMap(DefectMapT::detect(im, nWarmupFrames, threshold, min_fraction));
+    return defect_map ? defect_map->nDefects() : 0;
+}
+
+template<class FloatT, class IdxT>
+const typename Boxxer3D<FloatT,IdxT>::ImageT&
+Boxxer3D<FloatT,IdxT>::defectFreeFrame(const ImageT &frame, ImageT &buffer) const
+{
+    if(!defect_map) return frame;
+    buffer = frame;
+    defect_map->patch(frame, buffer);
+    return buffer;
+}
+
+/**
+ * Bin b of the movie as the filters should read it.  Frames are patched for defects before they are summed.  A
+ * bin of one frame is the defect free frame itself.
+ */
+template<class FloatT, class IdxT>
+const typename Boxxer3D<FloatT,IdxT>::ImageT&
+Boxxer3D<FloatT,IdxT>::binnedFrame(const ImageStackT &im, const TemporalBinningT &binning, IdxT b,
+                                ImageT &bin_buffer, ImageT &frame_buffer) const
+{
+    IdxT first = binning.firstFrame(b);
+    if(binning.bin_size==1) return defectFreeFrame(im.slice(first), frame_buffer);
+    bin_buffer = defectFreeFrame(im.slice(first), frame_buffer);
+    for(IdxT k=1; k<binning.bin_size; k++) bin_buffer += defectFreeFrame(im.slice(first+k), frame_buffer);
+    if(binning.mean) bin_buffer /= static_cast<FloatT>(binning.bin_size);
+    return bin_buffer;
+}
+
+template<class FloatT, class IdxT>
+void Boxxer3D<FloatT,IdxT>::filterScaledLoG(const ImageT &raw_im, ScaledImageT &fim)
 {
+    ImageT frame_buf;
+    const ImageT &im = defectFreeFrame(raw_im, frame_buf);
     omp_exception_catcher::OMPExceptionCatcher catcher;
     #pragma omp parallel for
     for(IdxT s=0; s<nScales; s++) {
@@ -63,8 +193,10 @@ void Boxxer3D<FloatT,IdxT>::filterScaledLoG(const ImageT &im, ScaledImageT &fim)
 }
 
 template<class FloatT, class IdxT>
-void Boxxer3D<FloatT,IdxT>::filterScaledDoG(const ImageT &im, ScaledImageT &fim)
+void Boxxer3D<FloatT,IdxT>::filterScaledDoG(const ImageT &raw_im, ScaledImageT &fim)
 {
+    ImageT frame_buf;
+    const ImageT &im = defectFreeFrame(raw_im, frame_buf);
     omp_exception_catcher::OMPExceptionCatcher catcher;
     #pragma omp parallel for
     for(IdxT s=0; s<nScales; s++)
@@ -75,6 +207,76 @@ void Boxxer3D<FloatT,IdxT>::filterScaledDoG(const ImageT &im, ScaledImageT &fim)
     catcher.rethrow(); //Rethrow any caught exceptions
 }
 
+/**
+ * Each scale filter writes its final combine pass straight into the interleaved image with stride nScales, so there
+ * is no planar scaled image and no transpose.  As with filterScaledLoG the scales are split between threads, which
+ * share the output cache lines only for that last pass.
+ */
+template<class FloatT, class IdxT>
+void Boxxer3D<FloatT,IdxT>::filterScaledLoGInterleaved(const ImageT &raw_im, InterleavedImageT &fim)
+{
+    checkInterleavedSize(fim);
+    ImageT frame_buf;
+    const ImageT &im = defectFreeFrame(raw_im, frame_buf);
+    std::vector<FloatT*> slice_out(imsize(2));
+    for(IdxT k=0; k<imsize(2); k++) slice_out[k] = fim.slice(k).memptr();
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel for
+    for(IdxT s=0; s<nScales; s++) {
+        catcher.run([&]{
+            std::vector<FloatT*> scale_out(imsize(2));
+            for(IdxT k=0; k<imsize(2); k++) scale_out[k] = slice_out[k]+s;
+            LoGFilter3D<FloatT,IdxT> scale_filter(imsize,sigma.col(s));
+            scale_filter.filter(im, scale_out.data(), nScales);
+        });
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+}
+
+template<class FloatT, class IdxT>
+void Boxxer3D<FloatT,IdxT>::filterScaledDoGInterleaved(const ImageT &raw_im, InterleavedImageT &fim)
+{
+    checkInterleavedSize(fim);
+    ImageT frame_buf;
+    const ImageT &im = defectFreeFrame(raw_im, frame_buf);
+    std::vector<FloatT*> slice_out(imsize(2));
+    for(IdxT k=0; k<imsize(2); k++) slice_out[k] = fim.slice(k).memptr();
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel for
+    for(IdxT s=0; s<nScales; s++) {
+        catcher.run([&]{
+            std::vector<FloatT*> scale_out(imsize(2));
+            for(IdxT k=0; k<imsize(2); k++) scale_out[k] = slice_out[k]+s;
+            DoGFilter3D<FloatT,IdxT> scale_filter(imsize,sigma.col(s),sigma_ratio);
+            scale_filter.filter(im, scale_out.data(), nScales);
+        });
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+}
+
+template<class FloatT, class IdxT>
+void Boxxer3D<FloatT,IdxT>::checkInterleavedSize(const InterleavedImageT &fim) const
+{
+    if(fim.sX!=nScales || fim.sY!=imsize(0) || fim.sZ!=imsize(1) || fim.sN!=imsize(2)) {
+        std::ostringstream msg;
+        msg<<"Got interleaved image of size: ["<<fim.sX<<","<<fim.sY<<","<<fim.sZ<<","<<fim.sN<<"] expected: ["
+           <<nScales<<","<<imsize(0)<<","<<imsize(1)<<","<<imsize(2)<<"]";
+        throw ParameterShapeError(msg.str());
+    }
+}
+
+/**
+ * The a trous wavelet planes for levels wavelet_first_level ... wavelet_first_level+nScales-1 as scales.
+ * The levels are computed incrementally by a single filter.
+ */
+template<class FloatT, class IdxT>
+void Boxxer3D<FloatT,IdxT>::filterScaledWavelet(const ImageT &im, ScaledImageT &fim)
+{
+    AtrousFilter3D<FloatT,IdxT> filter(imsize, wavelet_first_level, nScales);
+    ImageT frame_buf;
+    filter.filter(defectFreeFrame(im, frame_buf),fim);
+}
+
 /**
  * 
  * Get the maxima over all scales and all frames.  Scale and maxfind on each frame individually to
@@ -93,10 +295,12 @@ IdxT Boxxer3D<FloatT,IdxT>::scaleSpaceLoGMaxima(const ImageStackT &im, IMatT &ma
         auto sim = make_scaled_image();
         std::vector<LoGFilter3D<FloatT,IdxT>> scale_filters;
         for(IdxT s=0; s<nScales; s++) scale_filters.push_back(LoGFilter3D<FloatT,IdxT>(imsize,sigma.col(s)));
+        ImageT frame_buf;
         #pragma omp for
         for(IdxT n=0; n<nT; n++)
             catcher.run([&]{
-                for(IdxT s=0; s<nScales; s++) scale_filters[s].filter(im.slice(n),sim.slice(s));
+                const ImageT &frame = defectFreeFrame(im.slice(n), frame_buf);
+                for(IdxT s=0; s<nScales; s++) scale_filters[s].filter(frame,sim.slice(s));
                     scaleSpaceFrameMaxima(sim, frame_maxima(n), frame_max_vals(n), neighborhood_size, scale_neighborhood_size);
             });
     }
@@ -104,6 +308,56 @@ IdxT Boxxer3D<FloatT,IdxT>::scaleSpaceLoGMaxima(const ImageStackT &im, IMatT &ma
     return combine_maxima(frame_maxima, frame_max_vals, maxima, max_vals);
 }
 
+/**
+ * scaleSpaceLoGMaxima with the Hessian eigenvalue ratio at each maxima.  The x and y second derivative terms of the
+ * LoG are kept for each scale and the z term is the LoG minus them.  The three cross terms, and optionally the
+ * gradient, are evaluated directly at the maxima only.
+ */
+template<class FloatT, class IdxT>
+IdxT Boxxer3D<FloatT,IdxT>::scaleSpaceLoGMaximaShape(const ImageStackT &im, IMatT &maxima, VecT &max_vals,
+                                                     VecT &hessian_ratio, IdxT neighborhood_size,
+                                                     IdxT scale_neighborhood_size, VecT *gradient)
+{
+    IdxT nT=static_cast<IdxT>(im.n_slices);
+    arma::field<IMatT> frame_maxima(nT); //These will come back 4xN
+    arma::field<VecT> frame_max_vals(nT);
+    arma::field<VecT> frame_ratio(nT);
+    arma::field<VecT> frame_gradient(gradient ? nT : 0);
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel
+    {
+        auto sim = make_scaled_image();
+        auto dxx = make_scaled_image();
+        auto dyy = make_scaled_image();
+        std::vector<LoGFilter3D<FloatT,IdxT>> scale_filters;
+        for(IdxT s=0; s<nScales; s++) scale_filters.push_back(LoGFilter3D<FloatT,IdxT>(imsize,sigma.col(s)));
+        ImageT frame_buf;
+        #pragma omp for
+        for(IdxT n=0; n<nT; n++)
+            catcher.run([&]{
+                const ImageT &frame = defectFreeFrame(im.slice(n), frame_buf);
+                for(IdxT s=0; s<nScales; s++) scale_filters[s].filter(frame,sim.slice(s),dxx.slice(s),dyy.slice(s));
+                IdxT nMaxima = scaleSpaceFrameMaxima(sim, frame_maxima(n), frame_max_vals(n), neighborhood_size, scale_neighborhood_size);
+                const IMatT &fmaxima = frame_maxima(n);
+                frame_ratio(n).set_size(nMaxima);
+                if(gradient) frame_gradient(n).set_size(nMaxima);
+                for(IdxT k=0; k<nMaxima; k++) {
+                    IdxT x = fmaxima(0,k), y = fmaxima(1,k), z = fmaxima(2,k), s = fmaxima(3,k);
+                    FloatT a = dxx.slice(s)(x,y,z);
+                    FloatT b = dyy.slice(s)(x,y,z);
+                    FloatT c = sim.slice(s)(x,y,z)-a-b;
+                    auto cross = scale_filters[s].hessian_cross(frame, x, y, z);
+                    frame_ratio(n)(k) = hessianRatio3D<FloatT>(a, b, c, cross(0), cross(1), cross(2));
+                    if(gradient) frame_gradient(n)(k) = scale_filters[s].gradient_norm(frame, x, y, z);
+                }
+            });
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+    concat_frame_values(frame_ratio, hessian_ratio);
+    if(gradient) concat_frame_values(frame_gradient, *gradient);
+    return combine_maxima(frame_maxima, frame_max_vals, maxima, max_vals);
+}
+
 template<class FloatT, class IdxT>
 IdxT Boxxer3D<FloatT,IdxT>::scaleSpaceDoGMaxima(const ImageStackT &im, IMatT &maxima, VecT &max_vals,
                                                 IdxT neighborhood_size, IdxT scale_neighborhood_size)
@@ -117,10 +371,12 @@ IdxT Boxxer3D<FloatT,IdxT>::scaleSpaceDoGMaxima(const ImageStackT &im, IMatT &ma
         auto sim = make_scaled_image();
         std::vector<DoGFilter3D<FloatT,IdxT>> scale_filters;
         for(IdxT s=0; s<nScales; s++) scale_filters.push_back(DoGFilter3D<FloatT,IdxT>(imsize,sigma.col(s),sigma_ratio));
+        ImageT frame_buf;
         #pragma omp for
         for(IdxT n=0; n<nT; n++)
             catcher.run([&]{
-                for(IdxT s=0; s<nScales; s++) scale_filters[s].filter(im.slice(n),sim.slice(s));
+                const ImageT &frame = defectFreeFrame(im.slice(n), frame_buf);
+                for(IdxT s=0; s<nScales; s++) scale_filters[s].filter(frame,sim.slice(s));
                     scaleSpaceFrameMaxima(sim, frame_maxima(n), frame_max_vals(n), neighborhood_size, scale_neighborhood_size);
             });
     }
@@ -128,6 +384,643 @@ IdxT Boxxer3D<FloatT,IdxT>::scaleSpaceDoGMaxima(const ImageStackT &im, IMatT &ma
     return combine_maxima(frame_maxima, frame_max_vals, maxima, max_vals);
 }
 
+template<class FloatT, class IdxT>
+IdxT Boxxer3D<FloatT,IdxT>::scaleSpaceWaveletMaxima(const ImageStackT &im, IMatT &maxima, VecT &max_vals,
+                                                    IdxT neighborhood_size, IdxT scale_neighborhood_size)
+{
+    IdxT nT=static_cast<IdxT>(im.n_slices);
+    arma::field<IMatT> frame_maxima(nT); //These will come back 4xN
+    arma::field<VecT> frame_max_vals(nT);
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel
+    {
+        auto sim = make_scaled_image();
+        AtrousFilter3D<FloatT,IdxT> filter(imsize, wavelet_first_level, nScales);
+        ImageT frame_buf;
+        #pragma omp for
+        for(IdxT n=0; n<nT; n++)
+            catcher.run([&]{
+                filter.filter(defectFreeFrame(im.slice(n), frame_buf),sim);
+                scaleSpaceFrameMaxima(sim, frame_maxima(n), frame_max_vals(n), neighborhood_size, scale_neighborhood_size);
+            });
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+    return combine_maxima(frame_maxima, frame_max_vals, maxima, max_vals);
+}
+
+template<class FloatT, class IdxT>
+IdxT Boxxer3D<FloatT,IdxT>::scaleSpaceLoGComponents(const ImageStackT &im, FloatT threshold, IMatT &components,
+                                                    VecT &integrated, VecT &peak_vals)
+{
+    return scaleSpaceComponents(im, false, threshold, components, integrated, peak_vals);
+}
+
+template<class FloatT, class IdxT>
+IdxT Boxxer3D<FloatT,IdxT>::scaleSpaceDoGComponents(const ImageStackT &im, FloatT threshold, IMatT &components,
+                                                    VecT &integrated, VecT &peak_vals)
+{
+    return scaleSpaceComponents(im, true, threshold, components, integrated, peak_vals);
+}
+
+/**
+ * Components are labeled as each frame is filtered.  A single volume is labeled with parallel tiles along z.
+ */
+template<class FloatT, class IdxT>
+IdxT Boxxer3D<FloatT,IdxT>::scaleSpaceComponents(const ImageStackT &im, bool use_DoG, FloatT threshold,
+                                                 IMatT &components, VecT &integrated, VecT &peak_vals)
+{
+    IdxT nT=static_cast<IdxT>(im.n_slices);
+    if(nT==0) {
+        components.set_size(ComponentLabeler3D<FloatT,IdxT>::NRows+1,0);
+        integrated.reset();
+        peak_vals.reset();
+        return 0;
+    }
+    arma::field<IMatT> frame_components(nT);
+    arma::field<VecT> frame_integrated(nT);
+    arma::field<VecT> frame_peak_vals(nT);
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel if(nT>1)
+    {
+        FrameFilter ff(*this, use_DoG);
+        ComponentLabeler3D<FloatT,IdxT> labeler(imsize);
+        #pragma omp for
+        for(IdxT n=0; n<nT; n++)
+            catcher.run([&]{
+                labeler.label(ff.filter(im.slice(n)), threshold, frame_components(n), frame_integrated(n), frame_peak_vals(n));
+            });
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+    concat_frame_values(frame_peak_vals, peak_vals);
+    return combine_maxima(frame_components, frame_integrated, components, integrated);
+}
+
+template<class FloatT, class IdxT>
+IdxT Boxxer3D<FloatT,IdxT>::scaleSpaceLoGMaximaBinned(const ImageStackT &im, const TemporalBinningT &binning,
+                                      IMatT &maxima, VecT &max_vals, IdxT neighborhood_size,
+                                      IdxT scale_neighborhood_size)
+{
+    return scaleSpaceMaximaBinned(im, false, binning, maxima, max_vals, neighborhood_size, scale_neighborhood_size);
+}
+
+template<class FloatT, class IdxT>
+IdxT Boxxer3D<FloatT,IdxT>::scaleSpaceDoGMaximaBinned(const ImageStackT &im, const TemporalBinningT &binning,
+                                      IMatT &maxima, VecT &max_vals, IdxT neighborhood_size,
+                                      IdxT scale_neighborhood_size)
+{
+    return scaleSpaceMaximaBinned(im, true, binning, maxima, max_vals, neighborhood_size, scale_neighborhood_size);
+}
+
+/**
+ * Scale-space maxima of a temporally binned movie.  See Boxxer2D::scaleSpaceMaximaBinned.
+ */
+template<class FloatT, class IdxT>
+IdxT Boxxer3D<FloatT,IdxT>::scaleSpaceMaximaBinned(const ImageStackT &im, bool use_DoG, const TemporalBinningT &binning,
+                                      IMatT &maxima, VecT &max_vals, IdxT neighborhood_size,
+                                      IdxT scale_neighborhood_size)
+{
+    binning.check();
+    IdxT nB = binning.nBins(static_cast<IdxT>(im.n_slices));
+    if(nB==0) {
+        maxima.set_size(5,0);
+        max_vals.reset();
+        return 0;
+    }
+    arma::field<IMatT> frame_maxima(nB); //These will come back 4xN
+    arma::field<VecT> frame_max_vals(nB);
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel
+    {
+        FrameFilter ff(*this, use_DoG);
+        ImageT bin_buf, frame_buf;
+        #pragma omp for
+        for(IdxT b=0; b<nB; b++) {
+            catcher.run([&]{
+                ff.filterPatched(binnedFrame(im, binning, b, bin_buf, frame_buf));
+                ff.maxima(frame_maxima(b), frame_max_vals(b), neighborhood_size, scale_neighborhood_size);
+            });
+        }
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+    IdxT Nmaxima = combine_maxima(frame_maxima, frame_max_vals, maxima, max_vals);
+    for(IdxT n=0; n<Nmaxima; n++) maxima(4,n) = binning.firstFrame(maxima(4,n)); //Report movie frames
+    return Nmaxima;
+}
+
+template<class FloatT, class IdxT>
+IdxT Boxxer3D<FloatT,IdxT>::scaleSpaceLoGMaximaCascade(const ImageStackT &im, const SpectralCascadeParams &params,
+                                      IMatT &maxima, VecT &max_vals, IdxT neighborhood_size,
+                                      IdxT scale_neighborhood_size, SpectralCascadeStats *stats) const
+{
+    return scaleSpaceMaximaCascade(im, false, params, maxima, max_vals, neighborhood_size, scale_neighborhood_size,
+                                   stats);
+}
+
+template<class FloatT, class IdxT>
+IdxT Boxxer3D<FloatT,IdxT>::scaleSpaceDoGMaximaCascade(const ImageStackT &im, const SpectralCascadeParams &params,
+                                      IMatT &maxima, VecT &max_vals, IdxT neighborhood_size,
+                                      IdxT scale_neighborhood_size, SpectralCascadeStats *stats) const
+{
+    return scaleSpaceMaximaCascade(im, true, params, maxima, max_vals, neighborhood_size, scale_neighborhood_size,
+                                   stats);
+}
+
+/**
+ * Spectral projection cascade.
+ *
+ * Each frame is projected along the spectral dimension, and the projections are searched by a Boxxer2D engine with
+ * the spatial rows of sigma, keeping the 2D maxima >projection_threshold as hits.  For each hit, a window spanning
+ * the spectral dimension is filtered at every scale.  Spatially the window is the box of box_radius around the hit
+ * plus a halo of the largest kernel half width and the maxima neighborhoods, clipped to the frame, so the filter
+ * response and maxima in the box are those of the full frame.  Each 3D maxima is kept by the first hit of its frame
+ * whose box holds it.
+ *
+ * The result is exactly the scaleSpaceLoG/DoGMaxima maxima that lie in the boxes of the hits.  Emitters too dim to
+ * give a hit in the projection are lost, so the projection threshold should be low.  Hits are scheduled dynamically
+ * and the filters of a thread are only rebuilt when its window size changes, which happens only near the edges.
+ */
+template<class FloatT, class IdxT>
+IdxT Boxxer3D<FloatT,IdxT>::scaleSpaceMaximaCascade(const ImageStackT &im, bool use_DoG,
+                                      const SpectralCascadeParams &params, IMatT &maxima, VecT &max_vals,
+                                      IdxT neighborhood_size, IdxT scale_neighborhood_size,
+                                      SpectralCascadeStats *stats) const
+{
+    IdxT L = params.spectral_dim;
+    if(L>=dim) {
+        std::ostringstream msg;
+        msg<<"Got spectral_dim: "<<L<<" expected <"<<dim;
+        throw ParameterValueError(msg.str());
+    }
+    IdxT A = L==0 ? 1 : 0; //The spatial dimensions
+    IdxT B = L==2 ? 1 : 2;
+    IdxT nT = static_cast<IdxT>(im.sN);
+    if(stats) *stats = SpectralCascadeStats();
+    if(nT==0) {
+        maxima.set_size(5,0);
+        max_vals.reset();
+        return 0;
+    }
+
+    //Project the frames
+    arma::Cube<FloatT> proj(imsize(A), imsize(B), nT);
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel
+    {
+        ImageT frame_buf;
+        #pragma omp for
+        for(IdxT n=0; n<nT; n++)
+            catcher.run([&]{
+                const ImageT &frame = defectFreeFrame(im.slice(n), frame_buf);
+                arma::Mat<FloatT> &p = proj.slice(n);
+                if(params.use_max) p.fill(-std::numeric_limits<FloatT>::infinity());
+                else p.zeros();
+                IdxT c[3];
+                for(c[2]=0; c[2]<imsize(2); c[2]++) for(c[1]=0; c[1]<imsize(1); c[1]++)
+                    for(c[0]=0; c[0]<imsize(0); c[0]++) {
+                        FloatT v = frame(c[0],c[1],c[2]);
+                        FloatT &q = p(c[A],c[B]);
+                        q = params.use_max ? std::max(q,v) : q+v;
+                    }
+            });
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+
+    //2D detection on the projections
+    MatT proj_sigma(2,nScales);
+    proj_sigma.row(0) = sigma.row(A);
+    proj_sigma.row(1) = sigma.row(B);
+    Boxxer2D<FloatT,IdxT> proj_boxxer({imsize(A), imsize(B)}, proj_sigma);
+    proj_boxxer.setDoGSigmaRatio(sigma_ratio);
+    IMatT hits; //Rows are [a b scale frame]
+    VecT hit_vals;
+    if(use_DoG) proj_boxxer.scaleSpaceDoGMaximaThreshold(proj, params.projection_threshold, hits, hit_vals,
+                                                         neighborhood_size, scale_neighborhood_size);
+    else proj_boxxer.scaleSpaceLoGMaximaThreshold(proj, params.projection_threshold, hits, hit_vals,
+                                                  neighborhood_size, scale_neighborhood_size);
+    IdxT nHits = static_cast<IdxT>(hits.n_cols);
+    std::vector<IdxT> frame_hits(nT+1, 0); //Hits of frame n are frame_hits[n] ... frame_hits[n+1]-1
+    for(IdxT k=0; k<nHits; k++) frame_hits[hits(3,k)+1]++;
+    for(IdxT n=0; n<nT; n++) frame_hits[n+1] += frame_hits[n];
+
+    //3D scale-space maxima in the windows of the hits
+    IdxT margin = std::max(std::max((neighborhood_size-1)/2, IdxT(1)), (scale_neighborhood_size-1)/2);
+    IVecT hw_max = {0,0,0};
+    FloatT sigma_max = 0;
+    for(IdxT s=0; s<nScales; s++) {
+        IVecT hw = GaussFIRFilter<FloatT,IdxT>::default_kernel_hw(sigma.col(s));
+        for(IdxT d=0; d<dim; d++) hw_max(d) = std::max(hw_max(d), hw(d));
+        sigma_max = std::max(sigma_max, std::max(sigma(A,s), sigma(B,s)));
+    }
+    IdxT radius = params.box_radius ? params.box_radius : static_cast<IdxT>(std::ceil(2*sigma_max));
+    auto in_box = [&](IdxT k, IdxT a, IdxT b) {
+        return a+radius>=hits(0,k) && a<=hits(0,k)+radius && b+radius>=hits(1,k) && b<=hits(1,k)+radius;
+    };
+    arma::field<IMatT> hit_maxima(nHits); //These will come back 4xN
+    arma::field<VecT> hit_max_vals(nHits);
+    std::vector<std::size_t> window_voxels(nHits, 0);
+    #pragma omp parallel
+    {
+        FrameFilter ff(*this, use_DoG);
+        ImageT window, frame_buf;
+        const ImageT *frame = nullptr;
+        IdxT frame_n = nT;
+        #pragma omp for schedule(dynamic)
+        for(IdxT k=0; k<nHits; k++) {
+            catcher.run([&]{
+                IdxT n = hits(3,k);
+                if(n!=frame_n) { //Consecutive hits of a thread are mostly in the same frame
+                    frame = &defectFreeFrame(im.slice(n), frame_buf);
+                    frame_n = n;
+                }
+                //The box of the hit spans all of the spectral dimension
+                IdxT box_lo[3], box_hi[3], win_lo[3], win_size[3];
+                for(IdxT d=0; d<dim; d++) {
+                    if(d==L) {
+                        box_lo[d] = 0;
+                        box_hi[d] = imsize(d);
+                        continue;
+                    }
+                    IdxT c = hits(d==A ? 0 : 1, k);
+                    box_lo[d] = c<radius ? 0 : c-radius;
+                    box_hi[d] = std::min(c+radius+1, imsize(d));
+                }
+                Boxxer2D<FloatT,IdxT>::filterWindowBounds(box_lo, box_hi, imsize, margin, hw_max, win_lo, win_size);
+                window.set_size(win_size[0], win_size[1], win_size[2]);
+                for(IdxT z=0; z<win_size[2]; z++) for(IdxT y=0; y<win_size[1]; y++) for(IdxT x=0; x<win_size[0]; x++)
+                    window(x,y,z) = (*frame)(win_lo[0]+x, win_lo[1]+y, win_lo[2]+z);
+                ff.filterPatched(window, win_lo[0], win_lo[1], win_lo[2]);
+                window_voxels[k] = window.n_elem;
+                //Keep the maxima in the box of this hit and not in the box of an earlier hit of the frame
+                auto first_box = [&](IdxT x, IdxT y, IdxT z) {
+                    IdxT c[3] = {x, y, z};
+                    if(!in_box(k,c[A],c[B])) return false;
+                    for(IdxT j=frame_hits[n]; j<k; j++) if(in_box(j,c[A],c[B])) return false;
+                    return true;
+                };
+                ff.maxima(hit_maxima(k), hit_max_vals(k), neighborhood_size, scale_neighborhood_size, first_box);
+            });
+        }
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+    if(stats) {
+        stats->nHits = nHits;
+        for(IdxT k=0; k<nHits; k++) stats->nWindowVoxels += window_voxels[k];
+    }
+    arma::field<IMatT> frame_maxima(nT); //These will come back 4xN
+    arma::field<VecT> frame_max_vals(nT);
+    for(IdxT n=0; n<nT; n++) {
+        IdxT nFrameMaxima = 0;
+        for(IdxT k=frame_hits[n]; k<frame_hits[n+1]; k++) nFrameMaxima += hit_max_vals(k).n_elem;
+        frame_maxima(n).set_size(4,nFrameMaxima);
+        frame_max_vals(n).set_size(nFrameMaxima);
+        IdxT nSaved = 0;
+        for(IdxT k=frame_hits[n]; k<frame_hits[n+1]; k++) {
+            for(IdxT i=0; i<hit_max_vals(k).n_elem; i++, nSaved++) {
+                frame_maxima(n).col(nSaved) = hit_maxima(k).col(i);
+                frame_max_vals(n)(nSaved) = hit_max_vals(k)(i);
+            }
+        }
+    }
+    return combine_maxima(frame_maxima, frame_max_vals, maxima, max_vals);
+}
+
+/**
+ * Make a mask from a list of box regions of interest.
+ *
+ * @param rois size:[6 x nROI] Rows are [x0, y0, z0, nx, ny, nz], the 0-based origin and size of each region.
+ *             Regions are clipped to the frame.
+ */
+template<class FloatT, class IdxT>
+typename Boxxer3D<FloatT,IdxT>::MaskT
+Boxxer3D<FloatT,IdxT>::makeROIMask(const IMatT &rois) const
+{
+    if(rois.n_rows!=6 && rois.n_elem>0) {
+        std::ostringstream msg;
+        msg<<"Got ROI list with #rows: "<<rois.n_rows<<" expected 6";
+        throw ParameterShapeError(msg.str());
+    }
+    MaskT mask(imsize(0),imsize(1),imsize(2));
+    mask.zeros();
+    for(IdxT r=0; r<rois.n_cols; r++) {
+        IdxT lo[3], hi[3];
+        for(IdxT d=0; d<dim; d++) {
+            lo[d] = std::min(rois(d,r),imsize(d));
+            hi[d] = std::min(lo[d]+rois(d+3,r),imsize(d));
+        }
+        for(IdxT z=lo[2]; z<hi[2]; z++) for(IdxT y=lo[1]; y<hi[1]; y++) for(IdxT x=lo[0]; x<hi[0]; x++)
+            mask(x,y,z) = 1;
+    }
+    return mask;
+}
+
+template<class FloatT, class IdxT>
+IdxT Boxxer3D<FloatT,IdxT>::scaleSpaceLoGMaximaMasked(const ImageStackT &im, const MaskT &mask, IMatT &maxima,
+                                      VecT &max_vals, IdxT neighborhood_size, IdxT scale_neighborhood_size) const
+{
+    return scaleSpaceMaximaMasked(im, mask, false, maxima, max_vals, neighborhood_size, scale_neighborhood_size);
+}
+
+template<class FloatT, class IdxT>
+IdxT Boxxer3D<FloatT,IdxT>::scaleSpaceDoGMaximaMasked(const ImageStackT &im, const MaskT &mask, IMatT &maxima,
+                                      VecT &max_vals, IdxT neighborhood_size, IdxT scale_neighborhood_size) const
+{
+    return scaleSpaceMaximaMasked(im, mask, true, maxima, max_vals, neighborhood_size, scale_neighborhood_size);
+}
+
+/* A tile of the frame and the window it is filtered in */
+template<class FloatT, class IdxT>
+struct Boxxer3D<FloatT,IdxT>::MaskTile
+{
+    IdxT lo[3], hi[3]; //Tile voxels [lo,hi)
+    IdxT win_lo[3], win_size[3]; //Filtering window
+};
+
+/**
+ * Divide the frame into MaskTileSize cubic tiles with any nonzero mask voxels, and compute the filtering window of
+ * each with Boxxer2D::filterWindowBounds(), using the largest kernel of any scale.
+ */
+template<class FloatT, class IdxT>
+std::vector<typename Boxxer3D<FloatT,IdxT>::MaskTile>
+Boxxer3D<FloatT,IdxT>::makeMaskTiles(const MaskT &mask, IdxT neighborhood_size, IdxT scale_neighborhood_size) const
+{
+    if(mask.n_rows!=imsize(0) || mask.n_cols!=imsize(1) || mask.n_slices!=imsize(2)) {
+        std::ostringstream msg;
+        msg<<"Got mask of size ["<<mask.n_rows<<","<<mask.n_cols<<","<<mask.n_slices<<"] expected imsize: "<<imsize.t();
+        throw ParameterShapeError(msg.str());
+    }
+    IdxT margin = std::max(std::max((neighborhood_size-1)/2, IdxT(1)), (scale_neighborhood_size-1)/2);
+    IVecT hw_max = {0,0,0};
+    for(IdxT s=0; s<nScales; s++) {
+        IVecT hw = GaussFIRFilter<FloatT,IdxT>::default_kernel_hw(sigma.col(s));
+        for(IdxT d=0; d<dim; d++) hw_max(d) = std::max(hw_max(d), hw(d));
+    }
+    std::vector<MaskTile> tiles;
+    for(IdxT tz=0; tz<imsize(2); tz+=MaskTileSize) for(IdxT ty=0; ty<imsize(1); ty+=MaskTileSize)
+        for(IdxT tx=0; tx<imsize(0); tx+=MaskTileSize) {
+            MaskTile tile;
+            IdxT t[3] = {tx, ty, tz};
+            for(IdxT d=0; d<dim; d++) {
+                tile.lo[d] = t[d];
+                tile.hi[d] = std::min(t[d]+MaskTileSize, imsize(d));
+            }
+            bool active = false;
+            for(IdxT z=tile.lo[2]; z<tile.hi[2] && !active; z++) for(IdxT y=tile.lo[1]; y<tile.hi[1] && !active; y++)
+                for(IdxT x=tile.lo[0]; x<tile.hi[0]; x++) if(mask(x,y,z)) { active=true; break; }
+            if(!active) continue;
+            Boxxer2D<FloatT,IdxT>::filterWindowBounds(tile.lo, tile.hi, imsize, margin, hw_max, tile.win_lo,
+                                                      tile.win_size);
+            tiles.push_back(tile);
+        }
+    return tiles;
+}
+
+/**
+ * Scale-space maxima restricted to the nonzero voxels of a mask.
+ *
+ * As Boxxer2D::scaleSpaceMaximaMasked, tiles without any mask voxels are skipped, so the cost scales with the masked
+ * volume, and the result is identical to the unmasked method followed by discarding maxima outside the mask.  Work
+ * items are ordered by frame, so consecutive items of a thread mostly reuse its defect free frame.
+ */
+template<class FloatT, class IdxT>
+IdxT Boxxer3D<FloatT,IdxT>::scaleSpaceMaximaMasked(const ImageStackT &im, const MaskT &mask, bool use_DoG,
+                                      IMatT &maxima, VecT &max_vals,
+                                      IdxT neighborhood_size, IdxT scale_neighborhood_size) const
+{
+    IdxT nT = static_cast<IdxT>(im.sN);
+    auto tiles = makeMaskTiles(mask, neighborhood_size, scale_neighborhood_size);
+    IdxT nTiles = static_cast<IdxT>(tiles.size());
+    std::size_t nItems = static_cast<std::size_t>(nTiles)*nT;
+    if(nItems==0) {
+        maxima.set_size(5,0);
+        max_vals.reset();
+        return 0;
+    }
+    arma::field<IMatT> item_maxima(nItems); //These will come back 4xN
+    arma::field<VecT> item_max_vals(nItems);
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel
+    {
+        //Filters have internal storage sized to the window, so each thread keeps one frame filter per window size
+        std::map<std::array<IdxT,3>, FrameFilter> filters;
+        ImageT window, frame_buf;
+        const ImageT *frame = nullptr;
+        IdxT frame_n = nT;
+        #pragma omp for schedule(dynamic)
+        for(std::size_t item=0; item<nItems; item++) {
+            catcher.run([&]{
+                const MaskTile &tile = tiles[item%nTiles];
+                IdxT n = static_cast<IdxT>(item/nTiles);
+                if(n!=frame_n) {
+                    frame = &defectFreeFrame(im.slice(n), frame_buf);
+                    frame_n = n;
+                }
+                std::array<IdxT,3> win_size = {{tile.win_size[0], tile.win_size[1], tile.win_size[2]}};
+                auto &ff = filters.emplace(win_size, FrameFilter(*this, use_DoG)).first->second;
+                window.set_size(win_size[0], win_size[1], win_size[2]);
+                for(IdxT z=0; z<win_size[2]; z++) for(IdxT y=0; y<win_size[1]; y++) for(IdxT x=0; x<win_size[0]; x++)
+                    window(x,y,z) = (*frame)(tile.win_lo[0]+x, tile.win_lo[1]+y, tile.win_lo[2]+z);
+                ff.filterPatched(window, tile.win_lo[0], tile.win_lo[1], tile.win_lo[2]);
+                //Keep only the maxima in the tile and the mask
+                ff.maxima(item_maxima(item), item_max_vals(item), neighborhood_size, scale_neighborhood_size,
+                          [&](IdxT x, IdxT y, IdxT z) {
+                              return x>=tile.lo[0] && x<tile.hi[0] && y>=tile.lo[1] && y<tile.hi[1] &&
+                                     z>=tile.lo[2] && z<tile.hi[2] && mask(x,y,z);
+                          });
+            });
+        }
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+    IdxT Nmaxima = combine_maxima(item_maxima, item_max_vals, maxima, max_vals);
+    for(IdxT k=0; k<Nmaxima; k++) maxima(4,k) /= nTiles; //Item index to frame index
+    return Nmaxima;
+}
+
+template<class FloatT, class IdxT>
+IdxT Boxxer3D<FloatT,IdxT>::scaleSpaceLoGMaximaAdaptive(const ImageStackT &im, FloatT threshold, IMatT &maxima,
+                                      VecT &max_vals, IdxT neighborhood_size, IdxT scale_neighborhood_size,
+                                      const AdaptiveScaleParams &params, AdaptiveScaleStats *stats)
+{
+    return scaleSpaceMaximaAdaptive(im, false, threshold, maxima, max_vals, neighborhood_size, scale_neighborhood_size,
+                                    params, stats);
+}
+
+template<class FloatT, class IdxT>
+IdxT Boxxer3D<FloatT,IdxT>::scaleSpaceDoGMaximaAdaptive(const ImageStackT &im, FloatT threshold, IMatT &maxima,
+                                      VecT &max_vals, IdxT neighborhood_size, IdxT scale_neighborhood_size,
+                                      const AdaptiveScaleParams &params, AdaptiveScaleStats *stats)
+{
+    return scaleSpaceMaximaAdaptive(im, true, threshold, maxima, max_vals, neighborhood_size, scale_neighborhood_size,
+                                    params, stats);
+}
+
+/**
+ * Scale-space maxima >threshold filtering only the scales chosen by a ScalePruner.  See
+ * Boxxer2D::scaleSpaceMaximaAdaptive.  The FrameFilter of a thread reallocates its response only when the number of
+ * scales changes, which happens only between periods.
+ */
+template<class FloatT, class IdxT>
+IdxT Boxxer3D<FloatT,IdxT>::scaleSpaceMaximaAdaptive(const ImageStackT &im, bool use_DoG, FloatT threshold,
+                                      IMatT &maxima, VecT &max_vals, IdxT neighborhood_size,
+                                      IdxT scale_neighborhood_size, const AdaptiveScaleParams &params,
+                                      AdaptiveScaleStats *stats)
+{
+    IdxT nT=static_cast<IdxT>(im.sN);
+    ScalePrunerT pruner(nScales, threshold, params);
+    IdxT period = pruner.recheckPeriod();
+    MatT peaks(nScales, nT);
+    peaks.fill(-std::numeric_limits<FloatT>::infinity());
+    arma::field<IMatT> frame_maxima(nT); //These will come back 4xN
+    arma::field<VecT> frame_max_vals(nT);
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel
+    {
+        FrameFilter ff(*this, use_DoG);
+        for(IdxT first=0; first<nT; first+=period) {
+            IdxT last = std::min(first+period, nT);
+            #pragma omp for schedule(dynamic)
+            for(IdxT n=first; n<last; n++) {
+                catcher.run([&]{
+                    const std::vector<IdxT> &scales = pruner.isFullFrame(n) ? pruner.allScales() : pruner.activeScales();
+                    if(scales.empty()) {
+                        frame_maxima(n).set_size(4,0);
+                        return;
+                    }
+                    const ScaledImageT &sim = ff.filter(im.slice(n), scales);
+                    for(IdxT k=0; k<scales.size(); k++) peaks(scales[k],n) = sim.slice(k).max();
+                    IMatT all_maxima;
+                    VecT all_max_vals;
+                    ff.maxima(all_maxima, all_max_vals, neighborhood_size, scale_neighborhood_size);
+                    thresholdMaxima(all_maxima, all_max_vals, threshold, frame_maxima(n), frame_max_vals(n));
+                });
+            }
+            #pragma omp single
+            catcher.run([&]{ pruner.update(peaks.cols(first,last-1)); });
+        }
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+    if(stats) *stats = pruner.stats();
+    if(nT==0) {
+        maxima.set_size(5,0);
+        max_vals.reset();
+        return 0;
+    }
+    return combine_maxima(frame_maxima, frame_max_vals, maxima, max_vals);
+}
+
+template<class FloatT, class IdxT>
+Boxxer3D<FloatT,IdxT>::FrameFilter::FrameFilter(const Boxxer3D &engine, bool use_DoG)
+    : _engine(&engine), use_DoG(use_DoG), size({0,0,0}), filter_sigma_ratio(0), origin{0,0,0}
+{ }
+
+template<class FloatT, class IdxT>
+const std::vector<IdxT>& Boxxer3D<FloatT,IdxT>::FrameFilter::allScales()
+{
+    if(all_scales.size()!=_engine->nScales) {
+        all_scales.resize(_engine->nScales);
+        for(IdxT s=0; s<_engine->nScales; s++) all_scales[s] = s;
+    }
+    return all_scales;
+}
+
+template<class FloatT, class IdxT>
+const typename Boxxer3D<FloatT,IdxT>::ScaledImageT&
+Boxxer3D<FloatT,IdxT>::FrameFilter::filter(const ImageT &frame)
+{
+    return filter(frame, allScales());
+}
+
+template<class FloatT, class IdxT>
+const typename Boxxer3D<FloatT,IdxT>::ScaledImageT&
+Boxxer3D<FloatT,IdxT>::FrameFilter::filter(const ImageT &frame, const std::vector<IdxT> &scales)
+{
+    origin[0] = origin[1] = origin[2] = 0;
+    return filterScales(_engine->defectFreeFrame(frame, frame_buf), scales);
+}
+
+template<class FloatT, class IdxT>
+const typename Boxxer3D<FloatT,IdxT>::ScaledImageT&
+Boxxer3D<FloatT,IdxT>::FrameFilter::filterPatched(const ImageT &im, IdxT x0, IdxT y0, IdxT z0)
+{
+    origin[0] = x0;
+    origin[1] = y0;
+    origin[2] = z0;
+    return filterScales(im, allScales());
+}
+
+/**
+ * Filter im at the given scales into consecutive hyperslices of the response, building the filters that are missing.
+ */
+template<class FloatT, class IdxT>
+const typename Boxxer3D<FloatT,IdxT>::ScaledImageT&
+Boxxer3D<FloatT,IdxT>::FrameFilter::filterScales(const ImageT &im, const std::vector<IdxT> &scales)
+{
+    const Boxxer3D &engine = *_engine;
+    if(im.n_rows!=size(0) || im.n_cols!=size(1) || im.n_slices!=size(2) || filter_sigma.n_cols!=engine.sigma.n_cols ||
+       !arma::all(arma::vectorise(filter_sigma==engine.sigma)) || (use_DoG && filter_sigma_ratio!=engine.sigma_ratio)) {
+        size = {static_cast<IdxT>(im.n_rows), static_cast<IdxT>(im.n_cols), static_cast<IdxT>(im.n_slices)};
+        filter_sigma = engine.sigma;
+        filter_sigma_ratio = engine.sigma_ratio;
+        dog_filters.clear();
+        log_filters.clear();
+        dog_filters.resize(engine.nScales);
+        log_filters.resize(engine.nScales);
+        maxima3D.reset();
+        sim.reset();
+    }
+    IdxT S = static_cast<IdxT>(scales.size());
+    if(!sim || sim->sN!=S) sim.reset(new ScaledImageT(size(0), size(1), size(2), S));
+    for(IdxT k=0; k<S; k++) {
+        IdxT s = scales[k];
+        if(s>=engine.nScales) {
+            std::ostringstream msg;
+            msg<<"Got scale: "<<s<<" expected <"<<engine.nScales;
+            throw ParameterValueError(msg.str());
+        }
+        if(use_DoG) {
+            if(!dog_filters[s]) dog_filters[s].reset(new DoGFilter3D<FloatT,IdxT>(size, engine.sigma.col(s), engine.sigma_ratio));
+            dog_filters[s]->filter(im, sim->slice(k));
+        } else {
+            if(!log_filters[s]) log_filters[s].reset(new LoGFilter3D<FloatT,IdxT>(size, engine.sigma.col(s)));
+            log_filters[s]->filter(im, sim->slice(k));
+        }
+    }
+    _scales = scales;
+    return *sim;
+}
+
+/**
+ * As Boxxer2D::FrameFilter::maxima.  Maxima not kept are dropped before the cross-scale refinement.
+ */
+template<class FloatT, class IdxT>
+IdxT Boxxer3D<FloatT,IdxT>::FrameFilter::maxima(IMatT &maxima, VecT &max_vals, IdxT neighborhood_size,
+                                                IdxT scale_neighborhood_size, const KeepT &keep)
+{
+    if(!maxima3D || maxima3D->boxsize!=neighborhood_size || arma::any(maxima3D->size!=size))
+        maxima3D.reset(new Maxima3D<FloatT,IdxT>(size, neighborhood_size));
+    arma::field<IMatT> scale_maxima(_engine->nScales);
+    arma::field<VecT> scale_max_vals(_engine->nScales);
+    for(IdxT s=0; s<_engine->nScales; s++) scale_maxima(s).set_size(3,0);
+    for(IdxT k=0; k<_scales.size(); k++) {
+        IMatT &sm = scale_maxima(_scales[k]);
+        VecT &sv = scale_max_vals(_scales[k]);
+        maxima3D->find_maxima(sim->slice(k), sm, sv);
+        if(!keep) continue;
+        IdxT nKeep = 0;
+        for(IdxT n=0; n<sv.n_elem; n++) {
+            if(!keep(sm(0,n)+origin[0], sm(1,n)+origin[1], sm(2,n)+origin[2])) continue;
+            sm.col(nKeep) = sm.col(n);
+            sv(nKeep) = sv(n);
+            nKeep++;
+        }
+        sm.resize(3,nKeep);
+        sv.resize(nKeep);
+    }
+    combine_maxima(scale_maxima, scale_max_vals, maxima, max_vals);
+    IdxT Nmaxima = _engine->scaleSpaceFrameMaximaRefine(*sim, maxima, max_vals, scale_neighborhood_size);
+    for(IdxT n=0; n<Nmaxima; n++) for(IdxT d=0; d<3; d++) maxima(d,n) += origin[d];
+    return Nmaxima;
+}
+
 /**
  * Get the scale maxima for a single frame
  */
@@ -137,7 +1030,8 @@ IdxT Boxxer3D<FloatT,IdxT>::scaleSpaceFrameMaxima(const ScaledImageT &sim, IMatT
 {
     arma::field<IMatT> scale_maxima(nScales);
     arma::field<VecT> scale_max_vals(nScales);
-    Maxima3D<FloatT,IdxT> maxima3D(imsize, neighborhood_size);
+    IVecT size = {static_cast<IdxT>(sim.sX), static_cast<IdxT>(sim.sY), static_cast<IdxT>(sim.sZ)}; //Frame or window
+    Maxima3D<FloatT,IdxT> maxima3D(size, neighborhood_size);
     for(IdxT s=0; s<nScales; s++)
         maxima3D.find_maxima(sim.slice(s), scale_maxima(s), scale_max_vals(s));
     combine_maxima(scale_maxima, scale_max_vals, maxima, max_vals);
@@ -159,21 +1053,22 @@ Boxxer3D<FloatT,IdxT>::scaleSpaceFrameMaximaRefine(const ScaledImageT &im, IMatT
     IdxT nMaxima = static_cast<IdxT>(maxima.n_cols);
     IdxT nNewMaxima=0;
     IdxT delta = static_cast<IdxT>((scale_neighborhood_size-1)/2);
+    IVecT size = {static_cast<IdxT>(im.sX), static_cast<IdxT>(im.sY), static_cast<IdxT>(im.sZ)}; //Frame or window
     for(IdxT n=0; n<nMaxima; n++) {
         IVecT mx = maxima.col(n);
         double mxv = max_vals(n);
         bool ok=true;
-        if ( (mx(0) < delta || mx(0)+delta>=imsize(0)) ||
-             (mx(1) < delta || mx(1)+delta>=imsize(1)) ||
-             (mx(2) < delta || mx(2)+delta>=imsize(2))) {
-            for(IdxT s=0; s<nScales; s++)
-                for(IdxT k= (mx(2) <= delta ? 0 : mx(2)-delta); k<imsize(2) && k<=mx(2)+delta; k++)
-                    for(IdxT j= (mx(1) <= delta ? 0 : mx(1)-delta); j<imsize(1) && j<=mx(1)+delta; j++)
-                        for(IdxT i= (mx(0) <= delta ? 0 : mx(0)-delta); i<imsize(0) && i<=mx(0)+delta; i++) {
+        if ( (mx(0) < delta || mx(0)+delta>=size(0)) ||
+             (mx(1) < delta || mx(1)+delta>=size(1)) ||
+             (mx(2) < delta || mx(2)+delta>=size(2))) {
+            for(IdxT s=0; s<im.sN; s++)
+                for(IdxT k= (mx(2) <= delta ? 0 : mx(2)-delta); k<size(2) && k<=mx(2)+delta; k++)
+                    for(IdxT j= (mx(1) <= delta ? 0 : mx(1)-delta); j<size(1) && j<=mx(1)+delta; j++)
+                        for(IdxT i= (mx(0) <= delta ? 0 : mx(0)-delta); i<size(0) && i<=mx(0)+delta; i++) {
                             if( im(i,j,k,s) > mxv) {ok=false; goto done;}
             }
         } else {
-            for(IdxT s=0; s<nScales; s++)
+            for(IdxT s=0; s<im.sN; s++)
                 for(IdxT k=mx(2)-delta; k<=mx(2)+delta; k++)
                     for(IdxT j=mx(1)-delta; j<=mx(1)+delta; j++)
                         for(IdxT i=mx(0)-delta; i<=mx(0)+delta; i++) {
@@ -187,13 +1082,73 @@ Boxxer3D<FloatT,IdxT>::scaleSpaceFrameMaximaRefine(const ScaledImageT &im, IMatT
             nNewMaxima++;
         }
     }
-    maxima = new_maxima(arma::span::all, arma::span(0,nNewMaxima-1));
-    max_vals = new_max_vals(arma::span(0,nNewMaxima-1));
+    if(nNewMaxima==0) {
+        maxima.set_size(maxima.n_rows,0);
+        max_vals.reset();
+    } else {
+        maxima = new_maxima(arma::span::all, arma::span(0,nNewMaxima-1));
+        max_vals = new_max_vals(arma::span(0,nNewMaxima-1));
+    }
+    return nNewMaxima;
+}
+/**
+ * The cross-scale refinement of scaleSpaceFrameMaximaRefine for an interleaved scaled image.  See
+ * Boxxer2D::scaleSpaceFrameMaximaRefineInterleaved.
+ */
+template<class FloatT, class IdxT>
+IdxT
+Boxxer3D<FloatT,IdxT>::scaleSpaceFrameMaximaRefineInterleaved(const InterleavedImageT &isim, IMatT &maxima,
+                                                              VecT &max_vals, IdxT scale_neighborhood_size) const
+{
+    using std::min;
+    IdxT S = static_cast<IdxT>(isim.sX);
+    IVecT size = {static_cast<IdxT>(isim.sY), static_cast<IdxT>(isim.sZ), static_cast<IdxT>(isim.sN)};
+    if(maxima.n_rows!=dim || maxima.n_cols!=max_vals.n_elem) {
+        std::ostringstream msg;
+        msg<<"Got maxima of size: ["<<maxima.n_rows<<","<<maxima.n_cols<<"] with "<<max_vals.n_elem
+           <<" values.  Expected ["<<dim<<" x nMaxima]";
+        throw ParameterShapeError(msg.str());
+    }
+    IMatT new_maxima(maxima.n_rows, maxima.n_cols);
+    VecT new_max_vals(max_vals.n_elem);
+    IdxT nMaxima = static_cast<IdxT>(maxima.n_cols);
+    IdxT nNewMaxima=0;
+    IdxT delta = static_cast<IdxT>((scale_neighborhood_size-1)/2);
+    for(IdxT n=0; n<nMaxima; n++) {
+        IVecT mx = maxima.col(n);
+        FloatT mxv = max_vals(n);
+        if(mx(0)>=size(0) || mx(1)>=size(1) || mx(2)>=size(2)) {
+            std::ostringstream msg;
+            msg<<"Maxima "<<n<<" at "<<mx.t()<<" is outside the interleaved image of size "<<size.t();
+            throw ParameterValueError(msg.str());
+        }
+        IdxT i0 = mx(0)<=delta ? 0 : mx(0)-delta;
+        IdxT run = (min(mx(0)+delta, size(0)-1)-i0+1)*S;
+        bool reject = false;
+        for(IdxT k = (mx(2)<=delta ? 0 : mx(2)-delta); k<size(2) && k<=mx(2)+delta && !reject; k++) {
+            const auto &slice = isim.slice(k);
+            for(IdxT j = (mx(1)<=delta ? 0 : mx(1)-delta); j<size(1) && j<=mx(1)+delta && !reject; j++) {
+                const FloatT *p = slice.slice_memptr(j) + static_cast<std::size_t>(i0)*S;
+                for(IdxT q=0; q<run; q++) reject |= p[q] > mxv;
+            }
+        }
+        if(reject) continue;
+        new_maxima.col(nNewMaxima) = mx;
+        new_max_vals(nNewMaxima) = mxv;
+        nNewMaxima++;
+    }
+    if(nNewMaxima==0) {
+        maxima.set_size(maxima.n_rows,0);
+        max_vals.reset();
+    } else {
+        maxima = new_maxima(arma::span::all, arma::span(0,nNewMaxima-1));
+        max_vals = new_max_vals(arma::span(0,nNewMaxima-1));
+    }
     return nNewMaxima;
 }
 
-/* Static Methods */
 
+/* Static Methods */
 
 template<class FloatT, class IdxT>
 void Boxxer3D<FloatT,IdxT>::filterLoG(const ImageStackT &im, ImageStackT &fim, const VecT &sigma)
@@ -249,6 +1204,24 @@ void Boxxer3D<FloatT,IdxT>::filterGauss(const ImageStackT &im, ImageStackT &fim,
     catcher.rethrow(); //Rethrow any caught exceptions
 }
 
+template<class FloatT, class IdxT>
+void Boxxer3D<FloatT,IdxT>::filterWavelet(const ImageStackT &im, ImageStackT &fim, IdxT level)
+{
+    IdxT nT=static_cast<IdxT>(fim.n_slices);
+    IVecT imsize = {static_cast<IdxT>(im.sX), static_cast<IdxT>(im.sY), static_cast<IdxT>(im.sZ)};
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel
+    {
+        AtrousFilter3D<FloatT,IdxT> filter(imsize,level);
+        #pragma omp for
+        for(IdxT n=0; n<nT; n++)
+            catcher.run([&]{
+                filter.filter(im.slice(n),fim.slice(n));
+            });
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+}
+
 /**
  * This finds local maxima over an image stack in parallel.
  */
@@ -274,6 +1247,88 @@ IdxT Boxxer3D<FloatT,IdxT>::enumerateImageMaxima(const ImageStackT &im, IMatT &m
     return combine_maxima(frame_maxima, frame_max_vals, maxima, max_vals);
 }
 
+template<class FloatT, class IdxT>
+IdxT Boxxer3D<FloatT,IdxT>::detectLoG(const ImageStackT &im, const VecT &sigma, IMatT &maxima, VecT &max_vals,
+                                      IdxT neighborhood_size, FloatT threshold)
+{
+    return detectFrames<LoGFilter3D<FloatT,IdxT>>(im, maxima, max_vals, neighborhood_size, threshold, sigma);
+}
+
+template<class FloatT, class IdxT>
+IdxT Boxxer3D<FloatT,IdxT>::detectDoG(const ImageStackT &im, const VecT &sigma, FloatT sigma_ratio, IMatT &maxima,
+                                      VecT &max_vals, IdxT neighborhood_size, FloatT threshold)
+{
+    return detectFrames<DoGFilter3D<FloatT,IdxT>>(im, maxima, max_vals, neighborhood_size, threshold, sigma, sigma_ratio);
+}
+
+template<class FloatT, class IdxT>
+IdxT Boxxer3D<FloatT,IdxT>::detectGauss(const ImageStackT &im, const VecT &sigma, IMatT &maxima, VecT &max_vals,
+                                        IdxT neighborhood_size, FloatT threshold)
+{
+    return detectFrames<GaussFilter3D<FloatT,IdxT>>(im, maxima, max_vals, neighborhood_size, threshold, sigma);
+}
+
+/**
+ * Filter and find the maxima of each frame in a per-thread buffer.  See Boxxer2D::detectFrames.
+ */
+template<class FloatT, class IdxT>
+template<class FilterT, class... FilterArgs>
+IdxT Boxxer3D<FloatT,IdxT>::detectFrames(const ImageStackT &im, IMatT &maxima, VecT &max_vals,
+                                         IdxT neighborhood_size, FloatT threshold, const FilterArgs&... filter_args)
+{
+    IdxT nT=static_cast<IdxT>(im.n_slices);
+    arma::field<IMatT> frame_maxima(nT);
+    arma::field<VecT> frame_max_vals(nT);
+    IVecT imsize = {static_cast<IdxT>(im.sX), static_cast<IdxT>(im.sY), static_cast<IdxT>(im.sZ)};
+    bool use_threshold = threshold > -std::numeric_limits<FloatT>::infinity();
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel
+    {
+        FilterT filter(imsize, filter_args...);
+        Maxima3D<FloatT,IdxT> maxima3D(imsize, neighborhood_size);
+        ImageT fframe(imsize(0), imsize(1), imsize(2));
+        IMatT fm;
+        VecT fv;
+        #pragma omp for
+        for(IdxT n=0; n<nT; n++)
+            catcher.run([&]{
+                filter.filter(im.slice(n), fframe);
+                if(!use_threshold) {
+                    maxima3D.find_maxima(fframe, frame_maxima(n), frame_max_vals(n));
+                    return;
+                }
+                maxima3D.find_maxima(fframe, fm, fv);
+                thresholdMaxima(fm, fv, threshold, frame_maxima(n), frame_max_vals(n));
+            });
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+    if(nT==0) {
+        maxima.set_size(4,0);
+        max_vals.reset();
+        return 0;
+    }
+    return combine_maxima(frame_maxima, frame_max_vals, maxima, max_vals);
+}
+
+/**
+ * Select the maxima with value strictly greater than threshold, preserving order.
+ */
+template<class FloatT, class IdxT>
+void Boxxer3D<FloatT,IdxT>::thresholdMaxima(const IMatT &maxima, const VecT &max_vals, FloatT threshold,
+                                            IMatT &thresh_maxima, VecT &thresh_max_vals)
+{
+    IdxT Nmaxima = static_cast<IdxT>(max_vals.n_elem);
+    IdxT Nkeep = 0;
+    for(IdxT n=0; n<Nmaxima; n++) if(max_vals(n)>threshold) Nkeep++;
+    thresh_maxima.set_size(maxima.n_rows, Nkeep);
+    thresh_max_vals.set_size(Nkeep);
+    for(IdxT n=0, i=0; n<Nmaxima; n++) if(max_vals(n)>threshold) {
+        thresh_maxima.col(i) = maxima.col(n);
+        thresh_max_vals(i) = max_vals(n);
+        i++;
+    }
+}
+
 template<class FloatT, class IdxT>
 IdxT Boxxer3D<FloatT,IdxT>::combine_maxima(const arma::field<IMatT> &frame_maxima,
                                            const arma::field<VecT> &frame_max_vals,
@@ -0,0 +1,251 @@
+/** @file Components.cpp
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief Connected-component labeler class member function definitions.
+ */
+
+#include <algorithm>
+#include <limits>
+#include <omp.h>
+#include "Boxxer/BoxxerError.h"
+#include "Boxxer/Components.h"
+
+namespace boxxer {
+
+namespace {
+template<class IdxT>
+IdxT find_root(std::vector<IdxT> &parent, IdxT i)
+{
+    while(parent[i]!=i) {
+        parent[i] = parent[parent[i]]; //Path halving
+        i = parent[i];
+    }
+    return i;
+}
+
+/* The larger root is linked to the smaller, so roots are the first pixel of their component */
+template<class IdxT>
+void unite(std::vector<IdxT> &parent, IdxT a, IdxT b)
+{
+    a = find_root(parent, a);
+    b = find_root(parent, b);
+    if(a<b) parent[b] = a;
+    else if(b<a) parent[a] = b;
+}
+
+template<class IVecT>
+void check_size(const IVecT &size, arma::uword dim)
+{
+    if(size.n_elem!=dim || !arma::all(size>0)) {
+        std::ostringstream msg;
+        msg<<"Got bad size: "<<size.t()<<" dim:"<<dim;
+        throw ParameterValueError(msg.str());
+    }
+}
+
+/**
+ * Label a column-major array of size [sx,sy,sz] with union-find.  2D arrays have sz=1.  Tiles are ranges of the
+ * last dimension, y in 2D and z in 3D.
+ * @param scale_ptr Functor returning the data pointer of scale s
+ */
+template<class FloatT, class IdxT, class ScaleF>
+IdxT label_components(const IdxT size[3], IdxT dim, IdxT nScales, ScaleF scale_ptr, FloatT threshold,
+                      std::vector<FloatT> &response, std::vector<IdxT> &peak_scale, std::vector<IdxT> &parent,
+                      arma::Mat<IdxT> &components, arma::Col<FloatT> &integrated, arma::Col<FloatT> &peak_vals)
+{
+    const IdxT Background = std::numeric_limits<IdxT>::max();
+    const std::size_t stride[3] = {1, size[0], static_cast<std::size_t>(size[0])*size[1]};
+    IdxT nOuter = size[dim-1];
+    std::size_t outer_stride = stride[dim-1];
+    IdxT nTiles = omp_in_parallel() ? 1 : std::min(nOuter, static_cast<IdxT>(omp_get_max_threads()));
+    //Previous neighbors in column-major order.  Only dz=0 in 2D.
+    std::vector<int> offsets[3];
+    for(int dz=(dim==3 ? -1 : 0); dz<=0; dz++) for(int dy=-1; dy<=1; dy++) for(int dx=-1; dx<=1; dx++) {
+        if(dz==0 && (dy>0 || (dy==0 && dx>=0))) continue;
+        offsets[0].push_back(dx);
+        offsets[1].push_back(dy);
+        offsets[2].push_back(dz);
+    }
+    IdxT nOffsets = static_cast<IdxT>(offsets[0].size());
+
+    #pragma omp parallel for if(nTiles>1)
+    for(IdxT t=0; t<nTiles; t++) {
+        IdxT o0 = (nOuter*t)/nTiles, o1 = (nOuter*(t+1))/nTiles;
+        std::size_t i0 = o0*outer_stride, i1 = o1*outer_stride;
+        for(std::size_t i=i0; i<i1; i++) {
+            FloatT best = scale_ptr(0)[i];
+            IdxT best_s = 0;
+            for(IdxT s=1; s<nScales; s++) if(scale_ptr(s)[i]>best) {
+                best = scale_ptr(s)[i];
+                best_s = s;
+            }
+            response[i] = best;
+            peak_scale[i] = best_s;
+        }
+        for(std::size_t i=i0; i<i1; i++) {
+            if(!(response[i]>threshold)) {
+                parent[i] = Background;
+                continue;
+            }
+            parent[i] = static_cast<IdxT>(i);
+            IdxT c[3] = {static_cast<IdxT>(i%size[0]), static_cast<IdxT>((i/size[0])%size[1]), static_cast<IdxT>(i/stride[2])};
+            for(IdxT k=0; k<nOffsets; k++) {
+                int64_t n[3];
+                bool inside = true;
+                for(IdxT d=0; d<3; d++) {
+                    n[d] = static_cast<int64_t>(c[d]) + offsets[d][k];
+                    inside = inside && n[d]>=0 && n[d]<static_cast<int64_t>(size[d]);
+                }
+                if(!inside || n[dim-1]<static_cast<int64_t>(o0)) continue; //Merged across tiles below
+                std::size_t j = n[0] + stride[1]*n[1] + stride[2]*n[2];
+                if(parent[j]!=Background) unite(parent, static_cast<IdxT>(i), static_cast<IdxT>(j));
+            }
+        }
+    }
+    //Merge each tile's first plane with the last plane of the previous tile
+    for(IdxT t=1; t<nTiles; t++) {
+        IdxT o0 = (nOuter*t)/nTiles;
+        for(std::size_t i=o0*outer_stride; i<(o0+1)*outer_stride; i++) {
+            if(parent[i]==Background) continue;
+            IdxT c[3] = {static_cast<IdxT>(i%size[0]), static_cast<IdxT>((i/size[0])%size[1]), static_cast<IdxT>(i/stride[2])};
+            for(IdxT k=0; k<nOffsets; k++) {
+                if(offsets[dim-1][k]!=-1) continue;
+                int64_t n[3];
+                bool inside = true;
+                for(IdxT d=0; d<3; d++) {
+                    n[d] = static_cast<int64_t>(c[d]) + offsets[d][k];
+                    inside = inside && n[d]>=0 && n[d]<static_cast<int64_t>(size[d]);
+                }
+                if(!inside) continue;
+                std::size_t j = n[0] + stride[1]*n[1] + stride[2]*n[2];
+                if(parent[j]!=Background) unite(parent, static_cast<IdxT>(i), static_cast<IdxT>(j));
+            }
+        }
+    }
+    //Summarize.  Roots come first in their component, so each is numbered when it is reached.
+    std::size_t nPixels = outer_stride*nOuter;
+    std::vector<IdxT> &id = peak_scale; //Component ids overwrite the peak scales of visited pixels
+    std::vector<IdxT> lo, hi, peak, scale, area;
+    std::vector<FloatT> sum, peak_val;
+    IdxT N = 0;
+    for(std::size_t i=0; i<nPixels; i++) {
+        if(parent[i]==Background) continue;
+        IdxT r = find_root(parent, static_cast<IdxT>(i));
+        IdxT c[3] = {static_cast<IdxT>(i%size[0]), static_cast<IdxT>((i/size[0])%size[1]), static_cast<IdxT>(i/stride[2])};
+        IdxT s = peak_scale[i];
+        IdxT n;
+        if(r==i) {
+            n = N++;
+            for(IdxT d=0; d<dim; d++) {
+                lo.push_back(c[d]);
+                hi.push_back(c[d]);
+                peak.push_back(c[d]);
+            }
+            scale.push_back(s);
+            area.push_back(0);
+            sum.push_back(0);
+            peak_val.push_back(response[i]);
+        } else {
+            n = id[r];
+        }
+        id[i] = n;
+        for(IdxT d=0; d<dim; d++) {
+            lo[n*dim+d] = std::min(lo[n*dim+d], c[d]);
+            hi[n*dim+d] = std::max(hi[n*dim+d], c[d]);
+        }
+        area[n]++;
+        sum[n] += response[i];
+        if(response[i]>peak_val[n]) {
+            peak_val[n] = response[i];
+            for(IdxT d=0; d<dim; d++) peak[n*dim+d] = c[d];
+            scale[n] = s;
+        }
+    }
+    components.set_size(3*dim+2, N);
+    integrated.set_size(N);
+    peak_vals.set_size(N);
+    for(IdxT n=0; n<N; n++) {
+        for(IdxT d=0; d<dim; d++) {
+            components(d,n) = lo[n*dim+d];
+            components(dim+d,n) = hi[n*dim+d];
+            components(2*dim+d,n) = peak[n*dim+d];
+        }
+        components(3*dim,n) = scale[n];
+        components(3*dim+1,n) = area[n];
+        integrated(n) = sum[n];
+        peak_vals(n) = peak_val[n];
+    }
+    return N;
+}
+} /* namespace */
+
+/* ComponentLabeler2D */
+
+template<class FloatT, class IdxT>
+const IdxT ComponentLabeler2D<FloatT,IdxT>::NRows = 8;
+
+template<class FloatT, class IdxT>
+ComponentLabeler2D<FloatT,IdxT>::ComponentLabeler2D(const IVecT &size_)
+    : size(size_)
+{
+    check_size(size, 2);
+    std::size_t nPixels = static_cast<std::size_t>(size(0))*size(1);
+    response.resize(nPixels);
+    peak_scale.resize(nPixels);
+    parent.resize(nPixels);
+}
+
+template<class FloatT, class IdxT>
+IdxT ComponentLabeler2D<FloatT,IdxT>::label(const ScaledImageT &sim, FloatT threshold, IMatT &components,
+                                            VecT &integrated, VecT &peak_vals)
+{
+    if(sim.n_rows!=size(0) || sim.n_cols!=size(1) || sim.n_slices==0) {
+        std::ostringstream msg;
+        msg<<"Got scaled image of size: ["<<sim.n_rows<<","<<sim.n_cols<<","<<sim.n_slices<<"] expected size: "<<size.t();
+        throw ParameterValueError(msg.str());
+    }
+    IdxT sz[3] = {size(0), size(1), 1};
+    return label_components<FloatT,IdxT>(sz, 2, static_cast<IdxT>(sim.n_slices),
+                                         [&](IdxT s){ return sim.slice(s).memptr(); }, threshold,
+                                         response, peak_scale, parent, components, integrated, peak_vals);
+}
+
+/* ComponentLabeler3D */
+
+template<class FloatT, class IdxT>
+const IdxT ComponentLabeler3D<FloatT,IdxT>::NRows = 11;
+
+template<class FloatT, class IdxT>
+ComponentLabeler3D<FloatT,IdxT>::ComponentLabeler3D(const IVecT &size_)
+    : size(size_)
+{
+    check_size(size, 3);
+    std::size_t nPixels = static_cast<std::size_t>(size(0))*size(1)*size(2);
+    response.resize(nPixels);
+    peak_scale.resize(nPixels);
+    parent.resize(nPixels);
+}
+
+template<class FloatT, class IdxT>
+IdxT ComponentLabeler3D<FloatT,IdxT>::label(const ScaledImageT &sim, FloatT threshold, IMatT &components,
+                                            VecT &integrated, VecT &peak_vals)
+{
+    if(sim.sX!=size(0) || sim.sY!=size(1) || sim.sZ!=size(2) || sim.sN==0) {
+        std::ostringstream msg;
+        msg<<"Got scaled image of size: ["<<sim.sX<<","<<sim.sY<<","<<sim.sZ<<","<<sim.sN<<"] expected size: "<<size.t();
+        throw ParameterValueError(msg.str());
+    }
+    IdxT sz[3] = {size(0), size(1), size(2)};
+    return label_components<FloatT,IdxT>(sz, 3, static_cast<IdxT>(sim.sN),
+                                         [&](IdxT s){ return sim.slice(s).memptr(); }, threshold,
+                                         response, peak_scale, parent, components, integrated, peak_vals);
+}
+
+/* Explicit Template Instantiation */
+template class ComponentLabeler2D<float>;
+template class ComponentLabeler2D<double>;
+
+template class ComponentLabeler3D<float>;
+template class ComponentLabeler3D<double>;
+
+} /* namespace boxxer */
@@ -0,0 +1,371 @@
+/**
+ * @file CompressedMovieFile.cpp
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The CompressedMovieFile class definition
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <fcntl.h>
+#include <omp.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "OMPExceptionCatcher/OMPExceptionCatcher.h"
+#include "Boxxer/BoxxerError.h"
+#include "Boxxer/CompressedMovieFile.h"
+
+namespace boxxer {
+
+namespace {
+/* LZ4 block format constants */
+const std::size_t MinMatch = 4;
+const std::size_t LastLiterals = 5; //The last 5 bytes are always literals
+const std::size_t MFLimit = 12; //The last match must start at least 12 bytes before the end
+const std::size_t MaxOffset = 65535;
+const int HashLog = 12;
+
+inline uint32_t read32(const uint8_t *p)
+{
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline uint32_t hash32(uint32_t v)
+{
+    return (v*2654435761u) >> (32-HashLog);
+}
+
+inline uint8_t* writeLength(uint8_t *op, std::size_t len)
+{
+    for(; len>=255; len-=255) *op++ = 255;
+    *op++ = static_cast<uint8_t>(len);
+    return op;
+}
+
+/* Greedy single-pass LZ4 block compression.  dst must hold compressBound(n) bytes.  Returns the block size. */
+std::size_t lz4Compress(const uint8_t *src, std::size_t n, uint8_t *dst)
+{
+    std::vector<uint32_t> table(std::size_t(1)<<HashLog, 0);
+    uint8_t *op = dst;
+    std::size_t anchor = 0;
+    if(n>MFLimit) {
+        std::size_t mflimit = n-MFLimit;
+        std::size_t matchlimit = n-LastLiterals;
+        std::size_t ip = 0;
+        while(ip<mflimit) {
+            uint32_t h = hash32(read32(src+ip));
+            std::size_t ref = table[h];
+            table[h] = static_cast<uint32_t>(ip);
+            if(ref>=ip || ip-ref>MaxOffset || read32(src+ref)!=read32(src+ip)) {
+                ip++;
+                continue;
+            }
+            while(ip>anchor && ref>0 && src[ip-1]==src[ref-1]) { ip--; ref--; }
+            std::size_t len = MinMatch;
+            while(ip+len<matchlimit && src[ref+len]==src[ip+len]) len++;
+            std::size_t lit = ip-anchor;
+            uint8_t *token = op++;
+            *token = static_cast<uint8_t>((std::min<std::size_t>(lit,15)<<4) | std::min<std::size_t>(len-MinMatch,15));
+            if(lit>=15) op = writeLength(op, lit-15);
+            std::memcpy(op, src+anchor, lit);
+            op += lit;
+            std::size_t offset = ip-ref;
+            *op++ = static_cast<uint8_t>(offset & 0xff);
+            *op++ = static_cast<uint8_t>(offset >> 8);
+            if(len-MinMatch>=15) op = writeLength(op, len-MinMatch-15);
+            ip += len;
+            anchor = ip;
+        }
+    }
+    std::size_t lit = n-anchor;
+    *op++ = static_cast<uint8_t>(std::min<std::size_t>(lit,15)<<4);
+    if(lit>=15) op = writeLength(op, lit-15);
+    std::memcpy(op, src+anchor, lit);
+    op += lit;
+    return static_cast<std::size_t>(op-dst);
+}
+
+/* r = a*b, returning false on overflow */
+bool checkedMul(std::size_t a, std::size_t b, std::size_t &r)
+{
+    if(a!=0 && b>std::numeric_limits<std::size_t>::max()/a) return false;
+    r = a*b;
+    return true;
+}
+
+void corruptBlock()
+{
+    throw ParameterValueError("Corrupt compressed movie frame block.");
+}
+
+/* LZ4 block decompression of exactly n bytes, with bounds checks on every read and write */
+void lz4Decompress(const uint8_t *src, std::size_t nsrc, uint8_t *dst, std::size_t n)
+{
+    std::size_t ip = 0, op = 0;
+    auto readLength = [&](std::size_t len) {
+        if(len<15) return len;
+        uint8_t b;
+        do {
+            if(ip>=nsrc) corruptBlock();
+            b = src[ip++];
+            len += b;
+        } while(b==255);
+        return len;
+    };
+    while(true) {
+        if(ip>=nsrc) corruptBlock();
+        uint8_t token = src[ip++];
+        std::size_t lit = readLength(token>>4);
+        if(lit>nsrc-ip || lit>n-op) corruptBlock();
+        std::memcpy(dst+op, src+ip, lit);
+        ip += lit;
+        op += lit;
+        if(ip==nsrc) break; //The last sequence has no match
+        if(nsrc-ip<2) corruptBlock();
+        std::size_t offset = src[ip] | (static_cast<std::size_t>(src[ip+1])<<8);
+        ip += 2;
+        std::size_t len = readLength(token & 15) + MinMatch;
+        if(offset==0 || offset>op || len>n-op) corruptBlock();
+        const uint8_t *match = dst+op-offset;
+        for(std::size_t i=0; i<len; i++) dst[op+i] = match[i]; //Matches may overlap their output
+        op += len;
+    }
+    if(op!=n) corruptBlock();
+}
+} /* namespace */
+
+const char CompressedMovieFile::Magic[8] = {'B','O','X','X','C','M','V','1'};
+
+static_assert(sizeof(CompressedMovieFile::Header)==40, "CompressedMovieFile header must be 40 bytes");
+
+CompressedMovieFile::CompressedMovieFile(const std::string &path)
+    : _path(path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd<0) {
+        std::ostringstream msg;
+        msg<<"Unable to open compressed movie file: "<<path<<" : "<<std::strerror(errno);
+        throw ParameterValueError(msg.str());
+    }
+    struct stat st;
+    if(::fstat(fd,&st)!=0 || static_cast<std::size_t>(st.st_size)<sizeof(Header)+sizeof(uint64_t)) {
+        ::close(fd);
+        std::ostringstream msg;
+        msg<<"Compressed movie file is too small to contain a header: "<<path;
+        throw ParameterValueError(msg.str());
+    }
+    map_len = static_cast<std::size_t>(st.st_size);
+    map_addr = ::mmap(nullptr, map_len, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(map_addr==MAP_FAILED) {
+        map_addr = nullptr;
+        std::ostringstream msg;
+        msg<<"Unable to mmap compressed movie file: "<<path<<" : "<<std::strerror(errno);
+        throw ParameterValueError(msg.str());
+    }
+    //Every header field is checked against the file size before it is used, so a corrupt or truncated file is
+    //rejected rather than read out of bounds
+    const Header *hdr = static_cast<const Header*>(map_addr);
+    const uint64_t max_idx = std::numeric_limits<IdxT>::max();
+    std::size_t frame_elems = 0, frame_bytes = 0, index_bytes = 0;
+    bool valid = std::memcmp(hdr->magic, Magic, sizeof(Magic))==0 && hdr->codec==uint64_t(Codec::ShuffleLZ4) &&
+                 hdr->nrows<=max_idx && hdr->ncols<=max_idx && hdr->nframes<max_idx &&
+                 checkedMul(hdr->nrows, hdr->ncols, frame_elems) && frame_elems<=max_idx &&
+                 checkedMul(frame_elems, sizeof(FloatT), frame_bytes) &&
+                 checkedMul(hdr->nframes+1, sizeof(uint64_t), index_bytes) &&
+                 index_bytes<=map_len-sizeof(Header);
+    index = reinterpret_cast<const uint64_t*>(static_cast<const char*>(map_addr)+sizeof(Header));
+    std::size_t index_end = sizeof(Header) + index_bytes;
+    valid = valid && index[0]==index_end && index[hdr->nframes]==map_len;
+    for(uint64_t n=0; valid && n<hdr->nframes; n++)
+        valid = index[n]<=index[n+1] && index[n+1]-index[n]<=frame_bytes;
+    if(!valid) {
+        ::munmap(map_addr, map_len);
+        map_addr = nullptr;
+        std::ostringstream msg;
+        msg<<"Invalid compressed movie file header or index: "<<path;
+        throw ParameterValueError(msg.str());
+    }
+    _nrows = static_cast<IdxT>(hdr->nrows);
+    _ncols = static_cast<IdxT>(hdr->ncols);
+    _nframes = static_cast<IdxT>(hdr->nframes);
+    //Threads decompress frames in an interleaved order, so the default readahead suits the access better than
+    //sequential advice, which would drop pages behind each thread's reads
+    ::madvise(map_addr, map_len, MADV_NORMAL);
+}
+
+CompressedMovieFile::~CompressedMovieFile()
+{
+    if(map_addr) ::munmap(map_addr, map_len);
+}
+
+double CompressedMovieFile::compressionRatio() const
+{
+    return (sizeof(Header)+static_cast<double>(frameElems())*_nframes*sizeof(FloatT))/map_len;
+}
+
+std::size_t CompressedMovieFile::compressFrame(const FloatT *frame, std::size_t nElem, std::vector<uint8_t> &shuffled,
+                                               std::vector<uint8_t> &block)
+{
+    std::size_t nbytes = nElem*sizeof(FloatT);
+    shuffled.resize(nbytes);
+    const uint8_t *bytes = reinterpret_cast<const uint8_t*>(frame);
+    for(std::size_t b=0; b<sizeof(FloatT); b++) {
+        uint8_t *plane = shuffled.data()+b*nElem;
+        for(std::size_t i=0; i<nElem; i++) plane[i] = bytes[i*sizeof(FloatT)+b];
+    }
+    block.resize(compressBound(nbytes));
+    std::size_t size = lz4Compress(shuffled.data(), nbytes, block.data());
+    if(size>=nbytes) { //Incompressible, store as is
+        std::memcpy(block.data(), frame, nbytes);
+        size = nbytes;
+    }
+    block.resize(size);
+    return size;
+}
+
+void CompressedMovieFile::decompressFrame(const uint8_t *block, std::size_t nbytes, std::size_t nElem,
+                                          std::vector<uint8_t> &shuffled, FloatT *frame)
+{
+    std::size_t frame_bytes = nElem*sizeof(FloatT);
+    if(nbytes==frame_bytes) {
+        std::memcpy(frame, block, frame_bytes);
+        return;
+    }
+    shuffled.resize(frame_bytes);
+    lz4Decompress(block, nbytes, shuffled.data(), frame_bytes);
+    uint8_t *bytes = reinterpret_cast<uint8_t*>(frame);
+    for(std::size_t b=0; b<sizeof(FloatT); b++) {
+        const uint8_t *plane = shuffled.data()+b*nElem;
+        for(std::size_t i=0; i<nElem; i++) bytes[i*sizeof(FloatT)+b] = plane[i];
+    }
+}
+
+void CompressedMovieFile::readFrame(IdxT n, ImageT &frame) const
+{
+    if(n>=_nframes) {
+        std::ostringstream msg;
+        msg<<"Bad frame "<<n<<" for movie with "<<_nframes<<" frames";
+        throw ParameterValueError(msg.str());
+    }
+    frame.set_size(_nrows, _ncols);
+    std::vector<uint8_t> shuffled;
+    decompressFrame(block(n), blockBytes(n), frameElems(), shuffled, frame.memptr());
+}
+
+CompressedMovieFile::ImageStackT CompressedMovieFile::frames(IdxT begin, IdxT end) const
+{
+    if(begin>end || end>_nframes) {
+        std::ostringstream msg;
+        msg<<"Bad frame range ["<<begin<<","<<end<<") for movie with "<<_nframes<<" frames";
+        throw ParameterValueError(msg.str());
+    }
+    ImageStackT im(_nrows, _ncols, end-begin);
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel
+    {
+        std::vector<uint8_t> shuffled;
+        #pragma omp for
+        for(IdxT n=begin; n<end; n++)
+            catcher.run([&]{ decompressFrame(block(n), blockBytes(n), frameElems(), shuffled, im.slice_memptr(n-begin)); });
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+    return im;
+}
+
+CompressedMovieFile::IdxT CompressedMovieFile::scaleSpaceLoGMaxima(const BoxxerT &engine, IMatT &maxima, VecT &max_vals,
+                                              IdxT neighborhood_size, IdxT scale_neighborhood_size) const
+{
+    return scaleSpaceMaxima(engine, false, maxima, max_vals, neighborhood_size, scale_neighborhood_size);
+}
+
+CompressedMovieFile::IdxT CompressedMovieFile::scaleSpaceDoGMaxima(const BoxxerT &engine, IMatT &maxima, VecT &max_vals,
+                                              IdxT neighborhood_size, IdxT scale_neighborhood_size) const
+{
+    return scaleSpaceMaxima(engine, true, maxima, max_vals, neighborhood_size, scale_neighborhood_size);
+}
+
+/**
+ * The frames are a frame source for the engine's frame loop.  Each thread decompresses into its own frame buffer and
+ * byte plane buffer, which are reused for every frame.  The DoG Gaussian cache of the engine is keyed by the movie
+ * memory, so it is not used.
+ */
+CompressedMovieFile::IdxT CompressedMovieFile::scaleSpaceMaxima(const BoxxerT &engine, bool use_DoG, IMatT &maxima, VecT &max_vals,
+                                           IdxT neighborhood_size, IdxT scale_neighborhood_size) const
+{
+    if(engine.imsize(0)!=_nrows || engine.imsize(1)!=_ncols) {
+        std::ostringstream msg;
+        msg<<"Got engine imsize: ["<<engine.imsize(0)<<","<<engine.imsize(1)<<"] for movie of size: ["
+           <<_nrows<<","<<_ncols<<"]";
+        throw ParameterShapeError(msg.str());
+    }
+    std::vector<std::vector<uint8_t>> shuffled(omp_get_max_threads());
+    auto decompressed = [&](IdxT n, ImageT &buffer) -> const ImageT& {
+        buffer.set_size(_nrows, _ncols);
+        decompressFrame(block(n), blockBytes(n), frameElems(), shuffled[omp_get_thread_num()], buffer.memptr());
+        return buffer;
+    };
+    BoxxerT::FrameFilterPool pool;
+    return engine.scaleSpaceMaxima(_nframes, decompressed, use_DoG, pool, maxima, max_vals, neighborhood_size,
+                                   scale_neighborhood_size);
+}
+
+/**
+ * Frames are compressed in parallel a chunk at a time and appended in order, so the memory used is bounded by the
+ * chunk.  The index is written last, once the block sizes are known.
+ */
+void CompressedMovieFile::write(const std::string &path, const ImageStackT &im)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if(!out) {
+        std::ostringstream msg;
+        msg<<"Unable to open compressed movie file for writing: "<<path;
+        throw ParameterValueError(msg.str());
+    }
+    Header hdr;
+    std::memcpy(hdr.magic, Magic, sizeof(Magic));
+    hdr.nrows = im.n_rows;
+    hdr.ncols = im.n_cols;
+    hdr.nframes = im.n_slices;
+    hdr.codec = uint64_t(Codec::ShuffleLZ4);
+    IdxT nT = static_cast<IdxT>(im.n_slices);
+    std::vector<uint64_t> offsets(nT+1);
+    offsets[0] = sizeof(Header) + offsets.size()*sizeof(uint64_t);
+    out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+    out.write(reinterpret_cast<const char*>(offsets.data()), offsets.size()*sizeof(uint64_t)); //Placeholder
+    std::size_t nElem = static_cast<std::size_t>(im.n_rows)*im.n_cols;
+    IdxT chunk = 4*static_cast<IdxT>(omp_get_max_threads());
+    std::vector<std::vector<uint8_t>> blocks(chunk);
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    for(IdxT begin=0; begin<nT; begin+=chunk) {
+        IdxT end = std::min(begin+chunk, nT);
+        #pragma omp parallel
+        {
+            std::vector<uint8_t> shuffled;
+            #pragma omp for schedule(dynamic)
+            for(IdxT n=begin; n<end; n++)
+                catcher.run([&]{ compressFrame(im.slice_memptr(n), nElem, shuffled, blocks[n-begin]); });
+        }
+        catcher.rethrow(); //Rethrow any caught exceptions
+        for(IdxT n=begin; n<end; n++) {
+            const std::vector<uint8_t> &b = blocks[n-begin];
+            out.write(reinterpret_cast<const char*>(b.data()), b.size());
+            offsets[n+1] = offsets[n] + b.size();
+        }
+    }
+    out.seekp(sizeof(Header));
+    out.write(reinterpret_cast<const char*>(offsets.data()), offsets.size()*sizeof(uint64_t));
+    if(!out) {
+        std::ostringstream msg;
+        msg<<"Error writing compressed movie file: "<<path;
+        throw ParameterValueError(msg.str());
+    }
+}
+
+} /* namespace boxxer */
@@ -0,0 +1,250 @@
+/** @file DefectMap.cpp
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief Defect pixel map class member function definitions.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <omp.h>
+#include "OMPExceptionCatcher/OMPExceptionCatcher.h"
+#include "Boxxer/BoxxerError.h"
+#include "Boxxer/DefectMap.h"
+
+namespace boxxer {
+
+namespace {
+/**
+ * Median of the neighbors of pixel [x,y,z] in a column-major array of size [sx,sy,sz], skipping flagged neighbors
+ * when mask is given.  2D arrays have sz=1 and use the 8 neighbors in the plane.
+ * @returns false if there are no such neighbors
+ */
+template<class FloatT>
+bool neighbor_median(const FloatT *data, const uint8_t *mask, const int size[3], int x, int y, int z, FloatT &med)
+{
+    FloatT vals[26];
+    int n = 0;
+    int dz_max = size[2]>1 ? 1 : 0;
+    for(int dz=-dz_max; dz<=dz_max; dz++) for(int dy=-1; dy<=1; dy++) for(int dx=-1; dx<=1; dx++) {
+        int i = x+dx, j = y+dy, k = z+dz;
+        if((dx==0 && dy==0 && dz==0) || i<0 || j<0 || k<0 || i>=size[0] || j>=size[1] || k>=size[2]) continue;
+        std::size_t idx = i + static_cast<std::size_t>(size[0])*(j + static_cast<std::size_t>(size[1])*k);
+        if(mask && mask[idx]) continue;
+        vals[n++] = data[idx];
+    }
+    if(n==0) return false;
+    std::nth_element(vals, vals+n/2, vals+n);
+    med = vals[n/2];
+    if(n%2==0) med = (med + *std::max_element(vals, vals+n/2))/2;
+    return true;
+}
+
+/**
+ * Count the persistent outliers of the frames.  Each frame's residual from the neighbor median is compared to
+ * threshold times its robust standard deviation, 1.4826*median(|residual|), over the frame.
+ */
+template<class FloatT, class IdxT, class FrameF>
+std::vector<IdxT> count_outliers(FrameF frame, IdxT nFrames, const int size[3], FloatT threshold)
+{
+    std::size_t nPixels = static_cast<std::size_t>(size[0])*size[1]*size[2];
+    std::vector<IdxT> count(nPixels, 0);
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel
+    {
+        std::vector<IdxT> thread_count(nPixels, 0);
+        std::vector<FloatT> resid(nPixels), abs_resid(nPixels);
+        #pragma omp for
+        for(IdxT n=0; n<nFrames; n++)
+            catcher.run([&]{
+                const FloatT *data = frame(n);
+                std::size_t idx = 0;
+                for(int z=0; z<size[2]; z++) for(int y=0; y<size[1]; y++) for(int x=0; x<size[0]; x++, idx++) {
+                    FloatT med;
+                    resid[idx] = neighbor_median<FloatT>(data, nullptr, size, x, y, z, med) ? data[idx]-med : 0;
+                    abs_resid[idx] = std::abs(resid[idx]);
+                }
+                std::nth_element(abs_resid.begin(), abs_resid.begin()+nPixels/2, abs_resid.end());
+                FloatT limit = threshold*1.4826*abs_resid[nPixels/2];
+                for(std::size_t i=0; i<nPixels; i++) if(std::abs(resid[i])>limit) thread_count[i]++;
+            });
+        #pragma omp critical
+        for(std::size_t i=0; i<nPixels; i++) count[i] += thread_count[i];
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+    return count;
+}
+
+template<class IdxT>
+IdxT min_outlier_count(IdxT nFrames, double min_fraction)
+{
+    if(nFrames==0 || !(min_fraction>0) || min_fraction>1) {
+        std::ostringstream msg;
+        msg<<"Bad defect detection parameters nFrames: "<<nFrames<<" min_fraction: "<<min_fraction;
+        throw ParameterValueError(msg.str());
+    }
+    return std::max(IdxT(1), static_cast<IdxT>(std::ceil(min_fraction*nFrames)));
+}
+} /* namespace */
+
+/* DefectMap2D */
+
+template<class FloatT, class IdxT>
+const FloatT DefectMap2D<FloatT,IdxT>::DefaultThreshold = 8;
+template<class FloatT, class IdxT>
+const FloatT DefectMap2D<FloatT,IdxT>::DefaultMinFraction = 0.9;
+
+template<class FloatT, class IdxT>
+DefectMap2D<FloatT,IdxT>::DefectMap2D(const MaskT &mask_)
+    : mask(mask_)
+{
+    IdxT N = 0;
+    for(arma::uword i=0; i<mask.n_elem; i++) if(mask(i)) N++;
+    pixels.set_size(2,N);
+    col_start.resize(mask.n_cols+1);
+    IdxT k = 0;
+    for(IdxT y=0; y<mask.n_cols; y++) {
+        col_start[y] = k;
+        for(IdxT x=0; x<mask.n_rows; x++) if(mask(x,y)) {
+            pixels(0,k) = x;
+            pixels(1,k) = y;
+            k++;
+        }
+    }
+    col_start[mask.n_cols] = k;
+}
+
+/**
+ * Call func(x,y) for each defect in [x0,x1]x[y0,y1].  The defects of each column are found from col_start and
+ * sorted by row, so the cost is in the columns of the window and the defects in it, not in all the defects of the
+ * frame.
+ */
+template<class FloatT, class IdxT>
+template<class Func>
+void DefectMap2D<FloatT,IdxT>::for_each_in(IdxT x0, IdxT x1, IdxT y0, IdxT y1, Func &&func) const
+{
+    if(pixels.n_cols==0) return;
+    y1 = std::min(y1, static_cast<IdxT>(mask.n_cols-1));
+    for(IdxT y=y0; y<=y1; y++) {
+        IdxT lo = col_start[y], hi = col_start[y+1];
+        while(lo<hi) {
+            IdxT mid = lo+(hi-lo)/2;
+            if(pixels(0,mid)<x0) lo = mid+1; else hi = mid;
+        }
+        for(IdxT k=lo; k<col_start[y+1] && pixels(0,k)<=x1; k++) func(pixels(0,k), y);
+    }
+}
+
+template<class FloatT, class IdxT>
+void DefectMap2D<FloatT,IdxT>::patch(const ImageT &frame, ImageT &window, IdxT x0, IdxT y0) const
+{
+    if(window.is_empty()) return;
+    int size[3] = {static_cast<int>(frame.n_rows), static_cast<int>(frame.n_cols), 1};
+    for_each_in(x0, x0+window.n_rows-1, y0, y0+window.n_cols-1, [&](IdxT x, IdxT y){
+        FloatT med;
+        if(neighbor_median(frame.memptr(), mask.memptr(), size, x, y, 0, med)) window(x-x0,y-y0) = med;
+    });
+}
+
+/**
+ * A patched value is the median of the same unflagged neighbors in both frames, so its difference and magnitude
+ * are bounded by those of the neighbors, which may be outside the window.
+ */
+template<class FloatT, class IdxT>
+void DefectMap2D<FloatT,IdxT>::diff_bound(const ImageT &a, const ImageT &b, IdxT x0, IdxT x1, IdxT y0, IdxT y1,
+                                          double &max_diff, double &max_abs) const
+{
+    IdxT sx = a.n_rows, sy = a.n_cols;
+    for_each_in(x0, x1, y0, y1, [&](IdxT x, IdxT y){
+        bool patched = false;
+        for(IdxT j=(y>0 ? y-1 : 0); j<=y+1 && j<sy; j++) for(IdxT i=(x>0 ? x-1 : 0); i<=x+1 && i<sx; i++) {
+            if(mask(i,j)) continue; //Includes the defect itself
+            max_diff = std::max(max_diff, static_cast<double>(std::abs(a(i,j)-b(i,j))));
+            max_abs = std::max(max_abs, static_cast<double>(std::max(std::abs(a(i,j)),std::abs(b(i,j)))));
+            patched = true;
+        }
+        if(!patched) {
+            max_diff = std::max(max_diff, static_cast<double>(std::abs(a(x,y)-b(x,y))));
+            max_abs = std::max(max_abs, static_cast<double>(std::max(std::abs(a(x,y)),std::abs(b(x,y)))));
+        }
+    });
+}
+
+template<class FloatT, class IdxT>
+FloatT DefectMap2D<FloatT,IdxT>::patched_value(const ImageT &frame, IdxT x, IdxT y) const
+{
+    FloatT med;
+    int size[3] = {static_cast<int>(frame.n_rows), static_cast<int>(frame.n_cols), 1};
+    if(mask(x,y) && neighbor_median(frame.memptr(), mask.memptr(), size, x, y, 0, med)) return med;
+    return frame(x,y);
+}
+
+template<class FloatT, class IdxT>
+typename DefectMap2D<FloatT,IdxT>::MaskT
+DefectMap2D<FloatT,IdxT>::detect(const ImageStackT &im, IdxT nFrames, FloatT threshold, FloatT min_fraction)
+{
+    nFrames = std::min(nFrames, static_cast<IdxT>(im.n_slices));
+    IdxT min_count = min_outlier_count(nFrames, min_fraction);
+    int size[3] = {static_cast<int>(im.n_rows), static_cast<int>(im.n_cols), 1};
+    auto count = count_outliers<FloatT,IdxT>([&](IdxT n){ return im.slice(n).memptr(); }, nFrames, size, threshold);
+    MaskT defects(im.n_rows, im.n_cols);
+    for(arma::uword i=0; i<defects.n_elem; i++) defects(i) = count[i]>=min_count;
+    return defects;
+}
+
+/* DefectMap3D */
+
+template<class FloatT, class IdxT>
+const FloatT DefectMap3D<FloatT,IdxT>::DefaultThreshold = 8;
+template<class FloatT, class IdxT>
+const FloatT DefectMap3D<FloatT,IdxT>::DefaultMinFraction = 0.9;
+
+template<class FloatT, class IdxT>
+DefectMap3D<FloatT,IdxT>::DefectMap3D(const MaskT &mask_)
+    : mask(mask_)
+{
+    IdxT N = 0;
+    for(arma::uword i=0; i<mask.n_elem; i++) if(mask(i)) N++;
+    pixels.set_size(3,N);
+    IdxT k = 0;
+    for(IdxT z=0; z<mask.n_slices; z++) for(IdxT y=0; y<mask.n_cols; y++) for(IdxT x=0; x<mask.n_rows; x++)
+        if(mask(x,y,z)) {
+            pixels(0,k) = x;
+            pixels(1,k) = y;
+            pixels(2,k) = z;
+            k++;
+        }
+}
+
+template<class FloatT, class IdxT>
+void DefectMap3D<FloatT,IdxT>::patch(const ImageT &frame, ImageT &out) const
+{
+    int size[3] = {static_cast<int>(frame.n_rows), static_cast<int>(frame.n_cols), static_cast<int>(frame.n_slices)};
+    for(IdxT k=0; k<pixels.n_cols; k++) {
+        FloatT med;
+        if(neighbor_median(frame.memptr(), mask.memptr(), size, pixels(0,k), pixels(1,k), pixels(2,k), med))
+            out(pixels(0,k), pixels(1,k), pixels(2,k)) = med;
+    }
+}
+
+template<class FloatT, class IdxT>
+typename DefectMap3D<FloatT,IdxT>::MaskT
+DefectMap3D<FloatT,IdxT>::detect(const ImageStackT &im, IdxT nFrames, FloatT threshold, FloatT min_fraction)
+{
+    nFrames = std::min(nFrames, static_cast<IdxT>(im.n_slices));
+    IdxT min_count = min_outlier_count(nFrames, min_fraction);
+    int size[3] = {static_cast<int>(im.sX), static_cast<int>(im.sY), static_cast<int>(im.sZ)};
+    auto count = count_outliers<FloatT,IdxT>([&](IdxT n){ return im.slice(n).memptr(); }, nFrames, size, threshold);
+    MaskT defects(im.sX, im.sY, im.sZ);
+    for(arma::uword i=0; i<defects.n_elem; i++) defects(i) = count[i]>=min_count;
+    return defects;
+}
+
+/* Explicit Template Instantiation */
+template class DefectMap2D<float>;
+template class DefectMap2D<double>;
+
+template class DefectMap3D<float>;
+template class DefectMap3D<double>;
+
+} /* namespace boxxer */
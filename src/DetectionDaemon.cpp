@@ -0,0 +1,646 @@
+/**
+ * @file DetectionDaemon.cpp
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The DetectionServer and DetectionClient class definitions
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <future>
+#include <limits>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <omp.h>
+#include "Boxxer/BoxxerError.h"
+#include "Boxxer/DetectionDaemon.h"
+
+namespace boxxer {
+
+/* Shared-memory ring layout and control channel wire format.  Both ends are on the same host. */
+namespace {
+
+const char RingMagic[8] = {'B','O','X','X','R','N','G','1'};
+const std::size_t RingAlign = 64;
+const uint32_t WireMaxScales = 16;
+
+struct RingHeader
+{
+    char magic[8];
+    uint64_t nslots;
+    uint64_t max_frame_elems;
+    uint64_t max_maxima;
+    uint64_t slot_bytes;
+    char pad[24];
+};
+static_assert(sizeof(RingHeader)==RingAlign, "RingHeader must be one alignment unit");
+
+enum MsgType : uint32_t { MsgAttach=1, MsgConfigure=2, MsgDetect=3 };
+enum ReplyStatus : int32_t { ReplyOK=0, ReplyError=1, ReplyOverflow=2 };
+
+struct Request
+{
+    uint32_t type;
+    uint32_t slot;
+    uint32_t nframes;
+    uint32_t nrows;
+    uint32_t ncols;
+    uint32_t nscales;
+    uint32_t use_DoG;
+    uint32_t neighborhood_size;
+    uint32_t scale_neighborhood_size;
+    float sigma_ratio;
+    float sigma[2*WireMaxScales];
+    uint64_t shm_size; //As created by the client.  The server maps the actual size of the segment.
+    char shm_name[64];
+};
+
+struct Reply
+{
+    int32_t status;
+    uint32_t nmaxima;
+    char message[256];
+};
+
+/* Checked size arithmetic.  Each sets r and returns true, or returns false on overflow. */
+bool checked_mul(std::size_t a, std::size_t b, std::size_t &r)
+{
+    if(a!=0 && b>std::numeric_limits<std::size_t>::max()/a) return false;
+    r = a*b;
+    return true;
+}
+
+bool checked_add(std::size_t a, std::size_t b, std::size_t &r)
+{
+    if(b>std::numeric_limits<std::size_t>::max()-a) return false;
+    r = a+b;
+    return true;
+}
+
+bool checked_align_up(std::size_t n, std::size_t &r)
+{
+    if(!checked_add(n, RingAlign-1, r)) return false;
+    r = r/RingAlign*RingAlign;
+    return true;
+}
+
+/* Slot layout: frames [max_frame_elems floats], maxima [4 x max_maxima IdxT], max_vals [max_maxima floats] */
+bool slot_maxima_offset(std::size_t max_frame_elems, std::size_t &offset)
+{
+    std::size_t frame_bytes;
+    return checked_mul(max_frame_elems, sizeof(float), frame_bytes) && checked_align_up(frame_bytes, offset);
+}
+
+bool slot_vals_offset(std::size_t max_frame_elems, std::size_t max_maxima, std::size_t &offset)
+{
+    std::size_t maxima_offset, maxima_bytes;
+    return slot_maxima_offset(max_frame_elems, maxima_offset) &&
+           checked_mul(max_maxima, 4*sizeof(uint32_t), maxima_bytes) && checked_align_up(maxima_bytes, maxima_bytes) &&
+           checked_add(maxima_offset, maxima_bytes, offset);
+}
+
+/* The bytes of a slot used by the layout, before alignment */
+bool slot_used_bytes(std::size_t max_frame_elems, std::size_t max_maxima, std::size_t &used)
+{
+    std::size_t vals_offset, vals_bytes;
+    return slot_vals_offset(max_frame_elems, max_maxima, vals_offset) &&
+           checked_mul(max_maxima, sizeof(float), vals_bytes) && checked_add(vals_offset, vals_bytes, used);
+}
+
+/* Reject configurations the engine cannot represent before any engine is built.  Neighborhood half-widths are
+ * (n-1)/2, so sizes must be odd and >=3, and the Gaussian half-widths ceil(3*sigma) must fit the frame. */
+void check_configure(const Request &req)
+{
+    std::ostringstream msg;
+    if(req.nrows==0 || req.ncols==0) {
+        msg<<"Got empty frame size: ["<<req.nrows<<","<<req.ncols<<"]";
+    } else if(req.neighborhood_size<3 || req.neighborhood_size%2==0) {
+        msg<<"Neighborhood size must be odd and >=3 got: "<<req.neighborhood_size;
+    } else if(req.scale_neighborhood_size<3 || req.scale_neighborhood_size%2==0) {
+        msg<<"Scale neighborhood size must be odd and >=3 got: "<<req.scale_neighborhood_size;
+    } else if(req.use_DoG && (!std::isfinite(req.sigma_ratio) || !(req.sigma_ratio>1))) {
+        msg<<"Sigma ratio must be finite and >1 got: "<<req.sigma_ratio;
+    } else {
+        float max_sigma = static_cast<float>(std::max(req.nrows, req.ncols));
+        for(uint32_t i=0; i<2*req.nscales; i++) {
+            float s = req.sigma[i];
+            if(!std::isfinite(s) || !(s>0) || s>max_sigma) {
+                msg<<"Sigma must be finite and in (0,"<<max_sigma<<"] got: "<<s;
+                break;
+            }
+        }
+    }
+    if(!msg.str().empty()) throw ParameterValueError(msg.str());
+}
+
+bool send_all(int fd, const void *buf, std::size_t len)
+{
+    const char *p = static_cast<const char*>(buf);
+    while(len>0) {
+        ssize_t n = ::send(fd, p, len, MSG_NOSIGNAL);
+        if(n<0 && errno==EINTR) continue;
+        if(n<=0) return false;
+        p += n;
+        len -= static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+bool recv_all(int fd, void *buf, std::size_t len)
+{
+    char *p = static_cast<char*>(buf);
+    while(len>0) {
+        ssize_t n = ::recv(fd, p, len, 0);
+        if(n<0 && errno==EINTR) continue;
+        if(n<=0) return false;
+        p += n;
+        len -= static_cast<std::size_t>(n);
+    }
+    return true;
+}
+
+Reply make_reply(int32_t status, uint32_t nmaxima=0, const std::string &message="")
+{
+    Reply reply;
+    std::memset(&reply, 0, sizeof(reply));
+    reply.status = status;
+    reply.nmaxima = nmaxima;
+    std::strncpy(reply.message, message.c_str(), sizeof(reply.message)-1);
+    return reply;
+}
+
+sockaddr_un make_address(const std::string &socket_path)
+{
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(socket_path.size() >= sizeof(addr.sun_path)) {
+        std::ostringstream msg;
+        msg<<"Socket path too long: "<<socket_path;
+        throw ParameterValueError(msg.str());
+    }
+    std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path)-1);
+    return addr;
+}
+
+} /* anonymous namespace */
+
+
+/* DetectionServer */
+
+const DetectionServer::IdxT DetectionServer::MaxScales = WireMaxScales;
+const DetectionServer::IdxT DetectionServer::DefaultMaxEngines = 16;
+
+/**
+ * An engine and its per-thread frame filters, which stay warm between requests.  Jobs run one at a time on the
+ * worker thread, but connections that share the engine may outlive its eviction, so the pool has its own lock.
+ */
+struct DetectionServer::CachedEngine
+{
+    std::shared_ptr<const BoxxerT> engine;
+    std::mutex pool_mtx;
+    BoxxerT::FrameFilterPool pool;
+};
+
+struct DetectionServer::Connection
+{
+    int fd = -1;
+    std::thread thread;
+    char *ring = nullptr;
+    std::size_t ring_len = 0;
+    RingHeader header;
+    std::size_t maxima_offset = 0;
+    std::size_t vals_offset = 0;
+    std::shared_ptr<CachedEngine> engine;
+    bool use_DoG = true;
+    IdxT neighborhood_size = 3;
+    IdxT scale_neighborhood_size = 3;
+
+    ~Connection()
+    {
+        if(ring) ::munmap(ring, ring_len);
+        if(fd>=0) ::close(fd);
+    }
+};
+
+DetectionServer::DetectionServer(const std::string &socket_path, IdxT nThreads, IdxT max_engines, bool group_access)
+    : socket_path(socket_path), nThreads(nThreads), max_engines(max_engines), group_access(group_access)
+{
+    make_address(socket_path); //Validate
+    if(max_engines<1) throw ParameterValueError("Engine cache must hold at least one engine.");
+}
+
+DetectionServer::~DetectionServer()
+{
+    stop();
+}
+
+void DetectionServer::start()
+{
+    if(_running) return;
+    auto addr = make_address(socket_path);
+    listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if(listen_fd<0) throw ProcessError(std::string("Unable to create socket: ")+std::strerror(errno));
+    ::unlink(socket_path.c_str());
+    //Restrict the socket before it accepts connections
+    if(::bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))!=0 ||
+       ::chmod(socket_path.c_str(), group_access ? 0660 : 0600)!=0 || ::listen(listen_fd, 16)!=0) {
+        std::ostringstream msg;
+        msg<<"Unable to listen on socket: "<<socket_path<<" : "<<std::strerror(errno);
+        ::close(listen_fd);
+        listen_fd = -1;
+        throw ProcessError(msg.str());
+    }
+    jobs_stop = false;
+    _running = true;
+    worker_thread = std::thread(&DetectionServer::workerLoop, this);
+    accept_thread = std::thread(&DetectionServer::acceptLoop, this);
+}
+
+void DetectionServer::stop()
+{
+    if(!_running) return;
+    _running = false;
+    ::shutdown(listen_fd, SHUT_RDWR); //Wakes accept()
+    accept_thread.join();
+    ::close(listen_fd);
+    listen_fd = -1;
+    ::unlink(socket_path.c_str());
+    std::vector<std::shared_ptr<Connection>> conns;
+    {
+        std::lock_guard<std::mutex> lock(conn_mtx);
+        conns.swap(connections);
+    }
+    for(auto &conn: conns) ::shutdown(conn->fd, SHUT_RDWR); //Wakes recv()
+    for(auto &conn: conns) conn->thread.join();
+    {
+        std::lock_guard<std::mutex> lock(job_mtx);
+        jobs_stop = true;
+    }
+    job_cv.notify_all();
+    worker_thread.join();
+}
+
+std::size_t DetectionServer::nEngines() const
+{
+    std::lock_guard<std::mutex> lock(engine_mtx);
+    return engines.size();
+}
+
+void DetectionServer::acceptLoop()
+{
+    while(_running) {
+        int fd = ::accept(listen_fd, nullptr, nullptr);
+        if(fd<0) {
+            if(!_running) break;
+            if(errno==EINTR || errno==ECONNABORTED) continue;
+            break;
+        }
+        auto conn = std::make_shared<Connection>();
+        conn->fd = fd;
+        std::lock_guard<std::mutex> lock(conn_mtx);
+        if(!_running) break; //conn closes fd on destruction
+        conn->thread = std::thread(&DetectionServer::serveConnection, this, conn);
+        connections.push_back(conn);
+    }
+}
+
+/**
+ * The single detection thread.  All clients' detection jobs run here in submission order, so there is one
+ * OpenMP thread pool for the whole workstation.
+ */
+void DetectionServer::workerLoop()
+{
+    if(nThreads>0) omp_set_num_threads(static_cast<int>(nThreads));
+    while(true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(job_mtx);
+            job_cv.wait(lock, [this]{ return jobs_stop || !jobs.empty(); });
+            if(jobs.empty()) return;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        job();
+    }
+}
+
+void DetectionServer::runJob(std::function<void()> job)
+{
+    std::packaged_task<void()> task(std::move(job));
+    auto done = task.get_future();
+    {
+        std::lock_guard<std::mutex> lock(job_mtx);
+        if(jobs_stop) throw ProcessError("Detection server is stopping.");
+        jobs.emplace_back([&task]{ task(); });
+    }
+    job_cv.notify_one();
+    done.get(); //Rethrows any job exception
+}
+
+std::shared_ptr<DetectionServer::CachedEngine>
+DetectionServer::getEngine(const arma::Col<IdxT> &imsize, const arma::Mat<FloatT> &sigma, bool use_DoG, FloatT sigma_ratio)
+{
+    EngineKey key{std::vector<IdxT>(imsize.memptr(), imsize.memptr()+imsize.n_elem),
+                  std::vector<FloatT>(sigma.memptr(), sigma.memptr()+sigma.n_elem), sigma_ratio, use_DoG};
+    std::lock_guard<std::mutex> lock(engine_mtx);
+    auto it = engines.find(key);
+    if(it != engines.end()) {
+        engine_lru.splice(engine_lru.begin(), engine_lru, it->second);
+        return it->second->second;
+    }
+    auto engine = std::make_shared<BoxxerT>(imsize, sigma);
+    engine->setDoGSigmaRatio(sigma_ratio);
+    auto cached = std::make_shared<CachedEngine>();
+    cached->engine = engine;
+    engine_lru.emplace_front(key, cached);
+    engines[key] = engine_lru.begin();
+    while(engine_lru.size()>max_engines) { //Connections still using an evicted engine keep it alive
+        engines.erase(engine_lru.back().first);
+        engine_lru.pop_back();
+    }
+    return cached;
+}
+
+void DetectionServer::serveConnection(std::shared_ptr<Connection> conn)
+{
+    Request req;
+    while(recv_all(conn->fd, &req, sizeof(req))) {
+        Reply reply = make_reply(ReplyOK);
+        try {
+            switch(req.type) {
+                case MsgAttach: {
+                    req.shm_name[sizeof(req.shm_name)-1] = '\0';
+                    if(conn->ring) throw LogicalError("Ring already attached.");
+                    int shm_fd = ::shm_open(req.shm_name, O_RDWR, 0);
+                    if(shm_fd<0) throw ProcessError(std::string("Unable to open shared memory: ")+req.shm_name);
+                    //Map the actual size of the segment, not the size the client claims
+                    struct stat st;
+                    if(::fstat(shm_fd, &st)!=0 || st.st_size<static_cast<off_t>(sizeof(RingHeader))) {
+                        ::close(shm_fd);
+                        throw ParameterValueError(std::string("Shared memory is smaller than a ring header: ")+req.shm_name);
+                    }
+                    std::size_t ring_len = static_cast<std::size_t>(st.st_size);
+                    void *addr = ::mmap(nullptr, ring_len, PROT_READ|PROT_WRITE, MAP_SHARED, shm_fd, 0);
+                    ::close(shm_fd);
+                    if(addr==MAP_FAILED) throw ProcessError(std::string("Unable to map shared memory: ")+req.shm_name);
+                    //The header is copied once so the client cannot change it after it is checked
+                    RingHeader h;
+                    std::memcpy(&h, addr, sizeof(RingHeader));
+                    std::size_t maxima_offset, vals_offset, slot_used, slots_bytes, ring_used;
+                    bool valid = std::memcmp(h.magic, RingMagic, sizeof(RingMagic))==0 &&
+                                 slot_maxima_offset(h.max_frame_elems, maxima_offset) &&
+                                 slot_vals_offset(h.max_frame_elems, h.max_maxima, vals_offset) &&
+                                 slot_used_bytes(h.max_frame_elems, h.max_maxima, slot_used) && slot_used<=h.slot_bytes &&
+                                 checked_mul(h.nslots, h.slot_bytes, slots_bytes) &&
+                                 checked_add(sizeof(RingHeader), slots_bytes, ring_used) && ring_used<=ring_len;
+                    if(!valid) {
+                        ::munmap(addr, ring_len);
+                        throw ParameterValueError("Invalid shared memory ring header.");
+                    }
+                    conn->header = h;
+                    conn->maxima_offset = maxima_offset;
+                    conn->vals_offset = vals_offset;
+                    conn->ring_len = ring_len;
+                    conn->ring = static_cast<char*>(addr);
+                    break;
+                }
+                case MsgConfigure: {
+                    if(req.nscales<1 || req.nscales>MaxScales) throw ParameterValueError("Bad number of scales.");
+                    check_configure(req);
+                    arma::Col<IdxT> imsize = {req.nrows, req.ncols};
+                    arma::Mat<FloatT> sigma(req.sigma, 2, req.nscales);
+                    conn->engine = getEngine(imsize, sigma, req.use_DoG,
+                                             req.use_DoG ? req.sigma_ratio : BoxxerT::DefaultSigmaRatio);
+                    conn->use_DoG = req.use_DoG;
+                    conn->neighborhood_size = req.neighborhood_size;
+                    conn->scale_neighborhood_size = req.scale_neighborhood_size;
+                    break;
+                }
+                case MsgDetect: {
+                    if(!conn->ring) throw LogicalError("No ring attached.");
+                    if(!conn->engine) throw LogicalError("Client not configured.");
+                    const RingHeader &h = conn->header;
+                    auto cached = conn->engine;
+                    const BoxxerT &engine = *cached->engine;
+                    std::size_t frame_elems = static_cast<std::size_t>(engine.imsize(0))*engine.imsize(1);
+                    std::size_t slot_elems;
+                    if(req.slot>=h.nslots || !checked_mul(req.nframes, frame_elems, slot_elems) ||
+                       slot_elems > h.max_frame_elems)
+                        throw ParameterValueError("Bad ring slot or frame count.");
+                    char *slot = conn->ring + sizeof(RingHeader) + req.slot*h.slot_bytes;
+                    arma::Mat<IdxT> maxima;
+                    arma::Col<FloatT> max_vals;
+                    runJob([&]{
+                        const arma::Cube<FloatT> ims(reinterpret_cast<FloatT*>(slot), engine.imsize(0), engine.imsize(1),
+                                                     req.nframes, false, false);
+                        auto frames = [&](IdxT n, BoxxerT::ImageT &) -> const BoxxerT::ImageT& { return ims.slice(n); };
+                        std::lock_guard<std::mutex> lock(cached->pool_mtx);
+                        engine.scaleSpaceMaxima(req.nframes, frames, conn->use_DoG, cached->pool, maxima, max_vals,
+                                                conn->neighborhood_size, conn->scale_neighborhood_size);
+                    });
+                    IdxT N = static_cast<IdxT>(max_vals.n_elem);
+                    if(N > h.max_maxima) {
+                        reply = make_reply(ReplyOverflow, N, "Ring slot maxima capacity exceeded.");
+                        break;
+                    }
+                    if(N>0) {
+                        std::memcpy(slot+conn->maxima_offset, maxima.memptr(), maxima.n_elem*sizeof(IdxT));
+                        std::memcpy(slot+conn->vals_offset, max_vals.memptr(), N*sizeof(FloatT));
+                    }
+                    reply.nmaxima = N;
+                    break;
+                }
+                default:
+                    throw ParameterValueError("Unknown request type.");
+            }
+        } catch (std::exception &err) {
+            reply = make_reply(ReplyError, 0, err.what());
+        }
+        if(!send_all(conn->fd, &reply, sizeof(reply))) break;
+    }
+    if(conn->ring) {
+        ::munmap(conn->ring, conn->ring_len);
+        conn->ring = nullptr;
+    }
+    //Client disconnected.  Drop the connection unless stop() has already taken it and will join this thread.
+    std::lock_guard<std::mutex> lock(conn_mtx);
+    for(auto it=connections.begin(); it!=connections.end(); ++it) if(*it==conn) {
+        conn->thread.detach();
+        connections.erase(it);
+        break;
+    }
+}
+
+
+/* DetectionClient */
+
+DetectionClient::DetectionClient(const std::string &socket_path, IdxT nSlots, std::size_t max_frame_elems, std::size_t max_maxima)
+    : _nSlots(nSlots), max_frame_elems(max_frame_elems), max_maxima(max_maxima)
+{
+    if(nSlots<1 || max_frame_elems<1) throw ParameterValueError("Ring must have positive slots and frame capacity.");
+    std::size_t slot_used, slots_bytes;
+    if(!slot_maxima_offset(max_frame_elems, maxima_offset) ||
+       !slot_vals_offset(max_frame_elems, max_maxima, vals_offset) ||
+       !slot_used_bytes(max_frame_elems, max_maxima, slot_used) || !checked_align_up(slot_used, slot_bytes) ||
+       !checked_mul(nSlots, slot_bytes, slots_bytes) || !checked_add(sizeof(RingHeader), slots_bytes, ring_len) ||
+       ring_len > static_cast<std::size_t>(std::numeric_limits<off_t>::max()))
+        throw ParameterValueError("Ring capacity is too large.");
+
+    static std::atomic<unsigned> ring_counter{0};
+    std::ostringstream name;
+    name<<"/boxxer_ring_"<<::getpid()<<"_"<<ring_counter++;
+    int shm_fd = ::shm_open(name.str().c_str(), O_CREAT|O_EXCL|O_RDWR, 0600);
+    if(shm_fd<0) throw ProcessError(std::string("Unable to create shared memory: ")+std::strerror(errno));
+    if(::ftruncate(shm_fd, static_cast<off_t>(ring_len))!=0) {
+        ::close(shm_fd);
+        ::shm_unlink(name.str().c_str());
+        throw ProcessError(std::string("Unable to size shared memory: ")+std::strerror(errno));
+    }
+    ring_addr = ::mmap(nullptr, ring_len, PROT_READ|PROT_WRITE, MAP_SHARED, shm_fd, 0);
+    ::close(shm_fd);
+    if(ring_addr==MAP_FAILED) {
+        ring_addr = nullptr;
+        ::shm_unlink(name.str().c_str());
+        throw ProcessError(std::string("Unable to map shared memory: ")+std::strerror(errno));
+    }
+    RingHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, RingMagic, sizeof(RingMagic));
+    header.nslots = nSlots;
+    header.max_frame_elems = max_frame_elems;
+    header.max_maxima = max_maxima;
+    header.slot_bytes = slot_bytes;
+    std::memcpy(ring_addr, &header, sizeof(header));
+
+    try {
+        auto addr = make_address(socket_path);
+        sock_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if(sock_fd<0 || ::connect(sock_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))!=0) {
+            std::ostringstream msg;
+            msg<<"Unable to connect to detection server: "<<socket_path<<" : "<<std::strerror(errno);
+            throw ProcessError(msg.str());
+        }
+        Request req;
+        std::memset(&req, 0, sizeof(req));
+        req.type = MsgAttach;
+        req.shm_size = ring_len;
+        std::strncpy(req.shm_name, name.str().c_str(), sizeof(req.shm_name)-1);
+        Reply reply;
+        if(!send_all(sock_fd, &req, sizeof(req)) || !recv_all(sock_fd, &reply, sizeof(reply)))
+            throw ProcessError("Lost connection to detection server.");
+        if(reply.status!=ReplyOK) throw ProcessError(reply.message);
+    } catch (...) {
+        ::shm_unlink(name.str().c_str());
+        if(sock_fd>=0) ::close(sock_fd);
+        ::munmap(ring_addr, ring_len);
+        throw;
+    }
+    //Both ends have the ring mapped.  Unlinking now means the segment can never leak.
+    ::shm_unlink(name.str().c_str());
+}
+
+DetectionClient::~DetectionClient()
+{
+    if(sock_fd>=0) ::close(sock_fd);
+    if(ring_addr) ::munmap(ring_addr, ring_len);
+}
+
+void DetectionClient::configure(const IVecT &_imsize, const MatT &sigma, bool use_DoG, FloatT sigma_ratio,
+                                IdxT neighborhood_size, IdxT scale_neighborhood_size)
+{
+    if(_imsize.n_elem!=2 || sigma.n_rows!=2) throw ParameterShapeError("Expected 2D imsize and sigma.");
+    if(sigma.n_cols<1 || sigma.n_cols>DetectionServer::MaxScales) {
+        std::ostringstream msg;
+        msg<<"Number of scales must be in [1,"<<DetectionServer::MaxScales<<"] got: "<<sigma.n_cols;
+        throw ParameterShapeError(msg.str());
+    }
+    if(!pending.empty()) throw LogicalError("Cannot configure with submissions in flight.");
+    Request req;
+    std::memset(&req, 0, sizeof(req));
+    req.type = MsgConfigure;
+    req.nrows = _imsize(0);
+    req.ncols = _imsize(1);
+    req.nscales = static_cast<uint32_t>(sigma.n_cols);
+    req.use_DoG = use_DoG;
+    req.sigma_ratio = sigma_ratio;
+    req.neighborhood_size = neighborhood_size;
+    req.scale_neighborhood_size = scale_neighborhood_size;
+    std::memcpy(req.sigma, sigma.memptr(), sigma.n_elem*sizeof(FloatT));
+    Reply reply;
+    if(!send_all(sock_fd, &req, sizeof(req)) || !recv_all(sock_fd, &reply, sizeof(reply)))
+        throw ProcessError("Lost connection to detection server.");
+    if(reply.status!=ReplyOK) throw ParameterValueError(reply.message);
+    imsize = _imsize;
+}
+
+char* DetectionClient::slotPtr(IdxT slot) const
+{
+    return static_cast<char*>(ring_addr) + sizeof(RingHeader) + slot*slot_bytes;
+}
+
+DetectionClient::ImageStackT DetectionClient::slotFrames(IdxT slot, IdxT nT)
+{
+    if(imsize.n_elem!=2) throw LogicalError("Client not configured.");
+    if(slot>=_nSlots || static_cast<std::size_t>(nT)*imsize(0)*imsize(1) > max_frame_elems) {
+        std::ostringstream msg;
+        msg<<"Bad ring slot: "<<slot<<" or frame count: "<<nT;
+        throw ParameterValueError(msg.str());
+    }
+    return ImageStackT(reinterpret_cast<FloatT*>(slotPtr(slot)), imsize(0), imsize(1), nT, false, false);
+}
+
+void DetectionClient::submit(IdxT slot, IdxT nT)
+{
+    if(slot>=_nSlots) throw ParameterValueError("Bad ring slot.");
+    for(IdxT p: pending) if(p==slot) throw LogicalError("Ring slot is already in flight.");
+    Request req;
+    std::memset(&req, 0, sizeof(req));
+    req.type = MsgDetect;
+    req.slot = slot;
+    req.nframes = nT;
+    if(!send_all(sock_fd, &req, sizeof(req))) throw ProcessError("Lost connection to detection server.");
+    pending.push_back(slot);
+}
+
+DetectionClient::IdxT DetectionClient::collect(IMatT &maxima, VecT &max_vals)
+{
+    if(pending.empty()) throw LogicalError("No submissions in flight.");
+    IdxT slot = pending.front();
+    pending.pop_front();
+    Reply reply;
+    if(!recv_all(sock_fd, &reply, sizeof(reply))) throw ProcessError("Lost connection to detection server.");
+    if(reply.status!=ReplyOK) {
+        std::ostringstream msg;
+        msg<<"Detection failed for slot "<<slot<<": "<<reply.message;
+        if(reply.status==ReplyOverflow) msg<<" Nmaxima: "<<reply.nmaxima<<" capacity: "<<max_maxima;
+        throw ProcessError(msg.str());
+    }
+    const char *slot_ptr = slotPtr(slot);
+    maxima.set_size(4, reply.nmaxima);
+    max_vals.set_size(reply.nmaxima);
+    if(reply.nmaxima>0) {
+        std::memcpy(maxima.memptr(), slot_ptr+maxima_offset, maxima.n_elem*sizeof(IdxT));
+        std::memcpy(max_vals.memptr(), slot_ptr+vals_offset, max_vals.n_elem*sizeof(FloatT));
+    }
+    return slot;
+}
+
+DetectionClient::IdxT DetectionClient::detect(const ImageStackT &im, IMatT &maxima, VecT &max_vals)
+{
+    if(!pending.empty()) throw LogicalError("detect() cannot be mixed with submissions in flight.");
+    IdxT nT = static_cast<IdxT>(im.n_slices);
+    auto frames = slotFrames(0, nT);
+    frames = im;
+    submit(0, nT);
+    return collect(maxima, max_vals);
+}
+
+} /* namespace boxxer */
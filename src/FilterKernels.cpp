@@ -5,6 +5,7 @@
  *
  */
 
+#include <algorithm>
 #include "Boxxer/BoxxerError.h"
 #include "Boxxer/FilterKernels.h"
 
@@ -207,17 +208,8 @@ void gaussFIR_2Dx(const arma::Mat<FloatT> &data_vec, arma::Mat<FloatT> &fdata_ve
     //Use mirroring boundary conditions as they will likely give the best approximation to
     //What would be off the edge of the images.  This gives data(0,0)==data(-1,0); d(1,0)==data(-2,0);
     //This seems to be what dip_image uses.
-    IntT hw=static_cast<IntT>(kernel_vec.n_elem)-1;
-    IntT sizeX=static_cast<IntT>(data_vec.n_rows);
-    IntT sizeY=static_cast<IntT>(data_vec.n_cols);
-    if(sizeX<=2*hw+1) return gaussFIR_2Dx_small(data_vec, fdata_vec, kernel_vec);
-    const FloatT *data=data_vec.memptr();
-    FloatT *fdata=fdata_vec.memptr();
-    const FloatT *kernel=kernel_vec.memptr();
-    
-    for(IntT y=0; y<sizeY; y++){
-        gaussFIR_1D(sizeX,&data[y*sizeX],&fdata[y*sizeX],hw,kernel);
-    }
+    gaussFIR_axis<FloatT,IntT>(data_vec.n_rows, 1, data_vec.n_cols, data_vec.memptr(), fdata_vec.memptr(),
+                               static_cast<IntT>(kernel_vec.n_elem)-1, kernel_vec.memptr());
 }
 
 template <class FloatT, class IntT>
@@ -370,76 +362,15 @@ void gaussFIR_2Dy_rowmajor(const arma::Mat<FloatT> &data, arma::Mat<FloatT> &fda
     }
 }
 
-template <class FloatT, class IntT>
-void gaussFIR_2Dy(IntT sizeX, IntT sizeY, const FloatT data[], FloatT fdata[], IntT hw, const FloatT kernel[])
-{
-    for(IntT y=0; y<hw; y++) {
-        const FloatT *datacol=&data[sizeX*y];
-        for(IntT x=0; x<sizeX; x++){
-            FloatT val=kernel[0]*datacol[x];
-            for(IntT r=1;   r<=y;  r++) val+=kernel[r]*(datacol[x+sizeX*r]+datacol[x-sizeX*r]);
-            for(IntT r=y+1; r<=hw; r++) val+=kernel[r]*(datacol[x+sizeX*r]+data[x+sizeX*(r-y-1)]); //mirroring boundary conditions
-            fdata[x+sizeX*y]=val;
-        }
-    }
-    for(IntT y=hw; y<sizeY-hw; y++) { //Main Loop
-        const FloatT *datacol=&data[sizeX*y];
-        for(IntT x=0; x<sizeX; x++){
-            FloatT val=kernel[0]*datacol[x];
-            for(IntT r=1; r<=hw; r++) val+=kernel[r]*(datacol[x-sizeX*r]+datacol[x+sizeX*r]);
-            fdata[x+sizeX*y]=val;
-        }
-    }
-    for(IntT y=sizeY-hw; y<sizeY; y++) {
-        const FloatT *datacol=&data[sizeX*y];
-        for(IntT x=0; x<sizeX; x++){
-            FloatT val=kernel[0]*datacol[x];
-            for(IntT r=1; r<=sizeY-y-1; r++) val+=kernel[r]*(datacol[x-sizeX*r]+datacol[x+sizeX*r]);
-            for(IntT r=sizeY-y; r<=hw; r++) val+=kernel[r]*(datacol[x-sizeX*r]+data[x+sizeX*(2*sizeY-r-y-1)]); //mirroring boundary conditions
-            fdata[x+sizeX*y]=val;
-        }
-    }
-}
-
 template <class FloatT, class IntT>
 void gaussFIR_2Dy(const arma::Mat<FloatT> &data_vec, arma::Mat<FloatT> &fdata, const arma::Col<FloatT> &kernel_vec)
 {
-    //3% faster
     //Filters along y direction which is across rows for arma::Mat<FloatT>
     //Use mirroring boundary conditions as they will likely give the best approximation to
     //What would be off the edge of the images.  This gives data(0,0)==data(0,-1); d(1,0)==data(-2,0);
     //This seems to be what dip_image uses.
-    IntT hw=static_cast<IntT>(kernel_vec.n_elem)-1;
-    IntT sizeX=static_cast<IntT>(data_vec.n_rows);
-    IntT sizeY=static_cast<IntT>(data_vec.n_cols);
-    if(sizeY<=2*hw+1) return gaussFIR_2Dy_small(data_vec, fdata, kernel_vec);
-    const FloatT *data=data_vec.memptr();
-    const FloatT *kernel=kernel_vec.memptr();
-
-    for(IntT y=0; y<hw; y++) {
-        for(IntT x=0; x<sizeX; x++){
-            FloatT val=kernel[0]*data_vec(x,y);
-            for(IntT r=1; r<=y; r++) val+=kernel[r]*(data_vec(x,y-r)+data_vec(x,y+r));
-            for(IntT r=y+1; r<=hw; r++) val+=kernel[r]*(data_vec(x,y+r)+data_vec(x,r-y-1)); //mirroring boundary conditions
-            fdata(x,y)=val;
-        }
-    }
-    for(IntT y=hw; y<sizeY-hw; y++) { //Main Loop
-        const FloatT *datacol=&data[sizeX*y];
-        for(IntT x=0; x<sizeX; x++){
-            FloatT val=kernel[0]*datacol[x];
-            for(IntT r=1; r<=hw; r++) val+=kernel[r]*(datacol[x-sizeX*r]+datacol[x+sizeX*r]);
-            fdata(x,y)=val;
-        }
-    }
-    for(IntT y=sizeY-hw; y<sizeY; y++) {
-        for(IntT x=0; x<sizeX; x++){
-            FloatT val=kernel[0]*data_vec(x,y);
-            for(IntT r=1; r<sizeY-y; r++) val+=kernel[r]*(data_vec(x,y-r)+data_vec(x,y+r));
-            for(IntT r=sizeY-y; r<=hw; r++) val+=kernel[r]*(data_vec(x,y-r)+data_vec(x,2*sizeY-r-y-1)); //mirroring boundary conditions
-            fdata(x,y)=val;
-        }
-    }
+    gaussFIR_axis<FloatT,IntT>(data_vec.n_cols, data_vec.n_rows, 1, data_vec.memptr(), fdata.memptr(),
+                               static_cast<IntT>(kernel_vec.n_elem)-1, kernel_vec.memptr());
 }
 
 //3D filters
@@ -467,17 +398,8 @@ template <class FloatT, class IntT>
 void gaussFIR_3Dx(const arma::Cube<FloatT> &data_vec, arma::Cube<FloatT> &fdata_vec, const arma::Col<FloatT> &kernel_vec)
 {
     //Use mirroring boundary conditions
-    IntT hw=static_cast<IntT>(kernel_vec.n_elem)-1;
-    IntT sizeX=static_cast<IntT>(data_vec.n_rows);
-    IntT sizeY=static_cast<IntT>(data_vec.n_cols);
-    IntT sizeZ=static_cast<IntT>(data_vec.n_slices);
-    if(sizeX<=2*hw+1) return gaussFIR_3Dx_small(data_vec, fdata_vec, kernel_vec);
-    const FloatT *data=data_vec.memptr();
-    FloatT *fdata=fdata_vec.memptr();
-    const FloatT *kernel=kernel_vec.memptr();
-    for(IntT z=0; z<sizeZ; z++)  for(IntT y=0; y<sizeY; y++) {
-        gaussFIR_1D(sizeX,&data[sizeX*(y+z*sizeY)],&fdata[sizeX*(y+z*sizeY)],hw,kernel);
-    }
+    gaussFIR_axis<FloatT,IntT>(data_vec.n_rows, 1, data_vec.n_cols*data_vec.n_slices, data_vec.memptr(),
+                               fdata_vec.memptr(), static_cast<IntT>(kernel_vec.n_elem)-1, kernel_vec.memptr());
 }
 
 template <class FloatT, class IntT>
@@ -503,21 +425,8 @@ void gaussFIR_3Dy_small(const arma::Cube<FloatT> &data, arma::Cube<FloatT> &fdat
 template <class FloatT, class IntT>
 void gaussFIR_3Dy(const arma::Cube<FloatT> &data_vec, arma::Cube<FloatT> &fdata_vec, const arma::Col<FloatT> &kernel_vec)
 {
-    IntT hw=static_cast<IntT>(kernel_vec.n_elem)-1;
-    IntT sizeX=static_cast<IntT>(data_vec.n_rows);
-    IntT sizeY=static_cast<IntT>(data_vec.n_cols);
-    IntT sizeZ=static_cast<IntT>(data_vec.n_slices);
-    if(sizeY<=2*hw+1) return gaussFIR_3Dy_small(data_vec, fdata_vec, kernel_vec);
-    const FloatT *data=data_vec.memptr();
-    FloatT *fdata=fdata_vec.memptr();
-    const FloatT *kernel=kernel_vec.memptr();
-    
-    IntT sizeXY=sizeX*sizeY;
-    for(IntT z=0; z<sizeZ; z++){
-        gaussFIR_2Dy(sizeX,sizeY,data,fdata,hw,kernel);
-        data+=sizeXY;
-        fdata+=sizeXY;
-    }
+    gaussFIR_axis<FloatT,IntT>(data_vec.n_cols, data_vec.n_rows, data_vec.n_slices, data_vec.memptr(),
+                               fdata_vec.memptr(), static_cast<IntT>(kernel_vec.n_elem)-1, kernel_vec.memptr());
 }
 
 template <class FloatT, class IntT>
@@ -541,38 +450,226 @@ void gaussFIR_3Dz_small(const arma::Cube<FloatT> &data, arma::Cube<FloatT> &fdat
 }
 
 template <class FloatT, class IntT>
-void gaussFIR_3Dz(const arma::Cube<FloatT> &data_vec, arma::Cube<FloatT> &fdata, const arma::Col<FloatT> &kernel_vec)
+void gaussFIR_3Dz(const arma::Cube<FloatT> &data_vec, arma::Cube<FloatT> &fdata_vec, const arma::Col<FloatT> &kernel_vec)
 {
-    IntT hw=static_cast<IntT>(kernel_vec.n_elem)-1;
-    IntT sizeX=static_cast<IntT>(data_vec.n_rows);
-    IntT sizeY=static_cast<IntT>(data_vec.n_cols);
-    IntT sizeZ=static_cast<IntT>(data_vec.n_slices);
-    if(sizeZ<=2*hw+1) return gaussFIR_3Dz_small(data_vec, fdata, kernel_vec);
-    const FloatT *data=data_vec.memptr();
-    const FloatT *kernel=kernel_vec.memptr();
-    IntT sizeXY=sizeX*sizeY;
-    for(IntT y=0; y<sizeY; y++) for(IntT x=0; x<sizeX; x++){
-        const FloatT *dataslice=&data[x+sizeX*y];
-        for(IntT z=0; z<hw; z++){
-            FloatT val=kernel[0]*dataslice[sizeXY*z];
-            for(IntT r=1;   r<=z;  r++) val+=kernel[r]*(dataslice[sizeXY*(z+r)]+dataslice[sizeXY*(z-r)]);
-            for(IntT r=z+1; r<=hw; r++) val+=kernel[r]*(dataslice[sizeXY*(z+r)]+dataslice[sizeXY*(r-z-1)]); //mirroring boundary conditions
-            fdata(x,y,z)=val;
+    gaussFIR_axis<FloatT,IntT>(data_vec.n_slices, data_vec.n_rows*data_vec.n_cols, 1, data_vec.memptr(),
+                               fdata_vec.memptr(), static_cast<IntT>(kernel_vec.n_elem)-1, kernel_vec.memptr());
+}
+
+/* Axes above the first read along a stride of whole lower-axis rows.  Rather than walking each lower-axis position
+ * through the axis, the rows are split into contiguous pencils of AxisPencilSize pixels, and each pencil is filtered
+ * for the whole axis before moving on, so the 2hw+1 pencil rows feeding an output row are reused from cache and the
+ * inner loops run with unit stride.  The per-pixel sums are accumulated in the same order as gaussFIR_1D, so every
+ * axis gives the same results as a line-by-line filter.
+ */
+static const int AxisPencilSize = 512;
+
+template <class FloatT, class IntT>
+void gaussFIR_axis(IntT size, IntT stride, IntT outer, const FloatT data[], FloatT fdata[], IntT hw, const FloatT kernel[])
+{
+    std::size_t plane=static_cast<std::size_t>(stride)*size;
+    if(size<=2*hw+1) { //Small axis: mirroring boundary conditions, skipping taps beyond a single reflection
+        for(IntT o=0; o<outer; o++) {
+            const FloatT *d=&data[o*plane];
+            FloatT *f=&fdata[o*plane];
+            for(IntT x=0; x<size; x++) for(IntT i=0; i<stride; i++) {
+                FloatT val=0.0;
+                for(IntT r=-hw; r<=hw; r++) {
+                    IntT j=x+r;
+                    if(j<-size || j>=2*size) continue; //This is beyond mirroring boundary conditions
+                    if(j<0) j=-j-1;
+                    else if(j>=size) j=2*size-j-1;
+                    val+=kernel[abs(r)]*d[static_cast<std::size_t>(j)*stride+i];
+                }
+                f[static_cast<std::size_t>(x)*stride+i]=val;
+            }
         }
-        for(IntT z=hw; z<sizeZ-hw; z++){
-            FloatT val=kernel[0]*dataslice[sizeXY*z];
-            for(IntT r=1; r<=hw; r++) val+=kernel[r]*(dataslice[sizeXY*(z-r)]+dataslice[sizeXY*(z+r)]);
-            fdata(x,y,z)=val;
+        return;
+    }
+    if(stride==1) {
+        for(IntT o=0; o<outer; o++) gaussFIR_1D(size, &data[o*plane], &fdata[o*plane], hw, kernel);
+        return;
+    }
+    for(IntT o=0; o<outer; o++) for(IntT i0=0; i0<stride; i0+=AxisPencilSize) {
+        IntT n=std::min(static_cast<IntT>(AxisPencilSize), stride-i0);
+        const FloatT *d=&data[o*plane+i0];
+        FloatT *f=&fdata[o*plane+i0];
+        auto row = [=](IntT x) { return &d[static_cast<std::size_t>(stride)*x]; };
+        for(IntT x=0; x<size; x++) {
+            FloatT *fx=&f[static_cast<std::size_t>(stride)*x];
+            const FloatT *dx=row(x);
+            for(IntT i=0; i<n; i++) fx[i]=kernel[0]*dx[i];
+            for(IntT r=1; r<=hw; r++) {
+                //Mirroring boundary conditions
+                const FloatT *dlo=row(x>=r ? x-r : r-x-1);
+                const FloatT *dhi=row(x+r<size ? x+r : 2*size-r-x-1);
+                FloatT k=kernel[r];
+                for(IntT i=0; i<n; i++) fx[i]+=k*(dlo[i]+dhi[i]);
+            }
         }
-        for(IntT z=sizeZ-hw; z<sizeZ; z++){
-            FloatT val=kernel[0]*dataslice[sizeXY*z];
-            for(IntT r=1; r<sizeZ-z; r++) val+=kernel[r]*(dataslice[sizeXY*(z-r)]+dataslice[sizeXY*(z+r)]);
-            for(IntT r=sizeZ-z; r<=hw; r++) val+=kernel[r]*(dataslice[sizeXY*(z-r)]+dataslice[sizeXY*(2*sizeZ-r-z-1)]); //mirroring boundary conditions
-            fdata(x,y,z)=val;
+    }
+}
+
+
+//A trous B-spline filters
+template <class FloatT, class IntT>
+void atrousFIR_axis(IntT size, IntT stride, IntT outer, const FloatT data[], FloatT fdata[], IntT step)
+{
+    const FloatT k0=6./16, k1=4./16, k2=1./16;
+    auto mirror = [size](IntT j) -> IntT { //Mirroring boundary conditions, reflected as often as the step needs
+        IntT period=2*size;
+        j%=period;
+        if(j<0) j+=period;
+        return j<size ? j : period-j-1;
+    };
+    if(stride==1) {
+        for(IntT o=0; o<outer; o++) {
+            const FloatT *d=&data[o*size];
+            FloatT *f=&fdata[o*size];
+            IntT x=0;
+            auto edge_val = [&](IntT x) {
+                FloatT val=k0*d[x];
+                val+=k1*(d[mirror(x-step)]+d[mirror(x+step)]);
+                val+=k2*(d[mirror(x-2*step)]+d[mirror(x+2*step)]);
+                return val;
+            };
+            for(; x<2*step && x<size; x++) f[x]=edge_val(x);
+            for(; x+2*step<size; x++) //Main Loop
+                f[x]=k0*d[x] + k1*(d[x-step]+d[x+step]) + k2*(d[x-2*step]+d[x+2*step]);
+            for(; x<size; x++) f[x]=edge_val(x);
+        }
+        return;
+    }
+    //Higher axes filter whole contiguous rows of the lower axes at a time
+    IntT plane=stride*size;
+    const IntT deltas[4]={-step, step, -2*step, 2*step};
+    const FloatT weights[4]={k1, k1, k2, k2};
+    for(IntT o=0; o<outer; o++) {
+        const FloatT *d=&data[o*plane];
+        FloatT *f=&fdata[o*plane];
+        for(IntT x=0; x<size; x++) {
+            FloatT *frow=&f[x*stride];
+            const FloatT *drow=&d[x*stride];
+            for(IntT i=0; i<stride; i++) frow[i]=k0*drow[i];
+            for(int t=0; t<4; t++) {
+                IntT m=mirror(x+deltas[t]);
+                const FloatT *mrow=&d[m*stride];
+                for(IntT i=0; i<stride; i++) frow[i]+=weights[t]*mrow[i];
+            }
         }
     }
 }
 
+template <class FloatT, class IntT>
+void atrousFIR_2Dx(const arma::Mat<FloatT> &data, arma::Mat<FloatT> &fdata, IntT step)
+{
+    atrousFIR_axis<FloatT,IntT>(data.n_rows, 1, data.n_cols, data.memptr(), fdata.memptr(), step);
+}
+
+template <class FloatT, class IntT>
+void atrousFIR_2Dy(const arma::Mat<FloatT> &data, arma::Mat<FloatT> &fdata, IntT step)
+{
+    atrousFIR_axis<FloatT,IntT>(data.n_cols, data.n_rows, 1, data.memptr(), fdata.memptr(), step);
+}
+
+template <class FloatT, class IntT>
+void atrousFIR_3Dx(const arma::Cube<FloatT> &data, arma::Cube<FloatT> &fdata, IntT step)
+{
+    atrousFIR_axis<FloatT,IntT>(data.n_rows, 1, data.n_cols*data.n_slices, data.memptr(), fdata.memptr(), step);
+}
+
+template <class FloatT, class IntT>
+void atrousFIR_3Dy(const arma::Cube<FloatT> &data, arma::Cube<FloatT> &fdata, IntT step)
+{
+    atrousFIR_axis<FloatT,IntT>(data.n_cols, data.n_rows, data.n_slices, data.memptr(), fdata.memptr(), step);
+}
+
+template <class FloatT, class IntT>
+void atrousFIR_3Dz(const arma::Cube<FloatT> &data, arma::Cube<FloatT> &fdata, IntT step)
+{
+    atrousFIR_axis<FloatT,IntT>(data.n_slices, data.n_rows*data.n_cols, 1, data.memptr(), fdata.memptr(), step);
+}
+
+//Odd FIR filters
+template <class FloatT, class IntT>
+void oddFIR_axis(IntT size, IntT stride, IntT outer, const FloatT data[], FloatT fdata[], IntT hw, const FloatT kernel[])
+{
+    auto mirror = [size](IntT j) -> IntT { //Mirroring boundary conditions, reflected as often as the kernel needs
+        IntT period=2*size;
+        j%=period;
+        if(j<0) j+=period;
+        return j<size ? j : period-j-1;
+    };
+    if(stride==1) {
+        for(IntT o=0; o<outer; o++) {
+            const FloatT *d=&data[o*size];
+            FloatT *f=&fdata[o*size];
+            IntT x=0;
+            auto edge_val = [&](IntT x) {
+                FloatT val=0;
+                for(IntT r=1; r<=hw; r++) val+=kernel[r]*(d[mirror(x+r)]-d[mirror(x-r)]);
+                return val;
+            };
+            for(; x<hw && x<size; x++) f[x]+=edge_val(x);
+            for(; x+hw<size; x++) { //Main Loop
+                FloatT val=0;
+                for(IntT r=1; r<=hw; r++) val+=kernel[r]*(d[x+r]-d[x-r]);
+                f[x]+=val;
+            }
+            for(; x<size; x++) f[x]+=edge_val(x);
+        }
+        return;
+    }
+    //Higher axes filter whole contiguous rows of the lower axes at a time
+    IntT plane=stride*size;
+    for(IntT o=0; o<outer; o++) {
+        const FloatT *d=&data[o*plane];
+        FloatT *f=&fdata[o*plane];
+        for(IntT x=0; x<size; x++) {
+            FloatT *frow=&f[x*stride];
+            for(IntT r=1; r<=hw; r++) {
+                const FloatT *prow=&d[mirror(x+r)*stride];
+                const FloatT *mrow=&d[mirror(x-r)*stride];
+                for(IntT i=0; i<stride; i++) frow[i]+=kernel[r]*(prow[i]-mrow[i]);
+            }
+        }
+    }
+}
+
+template <class FloatT, class IntT>
+void oddFIR_2Dx(const arma::Mat<FloatT> &data, arma::Mat<FloatT> &fdata, const arma::Col<FloatT> &kernel)
+{
+    oddFIR_axis<FloatT,IntT>(data.n_rows, 1, data.n_cols, data.memptr(), fdata.memptr(),
+                             static_cast<IntT>(kernel.n_elem)-1, kernel.memptr());
+}
+
+template <class FloatT, class IntT>
+void oddFIR_2Dy(const arma::Mat<FloatT> &data, arma::Mat<FloatT> &fdata, const arma::Col<FloatT> &kernel)
+{
+    oddFIR_axis<FloatT,IntT>(data.n_cols, data.n_rows, 1, data.memptr(), fdata.memptr(),
+                             static_cast<IntT>(kernel.n_elem)-1, kernel.memptr());
+}
+
+template <class FloatT, class IntT>
+void oddFIR_3Dx(const arma::Cube<FloatT> &data, arma::Cube<FloatT> &fdata, const arma::Col<FloatT> &kernel)
+{
+    oddFIR_axis<FloatT,IntT>(data.n_rows, 1, data.n_cols*data.n_slices, data.memptr(), fdata.memptr(),
+                             static_cast<IntT>(kernel.n_elem)-1, kernel.memptr());
+}
+
+template <class FloatT, class IntT>
+void oddFIR_3Dy(const arma::Cube<FloatT> &data, arma::Cube<FloatT> &fdata, const arma::Col<FloatT> &kernel)
+{
+    oddFIR_axis<FloatT,IntT>(data.n_cols, data.n_rows, data.n_slices, data.memptr(), fdata.memptr(),
+                             static_cast<IntT>(kernel.n_elem)-1, kernel.memptr());
+}
+
+template <class FloatT, class IntT>
+void oddFIR_3Dz(const arma::Cube<FloatT> &data, arma::Cube<FloatT> &fdata, const arma::Col<FloatT> &kernel)
+{
+    oddFIR_axis<FloatT,IntT>(data.n_slices, data.n_rows*data.n_cols, 1, data.memptr(), fdata.memptr(),
+                             static_cast<IntT>(kernel.n_elem)-1, kernel.memptr());
+}
 
 /* Explicit Template Instantiations */
 /* 1D Gauss FIR Filters */
@@ -635,6 +732,47 @@ template void gaussFIR_3Dz<double>(const arma::Cube<double> &data, arma::Cube<do
 template void gaussFIR_3Dz_small<float>(const arma::Cube<float> &data, arma::Cube<float> &fdata, const arma::Col<float> &kernel);
 template void gaussFIR_3Dz_small<double>(const arma::Cube<double> &data, arma::Cube<double> &fdata, const arma::Col<double> &kernel);
 
+template void gaussFIR_axis<float>(int32_t size, int32_t stride, int32_t outer, const float data[], float fdata[], int32_t hw, const float kernel[]);
+template void gaussFIR_axis<double>(int32_t size, int32_t stride, int32_t outer, const double data[], double fdata[], int32_t hw, const double kernel[]);
+
+/* A trous B-spline FIR Filters */
+template void atrousFIR_axis<float>(int32_t size, int32_t stride, int32_t outer, const float data[], float fdata[], int32_t step);
+template void atrousFIR_axis<double>(int32_t size, int32_t stride, int32_t outer, const double data[], double fdata[], int32_t step);
+
+template void atrousFIR_2Dx<float>(const arma::Mat<float> &data, arma::Mat<float> &fdata, int32_t step);
+template void atrousFIR_2Dx<double>(const arma::Mat<double> &data, arma::Mat<double> &fdata, int32_t step);
+
+template void atrousFIR_2Dy<float>(const arma::Mat<float> &data, arma::Mat<float> &fdata, int32_t step);
+template void atrousFIR_2Dy<double>(const arma::Mat<double> &data, arma::Mat<double> &fdata, int32_t step);
+
+template void atrousFIR_3Dx<float>(const arma::Cube<float> &data, arma::Cube<float> &fdata, int32_t step);
+template void atrousFIR_3Dx<double>(const arma::Cube<double> &data, arma::Cube<double> &fdata, int32_t step);
+
+template void atrousFIR_3Dy<float>(const arma::Cube<float> &data, arma::Cube<float> &fdata, int32_t step);
+template void atrousFIR_3Dy<double>(const arma::Cube<double> &data, arma::Cube<double> &fdata, int32_t step);
+
+template void atrousFIR_3Dz<float>(const arma::Cube<float> &data, arma::Cube<float> &fdata, int32_t step);
+template void atrousFIR_3Dz<double>(const arma::Cube<double> &data, arma::Cube<double> &fdata, int32_t step);
+
+/* Odd FIR Filters */
+template void oddFIR_axis<float>(int32_t size, int32_t stride, int32_t outer, const float data[], float fdata[], int32_t hw, const float kernel[]);
+template void oddFIR_axis<double>(int32_t size, int32_t stride, int32_t outer, const double data[], double fdata[], int32_t hw, const double kernel[]);
+
+template void oddFIR_2Dx<float>(const arma::Mat<float> &data, arma::Mat<float> &fdata, const arma::Col<float> &kernel);
+template void oddFIR_2Dx<double>(const arma::Mat<double> &data, arma::Mat<double> &fdata, const arma::Col<double> &kernel);
+
+template void oddFIR_2Dy<float>(const arma::Mat<float> &data, arma::Mat<float> &fdata, const arma::Col<float> &kernel);
+template void oddFIR_2Dy<double>(const arma::Mat<double> &data, arma::Mat<double> &fdata, const arma::Col<double> &kernel);
+
+template void oddFIR_3Dx<float>(const arma::Cube<float> &data, arma::Cube<float> &fdata, const arma::Col<float> &kernel);
+template void oddFIR_3Dx<double>(const arma::Cube<double> &data, arma::Cube<double> &fdata, const arma::Col<double> &kernel);
+
+template void oddFIR_3Dy<float>(const arma::Cube<float> &data, arma::Cube<float> &fdata, const arma::Col<float> &kernel);
+template void oddFIR_3Dy<double>(const arma::Cube<double> &data, arma::Cube<double> &fdata, const arma::Col<double> &kernel);
+
+template void oddFIR_3Dz<float>(const arma::Cube<float> &data, arma::Cube<float> &fdata, const arma::Col<float> &kernel);
+template void oddFIR_3Dz<double>(const arma::Cube<double> &data, arma::Cube<double> &fdata, const arma::Col<double> &kernel);
+
 } /* namespace boxxer::kernels */
 
 } /* namespace boxxer */
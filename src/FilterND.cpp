@@ -0,0 +1,131 @@
+/**
+ * @file FilterND.cpp
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The class definitions for FilterND, the rank-templated separable Gauss, DoG, and LoG filters.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include "Boxxer/BoxxerError.h"
+#include "Boxxer/FilterKernels.h"
+#include "Boxxer/GaussFilter.h"
+#include "Boxxer/FilterND.h"
+
+namespace boxxer {
+
+template<int Rank, class FloatT, class IdxT>
+const FloatT FilterND<Rank,FloatT,IdxT>::DefaultSigmaRatio = 1.1;
+
+template<int Rank, class FloatT, class IdxT>
+FilterND<Rank,FloatT,IdxT>::FilterND(const SizeT &size, const SigmaT &sigma, FloatT sigma_ratio)
+    : size(size), sigma(sigma), sigma_ratio(sigma_ratio)
+{
+    for(int d=0; d<Rank; d++) hw[d] = static_cast<IdxT>(std::ceil(3*sigma[d]));
+    initialize();
+}
+
+template<int Rank, class FloatT, class IdxT>
+FilterND<Rank,FloatT,IdxT>::FilterND(const SizeT &size, const SigmaT &sigma, const SizeT &kernel_hw,
+                                     FloatT sigma_ratio)
+    : size(size), sigma(sigma), hw(kernel_hw), sigma_ratio(sigma_ratio)
+{
+    initialize();
+}
+
+template<int Rank, class FloatT, class IdxT>
+void FilterND<Rank,FloatT,IdxT>::initialize()
+{
+    std::size_t N = 1;
+    for(int d=0; d<Rank; d++) {
+        if(size[d]==0 || !(sigma[d]>0) || hw[d]==0) {
+            std::ostringstream msg;
+            msg<<"Got bad axis "<<d<<" size: "<<size[d]<<" sigma: "<<sigma[d]<<" hw: "<<hw[d];
+            throw ParameterValueError(msg.str());
+        }
+        N *= size[d];
+    }
+    if(!(sigma_ratio>1)) {
+        std::ostringstream msg;
+        msg<<"Received bad sigma_ratio: "<<sigma_ratio;
+        throw ParameterValueError(msg.str());
+    }
+    for(int d=0; d<Rank; d++) {
+        gauss_kernels[d] = GaussFIRFilter<FloatT,IdxT>::compute_Gauss_FIR_kernel(sigma[d], hw[d]);
+        inhibit_kernels[d] = GaussFIRFilter<FloatT,IdxT>::compute_Gauss_FIR_kernel(sigma[d]*sigma_ratio, hw[d]);
+        LoG_kernels[d] = GaussFIRFilter<FloatT,IdxT>::compute_LoG_FIR_kernel(sigma[d], hw[d]);
+    }
+    temp_im0.resize(N);
+    temp_im1.resize(N);
+    temp_im2.resize(N);
+}
+
+template<int Rank, class FloatT, class IdxT>
+void FilterND<Rank,FloatT,IdxT>::filter_axis(const SizeT &size, int axis, const FloatT *data, FloatT *fdata,
+                                             const VecT &kernel)
+{
+    int32_t stride = 1, outer = 1;
+    for(int d=0; d<axis; d++) stride *= static_cast<int32_t>(size[d]);
+    for(int d=axis+1; d<Rank; d++) outer *= static_cast<int32_t>(size[d]);
+    kernels::gaussFIR_axis<FloatT>(static_cast<int32_t>(size[axis]), stride, outer, data, fdata,
+                                   static_cast<int32_t>(kernel.n_elem)-1, kernel.memptr());
+}
+
+template<int Rank, class FloatT, class IdxT>
+void FilterND<Rank,FloatT,IdxT>::separable(const FloatT *im, FloatT *out, const std::array<const VecT*,Rank> &kernels,
+                                           bool descending)
+{
+    const FloatT *src = im;
+    for(int p=0; p<Rank; p++) {
+        int axis = descending ? Rank-1-p : p;
+        FloatT *dst = p==Rank-1 ? out : (p%2 ? temp_im1.data() : temp_im0.data());
+        filter_axis(size, axis, src, dst, *kernels[axis]);
+        src = dst;
+    }
+}
+
+template<int Rank, class FloatT, class IdxT>
+void FilterND<Rank,FloatT,IdxT>::gauss(const FloatT *im, FloatT *out)
+{
+    std::array<const VecT*,Rank> kern;
+    for(int d=0; d<Rank; d++) kern[d] = &gauss_kernels[d];
+    separable(im, out, kern, false);
+}
+
+template<int Rank, class FloatT, class IdxT>
+void FilterND<Rank,FloatT,IdxT>::DoG(const FloatT *im, FloatT *out)
+{
+    std::array<const VecT*,Rank> kern;
+    for(int d=0; d<Rank; d++) kern[d] = &gauss_kernels[d];
+    separable(im, out, kern, false);
+    for(int d=0; d<Rank; d++) kern[d] = &inhibit_kernels[d];
+    separable(im, temp_im2.data(), kern, false);
+    std::size_t N = nelem();
+    for(std::size_t i=0; i<N; i++) out[i] -= temp_im2[i];
+}
+
+template<int Rank, class FloatT, class IdxT>
+void FilterND<Rank,FloatT,IdxT>::LoG(const FloatT *im, FloatT *out)
+{
+    std::size_t N = nelem();
+    for(int d=0; d<Rank; d++) {
+        std::array<const VecT*,Rank> kern;
+        for(int a=0; a<Rank; a++) kern[a] = a==d ? &LoG_kernels[a] : &gauss_kernels[a];
+        if(d==0) {
+            separable(im, out, kern, true);
+        } else {
+            separable(im, temp_im2.data(), kern, true);
+            for(std::size_t i=0; i<N; i++) out[i] += temp_im2[i];
+        }
+    }
+}
+
+/* Explicit Template Instantiation */
+template class FilterND<2,float>;
+template class FilterND<2,double>;
+template class FilterND<3,float>;
+template class FilterND<3,double>;
+template class FilterND<4,float>;
+template class FilterND<4,double>;
+
+} /* namespace boxxer */
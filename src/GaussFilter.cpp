@@ -5,6 +5,7 @@
  *
  */
 
+#include <cmath>
 #include <limits>
 #include <iomanip>
 
@@ -14,6 +15,53 @@
 
 namespace boxxer {
 
+namespace {
+/**
+ * Correlation of a separable kernel with a column-major image at a single pixel, using the same mirror boundary
+ * as the FIR kernels.  Half-kernels are symmetric, or antisymmetric (k(-r)=-k(r)) when odd[d].
+ */
+template<class FloatT>
+FloatT point_correlate(const FloatT *data, const int size[3], const int pos[3],
+                       const FloatT *kern[3], const int hw[3], const bool odd[3])
+{
+    auto mirror = [](int j, int n) -> int {
+        if(j<0) return j>=-n ? -j-1 : -1;
+        if(j>=n) return j<2*n ? 2*n-j-1 : -1;
+        return j;
+    };
+    auto weight = [&](int d, int r) -> FloatT {
+        FloatT w = kern[d][r<0 ? -r : r];
+        return (odd[d] && r<0) ? -w : w;
+    };
+    FloatT val = 0;
+    for(int k=-hw[2]; k<=hw[2]; k++) {
+        int z = mirror(pos[2]+k, size[2]);
+        if(z<0) continue;
+        FloatT wz = weight(2,k);
+        for(int j=-hw[1]; j<=hw[1]; j++) {
+            int y = mirror(pos[1]+j, size[1]);
+            if(y<0) continue;
+            FloatT wyz = wz*weight(1,j);
+            const FloatT *col = &data[size[0]*(y+size[1]*z)];
+            for(int i=-hw[0]; i<=hw[0]; i++) {
+                int x = mirror(pos[0]+i, size[0]);
+                if(x>=0) val += wyz*weight(0,i)*col[x];
+            }
+        }
+    }
+    return val;
+}
+
+/** out[k*stride] = a[k] + sign*b[k].  The final combine of a multi-term filter written straight into a strided
+ * output, with the same single rounding as the planar out+=b or out-=b. */
+template<class FloatT, class IdxT>
+void combine_strided(const FloatT *a, const FloatT *b, FloatT sign, std::size_t n, FloatT *out, IdxT stride)
+{
+    if(sign>0) for(std::size_t k=0; k<n; k++) out[k*stride] = a[k]+b[k];
+    else for(std::size_t k=0; k<n; k++) out[k*stride] = a[k]-b[k];
+}
+} /* namespace */
+
 /* GaussFIRFilter */
 
 template<class FloatT, class IdxT>
@@ -52,6 +100,16 @@ GaussFIRFilter<FloatT,IdxT>::GaussFIRFilter(IdxT dim_, const IVecT &size_, const
     }
 }
 
+/**
+ * The kernel half-width used by the filters when no explicit half-width is given: ceil(3*sigma)
+ */
+template<class FloatT, class IdxT>
+typename GaussFIRFilter<FloatT,IdxT>::IVecT
+GaussFIRFilter<FloatT,IdxT>::default_kernel_hw(const VecT &sigma)
+{
+    return arma::conv_to<IVecT>::from(arma::ceil(default_sigma_hw_ratio * sigma));
+}
+
 template<class FloatT, class IdxT>
 typename GaussFIRFilter<FloatT,IdxT>::VecT
 GaussFIRFilter<FloatT,IdxT>::compute_Gauss_FIR_kernel(FloatT sigma, IdxT hw)
@@ -91,6 +149,22 @@ GaussFIRFilter<FloatT,IdxT>::compute_LoG_FIR_kernel(FloatT sigma, IdxT hw)
     return arma::conv_to<VecT>::from(kernel);
 }
 
+/**
+ * Right half + center of the first derivative of the normalized Gaussian, G'(r) = -r/sigma^2*G(r).
+ * The kernel is antisymmetric so it is only used for point evaluations, not by the symmetric gaussFIR_* passes.
+ */
+template<class FloatT, class IdxT>
+typename GaussFIRFilter<FloatT,IdxT>::VecT
+GaussFIRFilter<FloatT,IdxT>::compute_dGauss_FIR_kernel(FloatT sigma, IdxT hw)
+{
+    IdxT W=hw+1;
+    arma::vec kernel(W);
+    double sigmanorm=1./(sigma*sigma);
+    double norm=1./(sqrt(2*arma::Datum<double>::pi)*sigma);
+    for(IdxT r=0; r<W; r++) kernel(r)=-norm*r*sigmanorm*exp(-0.5*r*r*sigmanorm);
+    return arma::conv_to<VecT>::from(kernel);
+}
+
 /* GaussFilter2D */
 
 template<class FloatT, class IdxT>
@@ -309,6 +383,18 @@ void DoGFilter2D<FloatT,IdxT>::filter(const ImageT &im, ImageT &out)
     out-=temp_im0;
 }
 
+template<class FloatT, class IdxT>
+void DoGFilter2D<FloatT,IdxT>::filter(const ImageT &im, FloatT *out, IdxT stride)
+{
+    temp_im2.set_size(this->size(0),this->size(1));
+    kernels::gaussFIR_2Dx<FloatT>(im, temp_im0, excite_kernels(0));
+    kernels::gaussFIR_2Dy<FloatT>(temp_im0, temp_im1, excite_kernels(1));
+
+    kernels::gaussFIR_2Dx<FloatT>(im, temp_im0, inhibit_kernels(0));
+    kernels::gaussFIR_2Dy<FloatT>(temp_im0, temp_im2, inhibit_kernels(1));
+    combine_strided(temp_im1.memptr(), temp_im2.memptr(), FloatT(-1), temp_im1.n_elem, out, stride);
+}
+
 template<class FloatT, class IdxT>
 void DoGFilter2D<FloatT,IdxT>::test_filter(const ImageT &im)
 {
@@ -398,6 +484,22 @@ void DoGFilter3D<FloatT,IdxT>::filter(const ImageT &im, ImageT &out)
     out-=temp_im0;
 }
 
+template<class FloatT, class IdxT>
+void DoGFilter3D<FloatT,IdxT>::filter(const ImageT &im, FloatT *const slice_out[], IdxT stride)
+{
+    temp_im2.set_size(this->size(0),this->size(1),this->size(2));
+    kernels::gaussFIR_3Dx<FloatT>(im, temp_im0, excite_kernels(0));
+    kernels::gaussFIR_3Dy<FloatT>(temp_im0, temp_im1, excite_kernels(1));
+    kernels::gaussFIR_3Dz<FloatT>(temp_im1, temp_im2, excite_kernels(2));
+
+    kernels::gaussFIR_3Dx<FloatT>(im, temp_im0, inhibit_kernels(0));
+    kernels::gaussFIR_3Dy<FloatT>(temp_im0, temp_im1, inhibit_kernels(1));
+    kernels::gaussFIR_3Dz<FloatT>(temp_im1, temp_im0, inhibit_kernels(2));
+    for(IdxT z=0; z<this->size(2); z++)
+        combine_strided(temp_im2.slice_memptr(z), temp_im0.slice_memptr(z), FloatT(-1), temp_im2.n_elem_slice,
+                        slice_out[z], stride);
+}
+
 template<class FloatT, class IdxT>
 void DoGFilter3D<FloatT,IdxT>::test_filter(const ImageT &im)
 {
@@ -423,7 +525,7 @@ void DoGFilter3D<FloatT,IdxT>::test_filter(const ImageT &im)
 
 template<class FloatT, class IdxT>
 LoGFilter2D<FloatT,IdxT>::LoGFilter2D(const IVecT &size, const VecT &sigma)
-    : GaussFIRFilter<FloatT,IdxT>(2, size, sigma), gauss_kernels(2), LoG_kernels(2)
+    : GaussFIRFilter<FloatT,IdxT>(2, size, sigma), gauss_kernels(2), LoG_kernels(2), dgauss_kernels(2)
 {
     auto hw=arma::conv_to<IVecT>::from(arma::ceil(this->default_sigma_hw_ratio * sigma));
     set_kernel_hw(hw);
@@ -433,7 +535,7 @@ LoGFilter2D<FloatT,IdxT>::LoGFilter2D(const IVecT &size, const VecT &sigma)
 
 template<class FloatT, class IdxT>
 LoGFilter2D<FloatT,IdxT>::LoGFilter2D(const IVecT &size, const VecT &sigma, const IVecT &kernel_hw)
-    : GaussFIRFilter<FloatT,IdxT>(2, size, sigma), gauss_kernels(2), LoG_kernels(2)
+    : GaussFIRFilter<FloatT,IdxT>(2, size, sigma), gauss_kernels(2), LoG_kernels(2), dgauss_kernels(2)
 {
     set_kernel_hw(kernel_hw);
     temp_im0.set_size(size(0),size(1));
@@ -453,6 +555,7 @@ void LoGFilter2D<FloatT,IdxT>::set_kernel_hw(const IVecT &kernel_half_width)
     for(IdxT d=0; d<this->dim; d++) {
         gauss_kernels(d)=GaussFIRFilter<FloatT,IdxT>::compute_Gauss_FIR_kernel(this->sigma(d), this->hw(d));
         LoG_kernels(d)=GaussFIRFilter<FloatT,IdxT>::compute_LoG_FIR_kernel(this->sigma(d), this->hw(d));
+        dgauss_kernels(d)=GaussFIRFilter<FloatT,IdxT>::compute_dGauss_FIR_kernel(this->sigma(d), this->hw(d));
     }
 }
 
@@ -477,6 +580,62 @@ void LoGFilter2D<FloatT,IdxT>::filter(const ImageT &im, ImageT &out)
 //     out = (out%temp_im1)+temp_im0;
 }
 
+template<class FloatT, class IdxT>
+void LoGFilter2D<FloatT,IdxT>::filter(const ImageT &im, ImageT &out, ImageT &dxx)
+{
+    kernels::gaussFIR_2Dy<FloatT>(im, temp_im0, LoG_kernels(1)); //G''(y)
+    kernels::gaussFIR_2Dx<FloatT>(temp_im0, out, gauss_kernels(0)); //G(x)
+
+    kernels::gaussFIR_2Dy<FloatT>(im, temp_im0, gauss_kernels(1)); //G(y)
+    kernels::gaussFIR_2Dx<FloatT>(temp_im0, dxx, LoG_kernels(0)); //G''(x)
+    out+=dxx;
+}
+
+template<class FloatT, class IdxT>
+void LoGFilter2D<FloatT,IdxT>::filter(const ImageT &im, FloatT *out, IdxT stride)
+{
+    temp_im2.set_size(this->size(0),this->size(1));
+    kernels::gaussFIR_2Dy<FloatT>(im, temp_im0, LoG_kernels(1)); //G''(y)
+    kernels::gaussFIR_2Dx<FloatT>(temp_im0, temp_im1, gauss_kernels(0)); //G(x)
+
+    kernels::gaussFIR_2Dy<FloatT>(im, temp_im0, gauss_kernels(1)); //G(y)
+    kernels::gaussFIR_2Dx<FloatT>(temp_im0, temp_im2, LoG_kernels(0)); //G''(x)
+    combine_strided(temp_im1.memptr(), temp_im2.memptr(), FloatT(1), temp_im1.n_elem, out, stride);
+}
+
+/**
+ * The cross term is only needed at maxima so it is evaluated directly, costing (2hw+1)^2 per pixel.
+ */
+template<class FloatT, class IdxT>
+FloatT LoGFilter2D<FloatT,IdxT>::hessian_cross(const ImageT &im, IdxT x, IdxT y) const
+{
+    int size[3] = {static_cast<int>(im.n_rows), static_cast<int>(im.n_cols), 1};
+    int pos[3] = {static_cast<int>(x), static_cast<int>(y), 0};
+    FloatT one = 1;
+    const FloatT *kern[3] = {dgauss_kernels(0).memptr(), dgauss_kernels(1).memptr(), &one};
+    int hw[3] = {static_cast<int>(this->hw(0)), static_cast<int>(this->hw(1)), 0};
+    bool odd[3] = {true, true, false};
+    return -std::sqrt(this->sigma(0)*this->sigma(1)) * point_correlate(im.memptr(), size, pos, kern, hw, odd);
+}
+
+template<class FloatT, class IdxT>
+FloatT LoGFilter2D<FloatT,IdxT>::gradient_norm(const ImageT &im, IdxT x, IdxT y) const
+{
+    int size[3] = {static_cast<int>(im.n_rows), static_cast<int>(im.n_cols), 1};
+    int pos[3] = {static_cast<int>(x), static_cast<int>(y), 0};
+    FloatT one = 1;
+    int hw[3] = {static_cast<int>(this->hw(0)), static_cast<int>(this->hw(1)), 0};
+    FloatT norm2 = 0;
+    for(int d=0; d<2; d++) {
+        const FloatT *kern[3] = {gauss_kernels(0).memptr(), gauss_kernels(1).memptr(), &one};
+        kern[d] = dgauss_kernels(d).memptr();
+        bool odd[3] = {d==0, d==1, false};
+        FloatT g = this->sigma(d) * point_correlate(im.memptr(), size, pos, kern, hw, odd);
+        norm2 += g*g;
+    }
+    return std::sqrt(norm2);
+}
+
 template<class FloatT, class IdxT>
 void LoGFilter2D<FloatT,IdxT>::test_filter(const ImageT &im)
 {
@@ -520,7 +679,7 @@ std::ostream& operator<< (std::ostream &out, const LoGFilter2D<FloatT,IdxT> &fil
 
 template<class FloatT, class IdxT>
 LoGFilter3D<FloatT,IdxT>::LoGFilter3D(const IVecT &size, const VecT &sigma)
-    : GaussFIRFilter<FloatT,IdxT>(3, size, sigma), gauss_kernels(3), LoG_kernels(3)
+    : GaussFIRFilter<FloatT,IdxT>(3, size, sigma), gauss_kernels(3), LoG_kernels(3), dgauss_kernels(3)
 {
     auto hw=arma::conv_to<IVecT>::from(arma::ceil(this->default_sigma_hw_ratio * sigma));
     set_kernel_hw(hw);
@@ -531,7 +690,7 @@ LoGFilter3D<FloatT,IdxT>::LoGFilter3D(const IVecT &size, const VecT &sigma)
 
 template<class FloatT, class IdxT>
 LoGFilter3D<FloatT,IdxT>::LoGFilter3D(const IVecT &size, const VecT &sigma, const IVecT &kernel_hw)
-    : GaussFIRFilter<FloatT,IdxT>(3, size, sigma), gauss_kernels(3), LoG_kernels(3)
+    : GaussFIRFilter<FloatT,IdxT>(3, size, sigma), gauss_kernels(3), LoG_kernels(3), dgauss_kernels(3)
 {
     set_kernel_hw(kernel_hw);
     temp_im0.set_size(size(0),size(1),size(2));
@@ -552,6 +711,7 @@ void LoGFilter3D<FloatT,IdxT>::set_kernel_hw(const IVecT &kernel_half_width)
     for(IdxT d=0; d<this->dim; d++) {
         gauss_kernels(d)=GaussFIRFilter<FloatT,IdxT>::compute_Gauss_FIR_kernel(this->sigma(d), this->hw(d));
         LoG_kernels(d)=GaussFIRFilter<FloatT,IdxT>::compute_LoG_FIR_kernel(this->sigma(d), this->hw(d));
+        dgauss_kernels(d)=GaussFIRFilter<FloatT,IdxT>::compute_dGauss_FIR_kernel(this->sigma(d), this->hw(d));
     }
 }
 
@@ -590,6 +750,86 @@ void LoGFilter3D<FloatT,IdxT>::filter(const ImageT &im, ImageT &out)
 //     out += temp_im0%temp_im1;
 }
 
+template<class FloatT, class IdxT>
+void LoGFilter3D<FloatT,IdxT>::filter(const ImageT &im, ImageT &out, ImageT &dxx, ImageT &dyy)
+{
+    kernels::gaussFIR_3Dz<FloatT>(im, temp_im0, gauss_kernels(2));
+    kernels::gaussFIR_3Dy<FloatT>(temp_im0, temp_im1, gauss_kernels(1));
+    kernels::gaussFIR_3Dx<FloatT>(temp_im1, dxx, LoG_kernels(0));
+
+    kernels::gaussFIR_3Dz<FloatT>(im, temp_im0, gauss_kernels(2));
+    kernels::gaussFIR_3Dy<FloatT>(temp_im0, temp_im1, LoG_kernels(1));
+    kernels::gaussFIR_3Dx<FloatT>(temp_im1, dyy, gauss_kernels(0));
+
+    //Sum in the same order as filter(im,out) so the response is identical
+    out=dxx;
+    out+=dyy;
+    kernels::gaussFIR_3Dz<FloatT>(im, temp_im0, LoG_kernels(2));
+    kernels::gaussFIR_3Dy<FloatT>(temp_im0, temp_im1, gauss_kernels(1));
+    kernels::gaussFIR_3Dx<FloatT>(temp_im1, temp_im0, gauss_kernels(0));
+    out+=temp_im0;
+}
+
+template<class FloatT, class IdxT>
+void LoGFilter3D<FloatT,IdxT>::filter(const ImageT &im, FloatT *const slice_out[], IdxT stride)
+{
+    temp_im2.set_size(this->size(0),this->size(1),this->size(2));
+    kernels::gaussFIR_3Dz<FloatT>(im, temp_im0, gauss_kernels(2));
+    kernels::gaussFIR_3Dy<FloatT>(temp_im0, temp_im1, gauss_kernels(1));
+    kernels::gaussFIR_3Dx<FloatT>(temp_im1, temp_im2, LoG_kernels(0));
+
+    kernels::gaussFIR_3Dz<FloatT>(im, temp_im0, gauss_kernels(2));
+    kernels::gaussFIR_3Dy<FloatT>(temp_im0, temp_im1, LoG_kernels(1));
+    kernels::gaussFIR_3Dx<FloatT>(temp_im1, temp_im0, gauss_kernels(0));
+    temp_im2+=temp_im0;
+
+    kernels::gaussFIR_3Dz<FloatT>(im, temp_im0, LoG_kernels(2));
+    kernels::gaussFIR_3Dy<FloatT>(temp_im0, temp_im1, gauss_kernels(1));
+    kernels::gaussFIR_3Dx<FloatT>(temp_im1, temp_im0, gauss_kernels(0));
+    for(IdxT z=0; z<this->size(2); z++)
+        combine_strided(temp_im2.slice_memptr(z), temp_im0.slice_memptr(z), FloatT(1), temp_im2.n_elem_slice,
+                        slice_out[z], stride);
+}
+
+template<class FloatT, class IdxT>
+typename LoGFilter3D<FloatT,IdxT>::VecT
+LoGFilter3D<FloatT,IdxT>::hessian_cross(const ImageT &im, IdxT x, IdxT y, IdxT z) const
+{
+    int size[3] = {static_cast<int>(im.n_rows), static_cast<int>(im.n_cols), static_cast<int>(im.n_slices)};
+    int pos[3] = {static_cast<int>(x), static_cast<int>(y), static_cast<int>(z)};
+    int hw[3] = {static_cast<int>(this->hw(0)), static_cast<int>(this->hw(1)), static_cast<int>(this->hw(2))};
+    const IdxT pairs[3][2] = {{0,1}, {0,2}, {1,2}};
+    VecT cross(3);
+    for(int p=0; p<3; p++) {
+        const FloatT *kern[3] = {gauss_kernels(0).memptr(), gauss_kernels(1).memptr(), gauss_kernels(2).memptr()};
+        bool odd[3] = {false, false, false};
+        for(auto d: pairs[p]) {
+            kern[d] = dgauss_kernels(d).memptr();
+            odd[d] = true;
+        }
+        FloatT norm = std::sqrt(this->sigma(pairs[p][0])*this->sigma(pairs[p][1]));
+        cross(p) = -norm * point_correlate(im.memptr(), size, pos, kern, hw, odd);
+    }
+    return cross;
+}
+
+template<class FloatT, class IdxT>
+FloatT LoGFilter3D<FloatT,IdxT>::gradient_norm(const ImageT &im, IdxT x, IdxT y, IdxT z) const
+{
+    int size[3] = {static_cast<int>(im.n_rows), static_cast<int>(im.n_cols), static_cast<int>(im.n_slices)};
+    int pos[3] = {static_cast<int>(x), static_cast<int>(y), static_cast<int>(z)};
+    int hw[3] = {static_cast<int>(this->hw(0)), static_cast<int>(this->hw(1)), static_cast<int>(this->hw(2))};
+    FloatT norm2 = 0;
+    for(int d=0; d<3; d++) {
+        const FloatT *kern[3] = {gauss_kernels(0).memptr(), gauss_kernels(1).memptr(), gauss_kernels(2).memptr()};
+        kern[d] = dgauss_kernels(d).memptr();
+        bool odd[3] = {d==0, d==1, d==2};
+        FloatT g = this->sigma(d) * point_correlate(im.memptr(), size, pos, kern, hw, odd);
+        norm2 += g*g;
+    }
+    return std::sqrt(norm2);
+}
+
 template<class FloatT, class IdxT>
 void LoGFilter3D<FloatT,IdxT>::test_filter(const ImageT &im)
 {
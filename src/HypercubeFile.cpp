@@ -0,0 +1,320 @@
+/**
+ * @file HypercubeFile.cpp
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The HypercubeFile class definition
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+#include <fcntl.h>
+#include <omp.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Boxxer/BoxxerError.h"
+#include "Boxxer/HypercubeFile.h"
+
+namespace boxxer {
+
+namespace {
+/* IEEE half-precision conversion with round to nearest even */
+uint16_t float_to_half(float f)
+{
+    uint32_t x;
+    std::memcpy(&x, &f, sizeof(x));
+    uint32_t sign = (x>>16) & 0x8000;
+    uint32_t mant = x & 0x7fffff;
+    int32_t exp = static_cast<int32_t>((x>>23) & 0xff);
+    if(exp==0xff) return static_cast<uint16_t>(sign | 0x7c00 | (mant ? 0x200 : 0)); //Inf or NaN
+    int32_t e = exp - 127 + 15;
+    if(e>=0x1f) return static_cast<uint16_t>(sign | 0x7c00); //Overflow to Inf
+    if(e<=0) { //Subnormal or zero
+        if(e<-10) return static_cast<uint16_t>(sign);
+        mant |= 0x800000;
+        uint32_t shift = static_cast<uint32_t>(14-e);
+        uint32_t h = mant>>shift;
+        uint32_t rem = mant & ((1u<<shift)-1);
+        uint32_t halfway = 1u<<(shift-1);
+        if(rem>halfway || (rem==halfway && (h&1))) h++;
+        return static_cast<uint16_t>(sign | h);
+    }
+    uint32_t h = (static_cast<uint32_t>(e)<<10) | (mant>>13);
+    uint32_t rem = mant & 0x1fff;
+    if(rem>0x1000 || (rem==0x1000 && (h&1))) h++; //A carry correctly rounds up into the exponent
+    return static_cast<uint16_t>(sign | h);
+}
+
+float half_to_float(uint16_t h)
+{
+    uint32_t sign = static_cast<uint32_t>(h & 0x8000)<<16;
+    uint32_t exp = (h>>10) & 0x1f;
+    uint32_t mant = h & 0x3ff;
+    if(exp==0) {
+        float f = std::ldexp(static_cast<float>(mant), -24);
+        return sign ? -f : f;
+    }
+    uint32_t x = exp==0x1f ? (sign | 0x7f800000 | (mant<<13)) : (sign | ((exp+112)<<23) | (mant<<13));
+    float f;
+    std::memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+/* r = a*b, returning false on overflow */
+bool checkedMul(std::size_t a, std::size_t b, std::size_t &r)
+{
+    if(a!=0 && b>std::numeric_limits<std::size_t>::max()/a) return false;
+    r = a*b;
+    return true;
+}
+
+/* The file size for a hypercube of size [sX,sY,sZ,sN], returning false on overflow */
+bool checkedFileBytes(const uint64_t size[4], std::size_t elem_bytes, std::size_t &bytes)
+{
+    std::size_t n = elem_bytes;
+    for(int d=0; d<4; d++) if(!checkedMul(n, size[d], n)) return false;
+    if(n>std::numeric_limits<std::size_t>::max()-sizeof(HypercubeFile::Header)) return false;
+    bytes = sizeof(HypercubeFile::Header)+n;
+    return true;
+}
+} /* namespace */
+
+const char HypercubeFile::Magic[8] = {'B','O','X','X','H','Y','P','1'};
+const std::size_t HypercubeFile::DefaultChunkBytes = 64*1024*1024;
+
+static_assert(sizeof(HypercubeFile::Header)==64, "HypercubeFile header must be 64 bytes");
+
+HypercubeFile::HypercubeFile(const std::string &path, IdxT sX, IdxT sY, IdxT sZ, IdxT sN, Precision precision)
+    : _path(path), _size{sX,sY,sZ,sN}, _precision(precision), _writable(true)
+{
+    if(sX<1 || sY<1 || sZ<1) {
+        std::ostringstream msg;
+        msg<<"Got bad hypercube size: ["<<sX<<","<<sY<<","<<sZ<<","<<sN<<"]";
+        throw ParameterValueError(msg.str());
+    }
+    const uint64_t size[4] = {sX,sY,sZ,sN};
+    if(!checkedFileBytes(size, elemBytes(), map_len)) {
+        std::ostringstream msg;
+        msg<<"Hypercube size overflows: ["<<sX<<","<<sY<<","<<sZ<<","<<sN<<"]";
+        throw ParameterValueError(msg.str());
+    }
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd<0 || ::ftruncate(fd, static_cast<off_t>(map_len))!=0) {
+        std::ostringstream msg;
+        msg<<"Unable to create hypercube file: "<<path<<" : "<<std::strerror(errno);
+        if(fd>=0) ::close(fd);
+        throw ParameterValueError(msg.str());
+    }
+    map_addr = ::mmap(nullptr, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(map_addr==MAP_FAILED) {
+        map_addr = nullptr;
+        std::ostringstream msg;
+        msg<<"Unable to mmap hypercube file: "<<path<<" : "<<std::strerror(errno);
+        throw ParameterValueError(msg.str());
+    }
+    Header *hdr = static_cast<Header*>(map_addr);
+    std::memcpy(hdr->magic, Magic, sizeof(Magic));
+    for(IdxT d=0; d<4; d++) hdr->size[d] = _size[d];
+    hdr->elem_bytes = elemBytes();
+    _data = static_cast<char*>(map_addr)+sizeof(Header);
+}
+
+HypercubeFile::HypercubeFile(const std::string &path)
+    : _path(path), _writable(false)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd<0) {
+        std::ostringstream msg;
+        msg<<"Unable to open hypercube file: "<<path<<" : "<<std::strerror(errno);
+        throw ParameterValueError(msg.str());
+    }
+    struct stat st;
+    if(::fstat(fd,&st)!=0 || static_cast<std::size_t>(st.st_size)<sizeof(Header)) {
+        ::close(fd);
+        std::ostringstream msg;
+        msg<<"Hypercube file is too small to contain a header: "<<path;
+        throw ParameterValueError(msg.str());
+    }
+    map_len = static_cast<std::size_t>(st.st_size);
+    map_addr = ::mmap(nullptr, map_len, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(map_addr==MAP_FAILED) {
+        map_addr = nullptr;
+        std::ostringstream msg;
+        msg<<"Unable to mmap hypercube file: "<<path<<" : "<<std::strerror(errno);
+        throw ParameterValueError(msg.str());
+    }
+    //Sizes are range checked before they are narrowed to IdxT, and the file size is computed with checked arithmetic,
+    //so a corrupt header cannot wrap around to match the file size
+    const Header *hdr = static_cast<const Header*>(map_addr);
+    const uint64_t max_idx = std::numeric_limits<IdxT>::max();
+    std::size_t file_bytes = 0;
+    bool valid = std::memcmp(hdr->magic, Magic, sizeof(Magic))==0 && (hdr->elem_bytes==4 || hdr->elem_bytes==2) &&
+                 hdr->size[0]>=1 && hdr->size[1]>=1 && hdr->size[2]>=1;
+    for(IdxT d=0; valid && d<4; d++) valid = hdr->size[d]<=max_idx;
+    valid = valid && checkedFileBytes(hdr->size, hdr->elem_bytes, file_bytes) && map_len==file_bytes;
+    if(valid) {
+        for(IdxT d=0; d<4; d++) _size[d] = static_cast<IdxT>(hdr->size[d]);
+        _precision = hdr->elem_bytes==4 ? Precision::Float32 : Precision::Float16;
+    }
+    if(!valid) {
+        ::munmap(map_addr, map_len);
+        map_addr = nullptr;
+        std::ostringstream msg;
+        msg<<"Invalid hypercube file header or size: "<<path;
+        throw ParameterValueError(msg.str());
+    }
+    _data = static_cast<char*>(map_addr)+sizeof(Header);
+}
+
+HypercubeFile::~HypercubeFile()
+{
+    if(map_addr) ::munmap(map_addr, map_len);
+}
+
+void HypercubeFile::checkFrameRange(IdxT begin, IdxT end) const
+{
+    if(begin>end || end>_size[3]) {
+        std::ostringstream msg;
+        msg<<"Bad frame range ["<<begin<<","<<end<<") for hypercube file with "<<_size[3]<<" frames";
+        throw ParameterValueError(msg.str());
+    }
+}
+
+HypercubeFile::ScaledImageStackT HypercubeFile::frames(IdxT begin, IdxT end)
+{
+    checkFrameRange(begin, end);
+    if(!_writable || _precision!=Precision::Float32)
+        throw LogicalError("Only writable Float32 hypercube files can be wrapped as a Hypercube.");
+    return ScaledImageStackT(_data+begin*frameElems()*sizeof(FloatT), _size[0], _size[1], _size[2], end-begin);
+}
+
+void HypercubeFile::readFrame(IdxT n, ScaledImageT &out) const
+{
+    checkFrameRange(n, n+1);
+    out.set_size(_size[0], _size[1], _size[2]);
+    std::size_t nElem = frameElems();
+    const char *src = _data + n*nElem*elemBytes();
+    if(_precision==Precision::Float32) {
+        std::memcpy(out.memptr(), src, nElem*sizeof(FloatT));
+    } else {
+        const uint16_t *hsrc = reinterpret_cast<const uint16_t*>(src);
+        for(std::size_t i=0; i<nElem; i++) out(i) = half_to_float(hsrc[i]);
+    }
+}
+
+/**
+ * The range is widened to whole pages.  Pages shared with neighboring frames are harmlessly flushed early, or
+ * faulted back in from the page cache if they are still being written.
+ */
+void HypercubeFile::commit(IdxT begin, IdxT end)
+{
+    checkFrameRange(begin, end);
+    if(!_writable || begin==end) return;
+    std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    std::size_t frame_bytes = frameElems()*elemBytes();
+    std::size_t lo = sizeof(Header) + begin*frame_bytes;
+    std::size_t hi = sizeof(Header) + end*frame_bytes;
+    lo -= lo%page;
+    char *addr = static_cast<char*>(map_addr)+lo;
+    if(::msync(addr, hi-lo, MS_SYNC)!=0) {
+        std::ostringstream msg;
+        msg<<"Unable to msync hypercube file: "<<_path<<" : "<<std::strerror(errno);
+        throw ProcessError(msg.str());
+    }
+    ::madvise(addr, hi-lo, MADV_DONTNEED);
+}
+
+/**
+ * Frames are filtered a chunk at a time, directly into the mapped file for Float32, or into a buffer that is then
+ * converted for Float16.  Writeback of each chunk is started as soon as it is filtered, and the previous chunk is
+ * committed behind it, so I/O overlaps the filtering of the next chunk and at most two chunks are resident.
+ */
+template<class FilterF>
+void HypercubeFile::writeChunks(const ImageStackT &im, IdxT nScales, IdxT chunk_frames, FilterF filter)
+{
+    if(!_writable) throw LogicalError("Hypercube file is read-only.");
+    if(im.n_rows!=_size[0] || im.n_cols!=_size[1] || nScales!=_size[2] || im.n_slices!=_size[3]) {
+        std::ostringstream msg;
+        msg<<"Got image stack of size: ["<<im.n_rows<<","<<im.n_cols<<","<<im.n_slices<<"] with nScales: "<<nScales
+           <<" for hypercube file of size: ["<<_size[0]<<","<<_size[1]<<","<<_size[2]<<","<<_size[3]<<"]";
+        throw ParameterShapeError(msg.str());
+    }
+    IdxT nT = _size[3];
+    if(nT==0) return;
+    std::size_t nElem = frameElems();
+    if(chunk_frames==0) {
+        std::size_t default_frames = DefaultChunkBytes/(nElem*sizeof(FloatT));
+        chunk_frames = static_cast<IdxT>(std::max<std::size_t>(default_frames, omp_get_max_threads()));
+    }
+    chunk_frames = std::max(IdxT(1), std::min(chunk_frames, nT));
+    std::vector<FloatT> buffer;
+    if(_precision==Precision::Float16) buffer.resize(nElem*chunk_frames);
+    std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    for(IdxT begin=0; begin<nT; begin+=chunk_frames) {
+        IdxT end = std::min(begin+chunk_frames, nT);
+        IdxT n = end-begin;
+        const ImageStackT im_chunk(const_cast<FloatT*>(im.slice_memptr(begin)), im.n_rows, im.n_cols, n, false, true);
+        if(_precision==Precision::Float32) {
+            filter(im_chunk, reinterpret_cast<FloatT*>(_data)+begin*nElem, n);
+        } else {
+            filter(im_chunk, buffer.data(), n);
+            uint16_t *hout = reinterpret_cast<uint16_t*>(_data)+begin*nElem;
+            int64_t nChunkElem = static_cast<int64_t>(n*nElem);
+            #pragma omp parallel for
+            for(int64_t i=0; i<nChunkElem; i++) hout[i] = float_to_half(buffer[i]);
+        }
+        std::size_t lo = sizeof(Header) + begin*nElem*elemBytes();
+        lo -= lo%page;
+        ::msync(static_cast<char*>(map_addr)+lo, sizeof(Header)+end*nElem*elemBytes()-lo, MS_ASYNC);
+        if(begin>0) commit(begin-chunk_frames, begin);
+    }
+    commit(((nT-1)/chunk_frames)*chunk_frames, nT);
+}
+
+void HypercubeFile::filterScaledLoG(const BoxxerT &engine, const ImageStackT &im, IdxT chunk_frames)
+{
+    writeChunks(im, engine.nScales, chunk_frames, [&](const ImageStackT &im_chunk, FloatT *out, IdxT n) {
+        ScaledImageStackT fim(out, _size[0], _size[1], _size[2], n);
+        engine.filterScaledLoG(im_chunk, fim);
+    });
+}
+
+void HypercubeFile::filterScaledDoG(const BoxxerT &engine, const ImageStackT &im, IdxT chunk_frames)
+{
+    writeChunks(im, engine.nScales, chunk_frames, [&](const ImageStackT &im_chunk, FloatT *out, IdxT n) {
+        ScaledImageStackT fim(out, _size[0], _size[1], _size[2], n);
+        engine.filterScaledDoG(im_chunk, fim);
+    });
+}
+
+void HypercubeFile::filterLoG(const ImageStackT &im, const VecT &sigma, IdxT chunk_frames)
+{
+    writeChunks(im, 1, chunk_frames, [&](const ImageStackT &im_chunk, FloatT *out, IdxT n) {
+        ImageStackT fim(out, _size[0], _size[1], n, false, true);
+        BoxxerT::filterLoG(im_chunk, fim, sigma);
+    });
+}
+
+void HypercubeFile::filterDoG(const ImageStackT &im, const VecT &sigma, FloatT sigma_ratio, IdxT chunk_frames)
+{
+    writeChunks(im, 1, chunk_frames, [&](const ImageStackT &im_chunk, FloatT *out, IdxT n) {
+        ImageStackT fim(out, _size[0], _size[1], n, false, true);
+        BoxxerT::filterDoG(im_chunk, fim, sigma, sigma_ratio);
+    });
+}
+
+void HypercubeFile::filterGauss(const ImageStackT &im, const VecT &sigma, IdxT chunk_frames)
+{
+    writeChunks(im, 1, chunk_frames, [&](const ImageStackT &im_chunk, FloatT *out, IdxT n) {
+        ImageStackT fim(out, _size[0], _size[1], n, false, true);
+        BoxxerT::filterGauss(im_chunk, fim, sigma);
+    });
+}
+
+} /* namespace boxxer */
@@ -0,0 +1,290 @@
+/**
+ * @file MaximaND.cpp
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The class definitions for MaximaND, the rank-templated local maxima finder.
+ */
+
+#include <algorithm>
+#include "Boxxer/BoxxerError.h"
+#include "Boxxer/MaximaND.h"
+
+namespace boxxer {
+
+namespace {
+/** The 3^Rank-1 neighbor displacements of the 3^Rank box.  The two along axis 0 come first. */
+template<int Rank>
+struct NeighborDeltas { int d[pow3(Rank)-1][Rank]; };
+
+template<int Rank>
+constexpr NeighborDeltas<Rank> make_neighbor_deltas()
+{
+    NeighborDeltas<Rank> deltas{};
+    deltas.d[0][0] = -1;
+    deltas.d[1][0] = 1;
+    int n = 2;
+    for(int q=0; q<pow3(Rank); q++) {
+        int digits[Rank] = {};
+        bool off_axis = false;
+        for(int r=0, rem=q; r<Rank; r++, rem/=3) {
+            digits[r] = rem%3-1;
+            if(r>0 && digits[r]!=0) off_axis = true;
+        }
+        if(!off_axis) continue; //The center and the two axis 0 neighbors
+        for(int r=0; r<Rank; r++) deltas.d[n][r] = digits[r];
+        n++;
+    }
+    return deltas;
+}
+
+template<int Rank>
+constexpr NeighborDeltas<Rank> neighbor_deltas = make_neighbor_deltas<Rank>();
+
+/**
+ * Call pred(idx) with the linear index of each pixel of the box of half-width k about coords, truncated at the image
+ * boundary, until it returns true.  Lines along axis 0 are contiguous, so the inner loop has unit stride.
+ * @returns true if pred returned true.
+ */
+template<int Rank, class IdxT, class Pred>
+bool any_in_box(const std::array<IdxT,Rank> &size, const std::array<IdxT,Rank> &stride, const IdxT coords[], IdxT k,
+                Pred pred)
+{
+    std::array<IdxT,Rank> lo, hi, c;
+    for(int r=0; r<Rank; r++) {
+        lo[r] = coords[r]<=k ? 0 : coords[r]-k;
+        hi[r] = std::min<IdxT>(coords[r]+k, size[r]-1);
+    }
+    c = lo;
+    while(true) {
+        std::size_t base = 0;
+        for(int r=1; r<Rank; r++) base += static_cast<std::size_t>(c[r])*stride[r];
+        for(IdxT x=lo[0]; x<=hi[0]; x++) if(pred(base+x)) return true;
+        int r = 1;
+        for(; r<Rank; r++) {
+            if(c[r]<hi[r]) { c[r]++; break; }
+            c[r] = lo[r];
+        }
+        if(r==Rank) return false;
+    }
+}
+
+template<int Rank, class IdxT>
+std::ostream& print_size(std::ostream &out, const std::array<IdxT,Rank> &size)
+{
+    out<<"[";
+    for(int r=0; r<Rank; r++) out<<(r ? "," : "")<<size[r];
+    return out<<"]";
+}
+} /* namespace */
+
+template<int Rank, class FloatT, class IdxT>
+const IdxT MaximaND<Rank,FloatT,IdxT>::MinBoxsize = 3;
+
+template<int Rank, class FloatT, class IdxT>
+MaximaND<Rank,FloatT,IdxT>::MaximaND(const SizeT &size, IdxT boxsize)
+    : size(size), boxsize(boxsize)
+{
+    if(boxsize<MinBoxsize || boxsize%2==0) {
+        std::ostringstream msg;
+        msg<<"Boxsize must be odd and >="<<MinBoxsize<<" got: "<<boxsize;
+        throw ParameterValueError(msg.str());
+    }
+    if(std::any_of(size.begin(), size.end(), [=](IdxT s){ return s<boxsize; })) {
+        std::ostringstream msg;
+        msg<<"Boxsize: "<<boxsize<<" greater than image size dimensions: ";
+        print_size<Rank>(msg, size);
+        throw ParameterValueError(msg.str());
+    }
+    nelem = 1;
+    for(int r=0; r<Rank; r++) {
+        stride[r] = static_cast<IdxT>(nelem);
+        nelem *= size[r];
+    }
+    const auto &deltas = neighbor_deltas<Rank>;
+    for(int q=2; q<NNeighbors; q++) {
+        OffsetT offset = 0;
+        for(int r=0; r<Rank; r++) offset += deltas.d[q][r]*static_cast<OffsetT>(stride[r]);
+        offsets[q-2] = offset;
+    }
+}
+
+template<int Rank, class FloatT, class IdxT>
+IdxT MaximaND<Rank,FloatT,IdxT>::find_maxima(const FloatT *im)
+{
+    maxima_3x3(im);
+    if(boxsize>MinBoxsize) Nmaxima = maxima_nxn(im, boxsize);
+    return Nmaxima;
+}
+
+template<int Rank, class FloatT, class IdxT>
+IdxT MaximaND<Rank,FloatT,IdxT>::find_maxima(const FloatT *im, IMatT &maxima_out, VecT &max_vals_out)
+{
+    find_maxima(im);
+    read_maxima(maxima_out, max_vals_out);
+    return Nmaxima;
+}
+
+template<int Rank, class FloatT, class IdxT>
+void MaximaND<Rank,FloatT,IdxT>::read_maxima(IMatT &maxima_out, VecT &max_vals_out) const
+{
+    maxima_out.set_size(Rank, Nmaxima);
+    max_vals_out.set_size(Nmaxima);
+    std::copy(maxima.begin(), maxima.end(), maxima_out.memptr());
+    std::copy(max_vals.begin(), max_vals.end(), max_vals_out.memptr());
+}
+
+/**
+ * Restrict a list of maxima to those that are also maxima over a larger neighborhood.
+ *
+ * The maxima must already be 3^Rank maxima, e.g., the output of find_maxima().  Then the result is identical to
+ * find_maxima() with boxsize=neighborhood_size, and the order of the maxima is preserved.  Only the first Rank rows
+ * of maxima_io are read.
+ * @returns Number of remaining maxima.
+ */
+template<int Rank, class FloatT, class IdxT>
+IdxT MaximaND<Rank,FloatT,IdxT>::refine_maxima(const FloatT *im, IMatT &maxima_io, VecT &max_vals_io,
+                                               IdxT neighborhood_size) const
+{
+    if(neighborhood_size<MinBoxsize || neighborhood_size%2==0) {
+        std::ostringstream msg;
+        msg<<"Neighborhood size must be odd and >="<<MinBoxsize<<" got: "<<neighborhood_size;
+        throw ParameterValueError(msg.str());
+    }
+    if(maxima_io.n_rows<Rank || maxima_io.n_cols!=max_vals_io.n_elem) {
+        std::ostringstream msg;
+        msg<<"Got maxima of size: ["<<maxima_io.n_rows<<","<<maxima_io.n_cols<<"] with "<<max_vals_io.n_elem
+           <<" values.  Expected ["<<Rank<<" x nMaxima]";
+        throw ParameterShapeError(msg.str());
+    }
+    IdxT k = (neighborhood_size-1)/2;
+    IdxT N = static_cast<IdxT>(maxima_io.n_cols);
+    IdxT kept = 0;
+    for(IdxT n=0; n<N; n++) {
+        FloatT val = max_vals_io(n);
+        if(any_in_box<Rank>(size, stride, maxima_io.colptr(n), k, [=](std::size_t i){ return im[i]>val; })) continue;
+        if(kept<n) { //Compact in place, preserving order
+            maxima_io.col(kept) = maxima_io.col(n);
+            max_vals_io(kept) = val;
+        }
+        kept++;
+    }
+    maxima_io.resize(maxima_io.n_rows, kept);
+    max_vals_io.resize(kept);
+    return kept;
+}
+
+template<int Rank, class FloatT, class IdxT>
+bool MaximaND<Rank,FloatT,IdxT>::check_maxima(const FloatT *im, const IdxT coords[], IdxT neighborhood_size) const
+{
+    std::size_t center = 0;
+    for(int r=0; r<Rank; r++) center += static_cast<std::size_t>(coords[r])*stride[r];
+    FloatT val = im[center];
+    IdxT k = (neighborhood_size-1)/2;
+    return !any_in_box<Rank>(size, stride, coords, k, [=](std::size_t i){ return i!=center && im[i]>=val; });
+}
+
+/**
+ * The 3^Rank maxima, scanning lines along axis 0.  On lines in the interior of the other axes the pixels between
+ * the line ends are compared along the line first, which rejects most pixels, and then against the remaining
+ * neighbors at their precomputed offsets.  A pixel greater than its successor along the line also skips it.  The
+ * line ends and the lines on the boundary are checked with bounds.
+ */
+template<int Rank, class FloatT, class IdxT>
+void MaximaND<Rank,FloatT,IdxT>::maxima_3x3(const FloatT *im)
+{
+    Nmaxima = 0;
+    maxima.clear();
+    max_vals.clear();
+    IdxT sizeX = size[0];
+    std::size_t nlines = nelem/sizeX;
+    SizeT coords{};
+    for(std::size_t l=0; l<nlines; l++) {
+        const FloatT *line = im + l*sizeX;
+        bool interior = true;
+        for(int r=1; r<Rank; r++) interior = interior && coords[r]>0 && coords[r]+1<size[r];
+        if(!interior) {
+            for(IdxT x=0; x<sizeX; x++) {
+                coords[0] = x;
+                if(boundary_maxima(im, coords, line[x])) record_maxima(coords, line[x]);
+            }
+        } else {
+            coords[0] = 0;
+            if(boundary_maxima(im, coords, line[0])) record_maxima(coords, line[0]);
+            for(IdxT x=1; x+1<sizeX; x++) {
+                const FloatT *p = line+x;
+                FloatT val = *p;
+                if(val<=p[1] || val<=p[-1]) continue;
+                bool is_max = true;
+                for(int q=0; q<NNeighbors-2; q++) if(val<=p[offsets[q]]) { is_max = false; break; }
+                if(is_max) {
+                    coords[0] = x;
+                    record_maxima(coords, val);
+                }
+                x++; //The next pixel is smaller so it is not a maxima
+            }
+            coords[0] = sizeX-1;
+            if(boundary_maxima(im, coords, line[sizeX-1])) record_maxima(coords, line[sizeX-1]);
+        }
+        for(int r=1; r<Rank; r++) { //Next line
+            if(++coords[r]<size[r]) break;
+            coords[r] = 0;
+        }
+    }
+}
+
+/** Keep the 3^Rank maxima with no larger pixel in their neighborhood_size box */
+template<int Rank, class FloatT, class IdxT>
+IdxT MaximaND<Rank,FloatT,IdxT>::maxima_nxn(const FloatT *im, IdxT neighborhood_size)
+{
+    IdxT k = (neighborhood_size-1)/2;
+    IdxT kept = 0;
+    for(IdxT n=0; n<Nmaxima; n++) {
+        FloatT val = max_vals[n];
+        const IdxT *coords = &maxima[static_cast<std::size_t>(n)*Rank];
+        if(any_in_box<Rank>(size, stride, coords, k, [=](std::size_t i){ return im[i]>val; })) continue;
+        if(kept<n) {
+            std::copy(coords, coords+Rank, &maxima[static_cast<std::size_t>(kept)*Rank]);
+            max_vals[kept] = val;
+        }
+        kept++;
+    }
+    maxima.resize(static_cast<std::size_t>(kept)*Rank);
+    max_vals.resize(kept);
+    return kept;
+}
+
+template<int Rank, class FloatT, class IdxT>
+bool MaximaND<Rank,FloatT,IdxT>::boundary_maxima(const FloatT *im, const SizeT &coords, FloatT val) const
+{
+    const auto &deltas = neighbor_deltas<Rank>;
+    for(int q=0; q<NNeighbors; q++) {
+        std::size_t idx = 0;
+        bool inside = true;
+        for(int r=0; r<Rank && inside; r++) {
+            int d = deltas.d[q][r];
+            IdxT c = coords[r];
+            if((d<0 && c==0) || (d>0 && c+1>=size[r])) inside = false;
+            else idx += static_cast<std::size_t>(d<0 ? c-1 : c+d)*stride[r];
+        }
+        if(inside && val<=im[idx]) return false;
+    }
+    return true;
+}
+
+template<int Rank, class FloatT, class IdxT>
+void MaximaND<Rank,FloatT,IdxT>::record_maxima(const SizeT &coords, FloatT val)
+{
+    maxima.insert(maxima.end(), coords.begin(), coords.end());
+    max_vals.push_back(val);
+    Nmaxima++;
+}
+
+/* Explicit Template Instantiation */
+template class MaximaND<2,float>;
+template class MaximaND<2,double>;
+template class MaximaND<3,float>;
+template class MaximaND<3,double>;
+template class MaximaND<4,float>;
+template class MaximaND<4,double>;
+
+} /* namespace boxxer */
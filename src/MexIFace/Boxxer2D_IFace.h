@@ -12,6 +12,9 @@
 
 #include "MexIFace/MexIFace.h"
 #include "Boxxer/Boxxer2D.h"
+#include "Boxxer/MultiChannel2D.h"
+#include "Boxxer/Mosaic2D.h"
+#include "Boxxer/PSFBoxxer.h"
 
 // using namespace boxxer;
 
@@ -33,31 +36,97 @@ private:
 
     //Non-static member function calls
     void objSetDoGSigmaRatio();
+    void objSetWaveletFirstLevel();
+    void objSetDefectMap();
+    void objGetDefectMap();
+    void objDetectDefectMap();
+    void objEnableGaussCache();
+    void objDisableGaussCache();
+    void objClearGaussCache();
     void objFilterScaledLoG();
     void objFilterScaledDoG();
+    void objFilterScaledWavelet();
     void objScaleSpaceLoGMaxima();
     void objScaleSpaceDoGMaxima();
+    void objScaleSpaceWaveletMaxima();
+    void objScaleSpaceLoGMaximaShape();
+    void objScaleSpaceLoGComponents();
+    void objScaleSpaceDoGComponents();
+    void objScaleSpaceDoGMaximaSweep();
+    void objScaleSpaceLoGMaximaMasked();
+    void objScaleSpaceDoGMaximaMasked();
+    void objScaleSpaceLoGMaximaTemporal();
+    void objScaleSpaceDoGMaximaTemporal();
+    void objScaleSpaceLoGMaximaThreshold();
+    void objScaleSpaceDoGMaximaThreshold();
+    void objScaleSpaceLoGMaximaAdaptive();
+    void objScaleSpaceDoGMaximaAdaptive();
+    void objScaleSpaceLoGMaximaBinned();
+    void objScaleSpaceDoGMaximaBinned();
+    void objScaleSpaceLoGMaximaMultiChannel();
+    void objScaleSpaceDoGMaximaMultiChannel();
+    void objCoincidentMaxima();
+    void objScaleSpaceLoGMaximaMosaic();
+    void objScaleSpaceDoGMaximaMosaic();
+    void objScaleSpacePSFMaxima();
 
     // Static member function wrappers
     void objFilterLoG();
     void objFilterDoG();
+    void objFilterWavelet();
     void objFilterGauss();
     void objEnumerateImageMaxima();
+    void objDetectLoG();
+    void objDetectDoG();
+    void objDetectGauss();
 };
 
 template<class FloatT, class IdxT>
 Boxxer2D_IFace<FloatT,IdxT>::Boxxer2D_IFace()
 {
     methodmap["setDoGSigmaRatio"] = std::bind(&Boxxer2D_IFace::objSetDoGSigmaRatio, this);
+    methodmap["setWaveletFirstLevel"] = std::bind(&Boxxer2D_IFace::objSetWaveletFirstLevel, this);
+    methodmap["setDefectMap"] = std::bind(&Boxxer2D_IFace::objSetDefectMap, this);
+    methodmap["getDefectMap"] = std::bind(&Boxxer2D_IFace::objGetDefectMap, this);
+    methodmap["detectDefectMap"] = std::bind(&Boxxer2D_IFace::objDetectDefectMap, this);
+    methodmap["enableGaussCache"] = std::bind(&Boxxer2D_IFace::objEnableGaussCache, this);
+    methodmap["disableGaussCache"] = std::bind(&Boxxer2D_IFace::objDisableGaussCache, this);
+    methodmap["clearGaussCache"] = std::bind(&Boxxer2D_IFace::objClearGaussCache, this);
     methodmap["filterScaledLoG"] = std::bind(&Boxxer2D_IFace::objFilterScaledLoG, this);
     methodmap["filterScaledDoG"] = std::bind(&Boxxer2D_IFace::objFilterScaledDoG, this);
+    methodmap["filterScaledWavelet"] = std::bind(&Boxxer2D_IFace::objFilterScaledWavelet, this);
     methodmap["scaleSpaceLoGMaxima"] = std::bind(&Boxxer2D_IFace::objScaleSpaceLoGMaxima, this);
     methodmap["scaleSpaceDoGMaxima"] = std::bind(&Boxxer2D_IFace::objScaleSpaceDoGMaxima, this);
+    methodmap["scaleSpaceWaveletMaxima"] = std::bind(&Boxxer2D_IFace::objScaleSpaceWaveletMaxima, this);
+    methodmap["scaleSpaceLoGMaximaShape"] = std::bind(&Boxxer2D_IFace::objScaleSpaceLoGMaximaShape, this);
+    methodmap["scaleSpaceLoGComponents"] = std::bind(&Boxxer2D_IFace::objScaleSpaceLoGComponents, this);
+    methodmap["scaleSpaceDoGComponents"] = std::bind(&Boxxer2D_IFace::objScaleSpaceDoGComponents, this);
+    methodmap["scaleSpaceDoGMaximaSweep"] = std::bind(&Boxxer2D_IFace::objScaleSpaceDoGMaximaSweep, this);
+    methodmap["scaleSpaceLoGMaximaMasked"] = std::bind(&Boxxer2D_IFace::objScaleSpaceLoGMaximaMasked, this);
+    methodmap["scaleSpaceDoGMaximaMasked"] = std::bind(&Boxxer2D_IFace::objScaleSpaceDoGMaximaMasked, this);
+    methodmap["scaleSpaceLoGMaximaTemporal"] = std::bind(&Boxxer2D_IFace::objScaleSpaceLoGMaximaTemporal, this);
+    methodmap["scaleSpaceDoGMaximaTemporal"] = std::bind(&Boxxer2D_IFace::objScaleSpaceDoGMaximaTemporal, this);
+    methodmap["scaleSpaceLoGMaximaThreshold"] = std::bind(&Boxxer2D_IFace::objScaleSpaceLoGMaximaThreshold, this);
+    methodmap["scaleSpaceDoGMaximaThreshold"] = std::bind(&Boxxer2D_IFace::objScaleSpaceDoGMaximaThreshold, this);
+    methodmap["scaleSpaceLoGMaximaAdaptive"] = std::bind(&Boxxer2D_IFace::objScaleSpaceLoGMaximaAdaptive, this);
+    methodmap["scaleSpaceDoGMaximaAdaptive"] = std::bind(&Boxxer2D_IFace::objScaleSpaceDoGMaximaAdaptive, this);
+    methodmap["scaleSpaceLoGMaximaBinned"] = std::bind(&Boxxer2D_IFace::objScaleSpaceLoGMaximaBinned, this);
+    methodmap["scaleSpaceDoGMaximaBinned"] = std::bind(&Boxxer2D_IFace::objScaleSpaceDoGMaximaBinned, this);
+    methodmap["scaleSpaceLoGMaximaMultiChannel"] = std::bind(&Boxxer2D_IFace::objScaleSpaceLoGMaximaMultiChannel, this);
+    methodmap["scaleSpaceDoGMaximaMultiChannel"] = std::bind(&Boxxer2D_IFace::objScaleSpaceDoGMaximaMultiChannel, this);
+    methodmap["coincidentMaxima"] = std::bind(&Boxxer2D_IFace::objCoincidentMaxima, this);
+    methodmap["scaleSpaceLoGMaximaMosaic"] = std::bind(&Boxxer2D_IFace::objScaleSpaceLoGMaximaMosaic, this);
+    methodmap["scaleSpaceDoGMaximaMosaic"] = std::bind(&Boxxer2D_IFace::objScaleSpaceDoGMaximaMosaic, this);
+    methodmap["scaleSpacePSFMaxima"] = std::bind(&Boxxer2D_IFace::objScaleSpacePSFMaxima, this);
 
     staticmethodmap["filterLoG"] = std::bind(&Boxxer2D_IFace::objFilterLoG, this);
     staticmethodmap["filterDoG"] = std::bind(&Boxxer2D_IFace::objFilterDoG, this);
+    staticmethodmap["filterWavelet"] = std::bind(&Boxxer2D_IFace::objFilterWavelet, this);
     staticmethodmap["filterGauss"] = std::bind(&Boxxer2D_IFace::objFilterGauss, this);
     staticmethodmap["enumerateImageMaxima"] = std::bind(&Boxxer2D_IFace::objEnumerateImageMaxima, this);
+    staticmethodmap["detectLoG"] = std::bind(&Boxxer2D_IFace::objDetectLoG, this);
+    staticmethodmap["detectDoG"] = std::bind(&Boxxer2D_IFace::objDetectDoG, this);
+    staticmethodmap["detectGauss"] = std::bind(&Boxxer2D_IFace::objDetectGauss, this);
 }
 
 template<class FloatT, class IdxT_>
@@ -80,6 +149,69 @@ void Boxxer2D_IFace<FloatT,IdxT>::objSetDoGSigmaRatio()
     obj->setDoGSigmaRatio(getAsFloat<FloatT>());
 }
 
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objEnableGaussCache()
+{
+    // [in] maxMBytes: memory bound for the cache of Gaussian filtered frames in MB.
+    checkNumArgs(0,1);
+    auto max_mbytes = getAsUnsigned<IdxT>();
+    obj->enableGaussCache(static_cast<std::size_t>(max_mbytes)<<20);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objDisableGaussCache()
+{
+    checkNumArgs(0,0);
+    obj->disableGaussCache();
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objClearGaussCache()
+{
+    checkNumArgs(0,0);
+    obj->clearGaussCache();
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objSetWaveletFirstLevel()
+{
+    // [in] level: first a trous wavelet level used as scale 1.  Level j has scale about 2^(j-1) pixels.
+    checkNumArgs(0,1);
+    obj->setWaveletFirstLevel(getAsUnsigned<IdxT>());
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objSetDefectMap()
+{
+    // [in] defects: uint8 imsize shaped map, nonzero at defective pixels.  All zeros disables defect patching.
+    checkNumArgs(0,1);
+    obj->setDefectMap(getMat<uint8_t>());
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objGetDefectMap()
+{
+    // [out] defects: uint8 imsize shaped map, nonzero at defective pixels.
+    checkNumArgs(1,0);
+    output(obj->getDefectMap());
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objDetectDefectMap()
+{
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] nWarmupFrames: Number of leading frames to examine
+    // [in] threshold: Outlier threshold in robust standard deviations of the neighbor median residual
+    // [in] minFraction: Fraction of the frames a pixel must be an outlier in to be flagged
+    // [out] nDefects: Number of defects found.  The map is set on the object.
+    checkNumArgs(1,4);
+    auto ims = getCube<FloatT>();
+    auto nWarmupFrames = getAsUnsigned<IdxT>();
+    auto threshold = getAsFloat<FloatT>();
+    auto min_fraction = getAsFloat<FloatT>();
+    output(obj->detectDefectMap(ims, nWarmupFrames, threshold, min_fraction));
+}
+
 template<class FloatT, class IdxT>
 void Boxxer2D_IFace<FloatT,IdxT>::objFilterScaledLoG()
 {
@@ -102,6 +234,17 @@ void Boxxer2D_IFace<FloatT,IdxT>::objFilterScaledDoG()
     obj->filterScaledDoG(ims,fims);
 }
 
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objFilterScaledWavelet()
+{
+    // [in] image: stack of imsize shaped frames, last dimension is time
+    // [out] fimage: stack of imsize x nScales wavelet planes. Size 4D: [x y S t]
+    checkNumArgs(1,1);
+    auto ims = getCube<FloatT>();
+    auto fims = makeOutputArray<FloatT>(ims.n_rows, ims.n_cols, obj->nScales, ims.n_slices);
+    obj->filterScaledWavelet(ims,fims);
+}
+
 template<class FloatT, class IdxT>
 void Boxxer2D_IFace<FloatT,IdxT>::objScaleSpaceLoGMaxima()
 {
@@ -140,6 +283,528 @@ void Boxxer2D_IFace<FloatT,IdxT>::objScaleSpaceDoGMaxima()
     output(max_vals);
 }
 
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objScaleSpaceWaveletMaxima()
+{
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] neighborhoodSize: Odd integer.  Acceptable values are in ValidMaximaNeighborhoodSizes.  (default=3)
+    // [in] scaleNeighborhoodSize: Odd integer.  Acceptable values are in ValidMaximaNeighborhoodSizes.  (default=3)
+    // [out] maxima: matrix type IdxT size:[dim+1, N]. List of maxima where rows are X, Y, ..., T and columns are different maxima detected.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    checkNumArgs(2,3);
+    auto ims = getCube<FloatT>();
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto scaleNeighborhoodSize = getAsUnsigned<IdxT>();
+    IMatT maxima;
+    VecT max_vals;
+    obj->scaleSpaceWaveletMaxima(ims, maxima, max_vals, neighborhoodSize, scaleNeighborhoodSize);
+    output(maxima);
+    output(max_vals);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objScaleSpaceLoGMaximaShape()
+{
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] neighborhoodSize: Odd integer.  Acceptable values are in ValidMaximaNeighborhoodSizes.  (default=3)
+    // [in] scaleNeighborhoodSize: Odd integer.  Acceptable values are in ValidMaximaNeighborhoodSizes.  (default=3)
+    // [in] computeGradient: nonzero to also compute the gradient magnitude at each maxima
+    // [out] maxima: matrix type IdxT size:[dim+1, N]. List of maxima where rows are X, Y, ..., T and columns are different maxima detected.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    // [out] hessian_ratio; type FloatT size:[N], Hessian eigenvalue ratio at each maxima. 1=round, 0=line.
+    // [out] gradient; type FloatT size:[N], scale normalized gradient magnitude at each maxima.  Empty if not computed.
+    checkNumArgs(4,4);
+    auto ims = getCube<FloatT>();
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto scaleNeighborhoodSize = getAsUnsigned<IdxT>();
+    auto computeGradient = getAsUnsigned<IdxT>();
+    IMatT maxima;
+    VecT max_vals, hessian_ratio, gradient;
+    obj->scaleSpaceLoGMaximaShape(ims, maxima, max_vals, hessian_ratio, neighborhoodSize, scaleNeighborhoodSize,
+                                  computeGradient ? &gradient : nullptr);
+    output(maxima);
+    output(max_vals);
+    output(hessian_ratio);
+    output(gradient);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objScaleSpaceLoGComponents()
+{
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] threshold: Pixels with maximum response over scales >threshold are foreground
+    // [out] components: matrix type IdxT size:[9, N]. Rows are [x_lo y_lo x_hi y_hi peak_x peak_y peak_scale area frame]
+    // [out] integrated: type FloatT size:[N], sum of the response over each component.
+    // [out] peak_vals: type FloatT size:[N], peak response of each component.
+    checkNumArgs(3,2);
+    auto ims = getCube<FloatT>();
+    auto threshold = getAsFloat<FloatT>();
+    IMatT components;
+    VecT integrated, peak_vals;
+    obj->scaleSpaceLoGComponents(ims, threshold, components, integrated, peak_vals);
+    output(components);
+    output(integrated);
+    output(peak_vals);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objScaleSpaceDoGComponents()
+{
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] threshold: Pixels with maximum response over scales >threshold are foreground
+    // [out] components: matrix type IdxT size:[9, N]. Rows are [x_lo y_lo x_hi y_hi peak_x peak_y peak_scale area frame]
+    // [out] integrated: type FloatT size:[N], sum of the response over each component.
+    // [out] peak_vals: type FloatT size:[N], peak response of each component.
+    checkNumArgs(3,2);
+    auto ims = getCube<FloatT>();
+    auto threshold = getAsFloat<FloatT>();
+    IMatT components;
+    VecT integrated, peak_vals;
+    obj->scaleSpaceDoGComponents(ims, threshold, components, integrated, peak_vals);
+    output(components);
+    output(integrated);
+    output(peak_vals);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objScaleSpaceLoGMaximaMasked()
+{
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] mask: uint8 imsize shaped mask.  Only maxima at nonzero mask pixels are returned.
+    // [in] neighborhoodSize: Odd integer.
+    // [in] scaleNeighborhoodSize: Odd integer.
+    // [out] maxima: matrix type IdxT size:[dim+2, N]. Rows are X, Y, scale, T.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    checkNumArgs(2,4);
+    auto ims = getCube<FloatT>();
+    auto mask = getMat<uint8_t>();
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto scaleNeighborhoodSize = getAsUnsigned<IdxT>();
+    IMatT maxima;
+    VecT max_vals;
+    obj->scaleSpaceLoGMaximaMasked(ims, mask, maxima, max_vals, neighborhoodSize, scaleNeighborhoodSize);
+    output(maxima);
+    output(max_vals);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objScaleSpaceDoGMaximaMasked()
+{
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] mask: uint8 imsize shaped mask.  Only maxima at nonzero mask pixels are returned.
+    // [in] neighborhoodSize: Odd integer.
+    // [in] scaleNeighborhoodSize: Odd integer.
+    // [out] maxima: matrix type IdxT size:[dim+2, N]. Rows are X, Y, scale, T.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    checkNumArgs(2,4);
+    auto ims = getCube<FloatT>();
+    auto mask = getMat<uint8_t>();
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto scaleNeighborhoodSize = getAsUnsigned<IdxT>();
+    IMatT maxima;
+    VecT max_vals;
+    obj->scaleSpaceDoGMaximaMasked(ims, mask, maxima, max_vals, neighborhoodSize, scaleNeighborhoodSize);
+    output(maxima);
+    output(max_vals);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objScaleSpaceLoGMaximaTemporal()
+{
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] threshold: Only maxima with value strictly greater than threshold are returned.
+    // [in] neighborhoodSize: Odd integer.
+    // [in] scaleNeighborhoodSize: Odd integer.
+    // [out] maxima: matrix type IdxT size:[dim+2, N]. Rows are X, Y, scale, T.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    // [out] skipFraction: fraction of tile-frames skipped as unchanged.
+    checkNumArgs(3,4);
+    auto ims = getCube<FloatT>();
+    auto threshold = getAsFloat<FloatT>();
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto scaleNeighborhoodSize = getAsUnsigned<IdxT>();
+    IMatT maxima;
+    VecT max_vals;
+    typename BoxxerT::TemporalSkipStats stats;
+    obj->scaleSpaceLoGMaximaTemporal(ims, threshold, maxima, max_vals, neighborhoodSize, scaleNeighborhoodSize, &stats);
+    output(maxima);
+    output(max_vals);
+    output(stats.nTileFrames ? static_cast<double>(stats.nSkipped)/stats.nTileFrames : 0.);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objScaleSpaceDoGMaximaTemporal()
+{
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] threshold: Only maxima with value strictly greater than threshold are returned.
+    // [in] neighborhoodSize: Odd integer.
+    // [in] scaleNeighborhoodSize: Odd integer.
+    // [out] maxima: matrix type IdxT size:[dim+2, N]. Rows are X, Y, scale, T.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    // [out] skipFraction: fraction of tile-frames skipped as unchanged.
+    checkNumArgs(3,4);
+    auto ims = getCube<FloatT>();
+    auto threshold = getAsFloat<FloatT>();
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto scaleNeighborhoodSize = getAsUnsigned<IdxT>();
+    IMatT maxima;
+    VecT max_vals;
+    typename BoxxerT::TemporalSkipStats stats;
+    obj->scaleSpaceDoGMaximaTemporal(ims, threshold, maxima, max_vals, neighborhoodSize, scaleNeighborhoodSize, &stats);
+    output(maxima);
+    output(max_vals);
+    output(stats.nTileFrames ? static_cast<double>(stats.nSkipped)/stats.nTileFrames : 0.);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objScaleSpaceLoGMaximaThreshold()
+{
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] threshold: Only maxima with value strictly greater than threshold are returned.
+    // [in] neighborhoodSize: Odd integer.
+    // [in] scaleNeighborhoodSize: Odd integer.
+    // [out] maxima: matrix type IdxT size:[dim+2, N]. Rows are X, Y, scale, T.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    // [out] nSkippedFrames: number of frames rejected without filtering.
+    checkNumArgs(3,4);
+    auto ims = getCube<FloatT>();
+    auto threshold = getAsFloat<FloatT>();
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto scaleNeighborhoodSize = getAsUnsigned<IdxT>();
+    IMatT maxima;
+    VecT max_vals;
+    IdxT nSkippedFrames = 0;
+    obj->scaleSpaceLoGMaximaThreshold(ims, threshold, maxima, max_vals, neighborhoodSize, scaleNeighborhoodSize, &nSkippedFrames);
+    output(maxima);
+    output(max_vals);
+    output(nSkippedFrames);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objScaleSpaceDoGMaximaThreshold()
+{
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] threshold: Only maxima with value strictly greater than threshold are returned.
+    // [in] neighborhoodSize: Odd integer.
+    // [in] scaleNeighborhoodSize: Odd integer.
+    // [out] maxima: matrix type IdxT size:[dim+2, N]. Rows are X, Y, scale, T.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    // [out] nSkippedFrames: number of frames rejected without filtering.
+    checkNumArgs(3,4);
+    auto ims = getCube<FloatT>();
+    auto threshold = getAsFloat<FloatT>();
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto scaleNeighborhoodSize = getAsUnsigned<IdxT>();
+    IMatT maxima;
+    VecT max_vals;
+    IdxT nSkippedFrames = 0;
+    obj->scaleSpaceDoGMaximaThreshold(ims, threshold, maxima, max_vals, neighborhoodSize, scaleNeighborhoodSize, &nSkippedFrames);
+    output(maxima);
+    output(max_vals);
+    output(nSkippedFrames);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objScaleSpaceLoGMaximaAdaptive()
+{
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] threshold: Only maxima with value strictly greater than threshold are returned.
+    // [in] neighborhoodSize: Odd integer.
+    // [in] scaleNeighborhoodSize: Odd integer.
+    // [in] window: Frames of peak responses used to choose the scales.
+    // [in] recheckPeriod: Every recheckPeriod-th frame is filtered at all scales.
+    // [in] margin: Scales are skipped when their peak was <= threshold-margin*|threshold|.
+    // [out] maxima: matrix type IdxT size:[dim+2, N]. Rows are X, Y, scale, T.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    // [out] stats: size:[4] type double.  [nFrames, nFullFrames, nScaleFrames, nSkippedScaleFrames]
+    // [out] skippedByScale: size:[nScales] type double.  Frames skipped at each scale.
+    checkNumArgs(4,7);
+    auto ims = getCube<FloatT>();
+    auto threshold = getAsFloat<FloatT>();
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto scaleNeighborhoodSize = getAsUnsigned<IdxT>();
+    typename BoxxerT::AdaptiveScaleParams params;
+    params.window = getAsUnsigned<IdxT>();
+    params.recheck_period = getAsUnsigned<IdxT>();
+    params.margin = getAsFloat<FloatT>();
+    IMatT maxima;
+    VecT max_vals;
+    typename BoxxerT::AdaptiveScaleStats stats;
+    obj->scaleSpaceLoGMaximaAdaptive(ims, threshold, maxima, max_vals, neighborhoodSize, scaleNeighborhoodSize, params, &stats);
+    output(maxima);
+    output(max_vals);
+    arma::vec out_stats = {static_cast<double>(stats.nFrames), static_cast<double>(stats.nFullFrames),
+                           static_cast<double>(stats.nScaleFrames), static_cast<double>(stats.nSkippedScaleFrames)};
+    output(out_stats);
+    output(arma::conv_to<arma::vec>::from(stats.nSkippedByScale));
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objScaleSpaceDoGMaximaAdaptive()
+{
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] threshold: Only maxima with value strictly greater than threshold are returned.
+    // [in] neighborhoodSize: Odd integer.
+    // [in] scaleNeighborhoodSize: Odd integer.
+    // [in] window: Frames of peak responses used to choose the scales.
+    // [in] recheckPeriod: Every recheckPeriod-th frame is filtered at all scales.
+    // [in] margin: Scales are skipped when their peak was <= threshold-margin*|threshold|.
+    // [out] maxima: matrix type IdxT size:[dim+2, N]. Rows are X, Y, scale, T.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    // [out] stats: size:[4] type double.  [nFrames, nFullFrames, nScaleFrames, nSkippedScaleFrames]
+    // [out] skippedByScale: size:[nScales] type double.  Frames skipped at each scale.
+    checkNumArgs(4,7);
+    auto ims = getCube<FloatT>();
+    auto threshold = getAsFloat<FloatT>();
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto scaleNeighborhoodSize = getAsUnsigned<IdxT>();
+    typename BoxxerT::AdaptiveScaleParams params;
+    params.window = getAsUnsigned<IdxT>();
+    params.recheck_period = getAsUnsigned<IdxT>();
+    params.margin = getAsFloat<FloatT>();
+    IMatT maxima;
+    VecT max_vals;
+    typename BoxxerT::AdaptiveScaleStats stats;
+    obj->scaleSpaceDoGMaximaAdaptive(ims, threshold, maxima, max_vals, neighborhoodSize, scaleNeighborhoodSize, params, &stats);
+    output(maxima);
+    output(max_vals);
+    arma::vec out_stats = {static_cast<double>(stats.nFrames), static_cast<double>(stats.nFullFrames),
+                           static_cast<double>(stats.nScaleFrames), static_cast<double>(stats.nSkippedScaleFrames)};
+    output(out_stats);
+    output(arma::conv_to<arma::vec>::from(stats.nSkippedByScale));
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objScaleSpaceLoGMaximaBinned()
+{
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] binSize: Frames summed into each bin.
+    // [in] stride: Frames between the starts of bins, at most binSize.  0 for binSize.
+    // [in] mean: Nonzero to average rather than sum the frames of a bin.
+    // [in] neighborhoodSize: Odd integer.
+    // [in] scaleNeighborhoodSize: Odd integer.
+    // [out] maxima: matrix type IdxT size:[dim+2, N]. Rows are X, Y, ..., scale, T.  T is the first frame of the bin.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    checkNumArgs(2,6);
+    auto ims = getCube<FloatT>();
+    typename BoxxerT::TemporalBinningT binning;
+    binning.bin_size = getAsUnsigned<IdxT>();
+    binning.stride = getAsUnsigned<IdxT>();
+    binning.mean = getAsUnsigned<IdxT>()!=0;
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto scaleNeighborhoodSize = getAsUnsigned<IdxT>();
+    IMatT maxima;
+    VecT max_vals;
+    obj->scaleSpaceLoGMaximaBinned(ims, binning, maxima, max_vals, neighborhoodSize, scaleNeighborhoodSize);
+    output(maxima);
+    output(max_vals);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objScaleSpaceDoGMaximaBinned()
+{
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] binSize: Frames summed into each bin.
+    // [in] stride: Frames between the starts of bins, at most binSize.  0 for binSize.
+    // [in] mean: Nonzero to average rather than sum the frames of a bin.
+    // [in] neighborhoodSize: Odd integer.
+    // [in] scaleNeighborhoodSize: Odd integer.
+    // [out] maxima: matrix type IdxT size:[dim+2, N]. Rows are X, Y, ..., scale, T.  T is the first frame of the bin.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    checkNumArgs(2,6);
+    auto ims = getCube<FloatT>();
+    typename BoxxerT::TemporalBinningT binning;
+    binning.bin_size = getAsUnsigned<IdxT>();
+    binning.stride = getAsUnsigned<IdxT>();
+    binning.mean = getAsUnsigned<IdxT>()!=0;
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto scaleNeighborhoodSize = getAsUnsigned<IdxT>();
+    IMatT maxima;
+    VecT max_vals;
+    obj->scaleSpaceDoGMaximaBinned(ims, binning, maxima, max_vals, neighborhoodSize, scaleNeighborhoodSize);
+    output(maxima);
+    output(max_vals);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objScaleSpaceLoGMaximaMultiChannel()
+{
+    // [in] image: Stack of imsize shaped frames holding nChannels channels along the last dimension
+    // [in] nChannels: number of channels
+    // [in] interleaved: true if slices are ordered channel fastest, false if channel stacks are concatenated
+    // [in] neighborhoodSize: Odd integer.
+    // [in] scaleNeighborhoodSize: Odd integer.
+    // [out] maxima: matrix type IdxT size:[dim+3, N]. Rows are X, Y, scale, T, channel.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    checkNumArgs(2,5);
+    auto ims = getCube<FloatT>();
+    auto nChannels = getAsUnsigned<IdxT>();
+    auto interleaved = getAsUnsigned<IdxT>();
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto scaleNeighborhoodSize = getAsUnsigned<IdxT>();
+    using MultiT = boxxer::MultiChannel2D<FloatT,IdxT>;
+    MultiT multi(*obj, nChannels, interleaved ? MultiT::Layout::Interleaved : MultiT::Layout::Sequential);
+    IMatT maxima;
+    VecT max_vals;
+    multi.scaleSpaceLoGMaxima(ims, maxima, max_vals, neighborhoodSize, scaleNeighborhoodSize);
+    output(maxima);
+    output(max_vals);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objScaleSpaceDoGMaximaMultiChannel()
+{
+    // [in] image: Stack of imsize shaped frames holding nChannels channels along the last dimension
+    // [in] nChannels: number of channels
+    // [in] interleaved: true if slices are ordered channel fastest, false if channel stacks are concatenated
+    // [in] neighborhoodSize: Odd integer.
+    // [in] scaleNeighborhoodSize: Odd integer.
+    // [out] maxima: matrix type IdxT size:[dim+3, N]. Rows are X, Y, scale, T, channel.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    checkNumArgs(2,5);
+    auto ims = getCube<FloatT>();
+    auto nChannels = getAsUnsigned<IdxT>();
+    auto interleaved = getAsUnsigned<IdxT>();
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto scaleNeighborhoodSize = getAsUnsigned<IdxT>();
+    using MultiT = boxxer::MultiChannel2D<FloatT,IdxT>;
+    MultiT multi(*obj, nChannels, interleaved ? MultiT::Layout::Interleaved : MultiT::Layout::Sequential);
+    IMatT maxima;
+    VecT max_vals;
+    multi.scaleSpaceDoGMaxima(ims, maxima, max_vals, neighborhoodSize, scaleNeighborhoodSize);
+    output(maxima);
+    output(max_vals);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objCoincidentMaxima()
+{
+    // [in] maxima: matrix type IdxT size:[dim+3, N] as returned by scaleSpace*MaximaMultiChannel.
+    // [in] nChannels: number of channels
+    // [in] registration: size:[2, 3, nChannels] affine map of each channel into the reference frame, or empty.
+    // [in] radius: coincidence radius in pixels
+    // [out] nCoincident: type IdxT size:[N], number of other channels with a maxima within radius in the same frame.
+    checkNumArgs(1,4);
+    auto maxima = getMat<IdxT>();
+    auto nChannels = getAsUnsigned<IdxT>();
+    auto registration = getCube<FloatT>();
+    auto radius = getAsFloat<FloatT>();
+    boxxer::MultiChannel2D<FloatT,IdxT> multi(*obj, nChannels);
+    typename BoxxerT::IVecT nCoincident;
+    multi.coincidence(maxima, registration, radius, nCoincident);
+    output(nCoincident);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objScaleSpaceLoGMaximaMosaic()
+{
+    // [in] tiles: Stack of imsize shaped mosaic tiles
+    // [in] positions: matrix type IdxT size:[2, nTiles].  Mosaic [x,y] of pixel [0,0] of each tile.
+    // [in] neighborhoodSize: Odd integer.
+    // [in] scaleNeighborhoodSize: Odd integer.
+    // [out] maxima: matrix type IdxT size:[4, N]. Rows are X, Y, scale, tile in mosaic coordinates.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    checkNumArgs(2,4);
+    auto tiles = getCube<FloatT>();
+    auto positions = getMat<IdxT>();
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto scaleNeighborhoodSize = getAsUnsigned<IdxT>();
+    boxxer::Mosaic2D<FloatT,IdxT> mosaic(*obj, positions);
+    IMatT maxima;
+    VecT max_vals;
+    mosaic.scaleSpaceLoGMaxima(tiles, maxima, max_vals, neighborhoodSize, scaleNeighborhoodSize);
+    output(maxima);
+    output(max_vals);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objScaleSpaceDoGMaximaMosaic()
+{
+    // [in] tiles: Stack of imsize shaped mosaic tiles
+    // [in] positions: matrix type IdxT size:[2, nTiles].  Mosaic [x,y] of pixel [0,0] of each tile.
+    // [in] neighborhoodSize: Odd integer.
+    // [in] scaleNeighborhoodSize: Odd integer.
+    // [out] maxima: matrix type IdxT size:[4, N]. Rows are X, Y, scale, tile in mosaic coordinates.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    checkNumArgs(2,4);
+    auto tiles = getCube<FloatT>();
+    auto positions = getMat<IdxT>();
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto scaleNeighborhoodSize = getAsUnsigned<IdxT>();
+    boxxer::Mosaic2D<FloatT,IdxT> mosaic(*obj, positions);
+    IMatT maxima;
+    VecT max_vals;
+    mosaic.scaleSpaceDoGMaxima(tiles, maxima, max_vals, neighborhoodSize, scaleNeighborhoodSize);
+    output(maxima);
+    output(max_vals);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objScaleSpacePSFMaxima()
+{
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] psfs: Stack of odd sized centered PSFs.  Each PSF is used in place of a scale.
+    // [in] rank: Maximum number of separable terms per PSF
+    // [in] neighborhoodSize: Odd integer.
+    // [in] scaleNeighborhoodSize: Odd integer.
+    // [out] maxima: matrix type IdxT size:[dim+2, N]. Rows are X, Y, psf, T.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    // [out] rankErrors: size:[maxTerms+1, nPSFs] relative l2 error of each PSF against rank.
+    // [out] symmetryErrors: size:[nPSFs] relative l2-norm of the asymmetric part of each PSF.
+    checkNumArgs(4,5);
+    auto ims = getCube<FloatT>();
+    auto psf_stack = getCube<FloatT>();
+    auto rank = getAsUnsigned<IdxT>();
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto scaleNeighborhoodSize = getAsUnsigned<IdxT>();
+    arma::field<typename BoxxerT::ImageT> psfs(psf_stack.n_slices);
+    for(IdxT p=0; p<psf_stack.n_slices; p++) psfs(p) = psf_stack.slice(p);
+    boxxer::PSFBoxxer2D<FloatT,IdxT> psf_boxxer(obj->imsize, psfs, rank);
+    IMatT maxima;
+    VecT max_vals;
+    psf_boxxer.scaleSpaceMaxima(ims, maxima, max_vals, neighborhoodSize, scaleNeighborhoodSize);
+    output(maxima);
+    output(max_vals);
+    output(psf_boxxer.rankErrors());
+    output(psf_boxxer.symmetryErrors());
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objScaleSpaceDoGMaximaSweep()
+{
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] sigmaRatios: vector of DoG sigma ratios >1
+    // [in] neighborhoodSizes: vector of odd integers
+    // [in] scaleNeighborhoodSizes: vector of odd integers
+    // [in] thresholds: vector of detection thresholds
+    // [out] sweepParams: matrix type FloatT size:[4, nCombos]. rows are [sigmaRatio, neighborhoodSize, scaleNeighborhoodSize, threshold]
+    // [out] maxima: matrix type IdxT size:[dim+2, N]. Rows are X, Y, ..., T, combination index.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    checkNumArgs(3,5);
+    auto ims = getCube<FloatT>();
+    auto sigma_ratios = getVec<FloatT>();
+    auto neighborhood_sizes = getVec<IdxT>();
+    auto scale_neighborhood_sizes = getVec<IdxT>();
+    auto thresholds = getVec<FloatT>();
+    typename BoxxerT::MatT sweep_params;
+    arma::field<IMatT> combo_maxima;
+    arma::field<VecT> combo_max_vals;
+    IdxT nCombos = obj->scaleSpaceDoGMaximaSweep(ims, sigma_ratios, neighborhood_sizes, scale_neighborhood_sizes,
+                                                 thresholds, sweep_params, combo_maxima, combo_max_vals);
+    IdxT N = 0;
+    for(IdxT c=0; c<nCombos; c++) N += combo_max_vals(c).n_elem;
+    IMatT maxima(combo_maxima(0).n_rows+1, N);
+    VecT max_vals(N);
+    for(IdxT c=0, i=0; c<nCombos; c++) for(IdxT n=0; n<combo_max_vals(c).n_elem; n++, i++) {
+        maxima.col(i).head(combo_maxima(c).n_rows) = combo_maxima(c).col(n);
+        maxima(combo_maxima(c).n_rows, i) = c;
+        max_vals(i) = combo_max_vals(c)(n);
+    }
+    output(sweep_params);
+    output(maxima);
+    output(max_vals);
+}
+
 template<class FloatT, class IdxT>
 void Boxxer2D_IFace<FloatT,IdxT>::objFilterLoG()
 {
@@ -174,6 +839,22 @@ void Boxxer2D_IFace<FloatT,IdxT>::objFilterDoG()
     BoxxerT::filterDoG(ims, fims, sigma, sigma_ratio);
 }
 
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objFilterWavelet()
+{
+    // fimage = obj.filterWavelet(image,level)
+    // Image stack filter with a single a trous wavelet plane
+    //
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] level: wavelet level >=1.  Level j has scale about 2^(j-1) pixels.
+    // [out] fimage: Stack of imsize shaped filtered frames
+    checkNumArgs(1,2);
+    auto ims = getCube<FloatT>();
+    auto level = getAsUnsigned<IdxT>();
+    auto fims = makeOutputArray<FloatT>(ims.n_rows, ims.n_cols, ims.n_slices);
+    BoxxerT::filterWavelet(ims, fims, level);
+}
+
 template<class FloatT, class IdxT>
 void Boxxer2D_IFace<FloatT,IdxT>::objFilterGauss()
 {
@@ -210,4 +891,78 @@ void Boxxer2D_IFace<FloatT,IdxT>::objEnumerateImageMaxima()
     output(max_vals);
 }
 
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objDetectLoG()
+{
+    // [maxima,max_vals] = obj.detectLoG(image,sigma,neighborhoodSize,threshold)
+    // filterLoG followed by enumerateImageMaxima without storing the filtered stack.
+    //
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] sigma: Col vector size:[dim,1] of sigma size to filter
+    // [in] neighborhoodSize: Odd integer.
+    // [in] threshold: Only maxima with value strictly greater than threshold are returned.  -Inf for all maxima.
+    // [out] maxima: matrix type IdxT size:[dim+1, N]. Rows are X, Y, ..., T.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    checkNumArgs(2,4);
+    auto ims = getCube<FloatT>();
+    auto sigma = getVec<FloatT>();
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto threshold = getAsFloat<FloatT>();
+    IMatT maxima;
+    VecT max_vals;
+    BoxxerT::detectLoG(ims, sigma, maxima, max_vals, neighborhoodSize, threshold);
+    output(maxima);
+    output(max_vals);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objDetectDoG()
+{
+    // [maxima,max_vals] = obj.detectDoG(image,sigma,sigmaRatio,neighborhoodSize,threshold)
+    // filterDoG followed by enumerateImageMaxima without storing the filtered stack.
+    //
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] sigma: Col vector size:[dim,1] of sigma size to filter
+    // [in] sigmaRatio: scalar giving the ratio of sigmas in the DoG method
+    // [in] neighborhoodSize: Odd integer.
+    // [in] threshold: Only maxima with value strictly greater than threshold are returned.  -Inf for all maxima.
+    // [out] maxima: matrix type IdxT size:[dim+1, N]. Rows are X, Y, ..., T.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    checkNumArgs(2,5);
+    auto ims = getCube<FloatT>();
+    auto sigma = getVec<FloatT>();
+    auto sigma_ratio = getAsFloat<FloatT>();
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto threshold = getAsFloat<FloatT>();
+    IMatT maxima;
+    VecT max_vals;
+    BoxxerT::detectDoG(ims, sigma, sigma_ratio, maxima, max_vals, neighborhoodSize, threshold);
+    output(maxima);
+    output(max_vals);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer2D_IFace<FloatT,IdxT>::objDetectGauss()
+{
+    // [maxima,max_vals] = obj.detectGauss(image,sigma,neighborhoodSize,threshold)
+    // filterGauss followed by enumerateImageMaxima without storing the filtered stack.
+    //
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] sigma: Col vector size:[dim,1] of sigma size to filter
+    // [in] neighborhoodSize: Odd integer.
+    // [in] threshold: Only maxima with value strictly greater than threshold are returned.  -Inf for all maxima.
+    // [out] maxima: matrix type IdxT size:[dim+1, N]. Rows are X, Y, ..., T.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    checkNumArgs(2,4);
+    auto ims = getCube<FloatT>();
+    auto sigma = getVec<FloatT>();
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto threshold = getAsFloat<FloatT>();
+    IMatT maxima;
+    VecT max_vals;
+    BoxxerT::detectGauss(ims, sigma, maxima, max_vals, neighborhoodSize, threshold);
+    output(maxima);
+    output(max_vals);
+}
+
 #endif /* BOXXER_BOXXER2D_IFACE */
@@ -32,31 +32,69 @@ private:
 
     //Non-static member function calls
     void objSetDoGSigmaRatio();
+    void objSetWaveletFirstLevel();
+    void objSetDefectMap();
+    void objGetDefectMap();
+    void objDetectDefectMap();
     void objFilterScaledLoG();
     void objFilterScaledDoG();
+    void objFilterScaledWavelet();
     void objScaleSpaceLoGMaxima();
     void objScaleSpaceDoGMaxima();
+    void objScaleSpaceWaveletMaxima();
+    void objScaleSpaceLoGMaximaShape();
+    void objScaleSpaceLoGComponents();
+    void objScaleSpaceDoGComponents();
+    void objScaleSpaceLoGMaximaAdaptive();
+    void objScaleSpaceDoGMaximaAdaptive();
+    void objScaleSpaceLoGMaximaBinned();
+    void objScaleSpaceDoGMaximaBinned();
+    void objScaleSpaceLoGMaximaCascade();
+    void objScaleSpaceDoGMaximaCascade();
 
     // Static member function wrappers
     void objFilterLoG();
     void objFilterDoG();
+    void objFilterWavelet();
     void objFilterGauss();
     void objEnumerateImageMaxima();
+    void objDetectLoG();
+    void objDetectDoG();
+    void objDetectGauss();
 };
 
 template<class FloatT, class IdxT>
 Boxxer3D_IFace<FloatT,IdxT>::Boxxer3D_IFace()
 {
     methodmap["setDoGSigmaRatio"] = std::bind(&Boxxer3D_IFace::objSetDoGSigmaRatio, this);
+    methodmap["setWaveletFirstLevel"] = std::bind(&Boxxer3D_IFace::objSetWaveletFirstLevel, this);
+    methodmap["setDefectMap"] = std::bind(&Boxxer3D_IFace::objSetDefectMap, this);
+    methodmap["getDefectMap"] = std::bind(&Boxxer3D_IFace::objGetDefectMap, this);
+    methodmap["detectDefectMap"] = std::bind(&Boxxer3D_IFace::objDetectDefectMap, this);
     methodmap["filterScaledLoG"] = std::bind(&Boxxer3D_IFace::objFilterScaledLoG, this);
     methodmap["filterScaledDoG"] = std::bind(&Boxxer3D_IFace::objFilterScaledDoG, this);
+    methodmap["filterScaledWavelet"] = std::bind(&Boxxer3D_IFace::objFilterScaledWavelet, this);
     methodmap["scaleSpaceLoGMaxima"] = std::bind(&Boxxer3D_IFace::objScaleSpaceLoGMaxima, this);
     methodmap["scaleSpaceDoGMaxima"] = std::bind(&Boxxer3D_IFace::objScaleSpaceDoGMaxima, this);
+    methodmap["scaleSpaceWaveletMaxima"] = std::bind(&Boxxer3D_IFace::objScaleSpaceWaveletMaxima, this);
+    methodmap["scaleSpaceLoGMaximaShape"] = std::bind(&Boxxer3D_IFace::objScaleSpaceLoGMaximaShape, this);
+    methodmap["scaleSpaceLoGComponents"] = std::bind(&Boxxer3D_IFace::objScaleSpaceLoGComponents, this);
+    methodmap["scaleSpaceDoGComponents"] = std::bind(&Boxxer3D_IFace::objScaleSpaceDoGComponents, this);
+    methodmap["scaleSpaceLoGMaximaAdaptive"] = std::bind(&Boxxer3D_IFace::objScaleSpaceLoGMaximaAdaptive, this);
+    methodmap["scaleSpaceDoGMaximaAdaptive"] = std::bind(&Boxxer3D_IFace::objScaleSpaceDoGMaximaAdaptive, this);
+    methodmap["scaleSpaceLoGMaximaBinned"] = std::bind(&Boxxer3D_IFace::objScaleSpaceLoGMaximaBinned, this);
+    methodmap["scaleSpaceDoGMaximaBinned"] = std::bind(&Boxxer3D_IFace::objScaleSpaceDoGMaximaBinned, this);
+    methodmap["scaleSpaceLoGMaximaCascade"] = std::bind(&Boxxer3D_IFace::objScaleSpaceLoGMaximaCascade, this);
+    methodmap["scaleSpaceDoGMaximaCascade"] = std::bind(&Boxxer3D_IFace::objScaleSpaceDoGMaximaCascade, this);
 
     staticmethodmap["filterLoG"] = std::bind(&Boxxer3D_IFace::objFilterLoG, this);
     staticmethodmap["filterDoG"] = std::bind(&Boxxer3D_IFace::objFilterDoG, this);
+    staticmethodmap["filterWavelet"] = std::bind(&Boxxer3D_IFace::objFilterWavelet, this);
     staticmethodmap["filterGauss"] = std::bind(&Boxxer3D_IFace::objFilterGauss, this);
     staticmethodmap["enumerateImageMaxima"] = std::bind(&Boxxer3D_IFace::objEnumerateImageMaxima, this);
+    staticmethodmap["detectLoG"] = std::bind(&Boxxer3D_IFace::objDetectLoG, this);
+    staticmethodmap["detectDoG"] = std::bind(&Boxxer3D_IFace::objDetectDoG, this);
+    staticmethodmap["detectGauss"] = std::bind(&Boxxer3D_IFace::objDetectGauss, this);
 }
 
 template<class FloatT, class IdxT_>
@@ -79,6 +117,46 @@ void Boxxer3D_IFace<FloatT,IdxT>::objSetDoGSigmaRatio()
     obj->setDoGSigmaRatio(getAsFloat<FloatT>());
 }
 
+template<class FloatT, class IdxT>
+void Boxxer3D_IFace<FloatT,IdxT>::objSetWaveletFirstLevel()
+{
+    // [in] level: first a trous wavelet level used as scale 1.  Level j has scale about 2^(j-1) pixels.
+    checkNumArgs(0,1);
+    obj->setWaveletFirstLevel(getAsUnsigned<IdxT>());
+}
+
+template<class FloatT, class IdxT>
+void Boxxer3D_IFace<FloatT,IdxT>::objSetDefectMap()
+{
+    // [in] defects: uint8 imsize shaped map, nonzero at defective pixels.  All zeros disables defect patching.
+    checkNumArgs(0,1);
+    obj->setDefectMap(getCube<uint8_t>());
+}
+
+template<class FloatT, class IdxT>
+void Boxxer3D_IFace<FloatT,IdxT>::objGetDefectMap()
+{
+    // [out] defects: uint8 imsize shaped map, nonzero at defective pixels.
+    checkNumArgs(1,0);
+    output(obj->getDefectMap());
+}
+
+template<class FloatT, class IdxT>
+void Boxxer3D_IFace<FloatT,IdxT>::objDetectDefectMap()
+{
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] nWarmupFrames: Number of leading frames to examine
+    // [in] threshold: Outlier threshold in robust standard deviations of the neighbor median residual
+    // [in] minFraction: Fraction of the frames a pixel must be an outlier in to be flagged
+    // [out] nDefects: Number of defects found.  The map is set on the object.
+    checkNumArgs(1,4);
+    auto ims = getHypercube<FloatT>();
+    auto nWarmupFrames = getAsUnsigned<IdxT>();
+    auto threshold = getAsFloat<FloatT>();
+    auto min_fraction = getAsFloat<FloatT>();
+    output(obj->detectDefectMap(ims, nWarmupFrames, threshold, min_fraction));
+}
+
 template<class FloatT, class IdxT>
 void Boxxer3D_IFace<FloatT,IdxT>::objFilterScaledLoG()
 {
@@ -101,6 +179,17 @@ void Boxxer3D_IFace<FloatT,IdxT>::objFilterScaledDoG()
     obj->filterScaledDoG(im,fims);
 }
 
+template<class FloatT, class IdxT>
+void Boxxer3D_IFace<FloatT,IdxT>::objFilterScaledWavelet()
+{
+    // [in] image: imsize shaped frame Size 3D: [x y z]
+    // [out] fimage: Stack of imsize x nScales wavelet planes. Size 4D: [x y z S]
+    checkNumArgs(1,1);
+    auto im = getCube<FloatT>();
+    auto fims = makeOutputArray<FloatT>(im.n_rows, im.n_cols, im.n_slices, obj->nScales);
+    obj->filterScaledWavelet(im,fims);
+}
+
 template<class FloatT, class IdxT>
 void Boxxer3D_IFace<FloatT,IdxT>::objScaleSpaceLoGMaxima()
 {
@@ -139,6 +228,275 @@ void Boxxer3D_IFace<FloatT,IdxT>::objScaleSpaceDoGMaxima()
     output(max_vals);
 }
 
+template<class FloatT, class IdxT>
+void Boxxer3D_IFace<FloatT,IdxT>::objScaleSpaceWaveletMaxima()
+{
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] neighborhoodSize: Odd integer.  Acceptable values are in ValidMaximaNeighborhoodSizes.  (default=3)
+    // [in] scaleNeighborhoodSize: Odd integer.  Acceptable values are in ValidMaximaNeighborhoodSizes.  (default=3)
+    // [out] maxima: matrix type IdxT size:[dim+1, N]. List of maxima where rows are X, Y, ..., T and columns are different maxima detected.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    checkNumArgs(2,3);
+    auto ims = getHypercube<FloatT>();
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto scaleNeighborhoodSize = getAsUnsigned<IdxT>();
+    IMatT maxima;
+    VecT max_vals;
+    obj->scaleSpaceWaveletMaxima(ims, maxima, max_vals, neighborhoodSize, scaleNeighborhoodSize);
+    output(maxima);
+    output(max_vals);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer3D_IFace<FloatT,IdxT>::objScaleSpaceLoGMaximaShape()
+{
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] neighborhoodSize: Odd integer.  Acceptable values are in ValidMaximaNeighborhoodSizes.  (default=3)
+    // [in] scaleNeighborhoodSize: Odd integer.  Acceptable values are in ValidMaximaNeighborhoodSizes.  (default=3)
+    // [in] computeGradient: nonzero to also compute the gradient magnitude at each maxima
+    // [out] maxima: matrix type IdxT size:[dim+1, N]. List of maxima where rows are X, Y, ..., T and columns are different maxima detected.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    // [out] hessian_ratio; type FloatT size:[N], Hessian eigenvalue ratio at each maxima. 1=round, 0=line.
+    // [out] gradient; type FloatT size:[N], scale normalized gradient magnitude at each maxima.  Empty if not computed.
+    checkNumArgs(4,4);
+    auto ims = getHypercube<FloatT>();
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto scaleNeighborhoodSize = getAsUnsigned<IdxT>();
+    auto computeGradient = getAsUnsigned<IdxT>();
+    IMatT maxima;
+    VecT max_vals, hessian_ratio, gradient;
+    obj->scaleSpaceLoGMaximaShape(ims, maxima, max_vals, hessian_ratio, neighborhoodSize, scaleNeighborhoodSize,
+                                  computeGradient ? &gradient : nullptr);
+    output(maxima);
+    output(max_vals);
+    output(hessian_ratio);
+    output(gradient);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer3D_IFace<FloatT,IdxT>::objScaleSpaceLoGComponents()
+{
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] threshold: Pixels with maximum response over scales >threshold are foreground
+    // [out] components: matrix type IdxT size:[12, N]. Rows are [x_lo y_lo z_lo x_hi y_hi z_hi peak_x peak_y peak_z peak_scale area frame]
+    // [out] integrated: type FloatT size:[N], sum of the response over each component.
+    // [out] peak_vals: type FloatT size:[N], peak response of each component.
+    checkNumArgs(3,2);
+    auto ims = getHypercube<FloatT>();
+    auto threshold = getAsFloat<FloatT>();
+    IMatT components;
+    VecT integrated, peak_vals;
+    obj->scaleSpaceLoGComponents(ims, threshold, components, integrated, peak_vals);
+    output(components);
+    output(integrated);
+    output(peak_vals);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer3D_IFace<FloatT,IdxT>::objScaleSpaceDoGComponents()
+{
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] threshold: Pixels with maximum response over scales >threshold are foreground
+    // [out] components: matrix type IdxT size:[12, N]. Rows are [x_lo y_lo z_lo x_hi y_hi z_hi peak_x peak_y peak_z peak_scale area frame]
+    // [out] integrated: type FloatT size:[N], sum of the response over each component.
+    // [out] peak_vals: type FloatT size:[N], peak response of each component.
+    checkNumArgs(3,2);
+    auto ims = getHypercube<FloatT>();
+    auto threshold = getAsFloat<FloatT>();
+    IMatT components;
+    VecT integrated, peak_vals;
+    obj->scaleSpaceDoGComponents(ims, threshold, components, integrated, peak_vals);
+    output(components);
+    output(integrated);
+    output(peak_vals);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer3D_IFace<FloatT,IdxT>::objScaleSpaceLoGMaximaAdaptive()
+{
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] threshold: Only maxima with value strictly greater than threshold are returned.
+    // [in] neighborhoodSize: Odd integer.
+    // [in] scaleNeighborhoodSize: Odd integer.
+    // [in] window: Frames of peak responses used to choose the scales.
+    // [in] recheckPeriod: Every recheckPeriod-th frame is filtered at all scales.
+    // [in] margin: Scales are skipped when their peak was <= threshold-margin*|threshold|.
+    // [out] maxima: matrix type IdxT size:[dim+2, N]. Rows are X, Y, Z, scale, T.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    // [out] stats: size:[4] type double.  [nFrames, nFullFrames, nScaleFrames, nSkippedScaleFrames]
+    // [out] skippedByScale: size:[nScales] type double.  Frames skipped at each scale.
+    checkNumArgs(4,7);
+    auto ims = getHypercube<FloatT>();
+    auto threshold = getAsFloat<FloatT>();
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto scaleNeighborhoodSize = getAsUnsigned<IdxT>();
+    typename BoxxerT::AdaptiveScaleParams params;
+    params.window = getAsUnsigned<IdxT>();
+    params.recheck_period = getAsUnsigned<IdxT>();
+    params.margin = getAsFloat<FloatT>();
+    IMatT maxima;
+    VecT max_vals;
+    typename BoxxerT::AdaptiveScaleStats stats;
+    obj->scaleSpaceLoGMaximaAdaptive(ims, threshold, maxima, max_vals, neighborhoodSize, scaleNeighborhoodSize, params, &stats);
+    output(maxima);
+    output(max_vals);
+    arma::vec out_stats = {static_cast<double>(stats.nFrames), static_cast<double>(stats.nFullFrames),
+                           static_cast<double>(stats.nScaleFrames), static_cast<double>(stats.nSkippedScaleFrames)};
+    output(out_stats);
+    output(arma::conv_to<arma::vec>::from(stats.nSkippedByScale));
+}
+
+template<class FloatT, class IdxT>
+void Boxxer3D_IFace<FloatT,IdxT>::objScaleSpaceDoGMaximaAdaptive()
+{
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] threshold: Only maxima with value strictly greater than threshold are returned.
+    // [in] neighborhoodSize: Odd integer.
+    // [in] scaleNeighborhoodSize: Odd integer.
+    // [in] window: Frames of peak responses used to choose the scales.
+    // [in] recheckPeriod: Every recheckPeriod-th frame is filtered at all scales.
+    // [in] margin: Scales are skipped when their peak was <= threshold-margin*|threshold|.
+    // [out] maxima: matrix type IdxT size:[dim+2, N]. Rows are X, Y, Z, scale, T.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    // [out] stats: size:[4] type double.  [nFrames, nFullFrames, nScaleFrames, nSkippedScaleFrames]
+    // [out] skippedByScale: size:[nScales] type double.  Frames skipped at each scale.
+    checkNumArgs(4,7);
+    auto ims = getHypercube<FloatT>();
+    auto threshold = getAsFloat<FloatT>();
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto scaleNeighborhoodSize = getAsUnsigned<IdxT>();
+    typename BoxxerT::AdaptiveScaleParams params;
+    params.window = getAsUnsigned<IdxT>();
+    params.recheck_period = getAsUnsigned<IdxT>();
+    params.margin = getAsFloat<FloatT>();
+    IMatT maxima;
+    VecT max_vals;
+    typename BoxxerT::AdaptiveScaleStats stats;
+    obj->scaleSpaceDoGMaximaAdaptive(ims, threshold, maxima, max_vals, neighborhoodSize, scaleNeighborhoodSize, params, &stats);
+    output(maxima);
+    output(max_vals);
+    arma::vec out_stats = {static_cast<double>(stats.nFrames), static_cast<double>(stats.nFullFrames),
+                           static_cast<double>(stats.nScaleFrames), static_cast<double>(stats.nSkippedScaleFrames)};
+    output(out_stats);
+    output(arma::conv_to<arma::vec>::from(stats.nSkippedByScale));
+}
+
+template<class FloatT, class IdxT>
+void Boxxer3D_IFace<FloatT,IdxT>::objScaleSpaceLoGMaximaBinned()
+{
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] binSize: Frames summed into each bin.
+    // [in] stride: Frames between the starts of bins, at most binSize.  0 for binSize.
+    // [in] mean: Nonzero to average rather than sum the frames of a bin.
+    // [in] neighborhoodSize: Odd integer.
+    // [in] scaleNeighborhoodSize: Odd integer.
+    // [out] maxima: matrix type IdxT size:[dim+2, N]. Rows are X, Y, ..., scale, T.  T is the first frame of the bin.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    checkNumArgs(2,6);
+    auto ims = getHypercube<FloatT>();
+    typename BoxxerT::TemporalBinningT binning;
+    binning.bin_size = getAsUnsigned<IdxT>();
+    binning.stride = getAsUnsigned<IdxT>();
+    binning.mean = getAsUnsigned<IdxT>()!=0;
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto scaleNeighborhoodSize = getAsUnsigned<IdxT>();
+    IMatT maxima;
+    VecT max_vals;
+    obj->scaleSpaceLoGMaximaBinned(ims, binning, maxima, max_vals, neighborhoodSize, scaleNeighborhoodSize);
+    output(maxima);
+    output(max_vals);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer3D_IFace<FloatT,IdxT>::objScaleSpaceDoGMaximaBinned()
+{
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] binSize: Frames summed into each bin.
+    // [in] stride: Frames between the starts of bins, at most binSize.  0 for binSize.
+    // [in] mean: Nonzero to average rather than sum the frames of a bin.
+    // [in] neighborhoodSize: Odd integer.
+    // [in] scaleNeighborhoodSize: Odd integer.
+    // [out] maxima: matrix type IdxT size:[dim+2, N]. Rows are X, Y, ..., scale, T.  T is the first frame of the bin.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    checkNumArgs(2,6);
+    auto ims = getHypercube<FloatT>();
+    typename BoxxerT::TemporalBinningT binning;
+    binning.bin_size = getAsUnsigned<IdxT>();
+    binning.stride = getAsUnsigned<IdxT>();
+    binning.mean = getAsUnsigned<IdxT>()!=0;
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto scaleNeighborhoodSize = getAsUnsigned<IdxT>();
+    IMatT maxima;
+    VecT max_vals;
+    obj->scaleSpaceDoGMaximaBinned(ims, binning, maxima, max_vals, neighborhoodSize, scaleNeighborhoodSize);
+    output(maxima);
+    output(max_vals);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer3D_IFace<FloatT,IdxT>::objScaleSpaceLoGMaximaCascade()
+{
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] projectionThreshold: Threshold for the 2D maxima of the projected frames.
+    // [in] spectralDim: 0-based dimension projected out.
+    // [in] useMax: Nonzero to project by maximum rather than sum.
+    // [in] boxRadius: Half width of the box searched around each 2D maxima.  0 for ceil(2*max spatial sigma).
+    // [in] neighborhoodSize: Odd integer.
+    // [in] scaleNeighborhoodSize: Odd integer.
+    // [out] maxima: matrix type IdxT size:[dim+2, N]. Rows are X, Y, Z, scale, T.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    // [out] stats: size:[2] type double.  [nHits, nWindowVoxels]
+    checkNumArgs(3,7);
+    auto ims = getHypercube<FloatT>();
+    typename BoxxerT::SpectralCascadeParams params;
+    params.projection_threshold = getAsFloat<FloatT>();
+    params.spectral_dim = getAsUnsigned<IdxT>();
+    params.use_max = getAsUnsigned<IdxT>()!=0;
+    params.box_radius = getAsUnsigned<IdxT>();
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto scaleNeighborhoodSize = getAsUnsigned<IdxT>();
+    IMatT maxima;
+    VecT max_vals;
+    typename BoxxerT::SpectralCascadeStats stats;
+    obj->scaleSpaceLoGMaximaCascade(ims, params, maxima, max_vals, neighborhoodSize, scaleNeighborhoodSize, &stats);
+    output(maxima);
+    output(max_vals);
+    arma::vec out_stats = {static_cast<double>(stats.nHits), static_cast<double>(stats.nWindowVoxels)};
+    output(out_stats);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer3D_IFace<FloatT,IdxT>::objScaleSpaceDoGMaximaCascade()
+{
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] projectionThreshold: Threshold for the 2D maxima of the projected frames.
+    // [in] spectralDim: 0-based dimension projected out.
+    // [in] useMax: Nonzero to project by maximum rather than sum.
+    // [in] boxRadius: Half width of the box searched around each 2D maxima.  0 for ceil(2*max spatial sigma).
+    // [in] neighborhoodSize: Odd integer.
+    // [in] scaleNeighborhoodSize: Odd integer.
+    // [out] maxima: matrix type IdxT size:[dim+2, N]. Rows are X, Y, Z, scale, T.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    // [out] stats: size:[2] type double.  [nHits, nWindowVoxels]
+    checkNumArgs(3,7);
+    auto ims = getHypercube<FloatT>();
+    typename BoxxerT::SpectralCascadeParams params;
+    params.projection_threshold = getAsFloat<FloatT>();
+    params.spectral_dim = getAsUnsigned<IdxT>();
+    params.use_max = getAsUnsigned<IdxT>()!=0;
+    params.box_radius = getAsUnsigned<IdxT>();
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto scaleNeighborhoodSize = getAsUnsigned<IdxT>();
+    IMatT maxima;
+    VecT max_vals;
+    typename BoxxerT::SpectralCascadeStats stats;
+    obj->scaleSpaceDoGMaximaCascade(ims, params, maxima, max_vals, neighborhoodSize, scaleNeighborhoodSize, &stats);
+    output(maxima);
+    output(max_vals);
+    arma::vec out_stats = {static_cast<double>(stats.nHits), static_cast<double>(stats.nWindowVoxels)};
+    output(out_stats);
+}
+
 template<class FloatT, class IdxT>
 void Boxxer3D_IFace<FloatT,IdxT>::objFilterLoG()
 {
@@ -173,6 +531,22 @@ void Boxxer3D_IFace<FloatT,IdxT>::objFilterDoG()
     BoxxerT::filterDoG(ims, fims, sigma, sigma_ratio);
 }
 
+template<class FloatT, class IdxT>
+void Boxxer3D_IFace<FloatT,IdxT>::objFilterWavelet()
+{
+    // fimage = obj.filterWavelet(image,level)
+    // Image stack filter with a single a trous wavelet plane
+    //
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] level: wavelet level >=1.  Level j has scale about 2^(j-1) pixels.
+    // [out] fimage: Stack of imsize shaped filtered frames
+    checkNumArgs(1,2);
+    auto ims = getHypercube<FloatT>();
+    auto level = getAsUnsigned<IdxT>();
+    auto fims = makeOutputArray<FloatT>(ims.sX, ims.sY, ims.sZ, ims.sN);
+    BoxxerT::filterWavelet(ims, fims, level);
+}
+
 template<class FloatT, class IdxT>
 void Boxxer3D_IFace<FloatT,IdxT>::objFilterGauss()
 {
@@ -209,4 +583,78 @@ void Boxxer3D_IFace<FloatT,IdxT>::objEnumerateImageMaxima()
     output(max_vals);
 }
 
+template<class FloatT, class IdxT>
+void Boxxer3D_IFace<FloatT,IdxT>::objDetectLoG()
+{
+    // [maxima,max_vals] = obj.detectLoG(image,sigma,neighborhoodSize,threshold)
+    // filterLoG followed by enumerateImageMaxima without storing the filtered stack.
+    //
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] sigma: Col vector size:[dim,1] of sigma size to filter
+    // [in] neighborhoodSize: Odd integer.
+    // [in] threshold: Only maxima with value strictly greater than threshold are returned.  -Inf for all maxima.
+    // [out] maxima: matrix type IdxT size:[dim+1, N]. Rows are X, Y, ..., T.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    checkNumArgs(2,4);
+    auto ims = getHypercube<FloatT>();
+    auto sigma = getVec<FloatT>();
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto threshold = getAsFloat<FloatT>();
+    IMatT maxima;
+    VecT max_vals;
+    BoxxerT::detectLoG(ims, sigma, maxima, max_vals, neighborhoodSize, threshold);
+    output(maxima);
+    output(max_vals);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer3D_IFace<FloatT,IdxT>::objDetectDoG()
+{
+    // [maxima,max_vals] = obj.detectDoG(image,sigma,sigmaRatio,neighborhoodSize,threshold)
+    // filterDoG followed by enumerateImageMaxima without storing the filtered stack.
+    //
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] sigma: Col vector size:[dim,1] of sigma size to filter
+    // [in] sigmaRatio: scalar giving the ratio of sigmas in the DoG method
+    // [in] neighborhoodSize: Odd integer.
+    // [in] threshold: Only maxima with value strictly greater than threshold are returned.  -Inf for all maxima.
+    // [out] maxima: matrix type IdxT size:[dim+1, N]. Rows are X, Y, ..., T.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    checkNumArgs(2,5);
+    auto ims = getHypercube<FloatT>();
+    auto sigma = getVec<FloatT>();
+    auto sigma_ratio = getAsFloat<FloatT>();
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto threshold = getAsFloat<FloatT>();
+    IMatT maxima;
+    VecT max_vals;
+    BoxxerT::detectDoG(ims, sigma, sigma_ratio, maxima, max_vals, neighborhoodSize, threshold);
+    output(maxima);
+    output(max_vals);
+}
+
+template<class FloatT, class IdxT>
+void Boxxer3D_IFace<FloatT,IdxT>::objDetectGauss()
+{
+    // [maxima,max_vals] = obj.detectGauss(image,sigma,neighborhoodSize,threshold)
+    // filterGauss followed by enumerateImageMaxima without storing the filtered stack.
+    //
+    // [in] image: Stack of imsize shaped frames, last dimension is time
+    // [in] sigma: Col vector size:[dim,1] of sigma size to filter
+    // [in] neighborhoodSize: Odd integer.
+    // [in] threshold: Only maxima with value strictly greater than threshold are returned.  -Inf for all maxima.
+    // [out] maxima: matrix type IdxT size:[dim+1, N]. Rows are X, Y, ..., T.
+    // [out] max_vals; type FloatT size:[N], vector of values at each maxima.
+    checkNumArgs(2,4);
+    auto ims = getHypercube<FloatT>();
+    auto sigma = getVec<FloatT>();
+    auto neighborhoodSize = getAsUnsigned<IdxT>();
+    auto threshold = getAsFloat<FloatT>();
+    IMatT maxima;
+    VecT max_vals;
+    BoxxerT::detectGauss(ims, sigma, maxima, max_vals, neighborhoodSize, threshold);
+    output(maxima);
+    output(max_vals);
+}
+
 #endif /* BOXXER_BOXXER3D_IFACE */
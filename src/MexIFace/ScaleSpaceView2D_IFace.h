@@ -0,0 +1,119 @@
+/** @file ScaleSpaceView2D_IFace.h
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief ScaleSpaceView2D MexIFace
+ */
+
+#ifndef BOXXER_SCALESPACEVIEW2D_IFACE
+#define BOXXER_SCALESPACEVIEW2D_IFACE
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "MexIFace/MexIFace.h"
+#include "Boxxer/ScaleSpaceView2D.h"
+
+template<class FloatT=float, class IdxT_=uint32_t>
+class ScaleSpaceView2D_IFace : public mexiface::MexIFace,
+                               public mexiface::MexIFaceHandler<boxxer::ScaleSpaceView2D<FloatT,IdxT_>>
+{
+public:
+    ScaleSpaceView2D_IFace();
+
+private:
+    using ViewT = boxxer::ScaleSpaceView2D<FloatT,IdxT_>;
+    using BoxxerT = typename ViewT::BoxxerT;
+    using mexiface::MexIFaceHandler<ViewT>::obj;
+
+    //Constructor
+    void objConstruct() override;
+
+    //Non-static member function calls
+    void objView();
+    void objCacheStats();
+    void objClearCache();
+    void objWaitPrefetch();
+};
+
+template<class FloatT, class IdxT>
+ScaleSpaceView2D_IFace<FloatT,IdxT>::ScaleSpaceView2D_IFace()
+{
+    methodmap["view"] = std::bind(&ScaleSpaceView2D_IFace::objView, this);
+    methodmap["cacheStats"] = std::bind(&ScaleSpaceView2D_IFace::objCacheStats, this);
+    methodmap["clearCache"] = std::bind(&ScaleSpaceView2D_IFace::objClearCache, this);
+    methodmap["waitPrefetch"] = std::bind(&ScaleSpaceView2D_IFace::objWaitPrefetch, this);
+}
+
+template<class FloatT, class IdxT>
+void ScaleSpaceView2D_IFace<FloatT,IdxT>::objConstruct()
+{
+    // [in] imsize - size:[2] type IdxT. Image size [X Y]
+    // [in] sigma - size:[2, nScales] type FloatT.  scale-space sigmas Each column is a scale.
+    // [in] sigmaRatio - DoG sigma ratio >1
+    // [in] defects - uint8 imsize shaped map, nonzero at defective pixels.  All zeros disables defect patching.
+    // [in] movie - Stack of imsize shaped frames.  Copied, as the background prefetch outlives the mex call.
+    // [in] useDoG - Nonzero to view the DoG response in place of the LoG.
+    // [in] maxMBytes - memory bound for the tile cache in MB.
+    // [in] nPrefetch - neighboring frames to prefetch on each side of a request.
+    // [out] handle - A new MexIFace object handle
+    checkNumArgs(1,8);
+    auto imsize = getVec<IdxT>();
+    auto sigma = getMat<FloatT>();
+    auto sigma_ratio = getAsFloat<FloatT>();
+    auto defects = getMat<uint8_t>();
+    auto movie = std::make_shared<const typename BoxxerT::ImageStackT>(getCube<FloatT>());
+    auto use_DoG = getAsUnsigned<IdxT>();
+    auto max_mbytes = getAsUnsigned<IdxT>();
+    auto nPrefetch = getAsUnsigned<IdxT>();
+    BoxxerT engine(imsize, sigma);
+    engine.setDoGSigmaRatio(sigma_ratio);
+    engine.setDefectMap(defects);
+    this->outputHandle(new ViewT(engine, movie, use_DoG!=0, static_cast<std::size_t>(max_mbytes)<<20, nPrefetch));
+}
+
+template<class FloatT, class IdxT>
+void ScaleSpaceView2D_IFace<FloatT,IdxT>::objView()
+{
+    // [in] frame: 0-based frame index
+    // [in] scale: 0-based scale index
+    // [in] lo: size:[2] type IdxT.  0-based first [x,y] of the region.
+    // [in] hi: size:[2] type IdxT.  0-based [x,y] one past the end of the region.
+    // [out] out: The scale-space response of the region, size:hi-lo
+    checkNumArgs(1,4);
+    auto frame = getAsUnsigned<IdxT>();
+    auto scale = getAsUnsigned<IdxT>();
+    auto lo = getVec<IdxT>();
+    auto hi = getVec<IdxT>();
+    typename ViewT::ImageT out;
+    obj->view(frame, scale, lo, hi, out);
+    output(out);
+}
+
+template<class FloatT, class IdxT>
+void ScaleSpaceView2D_IFace<FloatT,IdxT>::objCacheStats()
+{
+    // [out] stats: size:[6] type FloatT.  [hits, misses, evictions, nEntries, MBytes, maxMBytes]
+    checkNumArgs(1,0);
+    auto stats = obj->cacheStats();
+    arma::Col<FloatT> out = {static_cast<FloatT>(stats.hits), static_cast<FloatT>(stats.misses),
+                             static_cast<FloatT>(stats.evictions), static_cast<FloatT>(stats.n_entries),
+                             static_cast<FloatT>(stats.bytes)/(1<<20), static_cast<FloatT>(stats.max_bytes)/(1<<20)};
+    output(out);
+}
+
+template<class FloatT, class IdxT>
+void ScaleSpaceView2D_IFace<FloatT,IdxT>::objClearCache()
+{
+    checkNumArgs(0,0);
+    obj->clearCache();
+}
+
+template<class FloatT, class IdxT>
+void ScaleSpaceView2D_IFace<FloatT,IdxT>::objWaitPrefetch()
+{
+    checkNumArgs(0,0);
+    obj->waitPrefetch();
+}
+
+#endif /* BOXXER_SCALESPACEVIEW2D_IFACE */
@@ -0,0 +1,180 @@
+/**
+ * @file Mosaic2D.cpp
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The Mosaic2D class definition
+ */
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include <omp.h>
+#include "OMPExceptionCatcher/OMPExceptionCatcher.h"
+#include "Boxxer/BoxxerError.h"
+#include "Boxxer/Mosaic2D.h"
+
+namespace boxxer {
+
+template<class FloatT, class IdxT>
+Mosaic2D<FloatT,IdxT>::Mosaic2D(const BoxxerT &engine, const IMatT &positions)
+    : engine(engine), positions(positions)
+{
+    if(positions.n_rows!=2 || positions.n_cols<1) {
+        std::ostringstream msg;
+        msg<<"Got tile positions of size: ["<<positions.n_rows<<","<<positions.n_cols<<"] expected: [2,nTiles]";
+        throw ParameterShapeError(msg.str());
+    }
+    IdxT K = nTiles();
+    mosaic_size = {0,0};
+    for(IdxT k=0; k<K; k++) for(IdxT d=0; d<2; d++)
+        mosaic_size(d) = std::max(mosaic_size(d), positions(d,k)+engine.imsize(d));
+    regions.resize(K);
+    for(IdxT k=0; k<K; k++) {
+        OwnedRegion &region = regions[k];
+        for(IdxT j=0; j<K; j++) {
+            bool overlap = true;
+            for(IdxT d=0; d<2; d++)
+                overlap = overlap && positions(d,j)<positions(d,k)+engine.imsize(d) &&
+                                     positions(d,k)<positions(d,j)+engine.imsize(d);
+            if(overlap) region.overlaps.push_back(j);
+        }
+        region.empty = true;
+        for(IdxT d=0; d<2; d++) {
+            region.lo[d] = positions(d,k)+engine.imsize(d);
+            region.hi[d] = positions(d,k);
+        }
+        for(IdxT y=positions(1,k); y<positions(1,k)+engine.imsize(1); y++)
+            for(IdxT x=positions(0,k); x<positions(0,k)+engine.imsize(0); x++) {
+                if(owner(x,y,region.overlaps)!=k) continue;
+                region.empty = false;
+                region.lo[0] = std::min(region.lo[0], x);
+                region.lo[1] = std::min(region.lo[1], y);
+                region.hi[0] = std::max(region.hi[0], x+1);
+                region.hi[1] = std::max(region.hi[1], y+1);
+            }
+    }
+}
+
+template<class FloatT, class IdxT>
+bool Mosaic2D<FloatT,IdxT>::covers(IdxT tile, IdxT x, IdxT y) const
+{
+    return x>=positions(0,tile) && x<positions(0,tile)+engine.imsize(0) &&
+           y>=positions(1,tile) && y<positions(1,tile)+engine.imsize(1);
+}
+
+/* Distances to tile centers are compared in doubled coordinates so they are exact integers */
+template<class FloatT, class IdxT>
+IdxT Mosaic2D<FloatT,IdxT>::owner(IdxT x, IdxT y, const std::vector<IdxT> &candidates) const
+{
+    IdxT best = nTiles();
+    int64_t best_dist = std::numeric_limits<int64_t>::max();
+    for(IdxT k: candidates) {
+        if(!covers(k,x,y)) continue;
+        int64_t dx = 2*static_cast<int64_t>(x) - (2*static_cast<int64_t>(positions(0,k)) + engine.imsize(0) - 1);
+        int64_t dy = 2*static_cast<int64_t>(y) - (2*static_cast<int64_t>(positions(1,k)) + engine.imsize(1) - 1);
+        int64_t dist = dx*dx + dy*dy;
+        if(dist<best_dist || (dist==best_dist && k<best)) {
+            best = k;
+            best_dist = dist;
+        }
+    }
+    return best;
+}
+
+template<class FloatT, class IdxT>
+IdxT Mosaic2D<FloatT,IdxT>::owner(IdxT x, IdxT y) const
+{
+    std::vector<IdxT> all(nTiles());
+    for(IdxT k=0; k<nTiles(); k++) all[k] = k;
+    return owner(x, y, all);
+}
+
+template<class FloatT, class IdxT>
+IdxT Mosaic2D<FloatT,IdxT>::scaleSpaceLoGMaxima(const ImageStackT &tiles, IMatT &maxima, VecT &max_vals,
+                                                IdxT neighborhood_size, IdxT scale_neighborhood_size) const
+{
+    return scaleSpaceMaxima(tiles, false, maxima, max_vals, neighborhood_size, scale_neighborhood_size);
+}
+
+template<class FloatT, class IdxT>
+IdxT Mosaic2D<FloatT,IdxT>::scaleSpaceDoGMaxima(const ImageStackT &tiles, IMatT &maxima, VecT &max_vals,
+                                                IdxT neighborhood_size, IdxT scale_neighborhood_size) const
+{
+    return scaleSpaceMaxima(tiles, true, maxima, max_vals, neighborhood_size, scale_neighborhood_size);
+}
+
+/**
+ * Each tile is one item of a dynamically scheduled OpenMP loop, as owned regions differ in size.  The window of a
+ * tile is its owned bounding box grown by Boxxer2D::filterWindowBounds(), as for the masked tiles of Boxxer2D, clipped
+ * to the mosaic, so the mirror boundary conditions apply only at the mosaic edges.  The gathered windows are defect
+ * free, and the FrameFilter of a thread rebuilds its filters only when the window size changes, which for a regular
+ * grid happens only between edge and interior tiles.
+ */
+template<class FloatT, class IdxT>
+IdxT Mosaic2D<FloatT,IdxT>::scaleSpaceMaxima(const ImageStackT &tiles, bool use_DoG, IMatT &maxima, VecT &max_vals,
+                                             IdxT neighborhood_size, IdxT scale_neighborhood_size) const
+{
+    IdxT K = nTiles();
+    if(tiles.n_rows!=engine.imsize(0) || tiles.n_cols!=engine.imsize(1) || tiles.n_slices!=K) {
+        std::ostringstream msg;
+        msg<<"Got tile stack of size: ["<<tiles.n_rows<<","<<tiles.n_cols<<","<<tiles.n_slices<<"] expected: ["
+           <<engine.imsize(0)<<","<<engine.imsize(1)<<","<<K<<"]";
+        throw ParameterShapeError(msg.str());
+    }
+    IdxT margin = std::max(std::max((neighborhood_size-1)/2, IdxT(1)), (scale_neighborhood_size-1)/2);
+    IVecT hw_max = engine.maxKernelHW();
+    arma::field<IMatT> tile_maxima(K); //These will come back 3xN
+    arma::field<VecT> tile_max_vals(K);
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel
+    {
+        typename BoxxerT::FrameFilter ff(engine, use_DoG);
+        ImageT window;
+        #pragma omp for schedule(dynamic)
+        for(IdxT k=0; k<K; k++) {
+            catcher.run([&]{
+                const OwnedRegion &region = regions[k];
+                if(region.empty) {
+                    tile_maxima(k).set_size(3,0);
+                    return;
+                }
+                IdxT win_lo[2], win_size[2];
+                BoxxerT::filterWindowBounds(region.lo, region.hi, mosaic_size, margin, hw_max, win_lo, win_size);
+                window.set_size(win_size[0], win_size[1]);
+                //Gather the window from the owning tiles
+                std::vector<IdxT> sources;
+                for(IdxT j=0; j<K; j++) {
+                    bool overlap = true;
+                    for(IdxT d=0; d<2; d++)
+                        overlap = overlap && positions(d,j)<win_lo[d]+win_size[d] &&
+                                             win_lo[d]<positions(d,j)+engine.imsize(d);
+                    if(overlap) sources.push_back(j);
+                }
+                for(IdxT y=0; y<win_size[1]; y++) for(IdxT x=0; x<win_size[0]; x++) {
+                    IdxT gx = win_lo[0]+x, gy = win_lo[1]+y;
+                    IdxT o = owner(gx, gy, sources);
+                    IdxT src = o<K ? o : k;
+                    IdxT tx = std::min(std::max(gx, positions(0,src)), positions(0,src)+engine.imsize(0)-1) - positions(0,src);
+                    IdxT ty = std::min(std::max(gy, positions(1,src)), positions(1,src)+engine.imsize(1)-1) - positions(1,src);
+                    window(x,y) = engine.defect_map ? engine.defect_map->patched_value(tiles.slice(src), tx, ty)
+                                                    : tiles.slice(src)(tx,ty);
+                }
+                //Keep only the maxima at owned pixels
+                auto owned = [&](IdxT x, IdxT y) {
+                    return x>=region.lo[0] && x<region.hi[0] && y>=region.lo[1] && y<region.hi[1] &&
+                           owner(x, y, region.overlaps)==k;
+                };
+                ff.filterPatched(window, win_lo[0], win_lo[1]);
+                ff.maxima(tile_maxima(k), tile_max_vals(k), neighborhood_size, scale_neighborhood_size, owned);
+            });
+        }
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+    return BoxxerT::combine_maxima(tile_maxima, tile_max_vals, maxima, max_vals);
+}
+
+/* Explicit Template Instantiation */
+template class Mosaic2D<float>;
+template class Mosaic2D<double>;
+
+} /* namespace boxxer */
@@ -0,0 +1,124 @@
+/**
+ * @file MovieFile.cpp
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The MovieFile class definition
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Boxxer/BoxxerError.h"
+#include "Boxxer/MovieFile.h"
+
+namespace boxxer {
+
+const char MovieFile::Magic[8] = {'B','O','X','X','M','O','V','1'};
+
+namespace {
+
+/* r = a*b, returning false on overflow */
+bool checkedMul(std::size_t a, std::size_t b, std::size_t &r)
+{
+    if(a!=0 && b>std::numeric_limits<std::size_t>::max()/a) return false;
+    r = a*b;
+    return true;
+}
+
+} /* namespace */
+
+static_assert(sizeof(MovieFile::Header)==32, "MovieFile header must be 32 bytes");
+
+MovieFile::MovieFile(const std::string &path)
+    : _path(path)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd<0) {
+        std::ostringstream msg;
+        msg<<"Unable to open movie file: "<<path<<" : "<<std::strerror(errno);
+        throw ParameterValueError(msg.str());
+    }
+    struct stat st;
+    if(::fstat(fd,&st)!=0 || static_cast<std::size_t>(st.st_size)<sizeof(Header)) {
+        ::close(fd);
+        std::ostringstream msg;
+        msg<<"Movie file is too small to contain a header: "<<path;
+        throw ParameterValueError(msg.str());
+    }
+    map_len = static_cast<std::size_t>(st.st_size);
+    map_addr = ::mmap(nullptr, map_len, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(map_addr==MAP_FAILED) {
+        map_addr = nullptr;
+        std::ostringstream msg;
+        msg<<"Unable to mmap movie file: "<<path<<" : "<<std::strerror(errno);
+        throw ParameterValueError(msg.str());
+    }
+    //The sizes are checked before they are multiplied, so a corrupt header cannot wrap around to match the file size
+    const Header *hdr = static_cast<const Header*>(map_addr);
+    const uint64_t max_idx = std::numeric_limits<IdxT>::max();
+    std::size_t frame_elems = 0, nelem = 0, data_bytes = 0;
+    bool valid = std::memcmp(hdr->magic, Magic, sizeof(Magic))==0 &&
+                 hdr->nrows<=max_idx && hdr->ncols<=max_idx && hdr->nframes<=max_idx &&
+                 checkedMul(hdr->nrows, hdr->ncols, frame_elems) &&
+                 checkedMul(frame_elems, hdr->nframes, nelem) &&
+                 checkedMul(nelem, sizeof(FloatT), data_bytes) &&
+                 map_len-sizeof(Header)==data_bytes;
+    if(!valid) {
+        ::munmap(map_addr, map_len);
+        map_addr = nullptr;
+        std::ostringstream msg;
+        msg<<"Invalid movie file header or size: "<<path;
+        throw ParameterValueError(msg.str());
+    }
+    _nrows = static_cast<IdxT>(hdr->nrows);
+    _ncols = static_cast<IdxT>(hdr->ncols);
+    _nframes = static_cast<IdxT>(hdr->nframes);
+    //The mapping is read-only.  The non-const pointer is only used to construct const Cube views.
+    _data = reinterpret_cast<FloatT*>(static_cast<char*>(map_addr)+sizeof(Header));
+}
+
+MovieFile::~MovieFile()
+{
+    if(map_addr) ::munmap(map_addr, map_len);
+}
+
+const MovieFile::ImageStackT MovieFile::frames(IdxT begin, IdxT end) const
+{
+    if(begin>end || end>_nframes) {
+        std::ostringstream msg;
+        msg<<"Bad frame range ["<<begin<<","<<end<<") for movie with "<<_nframes<<" frames";
+        throw ParameterValueError(msg.str());
+    }
+    std::size_t frame_elem = static_cast<std::size_t>(_nrows)*_ncols;
+    return ImageStackT(_data+begin*frame_elem, _nrows, _ncols, end-begin, false, false);
+}
+
+void MovieFile::write(const std::string &path, const ImageStackT &im)
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if(!out) {
+        std::ostringstream msg;
+        msg<<"Unable to open movie file for writing: "<<path;
+        throw ParameterValueError(msg.str());
+    }
+    Header hdr;
+    std::memcpy(hdr.magic, Magic, sizeof(Magic));
+    hdr.nrows = im.n_rows;
+    hdr.ncols = im.n_cols;
+    hdr.nframes = im.n_slices;
+    out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+    out.write(reinterpret_cast<const char*>(im.memptr()), im.n_elem*sizeof(FloatT));
+    if(!out) {
+        std::ostringstream msg;
+        msg<<"Error writing movie file: "<<path;
+        throw ParameterValueError(msg.str());
+    }
+}
+
+} /* namespace boxxer */
@@ -0,0 +1,189 @@
+/**
+ * @file MultiChannel2D.cpp
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The MultiChannel2D class definition
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+#include <vector>
+#include "Boxxer/BoxxerError.h"
+#include "Boxxer/MultiChannel2D.h"
+
+namespace boxxer {
+
+template<class FloatT, class IdxT>
+MultiChannel2D<FloatT,IdxT>::MultiChannel2D(const BoxxerT &engine, IdxT nChannels, Layout layout)
+    : engine(engine), nChannels(nChannels), layout(layout)
+{
+    if(nChannels<1) throw ParameterValueError("Non-positive number of channels.");
+}
+
+template<class FloatT, class IdxT>
+IdxT MultiChannel2D<FloatT,IdxT>::nFrames(const ImageStackT &im) const
+{
+    if(im.n_rows!=engine.imsize(0) || im.n_cols!=engine.imsize(1) || im.n_slices%nChannels!=0) {
+        std::ostringstream msg;
+        msg<<"Got image stack of size: ["<<im.n_rows<<","<<im.n_cols<<","<<im.n_slices<<"] expected frames: ["
+           <<engine.imsize(0)<<","<<engine.imsize(1)<<"] and #slices divisible by nChannels: "<<nChannels;
+        throw ParameterShapeError(msg.str());
+    }
+    return static_cast<IdxT>(im.n_slices/nChannels);
+}
+
+template<class FloatT, class IdxT>
+IdxT MultiChannel2D<FloatT,IdxT>::scaleSpaceLoGMaxima(const ImageStackT &im, IMatT &maxima, VecT &max_vals,
+                                                      IdxT neighborhood_size, IdxT scale_neighborhood_size) const
+{
+    return scaleSpaceMaxima(im, false, maxima, max_vals, neighborhood_size, scale_neighborhood_size);
+}
+
+template<class FloatT, class IdxT>
+IdxT MultiChannel2D<FloatT,IdxT>::scaleSpaceDoGMaxima(const ImageStackT &im, IMatT &maxima, VecT &max_vals,
+                                                      IdxT neighborhood_size, IdxT scale_neighborhood_size) const
+{
+    return scaleSpaceMaxima(im, true, maxima, max_vals, neighborhood_size, scale_neighborhood_size);
+}
+
+/**
+ * Every (frame, channel) pair is one item of the engine's frame loop, ordered with channel fastest.  The filters of
+ * the shared engine are built once per thread and used for all channels.
+ */
+template<class FloatT, class IdxT>
+IdxT MultiChannel2D<FloatT,IdxT>::scaleSpaceMaxima(const ImageStackT &im, bool use_DoG, IMatT &maxima, VecT &max_vals,
+                                                   IdxT neighborhood_size, IdxT scale_neighborhood_size) const
+{
+    IdxT nT = nFrames(im);
+    IdxT nItems = nT*nChannels;
+    if(nItems==0) {
+        maxima.set_size(5,0);
+        max_vals.reset();
+        return 0;
+    }
+    using ImageT = typename BoxxerT::ImageT;
+    auto item_frame = [&](IdxT item, ImageT &) -> const ImageT& {
+        return im.slice(sliceIndex(item/nChannels, item%nChannels, nT));
+    };
+    typename BoxxerT::FrameFilterPool pool;
+    IMatT item_coords;
+    IdxT Nmaxima = engine.scaleSpaceMaxima(nItems, item_frame, use_DoG, pool, item_coords, max_vals,
+                                           neighborhood_size, scale_neighborhood_size);
+    maxima.set_size(5,Nmaxima);
+    for(IdxT n=0; n<Nmaxima; n++) {
+        for(IdxT i=0; i<3; i++) maxima(i,n) = item_coords(i,n);
+        maxima(3,n) = item_coords(3,n)/nChannels;
+        maxima(4,n) = item_coords(3,n)%nChannels;
+    }
+    return Nmaxima;
+}
+
+template<class FloatT, class IdxT>
+void MultiChannel2D<FloatT,IdxT>::coincidence(const IMatT &maxima, const arma::Cube<FloatT> &registration,
+                                              FloatT radius, IVecT &nCoincident) const
+{
+    if(maxima.n_rows!=5) {
+        std::ostringstream msg;
+        msg<<"Got maxima with #rows: "<<maxima.n_rows<<" expected 5 rows [x, y, scale, frame, channel].";
+        throw ParameterShapeError(msg.str());
+    }
+    if(!registration.is_empty() &&
+       (registration.n_rows!=2 || registration.n_cols!=3 || registration.n_slices!=nChannels)) {
+        std::ostringstream msg;
+        msg<<"Got registration of size: ["<<registration.n_rows<<","<<registration.n_cols<<","<<registration.n_slices
+           <<"] expected [2,3,"<<nChannels<<"]";
+        throw ParameterShapeError(msg.str());
+    }
+    if(!(radius>0)) {
+        std::ostringstream msg;
+        msg<<"Got bad coincidence radius: "<<radius;
+        throw ParameterValueError(msg.str());
+    }
+    using CellT = long long;
+    IdxT N = static_cast<IdxT>(maxima.n_cols);
+    std::vector<double> rx(N), ry(N);
+    //Points sorted by (frame, cell y, cell x) form the grid; each cell is a contiguous run found by binary search
+    using KeyT = std::tuple<IdxT,CellT,CellT>;
+    std::vector<std::pair<KeyT,IdxT>> grid(N);
+    for(IdxT n=0; n<N; n++) {
+        IdxT c = maxima(4,n);
+        if(c>=nChannels) {
+            std::ostringstream msg;
+            msg<<"Got maxima with channel: "<<c<<" >= nChannels: "<<nChannels;
+            throw ParameterValueError(msg.str());
+        }
+        double x = maxima(0,n), y = maxima(1,n);
+        if(registration.is_empty()) {
+            rx[n] = x;
+            ry[n] = y;
+        } else {
+            const auto &R = registration.slice(c);
+            rx[n] = R(0,0)*x + R(0,1)*y + R(0,2);
+            ry[n] = R(1,0)*x + R(1,1)*y + R(1,2);
+        }
+        grid[n] = {KeyT(maxima(3,n), static_cast<CellT>(std::floor(ry[n]/radius)),
+                        static_cast<CellT>(std::floor(rx[n]/radius))), n};
+    }
+    std::sort(grid.begin(), grid.end());
+    double r2 = static_cast<double>(radius)*radius;
+    nCoincident.zeros(N);
+    std::vector<char> seen(nChannels);
+    for(IdxT n=0; n<N; n++) {
+        IdxT t = maxima(3,n);
+        IdxT c = maxima(4,n);
+        CellT cy = static_cast<CellT>(std::floor(ry[n]/radius));
+        CellT cx = static_cast<CellT>(std::floor(rx[n]/radius));
+        std::fill(seen.begin(), seen.end(), 0);
+        seen[c] = 1; //Only count other channels
+        IdxT count = 0;
+        for(CellT dy=-1; dy<=1; dy++) for(CellT dx=-1; dx<=1; dx++) {
+            KeyT key(t, cy+dy, cx+dx);
+            auto it = std::lower_bound(grid.begin(), grid.end(), std::make_pair(key,IdxT(0)));
+            for(; it!=grid.end() && it->first==key; ++it) {
+                IdxT m = it->second;
+                IdxT cm = maxima(4,m);
+                if(seen[cm]) continue;
+                double ddx = rx[m]-rx[n], ddy = ry[m]-ry[n];
+                if(ddx*ddx+ddy*ddy<=r2) {
+                    seen[cm] = 1;
+                    count++;
+                }
+            }
+        }
+        nCoincident(n) = count;
+    }
+}
+
+template<class FloatT, class IdxT>
+IdxT MultiChannel2D<FloatT,IdxT>::filterCoincident(IMatT &maxima, VecT &max_vals, const arma::Cube<FloatT> &registration,
+                                                   FloatT radius, IdxT min_channels) const
+{
+    if(max_vals.n_elem!=maxima.n_cols) {
+        std::ostringstream msg;
+        msg<<"Got #maxima: "<<maxima.n_cols<<" and #max_vals: "<<max_vals.n_elem;
+        throw ParameterShapeError(msg.str());
+    }
+    IVecT nCoincident;
+    coincidence(maxima, registration, radius, nCoincident);
+    IdxT Nmaxima = static_cast<IdxT>(maxima.n_cols);
+    IdxT new_Nmaxima = 0;
+    for(IdxT n=0; n<Nmaxima; n++) {
+        if(nCoincident(n)+1>=min_channels) {
+            if(new_Nmaxima<n) { //Compact in place, preserving order
+                maxima.col(new_Nmaxima) = maxima.col(n);
+                max_vals(new_Nmaxima) = max_vals(n);
+            }
+            new_Nmaxima++;
+        }
+    }
+    maxima.resize(maxima.n_rows,new_Nmaxima);
+    max_vals.resize(new_Nmaxima);
+    return new_Nmaxima;
+}
+
+/* Explicit Template Instantiation */
+template class MultiChannel2D<float,uint32_t>;
+template class MultiChannel2D<double,uint32_t>;
+
+} /* namespace boxxer */
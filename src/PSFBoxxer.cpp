@@ -0,0 +1,138 @@
+/**
+ * @file PSFBoxxer.cpp
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The PSFBoxxer class definition
+ */
+
+#include <array>
+#include <cmath>
+#include <omp.h>
+#include "OMPExceptionCatcher/OMPExceptionCatcher.h"
+#include "Boxxer/BoxxerError.h"
+#include "Boxxer/PSFBoxxer.h"
+
+namespace boxxer {
+
+namespace {
+template<class FloatT>
+std::array<arma::uword,3> psf_dims(const arma::Mat<FloatT> &psf) { return {{psf.n_rows, psf.n_cols, 1}}; }
+template<class FloatT>
+std::array<arma::uword,3> psf_dims(const arma::Cube<FloatT> &psf) { return {{psf.n_rows, psf.n_cols, psf.n_slices}}; }
+} /* namespace */
+
+template<int Dim, class FloatT, class IdxT>
+PSFBoxxer<Dim,FloatT,IdxT>::PSFBoxxer(const IVecT &imsize, const arma::field<PSFT> &psfs, IdxT rank)
+    : engine(imsize, psfSigma(psfs))
+{
+    for(IdxT p=0; p<psfs.n_elem; p++) filters.emplace_back(imsize, psfs(p), rank);
+}
+
+/**
+ * The RMS width about the center of the positive part of each PSF.  These are the engine sigmas, and give the
+ * approximate size of each PSF for later stages such as fitting.
+ */
+template<int Dim, class FloatT, class IdxT>
+typename PSFBoxxer<Dim,FloatT,IdxT>::MatT
+PSFBoxxer<Dim,FloatT,IdxT>::psfSigma(const arma::field<PSFT> &psfs)
+{
+    if(psfs.n_elem==0) throw ParameterValueError("Got empty list of PSFs.");
+    MatT sigma(Dim, psfs.n_elem);
+    for(IdxT p=0; p<psfs.n_elem; p++) {
+        auto dims = psf_dims(psfs(p));
+        const FloatT *P = psfs(p).memptr();
+        std::array<double,3> moment{{0,0,0}};
+        double total = 0;
+        for(arma::uword z=0; z<dims[2]; z++) for(arma::uword y=0; y<dims[1]; y++) for(arma::uword x=0; x<dims[0]; x++) {
+            double v = P[x+dims[0]*(y+dims[1]*z)];
+            if(!(v>0)) continue;
+            std::array<double,3> d{{x-(dims[0]-1)/2., y-(dims[1]-1)/2., z-(dims[2]-1)/2.}};
+            for(int i=0; i<Dim; i++) moment[i] += v*d[i]*d[i];
+            total += v;
+        }
+        for(int i=0; i<Dim; i++) {
+            double s = total>0 ? std::sqrt(moment[i]/total) : 0;
+            sigma(i,p) = s>0 ? s : 1;
+        }
+    }
+    return sigma;
+}
+
+template<int Dim, class FloatT, class IdxT>
+typename PSFBoxxer<Dim,FloatT,IdxT>::IVecT
+PSFBoxxer<Dim,FloatT,IdxT>::ranks() const
+{
+    IVecT r(filters.size());
+    for(IdxT p=0; p<filters.size(); p++) r(p) = filters[p].rank;
+    return r;
+}
+
+template<int Dim, class FloatT, class IdxT>
+typename PSFBoxxer<Dim,FloatT,IdxT>::VecT
+PSFBoxxer<Dim,FloatT,IdxT>::approximationErrors() const
+{
+    VecT err(filters.size());
+    for(IdxT p=0; p<filters.size(); p++) err(p) = filters[p].approximation_error();
+    return err;
+}
+
+template<int Dim, class FloatT, class IdxT>
+typename PSFBoxxer<Dim,FloatT,IdxT>::VecT
+PSFBoxxer<Dim,FloatT,IdxT>::symmetryErrors() const
+{
+    VecT err(filters.size());
+    for(IdxT p=0; p<filters.size(); p++) err(p) = filters[p].symmetry_error;
+    return err;
+}
+
+template<int Dim, class FloatT, class IdxT>
+typename PSFBoxxer<Dim,FloatT,IdxT>::MatT
+PSFBoxxer<Dim,FloatT,IdxT>::rankErrors() const
+{
+    IdxT nRows = 0;
+    for(auto &f: filters) nRows = std::max(nRows, static_cast<IdxT>(f.rank_error.n_elem));
+    MatT err(nRows, filters.size());
+    err.zeros();
+    for(IdxT p=0; p<filters.size(); p++)
+        for(IdxT r=0; r<filters[p].rank_error.n_elem; r++) err(r,p) = filters[p].rank_error(r);
+    return err;
+}
+
+template<int Dim, class FloatT, class IdxT>
+IdxT PSFBoxxer<Dim,FloatT,IdxT>::scaleSpaceMaxima(const ImageStackT &im, IMatT &maxima, VecT &max_vals,
+                                                  IdxT neighborhood_size, IdxT scale_neighborhood_size) const
+{
+    IdxT nT = static_cast<IdxT>(im.n_slices);
+    if(nT==0) {
+        maxima.set_size(Dim+2,0);
+        max_vals.reset();
+        return 0;
+    }
+    arma::field<IMatT> frame_maxima(nT); //These will come back (Dim+1)xN
+    arma::field<VecT> frame_max_vals(nT);
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel
+    {
+        std::vector<FilterT> thread_filters(filters); //Filters have internal storage
+        auto sim = engine.make_scaled_image();
+        typename BoxxerT::ImageT frame_buf;
+        #pragma omp for
+        for(IdxT n=0; n<nT; n++) {
+            catcher.run([&]{
+                const auto &frame = engine.defectFreeFrame(im.slice(n), frame_buf);
+                for(IdxT s=0; s<engine.nScales; s++) thread_filters[s].filter(frame, sim.slice(s));
+                engine.scaleSpaceFrameMaxima(sim, frame_maxima(n), frame_max_vals(n), neighborhood_size, scale_neighborhood_size);
+            });
+        }
+    }
+    catcher.rethrow(); //Rethrow any caught exceptions
+    return BoxxerT::combine_maxima(frame_maxima, frame_max_vals, maxima, max_vals);
+}
+
+/* Explicit Template Instantiation */
+template class PSFBoxxer<2,float,uint32_t>;
+template class PSFBoxxer<2,double,uint32_t>;
+template class PSFBoxxer<3,float,uint32_t>;
+template class PSFBoxxer<3,double,uint32_t>;
+
+} /* namespace boxxer */
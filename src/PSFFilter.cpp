@@ -0,0 +1,264 @@
+/** @file PSFFilter.cpp
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief Low-rank separable PSF filter class member function definitions.
+ */
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <vector>
+
+#include "Boxxer/BoxxerError.h"
+#include "Boxxer/PSFFilter.h"
+#include "Boxxer/FilterKernels.h"
+
+namespace boxxer {
+
+namespace {
+
+/** A rank-1 separable term: weight times the outer product of unit-norm full length 1D factors */
+struct SeparableTerm
+{
+    double weight;
+    std::array<arma::vec,3> factors;
+};
+
+const double MinTermWeight = 1e-12; //Terms below this weight of a unit-norm template are dropped
+const double MinOddNorm = 1e-12; //Odd parts of unit-norm factors below this are SVD round-off and are not filtered
+
+/**
+ * Check the PSF is odd sized, then remove the mean and normalize.  A 2D PSF has nz=1.
+ * @param symmetry_error [out] Relative l2-norm of the PSF less its average over reflections of each axis.
+ */
+template<class FloatT>
+arma::cube prepare_template(const FloatT *psf, arma::uword nx, arma::uword ny, arma::uword nz, double &symmetry_error)
+{
+    if(nx<3 || ny<3 || nx%2==0 || ny%2==0 || nz%2==0 || (nz>1 && nz<3)) {
+        std::ostringstream msg;
+        msg<<"PSF size must be odd and >=3 in each dimension.  Got size: ["<<nx<<","<<ny;
+        if(nz>1) msg<<","<<nz;
+        msg<<"]";
+        throw ParameterShapeError(msg.str());
+    }
+    double norm2 = 0;
+    for(arma::uword i=0; i<nx*ny*nz; i++) norm2 += static_cast<double>(psf[i])*psf[i];
+    if(!(norm2>0) || !std::isfinite(norm2)) throw ParameterValueError("Got PSF with zero or non-finite norm.");
+    auto P = [&](arma::uword x, arma::uword y, arma::uword z) { return static_cast<double>(psf[x+nx*(y+ny*z)]); };
+    arma::cube T(nx,ny,nz);
+    double asym2 = 0, mean = 0;
+    for(arma::uword z=0; z<nz; z++) for(arma::uword y=0; y<ny; y++) for(arma::uword x=0; x<nx; x++) {
+        arma::uword rx = nx-1-x, ry = ny-1-y, rz = nz-1-z;
+        double sym = (P(x,y,z) + P(rx,y,z) + P(x,ry,z) + P(rx,ry,z) +
+                      P(x,y,rz) + P(rx,y,rz) + P(x,ry,rz) + P(rx,ry,rz))/8;
+        T(x,y,z) = P(x,y,z);
+        asym2 += (P(x,y,z)-sym)*(P(x,y,z)-sym);
+        mean += P(x,y,z);
+    }
+    symmetry_error = std::sqrt(asym2/norm2);
+    mean /= nx*ny*nz;
+    double tnorm2 = 0;
+    for(arma::uword i=0; i<T.n_elem; i++) {
+        T(i) -= mean;
+        tnorm2 += T(i)*T(i);
+    }
+    if(!(tnorm2>0)) throw ParameterValueError("Got constant PSF.  A matched filter template must have structure.");
+    double tnorm = std::sqrt(tnorm2);
+    for(arma::uword i=0; i<T.n_elem; i++) T(i) /= tnorm;
+    return T;
+}
+
+/**
+ * Decompose a unit-norm template into orthogonal separable terms ordered by decreasing weight.
+ * 2D templates (n_slices=1) use a single SVD.  3D templates are unfolded as [nx x ny*nz], and each right singular
+ * vector, reshaped to [ny x nz], is decomposed by a second SVD.
+ */
+std::vector<SeparableTerm> separable_terms(const arma::cube &T)
+{
+    arma::uword nx = T.n_rows, ny = T.n_cols, nz = T.n_slices;
+    arma::mat M(nx, ny*nz);
+    for(arma::uword i=0; i<T.n_elem; i++) M(i) = T(i);
+    arma::mat U, V;
+    arma::vec s;
+    arma::svd(U, s, V, M);
+    std::vector<SeparableTerm> terms;
+    arma::uword nSV = std::min(nx, ny*nz);
+    for(arma::uword i=0; i<nSV; i++) {
+        if(s(i)<=MinTermWeight) continue;
+        if(nz==1) {
+            terms.push_back(SeparableTerm{s(i), {U.col(i), V.col(i), arma::vec()}});
+            continue;
+        }
+        arma::mat W(ny, nz);
+        for(arma::uword j=0; j<ny*nz; j++) W(j) = V(j,i);
+        arma::mat U2, V2;
+        arma::vec s2;
+        arma::svd(U2, s2, V2, W);
+        for(arma::uword j=0; j<std::min(ny,nz); j++) {
+            double w = s(i)*s2(j);
+            if(w>MinTermWeight) terms.push_back(SeparableTerm{w, {U.col(i), U2.col(j), V2.col(j)}});
+        }
+    }
+    std::stable_sort(terms.begin(), terms.end(),
+                     [](const SeparableTerm &a, const SeparableTerm &b) { return a.weight>b.weight; });
+    return terms;
+}
+
+/** rank_error(r) = sqrt(sum_{k>=r} weight_k^2), r=0..nTerms. */
+template<class VecT>
+VecT rank_errors(const std::vector<SeparableTerm> &terms)
+{
+    VecT err(terms.size()+1);
+    double tail2 = 0;
+    err(terms.size()) = 0;
+    for(std::size_t r=terms.size(); r>0; r--) {
+        tail2 += terms[r-1].weight*terms[r-1].weight;
+        err(r-1) = std::sqrt(tail2);
+    }
+    return err;
+}
+
+/** The half kernel [k(0) ... k(hw)] of the even part of a full length factor, scaled */
+template<class VecT>
+VecT even_half_kernel(const arma::vec &f, double scale)
+{
+    arma::uword c = (f.n_elem-1)/2;
+    VecT h(c+1);
+    for(arma::uword r=0; r<=c; r++) h(r) = scale*0.5*(f(c+r)+f(c-r));
+    return h;
+}
+
+/** The half kernel of the odd part of a full length unit-norm factor, scaled, or empty if the factor is even */
+template<class VecT>
+VecT odd_half_kernel(const arma::vec &f, double scale)
+{
+    arma::uword c = (f.n_elem-1)/2;
+    VecT h(c+1);
+    h(0) = 0;
+    double norm2 = 0;
+    for(arma::uword r=1; r<=c; r++) {
+        double odd = 0.5*(f(c+r)-f(c-r));
+        h(r) = scale*odd;
+        norm2 += 2*odd*odd;
+    }
+    return std::sqrt(norm2)>MinOddNorm ? h : VecT();
+}
+
+template<class IVecT>
+void check_image_size(const IVecT &size, arma::uword dim)
+{
+    if(size.n_elem!=dim || !arma::all(size>0)) {
+        std::ostringstream msg;
+        msg<<"Got bad image size: "<<size.t()<<" dim:"<<dim;
+        throw ParameterValueError(msg.str());
+    }
+}
+
+} /* namespace */
+
+/* PSFFilter2D */
+
+template<class FloatT, class IdxT>
+PSFFilter2D<FloatT,IdxT>::PSFFilter2D(const IVecT &size, const ImageT &psf, IdxT max_rank)
+    : size(size), hw({static_cast<IdxT>(psf.n_rows/2), static_cast<IdxT>(psf.n_cols/2)})
+{
+    check_image_size(size, 2);
+    double sym_err;
+    auto terms = separable_terms(prepare_template(psf.memptr(), psf.n_rows, psf.n_cols, 1, sym_err));
+    symmetry_error = sym_err;
+    rank_error = rank_errors<VecT>(terms);
+    if(max_rank<1) throw ParameterValueError("PSF filter rank must be positive.");
+    rank = std::min(max_rank, static_cast<IdxT>(terms.size()));
+    kernels.set_size(2, rank);
+    odd_kernels.set_size(2, rank);
+    for(IdxT k=0; k<rank; k++) for(IdxT d=0; d<2; d++) {
+        double scale = d==0 ? terms[k].weight : 1;
+        kernels(d,k) = even_half_kernel<VecT>(terms[k].factors[d], scale);
+        odd_kernels(d,k) = odd_half_kernel<VecT>(terms[k].factors[d], scale);
+    }
+    temp_im0.set_size(size(0),size(1));
+    temp_im1.set_size(size(0),size(1));
+}
+
+template<class FloatT, class IdxT>
+typename PSFFilter2D<FloatT,IdxT>::VecT
+PSFFilter2D<FloatT,IdxT>::rankErrors(const ImageT &psf, FloatT *symmetry_error)
+{
+    double sym_err;
+    auto terms = separable_terms(prepare_template(psf.memptr(), psf.n_rows, psf.n_cols, 1, sym_err));
+    if(symmetry_error) *symmetry_error = sym_err;
+    return rank_errors<VecT>(terms);
+}
+
+template<class FloatT, class IdxT>
+void PSFFilter2D<FloatT,IdxT>::filter(const ImageT &im, ImageT &out)
+{
+    for(IdxT k=0; k<rank; k++) {
+        kernels::gaussFIR_2Dy<FloatT>(im, temp_im0, kernels(1,k));
+        if(!odd_kernels(1,k).is_empty()) kernels::oddFIR_2Dy<FloatT>(im, temp_im0, odd_kernels(1,k));
+        ImageT &term = k==0 ? out : temp_im1;
+        kernels::gaussFIR_2Dx<FloatT>(temp_im0, term, kernels(0,k));
+        if(!odd_kernels(0,k).is_empty()) kernels::oddFIR_2Dx<FloatT>(temp_im0, term, odd_kernels(0,k));
+        if(k>0) out += temp_im1;
+    }
+}
+
+/* PSFFilter3D */
+
+template<class FloatT, class IdxT>
+PSFFilter3D<FloatT,IdxT>::PSFFilter3D(const IVecT &size, const ImageT &psf, IdxT max_rank)
+    : size(size), hw({static_cast<IdxT>(psf.n_rows/2), static_cast<IdxT>(psf.n_cols/2), static_cast<IdxT>(psf.n_slices/2)})
+{
+    check_image_size(size, 3);
+    if(psf.n_slices<3) throw ParameterShapeError("3D PSF must have at least 3 slices.");
+    double sym_err;
+    auto terms = separable_terms(prepare_template(psf.memptr(), psf.n_rows, psf.n_cols, psf.n_slices, sym_err));
+    symmetry_error = sym_err;
+    rank_error = rank_errors<VecT>(terms);
+    if(max_rank<1) throw ParameterValueError("PSF filter rank must be positive.");
+    rank = std::min(max_rank, static_cast<IdxT>(terms.size()));
+    kernels.set_size(3, rank);
+    odd_kernels.set_size(3, rank);
+    for(IdxT k=0; k<rank; k++) for(IdxT d=0; d<3; d++) {
+        double scale = d==0 ? terms[k].weight : 1;
+        kernels(d,k) = even_half_kernel<VecT>(terms[k].factors[d], scale);
+        odd_kernels(d,k) = odd_half_kernel<VecT>(terms[k].factors[d], scale);
+    }
+    temp_im0.set_size(size(0),size(1),size(2));
+    temp_im1.set_size(size(0),size(1),size(2));
+}
+
+template<class FloatT, class IdxT>
+typename PSFFilter3D<FloatT,IdxT>::VecT
+PSFFilter3D<FloatT,IdxT>::rankErrors(const ImageT &psf, FloatT *symmetry_error)
+{
+    if(psf.n_slices<3) throw ParameterShapeError("3D PSF must have at least 3 slices.");
+    double sym_err;
+    auto terms = separable_terms(prepare_template(psf.memptr(), psf.n_rows, psf.n_cols, psf.n_slices, sym_err));
+    if(symmetry_error) *symmetry_error = sym_err;
+    return rank_errors<VecT>(terms);
+}
+
+template<class FloatT, class IdxT>
+void PSFFilter3D<FloatT,IdxT>::filter(const ImageT &im, ImageT &out)
+{
+    for(IdxT k=0; k<rank; k++) {
+        kernels::gaussFIR_3Dz<FloatT>(im, temp_im0, kernels(2,k));
+        if(!odd_kernels(2,k).is_empty()) kernels::oddFIR_3Dz<FloatT>(im, temp_im0, odd_kernels(2,k));
+        kernels::gaussFIR_3Dy<FloatT>(temp_im0, temp_im1, kernels(1,k));
+        if(!odd_kernels(1,k).is_empty()) kernels::oddFIR_3Dy<FloatT>(temp_im0, temp_im1, odd_kernels(1,k));
+        ImageT &term = k==0 ? out : temp_im0;
+        kernels::gaussFIR_3Dx<FloatT>(temp_im1, term, kernels(0,k));
+        if(!odd_kernels(0,k).is_empty()) kernels::oddFIR_3Dx<FloatT>(temp_im1, term, odd_kernels(0,k));
+        if(k>0) out += temp_im0;
+    }
+}
+
+/* Explicit Template Instantiation */
+template class PSFFilter2D<float>;
+template class PSFFilter2D<double>;
+
+template class PSFFilter3D<float>;
+template class PSFFilter3D<double>;
+
+} /* namespace boxxer */
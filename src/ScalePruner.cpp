@@ -0,0 +1,63 @@
+/** @file ScalePruner.cpp
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The class definition for ScalePruner.
+ */
+
+#include <cmath>
+#include <sstream>
+#include "Boxxer/BoxxerError.h"
+#include "Boxxer/ScalePruner.h"
+
+namespace boxxer {
+
+template<class FloatT, class IdxT>
+ScalePruner<FloatT,IdxT>::ScalePruner(IdxT nScales, FloatT threshold, const Params &params)
+    : nScales(nScales), bound(threshold-params.margin*std::abs(threshold)), params(params), full_scan(true)
+{
+    if(params.recheck_period<1 || params.window<params.recheck_period) {
+        std::ostringstream msg;
+        msg<<"Got window: "<<params.window<<" recheck_period: "<<params.recheck_period
+           <<" expected 1<=recheck_period<=window";
+        throw ParameterValueError(msg.str());
+    }
+    if(!(params.margin>=0)) {
+        std::ostringstream msg;
+        msg<<"Got margin: "<<params.margin<<" expected >=0";
+        throw ParameterValueError(msg.str());
+    }
+    for(IdxT s=0; s<nScales; s++) all.push_back(s);
+    active = all;
+    stats_.nSkippedByScale.resize(nScales, 0);
+}
+
+template<class FloatT, class IdxT>
+void ScalePruner<FloatT,IdxT>::update(const MatT &peaks)
+{
+    for(IdxT n=0; n<peaks.n_cols; n++) {
+        IdxT nComputed = 0;
+        for(IdxT s=0; s<nScales; s++) {
+            if(std::isinf(peaks(s,n)) && peaks(s,n)<0) stats_.nSkippedByScale[s]++;
+            else nComputed++;
+        }
+        stats_.nFrames++;
+        stats_.nScaleFrames += nComputed;
+        stats_.nSkippedScaleFrames += nScales-nComputed;
+        if(nComputed==nScales) stats_.nFullFrames++;
+        window_peaks.push_back(peaks.col(n));
+        if(window_peaks.size()>params.window) window_peaks.pop_front();
+    }
+    full_scan = window_peaks.size()<params.window;
+    active.clear();
+    for(IdxT s=0; s<nScales; s++) {
+        bool keep = full_scan;
+        for(auto it=window_peaks.begin(); it!=window_peaks.end() && !keep; ++it) keep = (*it)(s)>bound;
+        if(keep) active.push_back(s);
+    }
+}
+
+/* Explicit Template Instantiation */
+template class ScalePruner<float>;
+template class ScalePruner<double>;
+
+} /* namespace boxxer */
@@ -0,0 +1,175 @@
+/**
+ * @file ScaleSpaceView2D.cpp
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The ScaleSpaceView2D class definition
+ */
+
+#include <algorithm>
+#include <omp.h>
+#include "OMPExceptionCatcher/OMPExceptionCatcher.h"
+#include "Boxxer/BoxxerError.h"
+#include "Boxxer/GaussFilter.h"
+#include "Boxxer/ScaleSpaceView2D.h"
+
+namespace boxxer {
+
+template<class FloatT, class IdxT>
+const IdxT ScaleSpaceView2D<FloatT,IdxT>::TileSize = 64;
+
+template<class FloatT, class IdxT>
+const std::size_t ScaleSpaceView2D<FloatT,IdxT>::DefaultMaxBytes = 256*1024*1024;
+
+template<class FloatT, class IdxT>
+ScaleSpaceView2D<FloatT,IdxT>::ScaleSpaceView2D(const BoxxerT &engine, std::shared_ptr<const ImageStackT> movie_,
+                                                bool use_DoG, std::size_t max_bytes, IdxT nPrefetch)
+    : engine(engine), use_DoG(use_DoG), nPrefetch(nPrefetch), movie(std::move(movie_)), cache(max_bytes)
+{
+    if(!movie) throw ParameterValueError("Got null movie.");
+    if(movie->n_rows!=engine.imsize(0) || movie->n_cols!=engine.imsize(1)) {
+        std::ostringstream msg;
+        msg<<"Got movie of size: ["<<movie->n_rows<<","<<movie->n_cols<<","<<movie->n_slices<<"] expected frame size: "
+           <<engine.imsize.t();
+        throw ParameterShapeError(msg.str());
+    }
+    prefetch_thread = std::thread(&ScaleSpaceView2D::prefetchLoop, this);
+}
+
+template<class FloatT, class IdxT>
+ScaleSpaceView2D<FloatT,IdxT>::~ScaleSpaceView2D()
+{
+    {
+        std::lock_guard<std::mutex> lock(prefetch_mtx);
+        prefetch_stop = true;
+        prefetch_queue.clear();
+    }
+    prefetch_cv.notify_all();
+    prefetch_thread.join();
+}
+
+template<class FloatT, class IdxT>
+void ScaleSpaceView2D<FloatT,IdxT>::view(IdxT frame, IdxT scale, ImageT &out)
+{
+    view(frame, scale, IVecT({0,0}), engine.imsize, out);
+}
+
+/**
+ * Missing tiles are filtered in parallel.  The prefetch queue is replaced with the same tiles of the frames
+ * frame+1, frame-1, ..., frame+nPrefetch, frame-nPrefetch, nearest first.
+ */
+template<class FloatT, class IdxT>
+void ScaleSpaceView2D<FloatT,IdxT>::view(IdxT frame, IdxT scale, const IVecT &lo, const IVecT &hi, ImageT &out)
+{
+    if(frame>=nFrames() || scale>=engine.nScales) {
+        std::ostringstream msg;
+        msg<<"Got frame: "<<frame<<" scale: "<<scale<<" expected frame<"<<nFrames()<<" scale<"<<engine.nScales;
+        throw ParameterValueError(msg.str());
+    }
+    if(lo.n_elem!=2 || hi.n_elem!=2 || lo(0)>=hi(0) || lo(1)>=hi(1) || hi(0)>engine.imsize(0) || hi(1)>engine.imsize(1)) {
+        std::ostringstream msg;
+        msg<<"Got bad region lo: "<<lo.t()<<" hi: "<<hi.t()<<" for frame size: "<<engine.imsize.t();
+        throw ParameterValueError(msg.str());
+    }
+    std::vector<TileKey> keys;
+    for(IdxT ty=(lo(1)/TileSize)*TileSize; ty<hi(1); ty+=TileSize)
+        for(IdxT tx=(lo(0)/TileSize)*TileSize; tx<hi(0); tx+=TileSize) keys.push_back(TileKey{frame,scale,tx,ty});
+    IdxT nKeys = static_cast<IdxT>(keys.size());
+    std::vector<typename TileCacheT::ImagePtrT> tiles(nKeys);
+    std::vector<IdxT> missing;
+    for(IdxT k=0; k<nKeys; k++) {
+        tiles[k] = cache.find(keys[k]);
+        if(!tiles[k]) missing.push_back(k);
+    }
+    IdxT nMissing = static_cast<IdxT>(missing.size());
+    omp_exception_catcher::OMPExceptionCatcher catcher;
+    #pragma omp parallel for if(nMissing>1)
+    for(IdxT m=0; m<nMissing; m++)
+        catcher.run([&]{
+            IdxT k = missing[m];
+            tiles[k] = computeTile(keys[k]);
+            cache.insert(keys[k], tiles[k]);
+        });
+    catcher.rethrow(); //Rethrow any caught exceptions
+
+    out.set_size(hi(0)-lo(0), hi(1)-lo(1));
+    for(IdxT k=0; k<nKeys; k++) {
+        const TileKey &key = keys[k];
+        const ImageT &tile = *tiles[k];
+        IdxT x0 = std::max(lo(0), key.tx), x1 = std::min(hi(0), key.tx+static_cast<IdxT>(tile.n_rows));
+        IdxT y0 = std::max(lo(1), key.ty), y1 = std::min(hi(1), key.ty+static_cast<IdxT>(tile.n_cols));
+        out.submat(x0-lo(0), y0-lo(1), x1-1-lo(0), y1-1-lo(1)) =
+            tile.submat(x0-key.tx, y0-key.ty, x1-1-key.tx, y1-1-key.ty);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(prefetch_mtx);
+        prefetch_queue.clear();
+        for(IdxT dn=1; dn<=nPrefetch; dn++) {
+            if(frame+dn<nFrames())
+                for(const TileKey &key: keys) prefetch_queue.push_back(TileKey{frame+dn,scale,key.tx,key.ty});
+            if(frame>=dn)
+                for(const TileKey &key: keys) prefetch_queue.push_back(TileKey{frame-dn,scale,key.tx,key.ty});
+        }
+    }
+    prefetch_cv.notify_one();
+}
+
+template<class FloatT, class IdxT>
+void ScaleSpaceView2D<FloatT,IdxT>::waitPrefetch()
+{
+    std::unique_lock<std::mutex> lock(prefetch_mtx);
+    idle_cv.wait(lock, [this]{ return prefetch_queue.empty() && !prefetch_busy; });
+}
+
+/**
+ * The window is the tile extended by the kernel half-width of its scale with Boxxer2D::filterWindowBounds(), so the
+ * tile has the same values as the whole filtered frame.
+ */
+template<class FloatT, class IdxT>
+typename ScaleSpaceView2D<FloatT,IdxT>::TileCacheT::ImagePtrT
+ScaleSpaceView2D<FloatT,IdxT>::computeTile(const TileKey &key) const
+{
+    IVecT hw = GaussFIRFilter<FloatT,IdxT>::default_kernel_hw(engine.sigma.col(key.scale));
+    IdxT tile_lo[2] = {key.tx, key.ty};
+    IdxT tile_hi[2] = {std::min(key.tx+TileSize, engine.imsize(0)), std::min(key.ty+TileSize, engine.imsize(1))};
+    IdxT win_lo[2], win_size[2];
+    BoxxerT::filterWindowBounds(tile_lo, tile_hi, engine.imsize, 0, hw, win_lo, win_size);
+    typename BoxxerT::FrameFilter ff(engine, use_DoG); //Builds only the filter of key.scale
+    const auto &sim = ff.filterWindow(movie->slice(key.frame), win_lo[0], win_lo[1], {win_size[0], win_size[1]},
+                                      {key.scale});
+    const ImageT &response = sim.slice(0);
+    return std::make_shared<const ImageT>(response.submat(tile_lo[0]-win_lo[0], tile_lo[1]-win_lo[1],
+                                                          tile_hi[0]-1-win_lo[0], tile_hi[1]-1-win_lo[1]));
+}
+
+/**
+ * The background prefetch thread.  Prefetching is best-effort, so errors are dropped; the same tile will be
+ * computed, and its error reported, if it is ever requested.
+ */
+template<class FloatT, class IdxT>
+void ScaleSpaceView2D<FloatT,IdxT>::prefetchLoop()
+{
+    while(true) {
+        TileKey key;
+        {
+            std::unique_lock<std::mutex> lock(prefetch_mtx);
+            prefetch_busy = false;
+            if(prefetch_queue.empty()) idle_cv.notify_all();
+            prefetch_cv.wait(lock, [this]{ return prefetch_stop || !prefetch_queue.empty(); });
+            if(prefetch_stop) return;
+            key = prefetch_queue.front();
+            prefetch_queue.pop_front();
+            prefetch_busy = true;
+        }
+        if(cache.contains(key)) continue;
+        try {
+            cache.insert(key, computeTile(key));
+        } catch(...) { }
+    }
+}
+
+/* Explicit Template Instantiation */
+template class ScaleSpaceView2D<float>;
+template class ScaleSpaceView2D<double>;
+
+} /* namespace boxxer */
@@ -0,0 +1,426 @@
+/**
+ * @file ShardRunner.cpp
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief The ShardRunner class definition
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <dirent.h>
+#include <sched.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <omp.h>
+#include "Boxxer/BoxxerError.h"
+#include "Boxxer/MovieFile.h"
+#include "Boxxer/Boxxer2D.h"
+#include "Boxxer/ShardRunner.h"
+
+extern char **environ;
+
+namespace boxxer {
+
+static const char MaximaFileMagic[8] = {'B','O','X','X','M','A','X','1'};
+
+ShardRunner::ShardRunner(const std::string &worker_path, IdxT nShards, IdxT threads_per_shard, bool numa_bind)
+    : worker_path(worker_path), nShards(nShards), threads_per_shard(threads_per_shard), numa_bind(numa_bind)
+{
+    if(nShards<1) throw ParameterValueError("Non-positive number of shards.");
+    if(::access(worker_path.c_str(), X_OK)!=0) {
+        std::ostringstream msg;
+        msg<<"Shard worker is not executable: "<<worker_path;
+        throw ParameterValueError(msg.str());
+    }
+}
+
+/**
+ * Find the scale-space maxima of a movie file using nShards worker processes.
+ *
+ * @param movie_path Path to a MovieFile.
+ * @param params Detection parameters
+ * @param work_dir Directory for the per-shard maxima files.  Each call writes them to its own new subdirectory,
+ *                 so concurrent calls never collide.  The subdirectory is removed after the merge or on error, and
+ *                 those left by runners that were killed are removed at the start.
+ * @param maxima [out] 4xN maxima rows=[x,y,scale,frame] in frame order.
+ * @param max_vals [out] Maxima values.
+ * @returns Number of maxima.
+ */
+ShardRunner::IdxT ShardRunner::scaleSpaceMaxima(const std::string &movie_path, const Params &params,
+                                                const std::string &work_dir, IMatT &maxima, VecT &max_vals) const
+{
+    IdxT nT = MovieFile(movie_path).nFrames();
+    IdxT nActive = std::min(nShards, nT);
+    maxima.set_size(4,0);
+    max_vals.reset();
+    if(nActive==0) return 0;
+    auto shard_cpus = assignShardCpus(nActive);
+    removeStaleShardFiles(work_dir);
+    std::string run_dir = makeRunDir(work_dir);
+
+    std::vector<pid_t> pids(nActive, -1);
+    std::vector<std::string> out_paths(nActive);
+    std::ostringstream errors;
+    for(IdxT i=0; i<nActive; i++) {
+        IdxT begin = static_cast<IdxT>(static_cast<uint64_t>(i)*nT/nActive);
+        IdxT end = static_cast<IdxT>(static_cast<uint64_t>(i+1)*nT/nActive);
+        out_paths[i] = run_dir+"/"+std::to_string(i)+".max";
+        IdxT nThreads = threads_per_shard;
+        if(nThreads==0) {
+            if(!shard_cpus[i].empty()) nThreads = static_cast<IdxT>(shard_cpus[i].size());
+            else nThreads = std::max<IdxT>(1, std::thread::hardware_concurrency()/nActive);
+        }
+        auto args = encodeWorkerArgs(movie_path, begin, end, params, out_paths[i], nThreads,
+                                     formatCpuList(shard_cpus[i]));
+        std::vector<char*> argv;
+        argv.push_back(const_cast<char*>(worker_path.c_str()));
+        for(auto &arg: args) argv.push_back(const_cast<char*>(arg.c_str()));
+        argv.push_back(nullptr);
+        int err = ::posix_spawn(&pids[i], worker_path.c_str(), nullptr, nullptr, argv.data(), environ);
+        if(err) {
+            pids[i] = -1;
+            errors<<"Unable to spawn shard "<<i<<": "<<std::strerror(err)<<". ";
+        }
+    }
+    for(IdxT i=0; i<nActive; i++) {
+        if(pids[i]<0) continue;
+        int status = 0;
+        pid_t ret;
+        while((ret = ::waitpid(pids[i], &status, 0))<0 && errno==EINTR) { }
+        if(ret<0) errors<<"Unable to wait for shard "<<i<<" worker: "<<std::strerror(errno)<<". ";
+        else if(!WIFEXITED(status) || WEXITSTATUS(status)!=0)
+            errors<<"Shard "<<i<<" worker failed with status: "<<status<<". ";
+    }
+    if(!errors.str().empty()) {
+        removeDir(run_dir);
+        throw ProcessError(errors.str());
+    }
+
+    //Deterministic merge: shards are contiguous frame ranges so concatenating in shard order is frame order
+    arma::field<IMatT> shard_maxima(nActive);
+    arma::field<VecT> shard_max_vals(nActive);
+    IdxT Nmaxima = 0;
+    try {
+        for(IdxT i=0; i<nActive; i++) {
+            readMaximaFile(out_paths[i], shard_maxima(i), shard_max_vals(i));
+            Nmaxima += static_cast<IdxT>(shard_max_vals(i).n_elem);
+        }
+    } catch(...) {
+        removeDir(run_dir);
+        throw;
+    }
+    removeDir(run_dir);
+    maxima.set_size(4,Nmaxima);
+    max_vals.set_size(Nmaxima);
+    IdxT Nsaved = 0;
+    for(IdxT i=0; i<nActive; i++) {
+        IdxT N = static_cast<IdxT>(shard_max_vals(i).n_elem);
+        if(N==0) continue;
+        maxima.cols(Nsaved,Nsaved+N-1) = shard_maxima(i);
+        max_vals.rows(Nsaved,Nsaved+N-1) = shard_max_vals(i);
+        Nsaved += N;
+    }
+    return Nmaxima;
+}
+
+/**
+ * Process frames [frame_begin, frame_end) of the movie and write the maxima to out_path.
+ * Frame indexes in the output are global movie frame indexes.
+ */
+ShardRunner::IdxT ShardRunner::runShard(const std::string &movie_path, IdxT frame_begin, IdxT frame_end,
+                                        const Params &params, const std::string &out_path)
+{
+    MovieFile movie(movie_path);
+    const auto ims = movie.frames(frame_begin, frame_end);
+    Boxxer2D<FloatT,IdxT> boxxer(movie.imsize(), params.sigma);
+    IMatT maxima;
+    VecT max_vals;
+    if(frame_end>frame_begin) {
+        if(params.use_DoG) {
+            boxxer.setDoGSigmaRatio(params.sigma_ratio);
+            boxxer.scaleSpaceDoGMaxima(ims, maxima, max_vals, params.neighborhood_size, params.scale_neighborhood_size);
+        } else {
+            boxxer.scaleSpaceLoGMaxima(ims, maxima, max_vals, params.neighborhood_size, params.scale_neighborhood_size);
+        }
+        for(IdxT n=0; n<maxima.n_cols; n++) maxima(maxima.n_rows-1,n) += frame_begin;
+    } else {
+        maxima.set_size(4,0);
+    }
+    //Write to a temporary and rename so a partially written file is never mistaken for a result
+    std::string tmp_path = out_path + ".tmp";
+    try {
+        writeMaximaFile(tmp_path, maxima, max_vals);
+    } catch(...) {
+        std::remove(tmp_path.c_str());
+        throw;
+    }
+    if(std::rename(tmp_path.c_str(), out_path.c_str())!=0) {
+        std::remove(tmp_path.c_str());
+        std::ostringstream msg;
+        msg<<"Unable to rename maxima file: "<<tmp_path<<" -> "<<out_path;
+        throw ProcessError(msg.str());
+    }
+    return static_cast<IdxT>(max_vals.n_elem);
+}
+
+/**
+ * Floats are encoded in hex so the worker sees exactly the same parameters as the parent.
+ *
+ * Worker command line:
+ *  movie_path out_path frame_begin frame_end method sigma_ratio neighborhood_size scale_neighborhood_size
+ *  nThreads cpu_list nScales sigma(0,0) sigma(1,0) ... sigma(1,nScales-1)
+ */
+std::vector<std::string> ShardRunner::encodeWorkerArgs(const std::string &movie_path, IdxT frame_begin, IdxT frame_end,
+                                                       const Params &params, const std::string &out_path,
+                                                       IdxT nThreads, const std::string &cpu_list)
+{
+    auto hexfloat = [](double v) {
+        char buf[64];
+        std::snprintf(buf, sizeof(buf), "%a", v);
+        return std::string(buf);
+    };
+    std::vector<std::string> args = {movie_path, out_path, std::to_string(frame_begin), std::to_string(frame_end),
+                                     params.use_DoG ? "DoG" : "LoG", hexfloat(params.sigma_ratio),
+                                     std::to_string(params.neighborhood_size), std::to_string(params.scale_neighborhood_size),
+                                     std::to_string(nThreads), cpu_list.empty() ? "-" : cpu_list,
+                                     std::to_string(params.sigma.n_cols)};
+    for(IdxT n=0; n<params.sigma.n_elem; n++) args.push_back(hexfloat(params.sigma(n)));
+    return args;
+}
+
+/**
+ * Entry point for the boxxerShardWorker executable.
+ * Pins the process to its CPU list before the OpenMP runtime starts any threads, so that the thread pool
+ * and all first-touch allocations stay on the shard's NUMA node.
+ */
+int ShardRunner::workerMain(int argc, char **argv)
+{
+    try {
+        if(argc<12) throw ParameterShapeError("Too few shard worker arguments.");
+        std::string movie_path = argv[1];
+        std::string out_path = argv[2];
+        IdxT frame_begin = static_cast<IdxT>(std::stoul(argv[3]));
+        IdxT frame_end = static_cast<IdxT>(std::stoul(argv[4]));
+        Params params;
+        params.use_DoG = std::string(argv[5])=="DoG";
+        params.sigma_ratio = std::strtof(argv[6], nullptr);
+        params.neighborhood_size = static_cast<IdxT>(std::stoul(argv[7]));
+        params.scale_neighborhood_size = static_cast<IdxT>(std::stoul(argv[8]));
+        IdxT nThreads = static_cast<IdxT>(std::stoul(argv[9]));
+        std::string cpu_list = argv[10];
+        IdxT nScales = static_cast<IdxT>(std::stoul(argv[11]));
+        if(argc != 12+2*static_cast<int>(nScales)) throw ParameterShapeError("Bad number of shard worker sigma arguments.");
+        params.sigma.set_size(2,nScales);
+        for(IdxT n=0; n<2*nScales; n++) params.sigma(n) = std::strtof(argv[12+n], nullptr);
+
+        if(cpu_list!="-") {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            for(int cpu: parseCpuList(cpu_list)) CPU_SET(cpu, &set);
+            if(::sched_setaffinity(0, sizeof(set), &set)!=0)
+                std::cerr<<"boxxerShardWorker: unable to set CPU affinity: "<<std::strerror(errno)<<std::endl;
+        }
+        if(nThreads>0) omp_set_num_threads(static_cast<int>(nThreads));
+        runShard(movie_path, frame_begin, frame_end, params, out_path);
+    } catch (std::exception &err) {
+        std::cerr<<"boxxerShardWorker: "<<err.what()<<std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+void ShardRunner::writeMaximaFile(const std::string &path, const IMatT &maxima, const VecT &max_vals)
+{
+    if(maxima.n_cols != max_vals.n_elem) throw ParameterShapeError("Maxima and max_vals sizes do not match.");
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    uint64_t nrows = maxima.n_rows;
+    uint64_t N = maxima.n_cols;
+    out.write(MaximaFileMagic, sizeof(MaximaFileMagic));
+    out.write(reinterpret_cast<const char*>(&nrows), sizeof(nrows));
+    out.write(reinterpret_cast<const char*>(&N), sizeof(N));
+    out.write(reinterpret_cast<const char*>(maxima.memptr()), maxima.n_elem*sizeof(IdxT));
+    out.write(reinterpret_cast<const char*>(max_vals.memptr()), max_vals.n_elem*sizeof(FloatT));
+    if(!out) {
+        std::ostringstream msg;
+        msg<<"Error writing maxima file: "<<path;
+        throw ProcessError(msg.str());
+    }
+}
+
+void ShardRunner::readMaximaFile(const std::string &path, IMatT &maxima, VecT &max_vals)
+{
+    std::ifstream in(path, std::ios::binary);
+    char magic[8];
+    uint64_t nrows=0, N=0;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(&nrows), sizeof(nrows));
+    in.read(reinterpret_cast<char*>(&N), sizeof(N));
+    if(!in || std::memcmp(magic, MaximaFileMagic, sizeof(magic))!=0) {
+        std::ostringstream msg;
+        msg<<"Invalid maxima file: "<<path;
+        throw ProcessError(msg.str());
+    }
+    maxima.set_size(nrows,N);
+    max_vals.set_size(N);
+    in.read(reinterpret_cast<char*>(maxima.memptr()), maxima.n_elem*sizeof(IdxT));
+    in.read(reinterpret_cast<char*>(max_vals.memptr()), max_vals.n_elem*sizeof(FloatT));
+    if(!in) {
+        std::ostringstream msg;
+        msg<<"Truncated maxima file: "<<path;
+        throw ProcessError(msg.str());
+    }
+}
+
+/**
+ * Make a new private run directory in work_dir for the shard files of one scaleSpaceMaxima call.  Run directories
+ * are named for the pid of their runner, with a unique suffix so concurrent calls in one process never collide.
+ */
+std::string ShardRunner::makeRunDir(const std::string &work_dir)
+{
+    std::string templ = work_dir+"/boxxer_shard_"+std::to_string(::getpid())+"_XXXXXX";
+    std::vector<char> path(templ.begin(), templ.end());
+    path.push_back('\0');
+    if(!::mkdtemp(path.data())) {
+        std::ostringstream msg;
+        msg<<"Unable to make shard directory in: "<<work_dir<<" : "<<std::strerror(errno);
+        throw ProcessError(msg.str());
+    }
+    return std::string(path.data());
+}
+
+/** Remove a run directory and the shard files in it */
+void ShardRunner::removeDir(const std::string &dir_path)
+{
+    if(DIR *dir = ::opendir(dir_path.c_str())) {
+        while(struct dirent *ent = ::readdir(dir)) {
+            if(std::strcmp(ent->d_name, ".")==0 || std::strcmp(ent->d_name, "..")==0) continue;
+            std::remove((dir_path+"/"+ent->d_name).c_str());
+        }
+        ::closedir(dir);
+    }
+    ::rmdir(dir_path.c_str());
+}
+
+/**
+ * Remove the run directories left in work_dir by runners that were killed before cleaning up.  Only runs of pids
+ * that no longer exist are removed, so the runs of live runners sharing the work_dir, including other calls in this
+ * process, are left alone.
+ */
+void ShardRunner::removeStaleShardFiles(const std::string &work_dir)
+{
+    DIR *dir = ::opendir(work_dir.c_str());
+    if(!dir) return;
+    std::vector<std::string> stale;
+    while(struct dirent *ent = ::readdir(dir)) {
+        int pid;
+        if(std::sscanf(ent->d_name, "boxxer_shard_%d_", &pid)!=1 || pid<=0) continue;
+        if(!(::kill(pid, 0)!=0 && errno==ESRCH)) continue;
+        stale.push_back(work_dir+"/"+ent->d_name);
+    }
+    ::closedir(dir);
+    for(auto &path: stale) {
+        struct stat st;
+        if(::lstat(path.c_str(), &st)!=0) continue;
+        if(S_ISDIR(st.st_mode)) removeDir(path);
+        else std::remove(path.c_str());
+    }
+}
+
+/**
+ * The CPUs of each NUMA node that this process is allowed to run on.  Nodes with no allowed CPUs are dropped.
+ * Without NUMA information in sysfs all allowed CPUs are reported as a single node.
+ */
+std::vector<std::vector<int>> ShardRunner::numaNodeCpus()
+{
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if(::sched_getaffinity(0, sizeof(allowed), &allowed)!=0)
+        for(unsigned cpu=0; cpu<std::thread::hardware_concurrency() && cpu<CPU_SETSIZE; cpu++) CPU_SET(cpu, &allowed);
+
+    std::vector<std::pair<int,std::vector<int>>> nodes;
+    const char *node_dir = "/sys/devices/system/node";
+    if(DIR *dir = ::opendir(node_dir)) {
+        while(struct dirent *ent = ::readdir(dir)) {
+            int node;
+            if(std::sscanf(ent->d_name, "node%d", &node)!=1) continue;
+            std::ifstream in(std::string(node_dir)+"/"+ent->d_name+"/cpulist");
+            std::string cpu_list;
+            if(!std::getline(in, cpu_list)) continue;
+            std::vector<int> cpus;
+            for(int cpu: parseCpuList(cpu_list)) if(cpu<CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) cpus.push_back(cpu);
+            if(!cpus.empty()) nodes.emplace_back(node, std::move(cpus));
+        }
+        ::closedir(dir);
+    }
+    std::sort(nodes.begin(), nodes.end());
+    std::vector<std::vector<int>> node_cpus;
+    for(auto &node: nodes) node_cpus.push_back(std::move(node.second));
+    if(node_cpus.empty()) {
+        std::vector<int> cpus;
+        for(int cpu=0; cpu<CPU_SETSIZE; cpu++) if(CPU_ISSET(cpu, &allowed)) cpus.push_back(cpu);
+        node_cpus.push_back(cpus);
+    }
+    return node_cpus;
+}
+
+/** Parse a Linux cpulist string, e.g., "0-3,8,10-11" */
+std::vector<int> ShardRunner::parseCpuList(const std::string &cpu_list)
+{
+    std::vector<int> cpus;
+    std::istringstream in(cpu_list);
+    std::string range;
+    while(std::getline(in, range, ',')) {
+        int first, last;
+        int n = std::sscanf(range.c_str(), "%d-%d", &first, &last);
+        if(n==1) last = first;
+        else if(n!=2 || last<first) {
+            std::ostringstream msg;
+            msg<<"Bad cpu list: "<<cpu_list;
+            throw ParameterValueError(msg.str());
+        }
+        for(int cpu=first; cpu<=last; cpu++) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+std::string ShardRunner::formatCpuList(const std::vector<int> &cpus)
+{
+    std::ostringstream out;
+    for(size_t i=0; i<cpus.size(); i++) out<<(i ? "," : "")<<cpus[i];
+    return out.str();
+}
+
+/**
+ * Shards are dealt round-robin to the NUMA nodes, and each node's CPUs are split evenly between its shards.
+ * With more shards than CPUs on a node, shards share CPUs.  Without numa_bind no shard is pinned.
+ */
+std::vector<std::vector<int>> ShardRunner::assignShardCpus(IdxT nActiveShards) const
+{
+    std::vector<std::vector<int>> shard_cpus(nActiveShards);
+    if(!numa_bind) return shard_cpus;
+    auto nodes = numaNodeCpus();
+    IdxT nNodes = static_cast<IdxT>(nodes.size());
+    for(IdxT node=0; node<nNodes; node++) {
+        std::vector<IdxT> shards;
+        for(IdxT i=node; i<nActiveShards; i+=nNodes) shards.push_back(i);
+        IdxT nCpus = static_cast<IdxT>(nodes[node].size());
+        IdxT nNodeShards = static_cast<IdxT>(shards.size());
+        for(IdxT k=0; k<nNodeShards; k++) {
+            IdxT begin = k*nCpus/nNodeShards;
+            IdxT end = std::max(begin+1, (k+1)*nCpus/nNodeShards);
+            for(IdxT c=begin; c<end; c++) shard_cpus[shards[k]].push_back(nodes[node][c%nCpus]);
+        }
+    }
+    return shard_cpus;
+}
+
+} /* namespace boxxer */
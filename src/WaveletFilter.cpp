@@ -0,0 +1,146 @@
+/** @file WaveletFilter.cpp
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief A trous wavelet filter class member function definitions.
+ */
+
+#include "Boxxer/BoxxerError.h"
+#include "Boxxer/WaveletFilter.h"
+#include "Boxxer/FilterKernels.h"
+
+namespace boxxer {
+
+namespace {
+template<class IVecT, class IdxT>
+void check_levels(const IVecT &size, IdxT dim, IdxT first_level, IdxT nLevels, IdxT max_level)
+{
+    if(size.n_elem!=dim || !arma::all(size>0)) {
+        std::ostringstream msg;
+        msg<<"Got bad size: "<<size.t()<<" dim:"<<dim;
+        throw ParameterValueError(msg.str());
+    }
+    if(first_level<1 || nLevels<1 || first_level+nLevels-1>max_level) {
+        std::ostringstream msg;
+        msg<<"Got bad wavelet levels first_level: "<<first_level<<" nLevels: "<<nLevels<<" max level: "<<max_level;
+        throw ParameterValueError(msg.str());
+    }
+}
+} /* namespace */
+
+/* AtrousFilter2D */
+
+template<class FloatT, class IdxT>
+const IdxT AtrousFilter2D<FloatT,IdxT>::MaxLevel=16;
+
+template<class FloatT, class IdxT>
+AtrousFilter2D<FloatT,IdxT>::AtrousFilter2D(const IVecT &size, IdxT first_level, IdxT nLevels)
+    : size(size), first_level(first_level), nLevels(nLevels)
+{
+    check_levels(size, IdxT(2), first_level, nLevels, MaxLevel);
+    v_prev.set_size(size(0),size(1));
+    v_next.set_size(size(0),size(1));
+    temp_im.set_size(size(0),size(1));
+}
+
+/**
+ * Levels below first_level are only smoothed.  The two smooth buffers alternate so no level is copied.
+ */
+template<class FloatT, class IdxT>
+template<class PlaneF>
+void AtrousFilter2D<FloatT,IdxT>::filter_levels(const ImageT &im, PlaneF plane)
+{
+    const ImageT *src = &im;
+    IdxT last_level = first_level+nLevels-1;
+    for(IdxT j=1; j<=last_level; j++) {
+        int32_t step = 1<<(j-1);
+        ImageT &dst = (j%2) ? v_next : v_prev;
+        kernels::atrousFIR_2Dx<FloatT>(*src, temp_im, step);
+        kernels::atrousFIR_2Dy<FloatT>(temp_im, dst, step);
+        if(j>=first_level) {
+            ImageT &w = plane(j-first_level);
+            const FloatT *a = src->memptr();
+            const FloatT *b = dst.memptr();
+            FloatT *out = w.memptr();
+            for(arma::uword i=0; i<dst.n_elem; i++) out[i] = a[i]-b[i];
+        }
+        src = &dst;
+    }
+}
+
+template<class FloatT, class IdxT>
+void AtrousFilter2D<FloatT,IdxT>::filter(const ImageT &im, ScaledImageT &out)
+{
+    filter_levels(im, [&](IdxT l) -> ImageT& { return out.slice(l); });
+}
+
+template<class FloatT, class IdxT>
+void AtrousFilter2D<FloatT,IdxT>::filter(const ImageT &im, ImageT &out)
+{
+    IdxT n = nLevels;
+    nLevels = 1;
+    filter_levels(im, [&](IdxT) -> ImageT& { return out; });
+    nLevels = n;
+}
+
+/* AtrousFilter3D */
+
+template<class FloatT, class IdxT>
+const IdxT AtrousFilter3D<FloatT,IdxT>::MaxLevel=16;
+
+template<class FloatT, class IdxT>
+AtrousFilter3D<FloatT,IdxT>::AtrousFilter3D(const IVecT &size, IdxT first_level, IdxT nLevels)
+    : size(size), first_level(first_level), nLevels(nLevels)
+{
+    check_levels(size, IdxT(3), first_level, nLevels, MaxLevel);
+    v_prev.set_size(size(0),size(1),size(2));
+    v_next.set_size(size(0),size(1),size(2));
+    temp_im0.set_size(size(0),size(1),size(2));
+    temp_im1.set_size(size(0),size(1),size(2));
+}
+
+template<class FloatT, class IdxT>
+template<class PlaneF>
+void AtrousFilter3D<FloatT,IdxT>::filter_levels(const ImageT &im, PlaneF plane)
+{
+    const ImageT *src = &im;
+    IdxT last_level = first_level+nLevels-1;
+    for(IdxT j=1; j<=last_level; j++) {
+        int32_t step = 1<<(j-1);
+        ImageT &dst = (j%2) ? v_next : v_prev;
+        kernels::atrousFIR_3Dz<FloatT>(*src, temp_im0, step);
+        kernels::atrousFIR_3Dy<FloatT>(temp_im0, temp_im1, step);
+        kernels::atrousFIR_3Dx<FloatT>(temp_im1, dst, step);
+        if(j>=first_level) {
+            ImageT &w = plane(j-first_level);
+            const FloatT *a = src->memptr();
+            const FloatT *b = dst.memptr();
+            FloatT *out = w.memptr();
+            for(arma::uword i=0; i<dst.n_elem; i++) out[i] = a[i]-b[i];
+        }
+        src = &dst;
+    }
+}
+
+template<class FloatT, class IdxT>
+void AtrousFilter3D<FloatT,IdxT>::filter(const ImageT &im, ScaledImageT &out)
+{
+    filter_levels(im, [&](IdxT l) -> ImageT& { return out.slice(l); });
+}
+
+template<class FloatT, class IdxT>
+void AtrousFilter3D<FloatT,IdxT>::filter(const ImageT &im, ImageT &out)
+{
+    IdxT n = nLevels;
+    nLevels = 1;
+    filter_levels(im, [&](IdxT) -> ImageT& { return out; });
+    nLevels = n;
+}
+
+/* Explicit Template Instantiation */
+template class AtrousFilter2D<float>;
+template class AtrousFilter2D<double>;
+
+template class AtrousFilter3D<float>;
+template class AtrousFilter3D<double>;
+
+} /* namespace boxxer */
@@ -0,0 +1,30 @@
+/**
+ * @file boxxerCompressMovie.cpp
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief Convert a boxxer::MovieFile to a boxxer::CompressedMovieFile.
+ *
+ * Usage: boxxerCompressMovie <movie_path> <compressed_path>
+ */
+
+#include <iostream>
+#include "Boxxer/MovieFile.h"
+#include "Boxxer/CompressedMovieFile.h"
+
+int main(int argc, char **argv)
+{
+    if(argc!=3) {
+        std::cerr<<"Usage: "<<argv[0]<<" <movie_path> <compressed_path>"<<std::endl;
+        return 2;
+    }
+    try {
+        boxxer::MovieFile movie(argv[1]);
+        boxxer::CompressedMovieFile::write(argv[2], movie.frames(0, movie.nFrames()));
+        boxxer::CompressedMovieFile out(argv[2]);
+        std::cout<<"Compressed "<<out.nFrames()<<" frames with ratio "<<out.compressionRatio()<<std::endl;
+    } catch (std::exception &err) {
+        std::cerr<<"boxxerCompressMovie: "<<err.what()<<std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,47 @@
+/**
+ * @file boxxerDaemon.cpp
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief Local detection daemon.  Serves boxxer::DetectionClient requests until SIGINT or SIGTERM.
+ *
+ * Usage: boxxerDaemon [-g] <socket_path> [nThreads] [maxEngines]
+ *
+ * -g Give the socket group access (mode 0660 instead of 0600).
+ */
+
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <pthread.h>
+#include "Boxxer/DetectionDaemon.h"
+
+int main(int argc, char **argv)
+{
+    bool group_access = argc>1 && std::strcmp(argv[1], "-g")==0;
+    int arg0 = group_access ? 2 : 1;
+    if(argc<arg0+1 || argc>arg0+3) {
+        std::cerr<<"Usage: "<<argv[0]<<" [-g] <socket_path> [nThreads] [maxEngines]"<<std::endl;
+        return 2;
+    }
+    //Block termination signals in all server threads, and wait for them here
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    try {
+        uint32_t nThreads = argc>arg0+1 ? static_cast<uint32_t>(std::atoi(argv[arg0+1])) : 0;
+        uint32_t max_engines = argc>arg0+2 ? static_cast<uint32_t>(std::atoi(argv[arg0+2]))
+                                           : boxxer::DetectionServer::DefaultMaxEngines;
+        boxxer::DetectionServer server(argv[arg0], nThreads, max_engines, group_access);
+        server.start();
+        int sig;
+        sigwait(&signals, &sig);
+        server.stop();
+    } catch (std::exception &err) {
+        std::cerr<<"boxxerDaemon: "<<err.what()<<std::endl;
+        return 1;
+    }
+    return 0;
+}
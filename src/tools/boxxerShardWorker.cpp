@@ -0,0 +1,13 @@
+/**
+ * @file boxxerShardWorker.cpp
+ * @author Mark J. Olah (mjo\@cs.unm DOT edu)
+ * @date 2014-2019
+ * @brief Worker process for boxxer::ShardRunner.  Processes one frame-range shard of a movie file.
+ */
+
+#include "Boxxer/ShardRunner.h"
+
+int main(int argc, char **argv)
+{
+    return boxxer::ShardRunner::workerMain(argc, argv);
+}
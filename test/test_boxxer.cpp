@@ -1,14 +1,50 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <vector>
 
 #include "Boxxer/FilterKernels.h"
 #include "Boxxer/GaussFilter.h"
 #include "Boxxer/Maxima.h"
+#include "Boxxer/MaximaND.h"
+#include "Boxxer/FilterND.h"
 #include "Boxxer/Boxxer2D.h"
 #include "Boxxer/Boxxer3D.h"
+#include "Boxxer/BatchRunner2D.h"
+#include "Boxxer/MultiChannel2D.h"
+#include "Boxxer/PSFBoxxer.h"
+#include "Boxxer/WaveletFilter.h"
+#include "Boxxer/Components.h"
+#include "Boxxer/Mosaic2D.h"
+#include "Boxxer/ScaleSpaceView2D.h"
+#ifdef BOXXER_POSIX_TOOLS
+#include <fstream>
+#include <thread>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "Boxxer/MovieFile.h"
+#include "Boxxer/CompressedMovieFile.h"
+#include "Boxxer/HypercubeFile.h"
+#include "Boxxer/ShardRunner.h"
+#include "Boxxer/DetectionDaemon.h"
+#endif
 
 using std::cout;
 using std::endl;
 using namespace arma;
 using namespace boxxer;
+
+/* Checks report each failure with fail()<<message, and main() returns nonzero if any failed */
+int nFailures = 0;
+std::ostream& fail()
+{
+    nFailures++;
+    return cout<<"*** ";
+}
 // #include "maxima.h"
 
 // void time1D(int N, double sigma, double tol)
@@ -259,6 +295,245 @@ void testLoGFilter3D()
 }
 
 
+void testGaussFIR3Dz()
+{
+    typedef float TestFloat;
+    //Plane sizes that are smaller than, equal to, and not a multiple of the pencil size
+    unsigned sizes[3][3] = {{7,5,40},{32,16,33},{45,29,64}};
+    auto kernel = GaussFIRFilter<TestFloat>::compute_Gauss_FIR_kernel(2.0, 6);
+    int bad = 0;
+    for(auto &sz: sizes) {
+        arma::Cube<TestFloat> data(sz[0],sz[1],sz[2]), fast(sz[0],sz[1],sz[2]), slow(sz[0],sz[1],sz[2]);
+        data.randu();
+        kernels::gaussFIR_3Dz<TestFloat>(data, fast, kernel);
+        kernels::gaussFIR_3Dz_small<TestFloat>(data, slow, kernel);
+        TestFloat eps = 4*std::numeric_limits<TestFloat>::epsilon();
+        for(unsigned i=0; i<data.n_elem; i++) if(fabs(fast(i)-slow(i))>eps) bad++;
+    }
+    if(bad) fail()<<"gaussFIR_3Dz: "<<bad<<" pixels differ from the reference filter\n";
+    else std::cout<<"gaussFIR_3Dz pencils: all match\n";
+}
+
+/* Linear index of coords in a column-major array, or -1 if out of bounds */
+template<int Rank>
+long ndIndex(const std::array<uint32_t,Rank> &size, const std::array<long,Rank> &coords)
+{
+    long idx = 0, stride = 1;
+    for(int r=0; r<Rank; r++) {
+        if(coords[r]<0 || coords[r]>=static_cast<long>(size[r])) return -1;
+        idx += coords[r]*stride;
+        stride *= size[r];
+    }
+    return idx;
+}
+
+/* Call f(coords) for every offset in [-k,k]^Rank about center */
+template<int Rank, class F>
+void forBox(const std::array<long,Rank> &center, long k, F f)
+{
+    std::array<long,Rank> c;
+    for(int r=0; r<Rank; r++) c[r] = center[r]-k;
+    while(true) {
+        f(c);
+        int r = 0;
+        for(; r<Rank; r++) {
+            if(c[r]<center[r]+k) { c[r]++; break; }
+            c[r] = center[r]-k;
+        }
+        if(r==Rank) return;
+    }
+}
+
+/* Brute force maxima in raster order: strict 3^Rank maxima with no larger pixel in the nbhd box */
+template<int Rank, class FloatT>
+arma::Mat<uint32_t> bruteMaximaND(const std::array<uint32_t,Rank> &size, const FloatT *im, uint32_t nbhd)
+{
+    std::size_t N = 1;
+    for(int r=0; r<Rank; r++) N *= size[r];
+    std::vector<uint32_t> found;
+    std::array<long,Rank> c{};
+    for(std::size_t i=0; i<N; i++) {
+        FloatT val = im[i];
+        bool is_max = true;
+        forBox<Rank>(c, 1, [&](const std::array<long,Rank> &n) {
+            long j = ndIndex<Rank>(size, n);
+            if(j>=0 && static_cast<std::size_t>(j)!=i && im[j]>=val) is_max = false;
+        });
+        forBox<Rank>(c, (nbhd-1)/2, [&](const std::array<long,Rank> &n) {
+            long j = ndIndex<Rank>(size, n);
+            if(j>=0 && im[j]>val) is_max = false;
+        });
+        if(is_max) for(int r=0; r<Rank; r++) found.push_back(c[r]);
+        for(int r=0; r<Rank; r++) {
+            if(++c[r]<static_cast<long>(size[r])) break;
+            c[r] = 0;
+        }
+    }
+    arma::Mat<uint32_t> maxima(Rank, found.size()/Rank);
+    std::copy(found.begin(), found.end(), maxima.memptr());
+    return maxima;
+}
+
+void testMaximaND()
+{
+    bool ok = true;
+    auto check = [&](const char *name, const arma::Mat<uint32_t> &found, const arma::Mat<uint32_t> &expected) {
+        if(found.n_cols!=expected.n_cols || arma::any(arma::vectorise(found!=expected))) {
+            fail()<<name<<" found "<<found.n_cols<<" maxima expected: "<<expected.n_cols<<endl;
+            ok = false;
+        }
+    };
+    //Plateaus test the strict inequality
+    std::array<uint32_t,4> size4 = {{7,6,5,6}};
+    arma::Col<double> im4(7*6*5*6);
+    im4.randu();
+    for(uint32_t i=0; i<im4.n_elem; i+=11) im4(i) = std::floor(4*im4(i))/4;
+    arma::Mat<uint32_t> maxima, maxima5;
+    arma::Col<double> vals, vals5;
+    MaximaND<4,double> maxima4(size4);
+    uint32_t nMaxima4 = maxima4.find_maxima(im4.memptr(), maxima, vals);
+    check("MaximaND<4> 3^4", maxima, bruteMaximaND<4>(size4, im4.memptr(), 3));
+    MaximaND<4,double> maxima4_5(size4, 5);
+    maxima4_5.find_maxima(im4.memptr(), maxima5, vals5);
+    check("MaximaND<4> 5^4", maxima5, bruteMaximaND<4>(size4, im4.memptr(), 5));
+    maxima4.refine_maxima(im4.memptr(), maxima, vals, 5);
+    check("MaximaND<4> refined 5^4", maxima, maxima5);
+    for(uint32_t n=0; n<maxima.n_cols; n++) if(!maxima4.check_maxima(im4.memptr(), maxima.colptr(n), 5)) {
+        fail()<<"MaximaND<4>::check_maxima rejected refined maxima "<<n<<endl;
+        ok = false;
+    }
+
+    //Maxima2D and Maxima3D over larger neighborhoods, including boxes truncated by the image boundary
+    arma::Mat<float> im2(23,19);
+    im2.randu();
+    Maxima2D<float> maxima2D({23,19}, 7);
+    arma::Col<float> fvals;
+    maxima2D.find_maxima(im2, maxima, fvals);
+    check("Maxima2D 7x7", maxima, bruteMaximaND<2>({{23,19}}, im2.memptr(), 7));
+    arma::Cube<float> im3(12,11,10);
+    im3.randu();
+    for(uint32_t nbhd=3; nbhd<=7; nbhd+=2) {
+        Maxima3D<float> maxima3D({12,11,10}, nbhd);
+        maxima3D.find_maxima(im3, maxima, fvals);
+        check("Maxima3D nxn", maxima, bruteMaximaND<3>({{12,11,10}}, im3.memptr(), nbhd));
+    }
+    if(ok) cout<<"MaximaND: rank 2, 3, and 4 maxima match.  Rank 4 maxima 3^4: "<<nMaxima4<<" 5^4: "<<vals5.n_elem<<endl;
+}
+
+/* Separable filter of a rank 4 image at every pixel, directly from the half kernels with mirroring */
+arma::Col<double> directFilter4D(const std::array<uint32_t,4> &size, const arma::Col<double> &im,
+                                 const std::array<arma::Col<double>,4> &kern)
+{
+    arma::Col<double> out(im.n_elem);
+    std::array<long,4> c{};
+    long hw = 0;
+    for(int r=0; r<4; r++) hw = std::max<long>(hw, kern[r].n_elem-1);
+    for(uint32_t i=0; i<im.n_elem; i++) {
+        double val = 0;
+        forBox<4>(c, hw, [&](const std::array<long,4> &n) {
+            double w = 1;
+            std::array<long,4> m;
+            for(int r=0; r<4; r++) {
+                long d = std::abs(n[r]-c[r]);
+                if(d>=static_cast<long>(kern[r].n_elem)) return;
+                w *= kern[r](d);
+                long s = size[r];
+                m[r] = n[r]<0 ? -n[r]-1 : (n[r]>=s ? 2*s-n[r]-1 : n[r]);
+            }
+            val += w*im(ndIndex<4>(size, m));
+        });
+        out(i) = val;
+        for(int r=0; r<4; r++) {
+            if(++c[r]<static_cast<long>(size[r])) break;
+            c[r] = 0;
+        }
+    }
+    return out;
+}
+
+void testFilterND()
+{
+    bool ok = true;
+    //Rank 2 and 3 are the GaussFilter2D/3D filters exactly.  The second axis of 2D is shorter than the kernel.
+    arma::Mat<float> im2(37,6), out2(37,6), ref2(37,6);
+    im2.randu();
+    FilterND<2> filt2({{37,6}}, {{0.8f,1.3f}}, 1.4f);
+    GaussFilter2D<float> gauss2({37,6}, {0.8,1.3});
+    DoGFilter2D<float> dog2({37,6}, {0.8,1.3}, 1.4);
+    LoGFilter2D<float> log2({37,6}, {0.8,1.3});
+    filt2.gauss(im2.memptr(), out2.memptr());
+    gauss2.filter(im2, ref2);
+    bool match2 = std::equal(out2.memptr(), out2.memptr()+out2.n_elem, ref2.memptr());
+    filt2.DoG(im2.memptr(), out2.memptr());
+    dog2.filter(im2, ref2);
+    match2 = match2 && std::equal(out2.memptr(), out2.memptr()+out2.n_elem, ref2.memptr());
+    filt2.LoG(im2.memptr(), out2.memptr());
+    log2.filter(im2, ref2);
+    match2 = match2 && std::equal(out2.memptr(), out2.memptr()+out2.n_elem, ref2.memptr());
+    if(!match2) {
+        fail()<<"FilterND<2> does not match the 2D filters"<<endl;
+        ok = false;
+    }
+    arma::Cube<float> im3(20,18,7), out3(20,18,7), ref3(20,18,7);
+    im3.randu();
+    FilterND<3> filt3({{20,18,7}}, {{1.0f,0.7f,1.2f}}, 1.4f);
+    GaussFilter3D<float> gauss3({20,18,7}, {1.0,0.7,1.2});
+    DoGFilter3D<float> dog3({20,18,7}, {1.0,0.7,1.2}, 1.4);
+    LoGFilter3D<float> log3({20,18,7}, {1.0,0.7,1.2});
+    filt3.gauss(im3.memptr(), out3.memptr());
+    gauss3.filter(im3, ref3);
+    bool match3 = std::equal(out3.memptr(), out3.memptr()+out3.n_elem, ref3.memptr());
+    filt3.DoG(im3.memptr(), out3.memptr());
+    dog3.filter(im3, ref3);
+    match3 = match3 && std::equal(out3.memptr(), out3.memptr()+out3.n_elem, ref3.memptr());
+    filt3.LoG(im3.memptr(), out3.memptr());
+    log3.filter(im3, ref3);
+    match3 = match3 && std::equal(out3.memptr(), out3.memptr()+out3.n_elem, ref3.memptr());
+    if(!match3) {
+        fail()<<"FilterND<3> does not match the 3D filters"<<endl;
+        ok = false;
+    }
+
+    //Rank 4 against direct evaluation.  The last axis is shorter than the kernel.
+    std::array<uint32_t,4> size4 = {{9,8,11,5}};
+    std::array<double,4> sigma4 = {{0.8,1.0,0.7,0.9}};
+    FilterND<4,double> filt4(size4, sigma4, 1.4);
+    arma::Col<double> im4(9*8*11*5), out4(im4.n_elem);
+    im4.randu();
+    std::array<arma::Col<double>,4> gk, ik, lk;
+    for(int r=0; r<4; r++) {
+        gk[r] = GaussFIRFilter<double>::compute_Gauss_FIR_kernel(sigma4[r], filt4.hw[r]);
+        ik[r] = GaussFIRFilter<double>::compute_Gauss_FIR_kernel(sigma4[r]*1.4, filt4.hw[r]);
+        lk[r] = GaussFIRFilter<double>::compute_LoG_FIR_kernel(sigma4[r], filt4.hw[r]);
+    }
+    arma::Col<double> gauss_ref = directFilter4D(size4, im4, gk);
+    arma::Col<double> log_ref(im4.n_elem, arma::fill::zeros);
+    for(int d=0; d<4; d++) {
+        auto k = gk;
+        k[d] = lk[d];
+        log_ref += directFilter4D(size4, im4, k);
+    }
+    double tol = 1e-12;
+    filt4.gauss(im4.memptr(), out4.memptr());
+    auto max_err = [&](const arma::Col<double> &ref) {
+        double err = 0;
+        for(uint32_t i=0; i<ref.n_elem; i++) err = std::max(err, std::fabs(out4(i)-ref(i)));
+        return err;
+    };
+    double gauss_err = max_err(gauss_ref);
+    filt4.DoG(im4.memptr(), out4.memptr());
+    arma::Col<double> dog_ref = gauss_ref-directFilter4D(size4, im4, ik);
+    double dog_err = max_err(dog_ref);
+    filt4.LoG(im4.memptr(), out4.memptr());
+    double log_err = max_err(log_ref);
+    if(!(gauss_err<tol && dog_err<tol && log_err<tol)) {
+        fail()<<"FilterND<4> errors: Gauss: "<<gauss_err<<" DoG: "<<dog_err<<" LoG: "<<log_err<<endl;
+        ok = false;
+    }
+    if(ok) cout<<"FilterND: rank 2 and 3 match the 2D/3D filters.  Rank 4 max error Gauss: "<<gauss_err
+               <<" DoG: "<<dog_err<<" LoG: "<<log_err<<endl;
+}
+
 void testBoxxer2D()
 {
     uint32_t nT = 7;
@@ -286,6 +561,29 @@ void testBoxxer2D()
 //     for(int n=0; n<Nmaxima; n++){
 //         printf("Maxima[%i]: (%i,%i, %i):%.9g\n",n,maxima(0,n),maxima(1,n),maxima(2,n),max_vals(n));
 //     }
+
+    //Fused detection is identical to filtering then enumerating
+    Boxxer2D<TestFloat>::IMatT fused_maxima;
+    Boxxer2D<TestFloat>::VecT fused_max_vals;
+    Boxxer2D<TestFloat>::detectDoG(ims, sigma, 1.6, fused_maxima, fused_max_vals, 5);
+    if(fused_maxima.n_cols!=maxima.n_cols || !arma::all(arma::vectorise(fused_maxima==maxima)) || !arma::all(fused_max_vals==max_vals))
+        fail()<<"detectDoG does not match filterDoG+enumerateImageMaxima"<<endl;
+    TestFloat threshold = 0.5*max_vals.max();
+    Boxxer2D<TestFloat>::detectDoG(ims, sigma, 1.6, fused_maxima, fused_max_vals, 5, threshold);
+    uint32_t nKeep = 0;
+    bool match = true;
+    for(uint32_t n=0; n<max_vals.n_elem; n++) if(max_vals(n)>threshold) {
+        match = match && nKeep<fused_max_vals.n_elem && fused_max_vals(nKeep)==max_vals(n) &&
+                fused_maxima(0,nKeep)==maxima(0,n) && fused_maxima(1,nKeep)==maxima(1,n) && fused_maxima(2,nKeep)==maxima(2,n);
+        nKeep++;
+    }
+    if(!match || nKeep==0 || fused_max_vals.n_elem!=nKeep)
+        fail()<<"thresholded detectDoG does not match"<<endl;
+    Boxxer2D<TestFloat>::filterGauss(ims,out,sigma);
+    Boxxer2D<TestFloat>::enumerateImageMaxima(out,maxima, max_vals, 3);
+    Boxxer2D<TestFloat>::detectGauss(ims, sigma, fused_maxima, fused_max_vals, 3);
+    if(fused_maxima.n_cols!=maxima.n_cols || !arma::all(arma::vectorise(fused_maxima==maxima)) || !arma::all(fused_max_vals==max_vals))
+        fail()<<"detectGauss does not match filterGauss+enumerateImageMaxima"<<endl;
 }
 
 void testScaleSpace2D()
@@ -314,6 +612,1634 @@ void testScaleSpace2D()
 //     }
 }
 
+void testGaussCache2D()
+{
+    uint32_t nT=10;
+    uint32_t sz=32;
+    typedef float TestFloat;
+    Boxxer2D<TestFloat>::IVecT size={sz,sz};
+    Boxxer2D<TestFloat>::MatT sigma;
+    sigma << 1.0 << 1.6 << 2.0<<endr
+          << 1.0 << 1.6 << 2.0<<endr;
+    Boxxer2D<TestFloat> boxxer(size, sigma);
+    Boxxer2D<TestFloat> cached_boxxer(size, sigma);
+    auto ims=boxxer.make_image_stack(nT);
+    ims.randu();
+
+    Boxxer2D<TestFloat>::IMatT maxima, cached_maxima;
+    Boxxer2D<TestFloat>::VecT max_vals, cached_max_vals;
+    cached_boxxer.enableGaussCache(1<<24);
+    for(TestFloat ratio : {1.6f, 1.8f, 1.6f}) {
+        boxxer.setDoGSigmaRatio(ratio);
+        cached_boxxer.setDoGSigmaRatio(ratio);
+        boxxer.scaleSpaceDoGMaxima(ims, maxima, max_vals, 3, 3);
+        cached_boxxer.scaleSpaceDoGMaxima(ims, cached_maxima, cached_max_vals, 3, 3);
+        if(maxima.n_cols!=cached_maxima.n_cols || arma::any(arma::vectorise(maxima!=cached_maxima)) ||
+                arma::any(max_vals!=cached_max_vals))
+            fail()<<"GaussCache maxima do not match uncached maxima for ratio: "<<ratio<<endl;
+    }
+    //New data in the same buffer must not reuse the cached frames
+    ims.randu();
+    boxxer.scaleSpaceDoGMaxima(ims, maxima, max_vals, 3, 3);
+    cached_boxxer.scaleSpaceDoGMaxima(ims, cached_maxima, cached_max_vals, 3, 3);
+    if(maxima.n_cols!=cached_maxima.n_cols || arma::any(arma::vectorise(maxima!=cached_maxima)) ||
+            arma::any(max_vals!=cached_max_vals))
+        fail()<<"GaussCache maxima do not match uncached maxima after the stack was modified in place"<<endl;
+    //Frames of different stacks are keyed apart, so alternating stacks neither mixes nor drops them
+    auto other_ims=boxxer.make_image_stack(nT);
+    other_ims.randu();
+    cached_boxxer.scaleSpaceDoGMaxima(other_ims, cached_maxima, cached_max_vals, 3, 3);
+    auto hits=cached_boxxer.gaussCacheStats().hits;
+    cached_boxxer.scaleSpaceDoGMaxima(ims, cached_maxima, cached_max_vals, 3, 3);
+    if(cached_boxxer.gaussCacheStats().hits-hits!=2*nT*sigma.n_cols)
+        fail()<<"GaussCache dropped the frames of a stack when another stack was filtered"<<endl;
+    if(maxima.n_cols!=cached_maxima.n_cols || arma::any(arma::vectorise(maxima!=cached_maxima)) ||
+            arma::any(max_vals!=cached_max_vals))
+        fail()<<"GaussCache maxima do not match uncached maxima after alternating stacks"<<endl;
+    Boxxer2D<TestFloat> copied_boxxer(cached_boxxer);
+    if(!copied_boxxer.hasGaussCache() || copied_boxxer.gaussCacheStats().n_entries!=0 ||
+            copied_boxxer.gaussCacheStats().max_bytes!=cached_boxxer.gaussCacheStats().max_bytes)
+        fail()<<"Copied engine shares the GaussCache of the original"<<endl;
+    auto stats=cached_boxxer.gaussCacheStats();
+    cout<<"GaussCache: Nmaxima: "<<maxima.n_cols<<" hits: "<<stats.hits<<" misses: "<<stats.misses<<" bytes: "<<stats.bytes<<endl;
+}
+
+void testSweep2D()
+{
+    uint32_t nT=6;
+    uint32_t sz=40;
+    typedef float TestFloat;
+    Boxxer2D<TestFloat>::IVecT size={sz,sz};
+    Boxxer2D<TestFloat>::MatT sigma;
+    sigma << 1.0 << 1.6 <<endr
+          << 1.0 << 1.6 <<endr;
+    Boxxer2D<TestFloat> boxxer(size, sigma);
+    auto ims=boxxer.make_image_stack(nT);
+    ims.randu();
+
+    Boxxer2D<TestFloat>::VecT ratios={1.8, 1.4};
+    Boxxer2D<TestFloat>::IVecT nbhds={5, 3, 7};
+    Boxxer2D<TestFloat>::IVecT scale_nbhds={3, 5};
+    Boxxer2D<TestFloat>::VecT thresholds={-std::numeric_limits<TestFloat>::infinity()};
+    Boxxer2D<TestFloat>::MatT params;
+    arma::field<Boxxer2D<TestFloat>::IMatT> sweep_maxima;
+    arma::field<Boxxer2D<TestFloat>::VecT> sweep_max_vals;
+    uint32_t nCombos=boxxer.scaleSpaceDoGMaximaSweep(ims, ratios, nbhds, scale_nbhds, thresholds,
+                                                     params, sweep_maxima, sweep_max_vals);
+    uint32_t nMismatch=0;
+    Boxxer2D<TestFloat>::IMatT maxima;
+    Boxxer2D<TestFloat>::VecT max_vals;
+    for(uint32_t c=0; c<nCombos; c++) {
+        boxxer.setDoGSigmaRatio(params(0,c));
+        boxxer.scaleSpaceDoGMaxima(ims, maxima, max_vals, static_cast<uint32_t>(params(1,c)), static_cast<uint32_t>(params(2,c)));
+        if(maxima.n_cols!=sweep_maxima(c).n_cols || arma::any(arma::vectorise(maxima!=sweep_maxima(c))) ||
+                arma::any(max_vals!=sweep_max_vals(c))) nMismatch++;
+    }
+    if(nMismatch) fail()<<"Sweep maxima do not match scaleSpaceDoGMaxima for "<<nMismatch<<" combinations"<<endl;
+    cout<<"Sweep2D: nCombos: "<<nCombos<<" Nmaxima[0]: "<<sweep_maxima(0).n_cols<<endl;
+}
+
+void testBatchRunner2D()
+{
+    typedef float TestFloat;
+    Boxxer2D<TestFloat>::MatT sigma;
+    sigma << 1.0 << 1.6 <<endr
+          << 1.0 << 1.6 <<endr;
+    std::vector<Boxxer2D<TestFloat>::ImageStackT> movies;
+    movies.emplace_back(24,24,3);
+    movies.emplace_back(40,32,7);
+    movies.emplace_back(24,24,5);
+    movies.emplace_back(40,32,1);
+    for(auto &movie: movies) movie.randu();
+
+    BatchRunner2D<TestFloat> batch;
+    for(auto &movie: movies) batch.addJob(movie, sigma, true, 1.6, 3, 3);
+    batch.addJob(movies[1], sigma, false, 1.6, 5, 3);
+    arma::field<Boxxer2D<TestFloat>::IMatT> batch_maxima;
+    arma::field<Boxxer2D<TestFloat>::VecT> batch_max_vals;
+    auto stats = batch.run(batch_maxima, batch_max_vals);
+
+    uint32_t nMismatch=0;
+    Boxxer2D<TestFloat>::IMatT maxima;
+    Boxxer2D<TestFloat>::VecT max_vals;
+    for(uint32_t j=0; j<batch.nJobs(); j++) {
+        const auto &movie = movies[j<movies.size() ? j : 1];
+        Boxxer2D<TestFloat>::IVecT size = {static_cast<uint32_t>(movie.n_rows), static_cast<uint32_t>(movie.n_cols)};
+        Boxxer2D<TestFloat> boxxer(size, sigma);
+        if(j<movies.size()) {
+            boxxer.setDoGSigmaRatio(1.6);
+            boxxer.scaleSpaceDoGMaxima(movie, maxima, max_vals, 3, 3);
+        } else {
+            boxxer.scaleSpaceLoGMaxima(movie, maxima, max_vals, 5, 3);
+        }
+        if(maxima.n_cols!=batch_maxima(j).n_cols || arma::any(arma::vectorise(maxima!=batch_maxima(j))) ||
+                arma::any(max_vals!=batch_max_vals(j))) nMismatch++;
+    }
+    if(nMismatch) fail()<<"BatchRunner2D maxima do not match per-job maxima for "<<nMismatch<<" jobs"<<endl;
+
+    //A frame filter pool reused across calls must follow changes to the engine
+    Boxxer2D<TestFloat> boxxer({40,32}, sigma);
+    Boxxer2D<TestFloat>::FrameFilterPool pool;
+    auto source = [&](uint32_t n, Boxxer2D<TestFloat>::ImageT &) -> const Boxxer2D<TestFloat>::ImageT& {
+        return movies[1].slice(n);
+    };
+    for(TestFloat ratio: {1.6f, 1.3f}) {
+        boxxer.setDoGSigmaRatio(ratio);
+        Boxxer2D<TestFloat>::IMatT pool_maxima;
+        Boxxer2D<TestFloat>::VecT pool_max_vals;
+        boxxer.scaleSpaceMaxima(static_cast<uint32_t>(movies[1].n_slices), source, true, pool, pool_maxima,
+                                pool_max_vals, 3, 3);
+        boxxer.scaleSpaceDoGMaxima(movies[1], maxima, max_vals, 3, 3);
+        if(maxima.n_cols!=pool_maxima.n_cols || arma::any(arma::vectorise(maxima!=pool_maxima)) ||
+                arma::any(max_vals!=pool_max_vals))
+            fail()<<"Frame filter pool maxima do not match scaleSpaceDoGMaxima for ratio: "<<ratio<<endl;
+    }
+    cout<<"BatchRunner2D: jobs: "<<stats.nJobs<<" groups: "<<stats.nGroups<<" frames: "<<stats.nFrames
+        <<" Nmaxima: "<<stats.nMaxima<<" frames/s: "<<stats.frames_per_second<<endl;
+}
+
+/* Sort maxima columns so results in different orders can be compared as sets */
+template<class IMat>
+std::vector<std::vector<uint32_t>> sortedMaximaCols(const IMat &maxima)
+{
+    std::vector<std::vector<uint32_t>> cols(maxima.n_cols);
+    for(uint32_t n=0; n<maxima.n_cols; n++)
+        for(uint32_t i=0; i<maxima.n_rows; i++) cols[n].push_back(maxima(i,n));
+    std::sort(cols.begin(), cols.end());
+    return cols;
+}
+
+void testMasked2D()
+{
+    uint32_t nT=3;
+    Boxxer2D<float>::MatT sigma;
+    sigma << 1.0 << 1.6 << 2.5 <<endr
+          << 1.0 << 1.6 << 2.5 <<endr;
+    Boxxer2D<float> boxxer({100,90}, sigma);
+    boxxer.setDoGSigmaRatio(1.4);
+    auto ims = boxxer.make_image_stack(nT);
+    ims.randu();
+    Boxxer2D<float>::IMatT rois;
+    rois << 0  << 60 <<endr
+         << 5  << 40 <<endr
+         << 20 << 35 <<endr
+         << 12 << 50 <<endr;
+    auto mask = boxxer.makeROIMask(rois);
+    mask(99,89) = 1;
+    Boxxer2D<float>::IMatT maxima, masked_maxima;
+    Boxxer2D<float>::VecT max_vals, masked_max_vals;
+    for(int use_DoG=0; use_DoG<2; use_DoG++) {
+        if(use_DoG) {
+            boxxer.scaleSpaceDoGMaxima(ims, maxima, max_vals, 5, 3);
+            boxxer.scaleSpaceDoGMaximaMasked(ims, mask, masked_maxima, masked_max_vals, 5, 3);
+        } else {
+            boxxer.scaleSpaceLoGMaxima(ims, maxima, max_vals, 3, 5);
+            boxxer.scaleSpaceLoGMaximaMasked(ims, mask, masked_maxima, masked_max_vals, 3, 5);
+        }
+        Boxxer2D<float>::IMatT expected(5,maxima.n_cols);
+        uint32_t nExpected=0;
+        for(uint32_t n=0; n<maxima.n_cols; n++) if(mask(maxima(0,n),maxima(1,n))) {
+            for(uint32_t i=0; i<4; i++) expected(i,nExpected) = maxima(i,n);
+            expected(4,nExpected++) = *reinterpret_cast<const uint32_t*>(&max_vals(n));
+        }
+        expected.resize(5,nExpected);
+        Boxxer2D<float>::IMatT found(5,masked_maxima.n_cols);
+        for(uint32_t n=0; n<masked_maxima.n_cols; n++) {
+            for(uint32_t i=0; i<4; i++) found(i,n) = masked_maxima(i,n);
+            found(4,n) = *reinterpret_cast<const uint32_t*>(&masked_max_vals(n));
+        }
+        if(sortedMaximaCols(expected)!=sortedMaximaCols(found))
+            fail()<<"Masked "<<(use_DoG ? "DoG" : "LoG")<<" maxima do not match: "<<found.n_cols<<" vs "<<expected.n_cols<<endl;
+    }
+    cout<<"Masked2D: mask fraction: "<<arma::accu(arma::conv_to<arma::Mat<float>>::from(mask))/mask.n_elem
+        <<" Nmaxima: "<<masked_maxima.n_cols<<" of "<<maxima.n_cols<<endl;
+}
+
+void testMasked3D()
+{
+    uint32_t nT=2;
+    Boxxer3D<float>::MatT sigma(3,2);
+    sigma.col(0).fill(1.0);
+    sigma.col(1).fill(1.6);
+    Boxxer3D<float> boxxer({40,36,34}, sigma);
+    boxxer.setDoGSigmaRatio(1.4);
+    auto ims = boxxer.make_image_stack(nT);
+    for(uint32_t n=0; n<nT; n++) ims.slice(n).randu();
+    Boxxer3D<float>::IMatT rois;
+    rois << 0  << 30 <<endr
+         << 4  << 20 <<endr
+         << 2  << 28 <<endr
+         << 12 << 10 <<endr
+         << 10 << 16 <<endr
+         << 8  << 6  <<endr;
+    auto mask = boxxer.makeROIMask(rois);
+    mask(39,35,33) = 1;
+    Boxxer3D<float>::IMatT maxima, masked_maxima;
+    Boxxer3D<float>::VecT max_vals, masked_max_vals;
+    for(int use_DoG=0; use_DoG<2; use_DoG++) {
+        if(use_DoG) {
+            boxxer.scaleSpaceDoGMaxima(ims, maxima, max_vals, 5, 3);
+            boxxer.scaleSpaceDoGMaximaMasked(ims, mask, masked_maxima, masked_max_vals, 5, 3);
+        } else {
+            boxxer.scaleSpaceLoGMaxima(ims, maxima, max_vals, 3, 5);
+            boxxer.scaleSpaceLoGMaximaMasked(ims, mask, masked_maxima, masked_max_vals, 3, 5);
+        }
+        Boxxer3D<float>::IMatT expected(6,maxima.n_cols);
+        uint32_t nExpected=0;
+        for(uint32_t n=0; n<maxima.n_cols; n++) if(mask(maxima(0,n),maxima(1,n),maxima(2,n))) {
+            for(uint32_t i=0; i<5; i++) expected(i,nExpected) = maxima(i,n);
+            expected(5,nExpected++) = *reinterpret_cast<const uint32_t*>(&max_vals(n));
+        }
+        expected.resize(6,nExpected);
+        Boxxer3D<float>::IMatT found(6,masked_maxima.n_cols);
+        for(uint32_t n=0; n<masked_maxima.n_cols; n++) {
+            for(uint32_t i=0; i<5; i++) found(i,n) = masked_maxima(i,n);
+            found(5,n) = *reinterpret_cast<const uint32_t*>(&masked_max_vals(n));
+        }
+        if(expected.n_cols==0 || sortedMaximaCols(expected)!=sortedMaximaCols(found))
+            fail()<<"Masked 3D "<<(use_DoG ? "DoG" : "LoG")<<" maxima do not match: "<<found.n_cols<<" vs "<<expected.n_cols<<endl;
+    }
+    cout<<"Masked3D: Nmaxima: "<<masked_maxima.n_cols<<" of "<<maxima.n_cols<<endl;
+}
+
+void testTemporalSkip2D()
+{
+    uint32_t nT=8;
+    uint32_t sx=128, sy=96;
+    Boxxer2D<float>::MatT sigma;
+    sigma << 1.0 << 1.6 <<endr
+          << 1.0 << 1.6 <<endr;
+    Boxxer2D<float> boxxer({sx,sy}, sigma);
+    boxxer.setDoGSigmaRatio(1.6);
+    auto ims = boxxer.make_image_stack(nT);
+    Boxxer2D<float>::ImageT background = boxxer.make_image();
+    background.randu();
+    float threshold = 0.3;
+    for(uint32_t n=0; n<nT; n++) {
+        Boxxer2D<float>::ImageT noise = boxxer.make_image();
+        noise.randu();
+        ims.slice(n) = 0.1*background + 1e-3*noise;
+        //Sparse blinking emitters
+        uint32_t cx = (n*37)%(sx-20)+10, cy = (n*23)%(sy-20)+10;
+        for(int dy=-4; dy<=4; dy++) for(int dx=-4; dx<=4; dx++)
+            ims(cx+dx,cy+dy,n) += 3*std::exp(-(dx*dx+dy*dy)/(2*1.3*1.3));
+    }
+    Boxxer2D<float>::IMatT maxima, temporal_maxima;
+    Boxxer2D<float>::VecT max_vals, temporal_max_vals;
+    Boxxer2D<float>::TemporalSkipStats stats;
+    for(int use_DoG=0; use_DoG<2; use_DoG++) {
+        if(use_DoG) {
+            boxxer.scaleSpaceDoGMaxima(ims, maxima, max_vals, 3, 3);
+            boxxer.scaleSpaceDoGMaximaTemporal(ims, threshold, temporal_maxima, temporal_max_vals, 3, 3, &stats);
+        } else {
+            boxxer.scaleSpaceLoGMaxima(ims, maxima, max_vals, 3, 3);
+            boxxer.scaleSpaceLoGMaximaTemporal(ims, -threshold, temporal_maxima, temporal_max_vals, 3, 3, &stats);
+        }
+        Boxxer2D<float>::IMatT expected(4,maxima.n_cols);
+        uint32_t nExpected=0;
+        for(uint32_t n=0; n<maxima.n_cols; n++) if(max_vals(n) > (use_DoG ? threshold : -threshold))
+            expected.col(nExpected++) = maxima.col(n);
+        expected.resize(4,nExpected);
+        if(sortedMaximaCols(expected)!=sortedMaximaCols(temporal_maxima))
+            fail()<<"Temporal skip "<<(use_DoG ? "DoG" : "LoG")<<" maxima do not match: "<<temporal_maxima.n_cols<<" vs "<<expected.n_cols<<endl;
+    }
+    if(stats.nSkipped==0) fail()<<"Temporal skip did not skip any tiles"<<endl;
+    cout<<"TemporalSkip2D: Nmaxima: "<<temporal_maxima.n_cols<<" skipped "<<stats.nSkipped<<" of "<<stats.nTileFrames<<" tile-frames"<<endl;
+}
+
+void testDarkFrameSkip2D()
+{
+    uint32_t nT=10;
+    Boxxer2D<float>::MatT sigma;
+    sigma << 1.0 << 1.6 <<endr
+          << 1.0 << 1.6 <<endr;
+    Boxxer2D<float> boxxer({64,48}, sigma);
+    boxxer.setDoGSigmaRatio(1.6);
+    auto ims = boxxer.make_image_stack(nT);
+    ims.randu();
+    for(uint32_t i=0; i<ims.n_elem; i++) ims.memptr()[i] = 100 + 0.05*ims.memptr()[i]; //Camera offset and read noise
+    uint32_t nDark = 0;
+    for(uint32_t n=0; n<nT; n++) {
+        if(n%3==0) { nDark++; continue; } //Dark frames
+        for(int k=0; k<4; k++) {
+            int cx = 8+(n*13+k*17)%48, cy = 8+(n*7+k*11)%32;
+            for(int dy=-4; dy<=4; dy++) for(int dx=-4; dx<=4; dx++)
+                ims(cx+dx,cy+dy,n) += 20*std::exp(-(dx*dx+dy*dy)/(2*1.3*1.3));
+        }
+    }
+    float threshold = 1;
+    Boxxer2D<float>::IMatT maxima, thresh_maxima;
+    Boxxer2D<float>::VecT max_vals, thresh_max_vals;
+    uint32_t nSkipped = 0;
+    for(int use_DoG=0; use_DoG<2; use_DoG++) {
+        if(use_DoG) {
+            boxxer.scaleSpaceDoGMaxima(ims, maxima, max_vals, 3, 3);
+            boxxer.scaleSpaceDoGMaximaThreshold(ims, threshold, thresh_maxima, thresh_max_vals, 3, 3, &nSkipped);
+        } else { //Bright spots are LoG minima, so use the negated movie
+            Boxxer2D<float>::ImageStackT neg_ims = ims;
+            for(uint32_t i=0; i<ims.n_elem; i++) neg_ims.memptr()[i] = -ims.memptr()[i];
+            boxxer.scaleSpaceLoGMaxima(neg_ims, maxima, max_vals, 3, 3);
+            boxxer.scaleSpaceLoGMaximaThreshold(neg_ims, threshold, thresh_maxima, thresh_max_vals, 3, 3, &nSkipped);
+        }
+        Boxxer2D<float>::IMatT expected(4,maxima.n_cols);
+        uint32_t nExpected=0;
+        for(uint32_t n=0; n<maxima.n_cols; n++) if(max_vals(n) > threshold) expected.col(nExpected++) = maxima.col(n);
+        expected.resize(4,nExpected);
+        if(sortedMaximaCols(expected)!=sortedMaximaCols(thresh_maxima))
+            fail()<<"Dark frame skip "<<(use_DoG ? "DoG" : "LoG")<<" maxima do not match: "<<thresh_maxima.n_cols<<" vs "<<expected.n_cols<<endl;
+        if(nSkipped!=nDark)
+            fail()<<"Dark frame skip "<<(use_DoG ? "DoG" : "LoG")<<" skipped "<<nSkipped<<" frames expected "<<nDark<<endl;
+    }
+    cout<<"DarkFrameSkip2D: Nmaxima: "<<thresh_maxima.n_cols<<" skipped frames: "<<nSkipped<<" of "<<nT<<endl;
+}
+
+void testMultiChannel2D()
+{
+    typedef float TestFloat;
+    typedef MultiChannel2D<TestFloat> MultiT;
+    uint32_t nT=4, nC=2;
+    Boxxer2D<TestFloat>::MatT sigma;
+    sigma << 1.0 << 1.6 <<endr
+          << 1.0 << 1.6 <<endr;
+    Boxxer2D<TestFloat> boxxer({32,40}, sigma);
+    boxxer.setDoGSigmaRatio(1.6);
+    auto ims = boxxer.make_image_stack(nT*nC);
+    ims.randu();
+    Boxxer2D<TestFloat>::IMatT maxima, chan_maxima;
+    Boxxer2D<TestFloat>::VecT max_vals, chan_max_vals;
+    uint32_t nMismatch=0;
+    for(int interleaved=0; interleaved<2; interleaved++) {
+        MultiT multi(boxxer, nC, interleaved ? MultiT::Layout::Interleaved : MultiT::Layout::Sequential);
+        multi.scaleSpaceDoGMaxima(ims, maxima, max_vals, 3, 3);
+        for(uint32_t c=0; c<nC; c++) {
+            auto chan = boxxer.make_image_stack(nT);
+            for(uint32_t t=0; t<nT; t++) chan.slice(t) = ims.slice(interleaved ? t*nC+c : c*nT+t);
+            boxxer.scaleSpaceDoGMaxima(chan, chan_maxima, chan_max_vals, 3, 3);
+            uint32_t k=0;
+            for(uint32_t n=0; n<maxima.n_cols; n++) {
+                if(maxima(4,n)!=c) continue;
+                if(k>=chan_maxima.n_cols || chan_max_vals(k)!=max_vals(n)) { nMismatch++; break; }
+                for(uint32_t i=0; i<4; i++) if(chan_maxima(i,k)!=maxima(i,n)) nMismatch++;
+                k++;
+            }
+            if(k!=chan_maxima.n_cols) nMismatch++;
+        }
+    }
+    if(nMismatch) fail()<<"MultiChannel2D maxima do not match per-channel maxima: "<<nMismatch<<endl;
+
+    //Channel 1 is displaced by (+3,-2) from channel 0
+    MultiT multi(boxxer, nC);
+    Boxxer2D<TestFloat>::IMatT coinc_maxima;
+    coinc_maxima << 10 << 13 << 30 << 50 << 12 << 10 << 13 <<endr
+                 << 10 <<  8 << 30 << 50 << 10 << 10 <<  8 <<endr
+                 <<  0 <<  0 <<  0 <<  1 <<  0 <<  0 <<  0 <<endr
+                 <<  0 <<  0 <<  0 <<  0 <<  0 <<  1 <<  2 <<endr
+                 <<  0 <<  1 <<  0 <<  1 <<  0 <<  0 <<  1 <<endr;
+    arma::Cube<TestFloat> registration(2,3,nC);
+    registration.zeros();
+    for(uint32_t c=0; c<nC; c++) registration(0,0,c) = registration(1,1,c) = 1;
+    registration(0,2,1) = -3;
+    registration(1,2,1) = 2;
+    MultiT::IVecT nCoincident;
+    multi.coincidence(coinc_maxima, registration, 1.5, nCoincident);
+    MultiT::IVecT expected = {1, 1, 0, 0, 0, 0, 0};
+    if(arma::any(nCoincident!=expected)) fail()<<"MultiChannel2D coincidence counts incorrect: "<<nCoincident.t();
+    Boxxer2D<TestFloat>::VecT coinc_vals(coinc_maxima.n_cols);
+    for(uint32_t n=0; n<coinc_vals.n_elem; n++) coinc_vals(n) = n;
+    multi.filterCoincident(coinc_maxima, coinc_vals, registration, 1.5, 2);
+    if(coinc_maxima.n_cols!=2 || coinc_vals(0)!=0 || coinc_vals(1)!=1)
+        fail()<<"MultiChannel2D filterCoincident kept "<<coinc_maxima.n_cols<<" maxima expected 2"<<endl;
+    cout<<"MultiChannel2D: channels: "<<nC<<" frames: "<<nT<<" Nmaxima: "<<maxima.n_cols<<endl;
+}
+
+/* Axis-aligned elliptical Gaussian PSF with an optional defocus ring, which makes it non-separable */
+arma::Mat<double> makeRingPSF(int hw, double sx, double sy, double ring)
+{
+    arma::Mat<double> psf(2*hw+1, 2*hw+1);
+    for(int j=-hw; j<=hw; j++) for(int i=-hw; i<=hw; i++) {
+        double r = std::sqrt(double(i*i+j*j));
+        psf(i+hw,j+hw) = std::exp(-i*i/(2*sx*sx)-j*j/(2*sy*sy)) + ring*std::exp(-(r-3)*(r-3)/2);
+    }
+    return psf;
+}
+
+void testPSFFilter2D()
+{
+    typedef double TestFloat;
+    int hw = 6;
+    PSFBoxxer2D<TestFloat>::IVecT size = {40,36};
+    //Full rank filtering matches dense correlation with the zero-mean unit-norm template away from the edges
+    arma::Mat<TestFloat> im(size(0),size(1)), out(size(0),size(1));
+    im.randu();
+    auto dense_error = [&](const arma::Mat<TestFloat> &psf, PSFFilter2D<TestFloat> &filter) {
+        filter.filter(im, out);
+        auto tmpl = psf;
+        double mean = arma::accu(tmpl)/tmpl.n_elem;
+        for(uint32_t i=0; i<tmpl.n_elem; i++) tmpl(i) -= mean;
+        double nrm = arma::norm(tmpl);
+        double max_err = 0;
+        for(int y=hw; y+hw<static_cast<int>(size(1)); y++) for(int x=hw; x+hw<static_cast<int>(size(0)); x++) {
+            double val = 0;
+            for(int j=-hw; j<=hw; j++) for(int i=-hw; i<=hw; i++) val += tmpl(i+hw,j+hw)/nrm*im(x+i,y+j);
+            max_err = std::max(max_err, std::abs(val-out(x,y)));
+        }
+        return max_err;
+    };
+    auto psf = makeRingPSF(hw, 1.2, 2.4, 0.3);
+    PSFFilter2D<TestFloat> full(size, psf, 2*hw+1);
+    double max_err = dense_error(psf, full);
+    if(max_err>1e-9) fail()<<"PSFFilter2D full rank does not match dense correlation. max error: "<<max_err<<endl;
+    if(full.symmetry_error>1e-12) fail()<<"PSFFilter2D symmetric PSF has symmetry error: "<<full.symmetry_error<<endl;
+    if(full.approximation_error()>1e-9) fail()<<"PSFFilter2D full rank approximation error: "<<full.approximation_error()<<endl;
+    //A Gaussian minus its mean is exactly rank 2, the ring needs more terms
+    auto gauss_err = PSFFilter2D<TestFloat>::rankErrors(makeRingPSF(hw, 1.2, 2.4, 0));
+    if(gauss_err.n_elem<3 || gauss_err(2)>1e-9) fail()<<"PSFFilter2D Gaussian PSF is not rank 2"<<endl;
+    TestFloat sym_err;
+    arma::Mat<TestFloat> shifted = psf;
+    for(int j=0; j<2*hw+1; j++) for(int i=1; i<2*hw+1; i++) shifted(i,j) = psf(i-1,j); //Off-center PSF
+    PSFFilter2D<TestFloat>::rankErrors(shifted, &sym_err);
+    if(!(sym_err>0.01)) fail()<<"PSFFilter2D off-center PSF symmetry error not reported: "<<sym_err<<endl;
+    //An asymmetric, coma-like PSF is matched exactly by the odd passes
+    arma::Mat<TestFloat> coma = shifted;
+    for(int j=0; j<2*hw+1; j++) for(int i=0; i<2*hw+1; i++) coma(i,j) *= 1 + 0.1*(i-hw) + 0.05*(i-hw)*(j-hw);
+    PSFFilter2D<TestFloat> coma_filter(size, coma, 2*hw+1);
+    max_err = dense_error(coma, coma_filter);
+    if(max_err>1e-9) fail()<<"PSFFilter2D asymmetric PSF does not match dense correlation. max error: "<<max_err<<endl;
+    for(uint32_t r=1; r<full.rank_error.n_elem; r++)
+        if(full.rank_error(r)>full.rank_error(r-1)) fail()<<"PSFFilter2D rank error is not decreasing at rank "<<r<<endl;
+    cout<<"PSFFilter2D: ring PSF rank errors r=1..4: "<<full.rank_error(1)<<" "<<full.rank_error(2)<<" "
+        <<full.rank_error(3)<<" "<<full.rank_error(4)<<endl;
+
+    //Detection with astigmatic PSFs for two focal planes finds each spot at its position and PSF
+    arma::field<arma::Mat<TestFloat>> psfs(2);
+    psfs(0) = makeRingPSF(hw, 1.0, 2.2, 0.2);
+    psfs(1) = makeRingPSF(hw, 2.2, 1.0, 0.2);
+    PSFBoxxer2D<TestFloat> boxxer(size, psfs, 3);
+    auto ims = boxxer.engine.make_image_stack(2);
+    ims.randu();
+    for(uint32_t i=0; i<ims.n_elem; i++) ims.memptr()[i] *= 0.05;
+    uint32_t spots[2][3] = {{10, 12, 0}, {27, 22, 1}};
+    for(uint32_t n=0; n<2; n++) for(auto &spot: spots) {
+        for(int j=-hw; j<=hw; j++) for(int i=-hw; i<=hw; i++)
+            ims(spot[0]+i, spot[1]+j, n) += psfs(spot[2])(i+hw,j+hw);
+    }
+    PSFBoxxer2D<TestFloat>::IMatT maxima;
+    PSFBoxxer2D<TestFloat>::VecT max_vals;
+    boxxer.scaleSpaceMaxima(ims, maxima, max_vals, 5, 3);
+    uint32_t nFound = 0;
+    for(uint32_t n=0; n<maxima.n_cols; n++) {
+        if(max_vals(n)<0.5*arma::max(max_vals)) continue;
+        bool ok = false;
+        for(auto &spot: spots) if(maxima(0,n)==spot[0] && maxima(1,n)==spot[1] && maxima(2,n)==spot[2]) ok = true;
+        if(ok) nFound++;
+        else fail()<<"PSFBoxxer2D strong maxima at unexpected position: "<<maxima.col(n).t();
+    }
+    if(nFound!=4) fail()<<"PSFBoxxer2D found "<<nFound<<" of 4 spots"<<endl;
+    cout<<"PSFBoxxer2D: ranks: "<<boxxer.ranks().t()<<" approximation errors: "<<boxxer.approximationErrors().t();
+
+    //3D: the hierarchical SVD represents a separable Gaussian minus its mean with 4 terms
+    arma::field<arma::Cube<TestFloat>> psfs3(1);
+    psfs3(0).set_size(7,7,5);
+    for(int k=0; k<5; k++) for(int j=0; j<7; j++) for(int i=0; i<7; i++)
+        psfs3(0)(i,j,k) = std::exp(-((i-3)*(i-3)+(j-3)*(j-3))/2.0-(k-2)*(k-2)/4.0);
+    PSFBoxxer3D<TestFloat>::IVecT size3 = {16,16,12};
+    PSFBoxxer3D<TestFloat> boxxer3(size3, psfs3, 4);
+    if(boxxer3.approximationErrors()(0)>1e-9) fail()<<"PSFBoxxer3D separable PSF rank 4 error: "<<boxxer3.approximationErrors()(0)<<endl;
+    auto ims3 = boxxer3.engine.make_image_stack(1);
+    ims3.slice(0).zeros();
+    ims3.slice(0)(8,7,6) = 1;
+    boxxer3.scaleSpaceMaxima(ims3, maxima, max_vals, 3, 3);
+    bool found3 = false;
+    for(uint32_t n=0; n<maxima.n_cols; n++) if(maxima(0,n)==8 && maxima(1,n)==7 && maxima(2,n)==6) found3 = true;
+    if(!found3) fail()<<"PSFBoxxer3D did not find impulse maxima"<<endl;
+}
+
+/* Reference a trous smoothing along one axis of a matrix with the same mirror boundary as the FIR filters */
+arma::mat atrousReference(const arma::mat &im, int step, bool along_cols)
+{
+    const double k[5] = {1./16, 4./16, 6./16, 4./16, 1./16};
+    arma::mat out(im.n_rows, im.n_cols, arma::fill::zeros);
+    int n = along_cols ? im.n_cols : im.n_rows;
+    for(uint32_t y=0; y<im.n_cols; y++) for(uint32_t x=0; x<im.n_rows; x++) {
+        int c = along_cols ? y : x;
+        for(int t=-2; t<=2; t++) {
+            int j = c+t*step;
+            while(j<0 || j>=n) j = j<0 ? -j-1 : 2*n-j-1; //Reflect until inside
+            out(x,y) += k[t+2]*(along_cols ? im(x,j) : im(j,y));
+        }
+    }
+    return out;
+}
+
+void testWavelet2D()
+{
+    typedef double TestFloat;
+    AtrousFilter2D<TestFloat>::IVecT size = {37,30};
+    //Wavelet planes match the reference computation, including the boundary and steps beyond the image size
+    uint32_t first_level = 2, nLevels = 4;
+    AtrousFilter2D<TestFloat> filter(size, first_level, nLevels);
+    arma::mat im(size(0),size(1));
+    im.randu();
+    arma::cube planes(size(0),size(1),nLevels);
+    filter.filter(im, planes);
+    arma::mat v = im;
+    double max_err = 0;
+    for(uint32_t j=1; j<first_level+nLevels; j++) {
+        arma::mat v_next = atrousReference(atrousReference(v, 1<<(j-1), false), 1<<(j-1), true);
+        if(j>=first_level) max_err = std::max(max_err, arma::abs(planes.slice(j-first_level) - (v-v_next)).max());
+        v = v_next;
+    }
+    if(max_err>1e-12) fail()<<"AtrousFilter2D planes do not match reference. max error: "<<max_err<<endl;
+    //A constant image has zero response everywhere, including levels whose taps reach past the image
+    arma::mat flat(size(0),size(1)), out(size(0),size(1));
+    flat.fill(3.0);
+    for(uint32_t level : {2u, 7u}) {
+        AtrousFilter2D<TestFloat> single(size, level);
+        single.filter(flat, out);
+        if(arma::abs(out).max()>1e-12) fail()<<"AtrousFilter2D constant image has nonzero response at level "<<level<<endl;
+    }
+
+    //Detection finds a spot at its position and the scale grows with the spot size
+    Boxxer2D<TestFloat>::MatT sigma(2,3);
+    sigma.fill(1.0);
+    Boxxer2D<TestFloat> boxxer({64,64}, sigma);
+    boxxer.setWaveletFirstLevel(1);
+    auto ims = boxxer.make_image_stack(2);
+    ims.randu();
+    for(uint32_t i=0; i<ims.n_elem; i++) ims.memptr()[i] *= 0.02;
+    double spot_sigma[2] = {0.8, 2.0};
+    for(uint32_t n=0; n<2; n++)
+        for(uint32_t y=0; y<64; y++) for(uint32_t x=0; x<64; x++)
+            ims(x,y,n) += std::exp(-(std::pow(x-20.,2)+std::pow(y-40.,2))/(2*spot_sigma[n]*spot_sigma[n]));
+    Boxxer2D<TestFloat>::IMatT maxima;
+    Boxxer2D<TestFloat>::VecT max_vals;
+    boxxer.scaleSpaceWaveletMaxima(ims, maxima, max_vals, 5, 3);
+    uint32_t scale[2] = {0, 0};
+    for(uint32_t n=0; n<2; n++) {
+        double best = 0;
+        bool found = false;
+        for(uint32_t m=0; m<maxima.n_cols; m++) {
+            if(maxima(3,m)!=n || max_vals(m)<=best) continue;
+            best = max_vals(m);
+            found = maxima(0,m)==20 && maxima(1,m)==40;
+            scale[n] = maxima(2,m);
+        }
+        if(!found) fail()<<"Boxxer2D wavelet strongest maxima is not at the spot in frame "<<n<<endl;
+    }
+    if(!(scale[1]>scale[0])) fail()<<"Boxxer2D wavelet scale does not grow with spot size: "<<scale[0]<<" "<<scale[1]<<endl;
+    auto fims = boxxer.make_scaled_image_stack(2);
+    boxxer.filterScaledWavelet(ims, fims);
+    auto wims = boxxer.make_image_stack(2);
+    Boxxer2D<TestFloat>::filterWavelet(ims, wims, 2);
+    if(arma::abs(wims.slice(1) - fims.slice(1).slice(1)).max()>1e-12)
+        fail()<<"Boxxer2D filterWavelet does not match filterScaledWavelet"<<endl;
+    cout<<"Wavelet2D: maxima:"<<maxima.n_cols<<" spot scales: "<<scale[0]<<" "<<scale[1]<<endl;
+
+    //3D detection smoke test
+    Boxxer3D<float>::MatT sigma3(3,2);
+    sigma3.fill(1.0);
+    Boxxer3D<float> boxxer3({24,24,16}, sigma3);
+    auto ims3 = boxxer3.make_image_stack(1);
+    for(uint32_t z=0; z<16; z++) for(uint32_t y=0; y<24; y++) for(uint32_t x=0; x<24; x++)
+        ims3(x,y,z,0) = std::exp(-(std::pow(x-12.,2)+std::pow(y-10.,2)+std::pow(z-7.,2))/2.);
+    Boxxer3D<float>::IMatT maxima3;
+    Boxxer3D<float>::VecT max_vals3;
+    boxxer3.scaleSpaceWaveletMaxima(ims3, maxima3, max_vals3, 3, 3);
+    if(maxima3.n_cols==0) fail()<<"Boxxer3D wavelet found no maxima"<<endl;
+    else {
+        arma::uword best = max_vals3.index_max();
+        if(maxima3(0,best)!=12 || maxima3(1,best)!=10 || maxima3(2,best)!=7)
+            fail()<<"Boxxer3D wavelet strongest maxima is not at the spot: "<<maxima3.col(best).t();
+    }
+}
+
+void testShape2D()
+{
+    typedef double TestFloat;
+    //A round spot, an elongated spot and the same elongated spot rotated by 45 degrees
+    Boxxer2D<TestFloat>::MatT sigma(2,1);
+    sigma.fill(1.5);
+    Boxxer2D<TestFloat> boxxer({96,40}, sigma);
+    auto ims = boxxer.make_image_stack(1);
+    ims.zeros();
+    double spots[3][4] = {{16,20,0,1.5}, {48,20,0,3.5}, {80,20,0.25*arma::Datum<double>::pi,3.5}}; //x,y,angle,long sigma
+    for(auto &spot: spots) for(uint32_t y=0; y<40; y++) for(uint32_t x=0; x<96; x++) {
+        double dx = x-spot[0], dy = y-spot[1];
+        double u = std::cos(spot[2])*dx + std::sin(spot[2])*dy;
+        double v = -std::sin(spot[2])*dx + std::cos(spot[2])*dy;
+        ims(x,y,0) += std::exp(-u*u/(2*1.5*1.5) - v*v/(2*spot[3]*spot[3]));
+    }
+    Boxxer2D<TestFloat>::IMatT maxima, plain_maxima;
+    Boxxer2D<TestFloat>::VecT max_vals, plain_max_vals, ratio, gradient;
+    boxxer.scaleSpaceLoGMaximaShape(ims, maxima, max_vals, ratio, 3, 3, &gradient);
+    boxxer.scaleSpaceLoGMaxima(ims, plain_maxima, plain_max_vals, 3, 3);
+    if(maxima.n_cols!=plain_maxima.n_cols || arma::any(arma::vectorise(maxima!=plain_maxima)) ||
+       ratio.n_elem!=maxima.n_cols || gradient.n_elem!=maxima.n_cols)
+        fail()<<"Boxxer2D LoG shape maxima do not match scaleSpaceLoGMaxima"<<endl;
+    double spot_ratio[3] = {-2,-2,-2};
+    double spot_grad[3] = {-1,-1,-1};
+    for(uint32_t n=0; n<maxima.n_cols; n++) for(int k=0; k<3; k++)
+        if(maxima(0,n)==spots[k][0] && maxima(1,n)==spots[k][1]) {
+            spot_ratio[k] = ratio(n);
+            spot_grad[k] = gradient(n);
+        }
+    if(!(spot_ratio[0]>0.95)) fail()<<"Boxxer2D round spot Hessian ratio: "<<spot_ratio[0]<<endl;
+    if(!(spot_ratio[1]>0 && spot_ratio[1]<0.5)) fail()<<"Boxxer2D elongated spot Hessian ratio: "<<spot_ratio[1]<<endl;
+    if(!(std::abs(spot_ratio[2]-spot_ratio[1])<0.05))
+        fail()<<"Boxxer2D rotated spot Hessian ratio: "<<spot_ratio[2]<<" unrotated: "<<spot_ratio[1]<<endl;
+    if(!(spot_grad[0]>=0 && spot_grad[0]<1e-6)) fail()<<"Boxxer2D centered spot gradient: "<<spot_grad[0]<<endl;
+    cout<<"Shape2D: Hessian ratios round:"<<spot_ratio[0]<<" elongated:"<<spot_ratio[1]<<" rotated:"<<spot_ratio[2]<<endl;
+
+    //3D: a round blob and a filament along z
+    Boxxer3D<float>::MatT sigma3(3,1);
+    sigma3.fill(1.5);
+    Boxxer3D<float> boxxer3({32,20,24}, sigma3);
+    auto ims3 = boxxer3.make_image_stack(1);
+    for(uint32_t z=0; z<24; z++) for(uint32_t y=0; y<20; y++) for(uint32_t x=0; x<32; x++)
+        ims3(x,y,z,0) = std::exp(-(std::pow(x-8.,2)+std::pow(y-10.,2)+std::pow(z-12.,2))/(2*1.5*1.5)) +
+                        std::exp(-(std::pow(x-24.,2)+std::pow(y-10.,2))/(2*1.5*1.5)-std::pow(z-12.,2)/(2*6.*6.));
+    Boxxer3D<float>::IMatT maxima3;
+    Boxxer3D<float>::VecT max_vals3, ratio3;
+    boxxer3.scaleSpaceLoGMaximaShape(ims3, maxima3, max_vals3, ratio3, 3, 3);
+    uint32_t nFound = 0;
+    for(uint32_t n=0; n<maxima3.n_cols; n++) {
+        if(maxima3(1,n)!=10 || maxima3(2,n)!=12) continue;
+        if(maxima3(0,n)==8) {
+            nFound++;
+            if(!(ratio3(n)>0.95)) fail()<<"Boxxer3D round blob Hessian ratio: "<<ratio3(n)<<endl;
+        }
+        if(maxima3(0,n)==24) {
+            nFound++;
+            if(!(ratio3(n)<0.3)) fail()<<"Boxxer3D filament Hessian ratio: "<<ratio3(n)<<endl;
+        }
+    }
+    if(nFound!=2) fail()<<"Boxxer3D LoG shape maxima not found at the blob and filament"<<endl;
+    //On noise, where near ties are common, the shape maxima are exactly the plain LoG maxima
+    Boxxer3D<float>::IMatT plain_maxima3;
+    Boxxer3D<float>::VecT plain_max_vals3;
+    ims3.slice(0).randu();
+    boxxer3.scaleSpaceLoGMaximaShape(ims3, maxima3, max_vals3, ratio3, 3, 3);
+    boxxer3.scaleSpaceLoGMaxima(ims3, plain_maxima3, plain_max_vals3, 3, 3);
+    if(maxima3.n_cols!=plain_maxima3.n_cols || arma::any(arma::vectorise(maxima3!=plain_maxima3)) ||
+       arma::any(max_vals3!=plain_max_vals3) || ratio3.n_elem!=maxima3.n_cols)
+        fail()<<"Boxxer3D LoG shape maxima do not match scaleSpaceLoGMaxima"<<endl;
+}
+
+void testDefectMap2D()
+{
+    typedef double TestFloat;
+    //Hot pixels in every frame and a spot moving across the background
+    Boxxer2D<TestFloat>::MatT sigma(2,2);
+    sigma.fill(1.5);
+    sigma(0,1) = sigma(1,1) = 2.0;
+    Boxxer2D<TestFloat> boxxer({64,48}, sigma);
+    uint32_t nT = 20;
+    auto ims = boxxer.make_image_stack(nT);
+    ims.randu();
+    for(uint32_t i=0; i<ims.n_elem; i++) ims.memptr()[i] = 1 + 0.1*(ims.memptr()[i]-0.5);
+    uint32_t hot[3][2] = {{10,10}, {40,30}, {0,47}};
+    for(uint32_t n=0; n<nT; n++) {
+        for(auto &h: hot) ims(h[0],h[1],n) += 20;
+        double sx = 8+2.*n, sy = 20;
+        for(uint32_t y=0; y<48; y++) for(uint32_t x=0; x<64; x++)
+            ims(x,y,n) += 2*std::exp(-(std::pow(x-sx,2)+std::pow(y-sy,2))/(2*1.5*1.5));
+    }
+    auto strongest_hot = [&](const Boxxer2D<TestFloat>::IMatT &maxima, const Boxxer2D<TestFloat>::VecT &max_vals) {
+        double best = 0;
+        for(uint32_t m=0; m<maxima.n_cols; m++) for(auto &h: hot)
+            if(std::abs(int(maxima(0,m))-int(h[0]))<=1 && std::abs(int(maxima(1,m))-int(h[1]))<=1)
+                best = std::max(best, max_vals(m));
+        return best;
+    };
+    Boxxer2D<TestFloat>::IMatT maxima;
+    Boxxer2D<TestFloat>::VecT max_vals;
+    boxxer.scaleSpaceLoGMaxima(ims, maxima, max_vals, 3, 3);
+    double spot_val = 0;
+    for(uint32_t m=0; m<maxima.n_cols; m++) if(maxima(0,m)==8+2*maxima(3,m) && maxima(1,m)==20)
+        spot_val = std::max(spot_val, max_vals(m));
+    double hot_val = strongest_hot(maxima, max_vals);
+    if(!(hot_val>spot_val)) fail()<<"Boxxer2D hot pixels weaker than spot without defect map: "<<hot_val<<" "<<spot_val<<endl;
+
+    //The moving spot is never flagged
+    uint32_t nDefects = boxxer.detectDefectMap(ims, 10);
+    auto defects = boxxer.getDefectMap();
+    bool all_hot = true;
+    for(auto &h: hot) all_hot = all_hot && defects(h[0],h[1]);
+    if(nDefects!=3 || !all_hot) fail()<<"Boxxer2D detectDefectMap found: "<<nDefects<<" defects, expected the 3 hot pixels"<<endl;
+
+    boxxer.scaleSpaceLoGMaxima(ims, maxima, max_vals, 3, 3);
+    double patched_hot_val = strongest_hot(maxima, max_vals);
+    if(!(patched_hot_val<0.25*spot_val)) fail()<<"Boxxer2D defect map hot pixel response: "<<patched_hot_val<<" spot: "<<spot_val<<endl;
+    //Masked and threshold paths patch the same frames
+    Boxxer2D<TestFloat>::MaskT full(64,48);
+    full.fill(1);
+    Boxxer2D<TestFloat>::IMatT other_maxima;
+    Boxxer2D<TestFloat>::VecT other_max_vals;
+    boxxer.scaleSpaceLoGMaximaMasked(ims, full, other_maxima, other_max_vals, 3, 3);
+    if(other_maxima.n_cols!=maxima.n_cols || std::abs(arma::accu(other_max_vals)-arma::accu(max_vals))>1e-8)
+        fail()<<"Boxxer2D masked maxima with defect map do not match: "<<other_maxima.n_cols<<" "<<maxima.n_cols<<endl;
+    double threshold = 0.5*spot_val;
+    boxxer.scaleSpaceLoGMaximaThreshold(ims, threshold, other_maxima, other_max_vals, 3, 3);
+    uint32_t nAbove = arma::accu(max_vals>threshold);
+    if(other_maxima.n_cols!=nAbove || strongest_hot(other_maxima, other_max_vals)>0)
+        fail()<<"Boxxer2D threshold maxima with defect map: "<<other_maxima.n_cols<<" expected: "<<nAbove<<endl;
+    boxxer.clearDefectMap();
+    boxxer.scaleSpaceLoGMaxima(ims, maxima, max_vals, 3, 3);
+    if(strongest_hot(maxima, max_vals)!=hot_val) fail()<<"Boxxer2D clearDefectMap did not restore hot pixels"<<endl;
+    cout<<"DefectMap2D: defects:"<<nDefects<<" hot response raw:"<<hot_val<<" patched:"<<patched_hot_val<<" spot:"<<spot_val<<endl;
+
+    //3D: a hot voxel is found and patched
+    Boxxer3D<float>::MatT sigma3(3,1);
+    sigma3.fill(1.5);
+    Boxxer3D<float> boxxer3({20,16,12}, sigma3);
+    auto ims3 = boxxer3.make_image_stack(6);
+    for(uint32_t n=0; n<6; n++) for(uint32_t z=0; z<12; z++) for(uint32_t y=0; y<16; y++) for(uint32_t x=0; x<20; x++)
+        ims3(x,y,z,n) = 1 + 0.05*std::sin(1.3*x+0.7*y+2.1*z+0.5*n) + (x==5 && y==6 && z==7 ? 20 : 0);
+    uint32_t nDefects3 = boxxer3.detectDefectMap(ims3, 6);
+    Boxxer3D<float>::IMatT maxima3;
+    Boxxer3D<float>::VecT max_vals3;
+    boxxer3.scaleSpaceLoGMaxima(ims3, maxima3, max_vals3, 3, 3);
+    if(nDefects3!=1 || !boxxer3.getDefectMap()(5,6,7) || (max_vals3.n_elem && max_vals3.max()>1))
+        fail()<<"Boxxer3D defect map defects: "<<nDefects3<<" max response: "<<(max_vals3.n_elem ? max_vals3.max() : 0)<<endl;
+}
+
+void testComponents2D()
+{
+    typedef double TestFloat;
+    //An L-shaped aggregate, a diagonal chain that is only 8-connected, and an isolated pixel
+    Boxxer2D<TestFloat>::MatT sigma(2,2);
+    sigma.fill(0.5);
+    sigma(0,1) = sigma(1,1) = 0.7;
+    ComponentLabeler2D<TestFloat>::IVecT size = {40,33};
+    ComponentLabeler2D<TestFloat>::ScaledImageT sim(40,33,2);
+    sim.zeros();
+    for(uint32_t y=5; y<20; y++) sim(5,y,0) = 1; //Vertical bar of the L
+    for(uint32_t x=5; x<15; x++) sim(x,19,1) = 2; //Horizontal bar at scale 1
+    sim(10,19,1) = 5;
+    for(uint32_t k=0; k<8; k++) sim(20+k,20+k,0) = 1; //Diagonal chain crossing tile boundaries
+    sim(35,2,0) = 3;
+    ComponentLabeler2D<TestFloat>::IMatT comps;
+    ComponentLabeler2D<TestFloat>::VecT integrated, peak_vals;
+    ComponentLabeler2D<TestFloat> labeler(size);
+    uint32_t N = labeler.label(sim, 0.5, comps, integrated, peak_vals);
+    ComponentLabeler2D<TestFloat>::IMatT expected;
+    expected << 35 << 5  << 20 <<endr  //x_lo.  Numbered by first pixel in column-major order.
+             << 2  << 5  << 20 <<endr  //y_lo
+             << 35 << 14 << 27 <<endr  //x_hi
+             << 2  << 19 << 27 <<endr  //y_hi
+             << 35 << 10 << 20 <<endr  //peak_x
+             << 2  << 19 << 20 <<endr  //peak_y
+             << 0  << 1  << 0  <<endr  //peak_scale
+             << 1  << 24 << 8  <<endr; //area
+    if(N!=3 || comps.n_rows!=ComponentLabeler2D<TestFloat>::NRows || arma::any(arma::vectorise(comps!=expected)))
+        fail()<<"ComponentLabeler2D components: \n"<<comps<<endl;
+    if(N==3 && (std::abs(integrated(1)-(14+2*9+5))>1e-12 || peak_vals(1)!=5 || integrated(2)!=8 || peak_vals(0)!=3))
+        fail()<<"ComponentLabeler2D integrated: "<<integrated.t()<<" peak: "<<peak_vals.t();
+    //Labeling inside a parallel region uses a single tile and must agree
+    ComponentLabeler2D<TestFloat>::IMatT single_comps;
+    #pragma omp parallel num_threads(2)
+    {
+        #pragma omp single
+        {
+            ComponentLabeler2D<TestFloat> single_labeler(size);
+            ComponentLabeler2D<TestFloat>::VecT ints, peaks;
+            single_labeler.label(sim, 0.5, single_comps, ints, peaks);
+        }
+    }
+    if(single_comps.n_cols!=comps.n_cols || arma::any(arma::vectorise(single_comps!=comps)))
+        fail()<<"ComponentLabeler2D single tile labeling differs"<<endl;
+
+    //In the pipeline: two spots in frame 0, a bar in frame 1
+    Boxxer2D<TestFloat> boxxer({48,40}, sigma);
+    auto ims = boxxer.make_image_stack(2);
+    ims.zeros();
+    ims(10,10,0) = ims(30,25,0) = 1;
+    for(uint32_t y=8; y<30; y++) ims(20,y,1) = 1;
+    Boxxer2D<TestFloat>::IMatT components;
+    Boxxer2D<TestFloat>::VecT ints, peaks;
+    uint32_t nComponents = boxxer.scaleSpaceLoGComponents(ims, 0.1, components, ints, peaks);
+    bool ok = nComponents==3 && components.n_rows==ComponentLabeler2D<TestFloat>::NRows+1;
+    if(ok) {
+        ok = components(8,0)==0 && components(8,1)==0 && components(8,2)==1;
+        ok = ok && components(4,0)==10 && components(5,0)==10 && components(4,1)==30 && components(5,1)==25;
+        ok = ok && components(0,2)<=20 && components(2,2)>=20 && components(1,2)<=8 && components(3,2)>=29;
+    }
+    if(!ok) fail()<<"Boxxer2D LoG components: \n"<<components<<endl;
+    uint32_t nDoG = boxxer.scaleSpaceDoGComponents(ims, 0.02, components, ints, peaks); //DoG responses are smaller
+    if(nDoG!=3) fail()<<"Boxxer2D DoG components: "<<nDoG<<endl;
+    cout<<"Components2D: components:"<<N<<" pipeline:"<<nComponents<<" DoG:"<<nDoG<<endl;
+
+    //3D: two blobs, one spanning the tile boundaries along z
+    Boxxer3D<float>::MatT sigma3(3,1);
+    sigma3.fill(1.0);
+    Boxxer3D<float> boxxer3({16,12,20}, sigma3);
+    auto ims3 = boxxer3.make_image_stack(1);
+    for(uint32_t z=0; z<20; z++) for(uint32_t y=0; y<12; y++) for(uint32_t x=0; x<16; x++)
+        ims3(x,y,z,0) = (x==4 && y==4 && z==4 ? 1 : 0) + (x==11 && y==6 && z>=3 && z<17 ? 1 : 0);
+    Boxxer3D<float>::IMatT components3;
+    Boxxer3D<float>::VecT ints3, peaks3;
+    uint32_t n3 = boxxer3.scaleSpaceLoGComponents(ims3, 0.05f, components3, ints3, peaks3);
+    bool ok3 = n3==2 && components3.n_rows==ComponentLabeler3D<float>::NRows+1;
+    for(uint32_t n=0; ok3 && n<n3; n++) {
+        bool blob = components3(6,n)==4 && components3(7,n)==4 && components3(8,n)==4;
+        bool filament = components3(0,n)<=11 && components3(3,n)>=11 && components3(2,n)<=3 && components3(5,n)>=16;
+        ok3 = blob || filament;
+    }
+    if(!ok3)
+        fail()<<"Boxxer3D LoG components: \n"<<components3<<endl;
+}
+
+void testMosaic2D()
+{
+    typedef float TestFloat;
+    //A 3x2 grid of 40x36 tiles overlapping by 9 and 6 pixels, with a different offset in each tile
+    Boxxer2D<TestFloat>::MatT sigma(2,2);
+    sigma.fill(1.0);
+    sigma(0,1) = sigma(1,1) = 1.6;
+    Boxxer2D<TestFloat> engine({40,36}, sigma);
+    Mosaic2D<TestFloat>::IMatT positions;
+    positions << 0 << 31 << 62 << 0  << 31 << 62 <<endr
+              << 0 << 0  << 0  << 30 << 30 << 30 <<endr;
+    Mosaic2D<TestFloat> mosaic(engine, positions);
+    if(mosaic.mosaic_size(0)!=102 || mosaic.mosaic_size(1)!=66) fail()<<"Mosaic2D size: "<<mosaic.mosaic_size.t();
+    arma::Mat<TestFloat> scene(102,66);
+    scene.randu();
+    for(uint32_t i=0; i<scene.n_elem; i++) scene(i) *= 0.1;
+    double spots[4][2] = {{35,15}, {50,33}, {66,31}, {10,60}}; //Three in overlaps
+    for(auto &spot: spots) for(uint32_t y=0; y<66; y++) for(uint32_t x=0; x<102; x++)
+        scene(x,y) += std::exp(-(std::pow(x-spot[0],2)+std::pow(y-spot[1],2))/(2*1.2*1.2));
+    auto tiles = engine.make_image_stack(6);
+    for(uint32_t k=0; k<6; k++) for(uint32_t y=0; y<36; y++) for(uint32_t x=0; x<40; x++)
+        tiles(x,y,k) = scene(positions(0,k)+x, positions(1,k)+y) + 0.01*k;
+    //The reference is the whole mosaic stitched by ownership
+    Boxxer2D<TestFloat> global({102,66}, sigma);
+    auto stitched = global.make_image_stack(1);
+    bool covered = true;
+    for(uint32_t y=0; y<66; y++) for(uint32_t x=0; x<102; x++) {
+        uint32_t o = mosaic.owner(x,y);
+        covered = covered && o<6;
+        if(o<6) stitched(x,y,0) = tiles(x-positions(0,o), y-positions(1,o), o);
+    }
+    if(!covered || mosaic.owner(35,10)!=0 || mosaic.owner(36,10)!=1) fail()<<"Mosaic2D ownership is not split mid-overlap"<<endl;
+    for(int use_DoG=0; use_DoG<2; use_DoG++) {
+        Mosaic2D<TestFloat>::IMatT maxima, ref_maxima;
+        Mosaic2D<TestFloat>::VecT max_vals, ref_max_vals;
+        if(use_DoG) {
+            mosaic.scaleSpaceDoGMaxima(tiles, maxima, max_vals, 3, 3);
+            global.scaleSpaceDoGMaxima(stitched, ref_maxima, ref_max_vals, 3, 3);
+        } else {
+            mosaic.scaleSpaceLoGMaxima(tiles, maxima, max_vals, 5, 3);
+            global.scaleSpaceLoGMaxima(stitched, ref_maxima, ref_max_vals, 5, 3);
+        }
+        std::map<std::tuple<uint32_t,uint32_t,uint32_t>,TestFloat> ref;
+        for(uint32_t n=0; n<ref_maxima.n_cols; n++) ref[std::make_tuple(ref_maxima(0,n),ref_maxima(1,n),ref_maxima(2,n))] = ref_max_vals(n);
+        bool match = maxima.n_cols==ref_maxima.n_cols && maxima.n_rows==4;
+        for(uint32_t n=0; match && n<maxima.n_cols; n++) {
+            auto it = ref.find(std::make_tuple(maxima(0,n),maxima(1,n),maxima(2,n)));
+            match = it!=ref.end() && it->second==max_vals(n) && mosaic.owner(maxima(0,n),maxima(1,n))==maxima(3,n);
+        }
+        if(!match) fail()<<"Mosaic2D "<<(use_DoG ? "DoG" : "LoG")<<" maxima: "<<maxima.n_cols
+                       <<" do not match stitched mosaic maxima: "<<ref_maxima.n_cols<<endl;
+        uint32_t nSpots = 0;
+        for(auto &spot: spots) {
+            uint32_t count = 0;
+            for(uint32_t n=0; n<maxima.n_cols; n++)
+                if(maxima(0,n)==spot[0] && maxima(1,n)==spot[1] && max_vals(n)>0.3*max_vals.max()) count++;
+            if(count==1) nSpots++;
+        }
+        if(nSpots!=4) fail()<<"Mosaic2D spots found exactly once: "<<nSpots<<endl;
+        if(!use_DoG) cout<<"Mosaic2D: maxima:"<<maxima.n_cols<<" spots:"<<nSpots<<endl;
+    }
+}
+
+void testScaleSpaceView2D()
+{
+    typedef float TestFloat;
+    Boxxer2D<TestFloat>::MatT sigma(2,2);
+    sigma.fill(1.0);
+    sigma(0,1) = sigma(1,1) = 2.0;
+    Boxxer2D<TestFloat> engine({150,140}, sigma);
+    Boxxer2D<TestFloat>::MaskT defects(150,140,fill::zeros);
+    defects(70,64) = 1;
+    engine.setDefectMap(defects);
+    auto movie = std::make_shared<Boxxer2D<TestFloat>::ImageStackT>(150,140,4);
+    movie->randu();
+    for(uint32_t i=0; i<movie->n_elem; i++) (*movie)(i) *= 100;
+    for(int use_DoG=0; use_DoG<2; use_DoG++) {
+        auto fim = engine.make_scaled_image_stack(4);
+        if(use_DoG) engine.filterScaledDoG(*movie, fim);
+        else engine.filterScaledLoG(*movie, fim);
+        ScaleSpaceView2D<TestFloat> view(engine, movie, use_DoG);
+        Boxxer2D<TestFloat>::ImageT out;
+        bool match = true;
+        view.view(1, 1, {60,50}, {130,70}, out); //Spans six tiles
+        match = match && arma::all(arma::vectorise(out==fim.slice(1).slice(1).submat(60,50,129,69)));
+        auto stats = view.cacheStats();
+        if(stats.misses!=6 || stats.n_entries<6) fail()<<"ScaleSpaceView2D region misses: "<<stats.misses<<endl;
+        view.waitPrefetch();
+        view.view(2, 1, {60,50}, {130,70}, out); //Prefetched
+        match = match && arma::all(arma::vectorise(out==fim.slice(2).slice(1).submat(60,50,129,69)));
+        view.view(1, 1, {64,64}, {70,70}, out); //Cached
+        match = match && arma::all(arma::vectorise(out==fim.slice(1).slice(1).submat(64,64,69,69)));
+        auto stats2 = view.cacheStats();
+        if(stats2.misses!=stats.misses || stats2.hits!=stats.hits+7)
+            fail()<<"ScaleSpaceView2D hits: "<<stats2.hits<<" misses: "<<stats2.misses<<" expected prefetched and cached tiles"<<endl;
+        for(uint32_t n=0; n<4; n++) for(uint32_t s=0; s<2; s++) {
+            view.view(n, s, out);
+            match = match && arma::all(arma::vectorise(out==fim.slice(n).slice(s)));
+        }
+        if(!match) fail()<<"ScaleSpaceView2D "<<(use_DoG ? "DoG" : "LoG")<<" view does not match whole-frame filter"<<endl;
+        view.waitPrefetch();
+        view.setCacheMaxBytes(64*64*sizeof(TestFloat)*3);
+        stats = view.cacheStats();
+        if(stats.bytes>stats.max_bytes || stats.evictions==0) fail()<<"ScaleSpaceView2D cache not bounded"<<endl;
+    }
+}
+
+#ifdef BOXXER_SHARD_WORKER
+void testShardRunner()
+{
+    uint32_t nT=11;
+    uint32_t sz=32;
+    Boxxer2D<float>::IVecT size={sz,sz};
+    ShardRunner::Params params;
+    params.sigma << 1.0 << 1.6 <<endr
+                 << 1.0 << 1.6 <<endr;
+    params.sigma_ratio = 1.6;
+    params.neighborhood_size = 5;
+    Boxxer2D<float> boxxer(size, params.sigma);
+    boxxer.setDoGSigmaRatio(params.sigma_ratio);
+    auto ims=boxxer.make_image_stack(nT);
+    ims.randu();
+    std::string movie_path = "/tmp/boxxer_test_movie_" + std::to_string(::getpid()) + ".bxm";
+    MovieFile::write(movie_path, ims);
+
+    Boxxer2D<float>::IMatT maxima, shard_maxima;
+    Boxxer2D<float>::VecT max_vals, shard_max_vals;
+    boxxer.scaleSpaceDoGMaxima(ims, maxima, max_vals, params.neighborhood_size, params.scale_neighborhood_size);
+    //The run directory of a runner that no longer exists must be cleaned up
+    pid_t dead_pid = ::fork();
+    if(dead_pid==0) ::_exit(0);
+    ::waitpid(dead_pid, nullptr, 0);
+    std::string stale_dir = "/tmp/boxxer_shard_" + std::to_string(dead_pid) + "_stale";
+    ::mkdir(stale_dir.c_str(), 0700);
+    std::ofstream(stale_dir+"/0.max.tmp")<<"stale";
+    //Concurrent calls in one process each write to their own run directory
+    ShardRunner runner(BOXXER_SHARD_WORKER, 3, 2);
+    Boxxer2D<float>::IMatT other_maxima;
+    Boxxer2D<float>::VecT other_max_vals;
+    std::thread other([&]{ runner.scaleSpaceMaxima(movie_path, params, "/tmp", other_maxima, other_max_vals); });
+    runner.scaleSpaceMaxima(movie_path, params, "/tmp", shard_maxima, shard_max_vals);
+    other.join();
+    std::remove(movie_path.c_str());
+    if(::access(stale_dir.c_str(), F_OK)==0) {
+        fail()<<"ShardRunner did not remove a stale shard directory"<<endl;
+        std::remove((stale_dir+"/0.max.tmp").c_str());
+        ::rmdir(stale_dir.c_str());
+    }
+    if(maxima.n_cols!=shard_maxima.n_cols || arma::any(arma::vectorise(maxima!=shard_maxima)) ||
+            arma::any(max_vals!=shard_max_vals))
+        fail()<<"ShardRunner maxima do not match single process maxima"<<endl;
+    if(maxima.n_cols!=other_maxima.n_cols || arma::any(arma::vectorise(maxima!=other_maxima)) ||
+            arma::any(max_vals!=other_max_vals))
+        fail()<<"Concurrent ShardRunner maxima do not match single process maxima"<<endl;
+    //A header whose size product wraps to the empty data size must be rejected
+    MovieFile::Header hdr;
+    std::memcpy(hdr.magic, MovieFile::Magic, sizeof(hdr.magic));
+    hdr.nrows = hdr.ncols = uint64_t(1)<<32;
+    hdr.nframes = 1;
+    std::ofstream(movie_path, std::ios::binary).write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+    try {
+        MovieFile wrapped(movie_path);
+        fail()<<"MovieFile accepted a header with an overflowing size"<<endl;
+    } catch(ParameterValueError &) { }
+    std::remove(movie_path.c_str());
+    cout<<"ShardRunner: nShards: 3 Nmaxima: "<<shard_maxima.n_cols<<" NUMA nodes: "<<ShardRunner::numaNodeCpus().size()<<endl;
+}
+#endif
+
+#ifdef BOXXER_POSIX_TOOLS
+void testHypercubeFile()
+{
+    Boxxer2D<float>::MatT sigma(2,2);
+    sigma.fill(1.0);
+    sigma(0,1) = sigma(1,1) = 1.6;
+    Boxxer2D<float> boxxer({40,36}, sigma);
+    uint32_t nT = 7;
+    auto ims = boxxer.make_image_stack(nT);
+    ims.randu();
+    auto fim = boxxer.make_scaled_image_stack(nT);
+    boxxer.filterScaledLoG(ims, fim);
+    std::string path = "/tmp/boxxer_test_hypercube_" + std::to_string(::getpid()) + ".bxh";
+    Boxxer2D<float>::ScaledImageT frame;
+    {
+        HypercubeFile out(path, 40, 36, 2, nT);
+        out.filterScaledLoG(boxxer, ims, 3); //Chunks of 3, 3, and 1 frames
+    }
+    bool match = true;
+    {
+        HypercubeFile in(path);
+        match = in.precision()==HypercubeFile::Precision::Float32 && in.nFrames()==nT && in.size(2)==2;
+        for(uint32_t n=0; match && n<nT; n++) {
+            in.readFrame(n, frame);
+            for(uint32_t i=0; i<frame.n_elem; i++) match = match && frame(i)==fim.slice(n)(i);
+        }
+    }
+    if(!match) fail()<<"HypercubeFile Float32 LoG does not match filterScaledLoG"<<endl;
+    boxxer.filterScaledDoG(ims, fim);
+    double max_rel_err = 0;
+    {
+        HypercubeFile out(path, 40, 36, 2, nT, HypercubeFile::Precision::Float16);
+        out.filterScaledDoG(boxxer, ims, 2);
+    }
+    {
+        HypercubeFile in(path);
+        for(uint32_t n=0; n<nT; n++) {
+            in.readFrame(n, frame);
+            double scale = 0, err = 0;
+            for(uint32_t i=0; i<frame.n_elem; i++) {
+                scale = std::max(scale, std::fabs(static_cast<double>(fim.slice(n)(i))));
+                err = std::max(err, std::fabs(static_cast<double>(frame(i))-fim.slice(n)(i)));
+            }
+            max_rel_err = std::max(max_rel_err, err/scale);
+        }
+    }
+    if(max_rel_err>1e-3) fail()<<"HypercubeFile Float16 DoG relative error: "<<max_rel_err<<endl;
+    auto gim = boxxer.make_image_stack(nT);
+    Boxxer2D<float>::VecT gsigma = {1.3f, 0.8f};
+    Boxxer2D<float>::filterGauss(ims, gim, gsigma);
+    {
+        HypercubeFile out(path, 40, 36, 1, nT);
+        out.filterGauss(ims, gsigma);
+        auto view = out.frames(0, nT);
+        match = true;
+        for(uint32_t n=0; n<nT; n++) match = match && arma::all(arma::vectorise(view.slice(n).slice(0)==gim.slice(n)));
+    }
+    if(!match) fail()<<"HypercubeFile filterGauss does not match"<<endl;
+    //Sizes that truncate to IdxT or whose product wraps must not match the file size
+    uint32_t nAccepted = 0;
+    for(int corruption=0; corruption<2; corruption++) {
+        std::vector<char> bytes;
+        {
+            std::ifstream in(path, std::ios::binary);
+            bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        HypercubeFile::Header hdr;
+        std::memcpy(&hdr, bytes.data(), sizeof(hdr));
+        if(corruption==0) hdr.size[0] += uint64_t(1)<<32;
+        else { hdr.size[0] = hdr.size[1] = uint64_t(1)<<32; hdr.size[2] = 1; hdr.size[3] = 0; }
+        std::memcpy(bytes.data(), &hdr, sizeof(hdr));
+        if(corruption==1) bytes.resize(sizeof(hdr));
+        std::string bad_path = path+".bad";
+        std::ofstream(bad_path, std::ios::binary).write(bytes.data(), bytes.size());
+        try {
+            HypercubeFile in(bad_path);
+            nAccepted++;
+        } catch(ParameterValueError &) { }
+        std::remove(bad_path.c_str());
+    }
+    std::remove(path.c_str());
+    if(nAccepted) fail()<<"HypercubeFile corrupt headers accepted: "<<nAccepted<<endl;
+    cout<<"HypercubeFile: Float16 max relative error: "<<max_rel_err<<endl;
+}
+
+void testCompressedMovieFile()
+{
+    //Integer camera counts compress, random bits are stored as is.  Frame 0 is constant for the longest matches.
+    Boxxer2D<float>::MatT sigma(2,2);
+    sigma.fill(1.0);
+    sigma(0,1) = sigma(1,1) = 1.6;
+    Boxxer2D<float> boxxer({64,48}, sigma);
+    uint32_t nT = 9;
+    auto ims = boxxer.make_image_stack(nT);
+    ims.randu();
+    for(uint32_t i=0; i<ims.n_elem; i++) ims.memptr()[i] = std::round(100 + 20*ims.memptr()[i]);
+    ims.slice(0).fill(100);
+    for(uint32_t n=1; n<nT; n++) for(int dy=-4; dy<=4; dy++) for(int dx=-4; dx<=4; dx++)
+        ims(10+5*n+dx,20+dy,n) += std::round(200*std::exp(-(dx*dx+dy*dy)/(2*1.3*1.3)));
+    auto rand_ims = boxxer.make_image_stack(3);
+    std::mt19937 rng(3);
+    for(uint32_t i=0; i<rand_ims.n_elem; i++) {
+        uint32_t bits = rng();
+        std::memcpy(rand_ims.memptr()+i, &bits, sizeof(bits));
+    }
+    std::string path = "/tmp/boxxer_test_cmovie_" + std::to_string(::getpid()) + ".bxc";
+    for(int random=0; random<2; random++) {
+        const auto &movie = random ? rand_ims : ims;
+        CompressedMovieFile::write(path, movie);
+        CompressedMovieFile in(path);
+        auto frames = in.frames(0, in.nFrames());
+        bool match = in.nFrames()==movie.n_slices && frames.n_elem==movie.n_elem &&
+                     std::memcmp(frames.memptr(), movie.memptr(), movie.n_elem*sizeof(float))==0;
+        if(!match) fail()<<"CompressedMovieFile frames do not match"<<(random ? " for random frames" : "")<<endl;
+        if(!random && in.compressionRatio()<2)
+            fail()<<"CompressedMovieFile compression ratio: "<<in.compressionRatio()<<endl;
+        cout<<"CompressedMovieFile: "<<(random ? "random" : "camera")<<" compression ratio: "<<in.compressionRatio()<<endl;
+        if(random) continue;
+        for(int use_DoG=0; use_DoG<2; use_DoG++) {
+            Boxxer2D<float>::IMatT maxima, file_maxima;
+            Boxxer2D<float>::VecT max_vals, file_max_vals;
+            if(use_DoG) {
+                boxxer.scaleSpaceDoGMaxima(ims, maxima, max_vals, 3, 3);
+                in.scaleSpaceDoGMaxima(boxxer, file_maxima, file_max_vals, 3, 3);
+            } else {
+                boxxer.scaleSpaceLoGMaxima(ims, maxima, max_vals, 3, 3);
+                in.scaleSpaceLoGMaxima(boxxer, file_maxima, file_max_vals, 3, 3);
+            }
+            match = maxima.n_cols>0 && maxima.n_cols==file_maxima.n_cols &&
+                    arma::all(arma::vectorise(maxima==file_maxima)) && arma::all(max_vals==file_max_vals);
+            if(!match) fail()<<"CompressedMovieFile "<<(use_DoG ? "DoG" : "LoG")<<" maxima do not match"<<endl;
+        }
+    }
+    //Truncated and garbage blocks must throw or decode within the frame, never write past it
+    std::size_t nElem = ims.n_elem_slice, guard = 64;
+    std::vector<uint8_t> shuffled, block, garbage;
+    std::vector<float> out(nElem+guard);
+    std::size_t nbytes = CompressedMovieFile::compressFrame(ims.slice_memptr(1), nElem, shuffled, block);
+    uint32_t nUncaught = 0, nOverrun = 0;
+    for(std::size_t len=0; len<nbytes; len++) {
+        try {
+            CompressedMovieFile::decompressFrame(block.data(), len, nElem, shuffled, out.data());
+            nUncaught++;
+        } catch(ParameterValueError&) {}
+    }
+    if(nUncaught) fail()<<"CompressedMovieFile truncated blocks decoded without error: "<<nUncaught<<endl;
+    for(int trial=0; trial<200; trial++) {
+        garbage.resize(1 + rng()%(2*nbytes));
+        if(garbage.size()==nElem*sizeof(float)) continue; //A raw block
+        for(auto &b: garbage) b = static_cast<uint8_t>(rng());
+        if(trial%2) std::copy(block.begin(), block.begin()+std::min(nbytes, garbage.size())/2, garbage.begin());
+        std::fill(out.begin()+nElem, out.end(), -1.0f);
+        try {
+            CompressedMovieFile::decompressFrame(garbage.data(), garbage.size(), nElem, shuffled, out.data());
+        } catch(ParameterValueError&) {}
+        if(std::any_of(out.begin()+nElem, out.end(), [](float v){ return v!=-1.0f; })) nOverrun++;
+    }
+    if(nOverrun) fail()<<"CompressedMovieFile garbage blocks wrote past the frame: "<<nOverrun<<endl;
+    //Corrupt headers and indexes must be rejected on open
+    CompressedMovieFile::write(path, ims);
+    std::string file;
+    {
+        std::ifstream f(path, std::ios::binary);
+        file.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+    }
+    using Header = CompressedMovieFile::Header;
+    auto corrupt = [&](std::size_t offset, uint64_t val) {
+        std::string bad = file;
+        std::memcpy(&bad[offset], &val, sizeof(val));
+        return bad;
+    };
+    std::vector<std::string> bad_files = {
+        file.substr(0, file.size()-1),
+        corrupt(offsetof(Header,nrows), uint64_t(1)<<40),
+        corrupt(offsetof(Header,ncols), uint64_t(1)<<33),
+        corrupt(offsetof(Header,nrows), uint64_t(1)<<31),
+        corrupt(offsetof(Header,nframes), std::numeric_limits<uint64_t>::max()),
+        corrupt(offsetof(Header,nframes), uint64_t(1)<<61),
+        corrupt(offsetof(Header,nframes), nT+1),
+        corrupt(sizeof(Header)+3*sizeof(uint64_t), file.size()+1),
+        corrupt(sizeof(Header)+3*sizeof(uint64_t), 0)};
+    uint32_t nAccepted = 0;
+    for(const auto &bad: bad_files) {
+        std::ofstream(path, std::ios::binary|std::ios::trunc).write(bad.data(), bad.size());
+        try {
+            CompressedMovieFile in(path);
+            nAccepted++;
+        } catch(ParameterValueError&) {}
+    }
+    if(nAccepted) fail()<<"CompressedMovieFile corrupt files accepted: "<<nAccepted<<endl;
+    std::remove(path.c_str());
+}
+
+void testDetectionDaemon()
+{
+    uint32_t nT=4;
+    uint32_t sz=32;
+    Boxxer2D<float>::IVecT size={sz,sz};
+    Boxxer2D<float>::MatT sigma;
+    sigma << 1.0 << 1.6 <<endr
+          << 1.0 << 1.6 <<endr;
+    Boxxer2D<float> boxxer(size, sigma);
+    boxxer.setDoGSigmaRatio(1.6);
+    auto ims=boxxer.make_image_stack(nT);
+    ims.randu();
+    Boxxer2D<float>::IMatT maxima, daemon_maxima;
+    Boxxer2D<float>::VecT max_vals, daemon_max_vals;
+    boxxer.scaleSpaceDoGMaxima(ims, maxima, max_vals, 3, 3);
+
+    DetectionServer server("/tmp/boxxer_test_" + std::to_string(::getpid()) + ".sock");
+    server.start();
+    uint32_t nMismatch=0;
+    {
+        DetectionClient client(server.socketPath(), 2, ims.n_elem, 4096);
+        client.configure(size, sigma, true, 1.6, 3, 3);
+        client.detect(ims, daemon_maxima, daemon_max_vals);
+        if(maxima.n_cols!=daemon_maxima.n_cols || arma::any(arma::vectorise(maxima!=daemon_maxima)) ||
+                arma::any(max_vals!=daemon_max_vals)) nMismatch++;
+        //Pipelined submissions filled in place
+        for(uint32_t slot=0; slot<client.nSlots(); slot++) {
+            auto frames = client.slotFrames(slot, nT);
+            frames = ims;
+            client.submit(slot, nT);
+        }
+        for(uint32_t slot=0; slot<client.nSlots(); slot++) {
+            client.collect(daemon_maxima, daemon_max_vals);
+            if(maxima.n_cols!=daemon_maxima.n_cols || arma::any(max_vals!=daemon_max_vals)) nMismatch++;
+        }
+        //Bad configurations are rejected by the server and leave the client connected
+        auto bad_sigma = sigma;
+        bad_sigma(0,1) = std::numeric_limits<float>::quiet_NaN();
+        uint32_t nRejected=0;
+        auto try_configure = [&](const Boxxer2D<float>::IVecT &sz, const Boxxer2D<float>::MatT &sg, float ratio,
+                                 uint32_t nbhd, uint32_t snbhd) {
+            try { client.configure(sz, sg, true, ratio, nbhd, snbhd); }
+            catch(ParameterValueError &) { nRejected++; }
+        };
+        try_configure({0,sz}, sigma, 1.6, 3, 3);
+        try_configure(size, sigma, 1.6, 0, 3);
+        try_configure(size, sigma, 1.6, 3, 4);
+        try_configure(size, bad_sigma, 1.6, 3, 3);
+        try_configure(size, sigma*1e9f, 1.6, 3, 3);
+        try_configure(size, sigma, std::numeric_limits<float>::quiet_NaN(), 3, 3);
+        try_configure(size, sigma, 1.0, 3, 3);
+        if(nRejected!=7) fail()<<"Daemon accepted bad configurations: "<<7-nRejected<<endl;
+        client.configure(size, sigma, true, 1.6, 3, 3);
+        client.detect(ims, daemon_maxima, daemon_max_vals);
+        if(maxima.n_cols!=daemon_maxima.n_cols || arma::any(max_vals!=daemon_max_vals)) nMismatch++;
+    }
+    struct stat st;
+    if(::stat(server.socketPath().c_str(), &st)!=0 || (st.st_mode & 0777)!=0600)
+        fail()<<"Daemon socket is not private to the user"<<endl;
+    server.stop();
+    //A one engine cache evicts the DoG engine for the LoG engine
+    DetectionServer small_server("/tmp/boxxer_test_small_" + std::to_string(::getpid()) + ".sock", 0, 1);
+    small_server.start();
+    {
+        DetectionClient client(small_server.socketPath(), 1, ims.n_elem, 4096);
+        client.configure(size, sigma, true, 1.6, 3, 3);
+        client.configure(size, sigma, false, 1.6, 3, 3);
+        for(int repeat=0; repeat<2; repeat++) {
+            client.detect(ims, daemon_maxima, daemon_max_vals);
+            boxxer.scaleSpaceLoGMaxima(ims, maxima, max_vals, 3, 3);
+            if(maxima.n_cols!=daemon_maxima.n_cols || arma::any(arma::vectorise(maxima!=daemon_maxima)) ||
+                    arma::any(max_vals!=daemon_max_vals)) nMismatch++;
+        }
+    }
+    if(small_server.nEngines()!=1) fail()<<"Daemon engine cache exceeds capacity: "<<small_server.nEngines()<<endl;
+    small_server.stop();
+    if(nMismatch) fail()<<"Daemon maxima do not match local maxima: "<<nMismatch<<endl;
+    cout<<"DetectionDaemon: Nmaxima: "<<daemon_maxima.n_cols<<" engines: "<<server.nEngines()<<endl;
+}
+#endif
+
+/* Expected result of the cross-scale refinement: keep the maxima with no larger value at any scale in the window */
+template<class ValueAt>
+void refineMaximaReference(const arma::Mat<uint32_t> &maxima, const arma::Col<float> &vals, const arma::Col<uint32_t> &size,
+                           uint32_t nScales, uint32_t delta, ValueAt value, arma::Mat<uint32_t> &kept)
+{
+    std::vector<uint32_t> keep;
+    for(uint32_t n=0; n<maxima.n_cols; n++) {
+        bool ok = true;
+        uint32_t lo[3]={0,0,0}, hi[3]={0,0,0};
+        for(uint32_t d=0; d<maxima.n_rows; d++) {
+            lo[d] = maxima(d,n)<=delta ? 0 : maxima(d,n)-delta;
+            hi[d] = std::min(maxima(d,n)+delta, size(d)-1);
+        }
+        for(uint32_t s=0; s<nScales; s++)
+            for(uint32_t k=lo[2]; k<=hi[2]; k++) for(uint32_t j=lo[1]; j<=hi[1]; j++) for(uint32_t i=lo[0]; i<=hi[0]; i++)
+                if(value(i,j,k,s) > vals(n)) ok = false;
+        if(ok) keep.push_back(n);
+    }
+    kept.set_size(maxima.n_rows, keep.size());
+    for(uint32_t q=0; q<keep.size(); q++) kept.col(q) = maxima.col(keep[q]);
+}
+
+/* Concatenate the per-scale maxima of one frame, as the scaleSpace*Maxima methods do before refinement */
+void concatScaleMaxima(const arma::field<arma::Mat<uint32_t>> &scale_maxima, const arma::field<arma::Col<float>> &scale_vals,
+                       arma::Mat<uint32_t> &maxima, arma::Col<float> &vals)
+{
+    uint32_t N=0;
+    for(uint32_t s=0; s<scale_maxima.n_elem; s++) N += scale_maxima(s).n_cols;
+    maxima.set_size(scale_maxima(0).n_rows, N);
+    vals.set_size(N);
+    uint32_t q=0;
+    for(uint32_t s=0; s<scale_maxima.n_elem; s++) for(uint32_t n=0; n<scale_maxima(s).n_cols; n++, q++) {
+        maxima.col(q) = scale_maxima(s).col(n);
+        vals(q) = scale_vals(s)(n);
+    }
+}
+
+void testInterleavedScales()
+{
+    typedef float TestFloat;
+    bool ok = true;
+    Boxxer2D<TestFloat>::MatT sigma2(2,4);
+    for(uint32_t s=0; s<4; s++) sigma2.col(s).fill(0.9+0.4*s);
+    Boxxer2D<TestFloat> boxxer2({45,38}, sigma2);
+    uint32_t nT=3;
+    auto ims = boxxer2.make_image_stack(nT);
+    ims.randu();
+    auto fim = boxxer2.make_scaled_image_stack(nT);
+    auto ifim = boxxer2.make_interleaved_scaled_image_stack(nT);
+    for(int use_DoG=0; use_DoG<2; use_DoG++) {
+        if(use_DoG) {
+            boxxer2.filterScaledDoG(ims, fim);
+            boxxer2.filterScaledDoGInterleaved(ims, ifim);
+        } else {
+            boxxer2.filterScaledLoG(ims, fim);
+            boxxer2.filterScaledLoGInterleaved(ims, ifim);
+        }
+        bool match = true;
+        for(uint32_t n=0; n<nT; n++) for(uint32_t s=0; s<4; s++) for(uint32_t y=0; y<38; y++) for(uint32_t x=0; x<45; x++)
+            match = match && fim(x,y,s,n)==ifim(s,x,y,n);
+        if(!match) {
+            fail()<<"filterScaled"<<(use_DoG ? "DoG" : "LoG")<<"Interleaved does not match the planar filter"<<endl;
+            ok = false;
+        }
+    }
+    boxxer2.enableGaussCache(1<<24);
+    auto cfim = boxxer2.make_interleaved_scaled_image_stack(nT);
+    boxxer2.filterScaledDoGInterleaved(ims, cfim);
+    bool match = true;
+    for(uint32_t n=0; n<nT; n++) for(uint32_t y=0; y<38; y++) for(uint32_t x=0; x<45; x++) for(uint32_t s=0; s<4; s++)
+        match = match && cfim(s,x,y,n)==ifim(s,x,y,n);
+    if(!match) {
+        fail()<<"Cached filterScaledDoGInterleaved does not match the uncached filter"<<endl;
+        ok = false;
+    }
+    bool threw = false;
+    auto bad_fim = boxxer2.make_interleaved_scaled_image_stack(nT+1);
+    try { boxxer2.filterScaledDoGInterleaved(ims, bad_fim); } catch(ParameterShapeError&) { threw = true; }
+    if(!threw) {
+        fail()<<"filterScaledDoGInterleaved accepted a mis-sized stack"<<endl;
+        ok = false;
+    }
+
+    uint32_t nRefined2 = 0;
+    for(uint32_t snbhd=3; snbhd<=7; snbhd+=4) {
+        arma::field<arma::Mat<uint32_t>> scale_maxima(4);
+        arma::field<arma::Col<float>> scale_vals(4);
+        Maxima2D<TestFloat> maxima2D({45,38}, 3);
+        for(uint32_t s=0; s<4; s++) maxima2D.find_maxima(fim.slice(1).slice(s), scale_maxima(s), scale_vals(s));
+        arma::Mat<uint32_t> maxima, expected;
+        arma::Col<float> vals;
+        concatScaleMaxima(scale_maxima, scale_vals, maxima, vals);
+        refineMaximaReference(maxima, vals, {45,38}, 4, (snbhd-1)/2,
+                              [&](uint32_t i, uint32_t j, uint32_t, uint32_t s) { return fim(i,j,s,1); }, expected);
+        boxxer2.scaleSpaceFrameMaximaRefineInterleaved(ifim.slice(1), maxima, vals, snbhd);
+        if(maxima.n_cols!=expected.n_cols || arma::any(arma::vectorise(maxima!=expected))) {
+            fail()<<"2D interleaved refinement kept "<<maxima.n_cols<<" maxima expected: "<<expected.n_cols
+                  <<" scale nbhd: "<<snbhd<<endl;
+            ok = false;
+        }
+        nRefined2 += maxima.n_cols;
+    }
+
+    Boxxer3D<TestFloat>::MatT sigma3(3,3);
+    for(uint32_t s=0; s<3; s++) sigma3.col(s).fill(0.8+0.5*s);
+    Boxxer3D<TestFloat> boxxer3({20,18,16}, sigma3);
+    auto ims3 = boxxer3.make_image_stack(1);
+    ims3.slice(0).randu();
+    auto sim3 = boxxer3.make_scaled_image();
+    auto isim3 = boxxer3.make_interleaved_scaled_image();
+    for(int use_DoG=0; use_DoG<2; use_DoG++) {
+        if(use_DoG) {
+            boxxer3.filterScaledDoG(ims3.slice(0), sim3);
+            boxxer3.filterScaledDoGInterleaved(ims3.slice(0), isim3);
+        } else {
+            boxxer3.filterScaledLoG(ims3.slice(0), sim3);
+            boxxer3.filterScaledLoGInterleaved(ims3.slice(0), isim3);
+        }
+        match = true;
+        for(uint32_t s=0; s<3; s++) for(uint32_t z=0; z<16; z++) for(uint32_t y=0; y<18; y++) for(uint32_t x=0; x<20; x++)
+            match = match && sim3(x,y,z,s)==isim3(s,x,y,z);
+        if(!match) {
+            fail()<<"3D filterScaled"<<(use_DoG ? "DoG" : "LoG")<<"Interleaved does not match the planar filter"<<endl;
+            ok = false;
+        }
+    }
+
+    arma::field<arma::Mat<uint32_t>> scale_maxima3(3);
+    arma::field<arma::Col<float>> scale_vals3(3);
+    Maxima3D<TestFloat> maxima3D({20,18,16}, 3);
+    for(uint32_t s=0; s<3; s++) maxima3D.find_maxima(sim3.slice(s), scale_maxima3(s), scale_vals3(s));
+    arma::Mat<uint32_t> maxima3, expected3;
+    arma::Col<float> vals3;
+    concatScaleMaxima(scale_maxima3, scale_vals3, maxima3, vals3);
+    refineMaximaReference(maxima3, vals3, {20,18,16}, 3, 2,
+                          [&](uint32_t i, uint32_t j, uint32_t k, uint32_t s) { return sim3(i,j,k,s); }, expected3);
+    boxxer3.scaleSpaceFrameMaximaRefineInterleaved(isim3, maxima3, vals3, 5);
+    if(maxima3.n_cols!=expected3.n_cols || arma::any(arma::vectorise(maxima3!=expected3))) {
+        fail()<<"3D interleaved refinement kept "<<maxima3.n_cols<<" maxima expected: "<<expected3.n_cols<<endl;
+        ok = false;
+    }
+    if(ok) cout<<"InterleavedScales: 2D and 3D interleaved filters and refinement match.  Refined maxima 2D: "
+               <<nRefined2<<" 3D: "<<maxima3.n_cols<<endl;
+}
+
+void testAdaptiveScales()
+{
+    //Blobs of one size, with many larger scales that never come near the threshold
+    Boxxer2D<float>::MatT sigma(2,8);
+    float sg[8] = {1,1.4,2,2.8,4,5.6,8,11};
+    for(int s=0; s<8; s++) sigma(0,s) = sigma(1,s) = sg[s];
+    Boxxer2D<float> boxxer({64,64}, sigma);
+    uint32_t nT = 40;
+    auto ims = boxxer.make_image_stack(nT);
+    ims.randu();
+    for(uint32_t i=0; i<ims.n_elem; i++) ims.memptr()[i] = 100 + 0.5*ims.memptr()[i];
+    for(uint32_t n=0; n<nT; n++) for(int k=0; k<5; k++) {
+        int cx = 8+(n*13+k*17)%48, cy = 8+(n*7+k*11)%48;
+        for(int dy=-5; dy<=5; dy++) for(int dx=-5; dx<=5; dx++)
+            ims(cx+dx,cy+dy,n) += 20*std::exp(-(dx*dx+dy*dy)/(2*1.4*1.4));
+    }
+    Boxxer2D<float>::AdaptiveScaleParams params;
+    params.window = 16;
+    params.recheck_period = 8;
+    for(int use_DoG=0; use_DoG<2; use_DoG++) {
+        float threshold = use_DoG ? 0.4 : 3;
+        Boxxer2D<float>::IMatT maxima, adaptive_maxima;
+        Boxxer2D<float>::VecT max_vals, adaptive_max_vals;
+        Boxxer2D<float>::AdaptiveScaleStats stats;
+        if(use_DoG) {
+            boxxer.scaleSpaceDoGMaximaThreshold(ims, threshold, maxima, max_vals, 3, 3);
+            boxxer.scaleSpaceDoGMaximaAdaptive(ims, threshold, adaptive_maxima, adaptive_max_vals, 3, 3, params, &stats);
+        } else {
+            boxxer.scaleSpaceLoGMaximaThreshold(ims, threshold, maxima, max_vals, 3, 3);
+            boxxer.scaleSpaceLoGMaximaAdaptive(ims, threshold, adaptive_maxima, adaptive_max_vals, 3, 3, params, &stats);
+        }
+        const char *name = use_DoG ? "DoG" : "LoG";
+        if(maxima.n_cols==0 || sortedMaximaCols(maxima)!=sortedMaximaCols(adaptive_maxima))
+            fail()<<"Adaptive "<<name<<" maxima do not match: "<<adaptive_maxima.n_cols<<" vs "<<maxima.n_cols<<endl;
+        if(stats.nFrames!=nT || stats.nScaleFrames+stats.nSkippedScaleFrames!=nT*boxxer.nScales)
+            fail()<<"Adaptive "<<name<<" stats do not add up"<<endl;
+        if(stats.nSkippedScaleFrames==0 || stats.nSkippedByScale[0]!=0)
+            fail()<<"Adaptive "<<name<<" skipped the wrong scales"<<endl;
+        if(stats.nFullFrames!=16+(nT-16+7)/8)
+            fail()<<"Adaptive "<<name<<" full frames: "<<stats.nFullFrames<<endl;
+        cout<<"AdaptiveScales "<<name<<": Nmaxima: "<<adaptive_maxima.n_cols<<" skipped "<<stats.nSkippedScaleFrames
+            <<" of "<<stats.nSkippedScaleFrames+stats.nScaleFrames<<" frame-scales"<<endl;
+    }
+
+    Boxxer3D<float>::MatT sigma3(3,4);
+    for(int s=0; s<4; s++) sigma3.col(s).fill(sg[2*s]);
+    Boxxer3D<float> boxxer3({24,24,16}, sigma3);
+    auto ims3 = boxxer3.make_image_stack(12);
+    for(uint32_t n=0; n<12; n++) {
+        ims3.slice(n).randu();
+        ims3.slice(n) *= 0.5;
+        for(int dz=-3; dz<=3; dz++) for(int dy=-3; dy<=3; dy++) for(int dx=-3; dx<=3; dx++)
+            ims3(8+n+dx,12+dy,8+dz,n) += 20*std::exp(-(dx*dx+dy*dy+dz*dz)/(2*1.2*1.2));
+    }
+    Boxxer3D<float>::IMatT maxima3, adaptive_maxima3;
+    Boxxer3D<float>::VecT max_vals3, adaptive_max_vals3;
+    Boxxer3D<float>::AdaptiveScaleStats stats3;
+    params.window = 4;
+    params.recheck_period = 4;
+    float threshold3 = 2;
+    boxxer3.scaleSpaceLoGMaxima(ims3, maxima3, max_vals3, 3, 3);
+    boxxer3.scaleSpaceLoGMaximaAdaptive(ims3, threshold3, adaptive_maxima3, adaptive_max_vals3, 3, 3, params, &stats3);
+    Boxxer3D<float>::IMatT expected3(5,maxima3.n_cols);
+    uint32_t nExpected = 0;
+    for(uint32_t n=0; n<maxima3.n_cols; n++) if(max_vals3(n)>threshold3) expected3.col(nExpected++) = maxima3.col(n);
+    expected3.resize(5,nExpected);
+    if(nExpected==0 || sortedMaximaCols(expected3)!=sortedMaximaCols(adaptive_maxima3))
+        fail()<<"Adaptive 3D maxima do not match: "<<adaptive_maxima3.n_cols<<" vs "<<nExpected<<endl;
+    cout<<"AdaptiveScales 3D: Nmaxima: "<<adaptive_maxima3.n_cols<<" skipped "<<stats3.nSkippedScaleFrames
+        <<" of "<<stats3.nSkippedScaleFrames+stats3.nScaleFrames<<" frame-scales"<<endl;
+}
+
+void testTemporalBinning()
+{
+    //Dim blobs that are only clear once a few frames are summed
+    Boxxer2D<float>::MatT sigma(2,3);
+    float sg[3] = {1,1.4,2};
+    for(int s=0; s<3; s++) sigma(0,s) = sigma(1,s) = sg[s];
+    Boxxer2D<float> boxxer({48,40}, sigma);
+    uint32_t nT = 14;
+    auto ims = boxxer.make_image_stack(nT);
+    ims.randu();
+    for(uint32_t n=0; n<nT; n++) for(int k=0; k<3; k++) {
+        int cx = 8+k*14, cy = 10+(k*9+n/4)%20;
+        for(int dy=-4; dy<=4; dy++) for(int dx=-4; dx<=4; dx++)
+            ims(cx+dx,cy+dy,n) += std::exp(-(dx*dx+dy*dy)/(2*1.4*1.4));
+    }
+    uint32_t bin_sizes[3] = {1,4,4}, strides[3] = {0,0,1};
+    for(int c=0; c<3; c++) for(int use_DoG=0; use_DoG<2; use_DoG++) {
+        Boxxer2D<float>::TemporalBinningT binning;
+        binning.bin_size = bin_sizes[c];
+        binning.stride = strides[c];
+        binning.mean = c==2;
+        uint32_t nB = binning.nBins(nT);
+        auto binned = boxxer.make_image_stack(nB);
+        for(uint32_t b=0; b<nB; b++) {
+            binned.slice(b) = ims.slice(binning.firstFrame(b));
+            for(uint32_t k=1; k<binning.bin_size; k++) binned.slice(b) += ims.slice(binning.firstFrame(b)+k);
+            if(binning.mean) binned.slice(b) /= static_cast<float>(binning.bin_size);
+        }
+        Boxxer2D<float>::IMatT maxima, binned_maxima;
+        Boxxer2D<float>::VecT max_vals, binned_max_vals;
+        if(use_DoG) {
+            boxxer.scaleSpaceDoGMaxima(binned, maxima, max_vals, 3, 3);
+            boxxer.scaleSpaceDoGMaximaBinned(ims, binning, binned_maxima, binned_max_vals, 3, 3);
+        } else {
+            boxxer.scaleSpaceLoGMaxima(binned, maxima, max_vals, 3, 3);
+            boxxer.scaleSpaceLoGMaximaBinned(ims, binning, binned_maxima, binned_max_vals, 3, 3);
+        }
+        for(uint32_t n=0; n<maxima.n_cols; n++) maxima(3,n) *= binning.step();
+        const char *name = use_DoG ? "DoG" : "LoG";
+        if(maxima.n_cols==0 || sortedMaximaCols(maxima)!=sortedMaximaCols(binned_maxima))
+            fail()<<"Binned "<<name<<" bin_size "<<binning.bin_size<<" maxima do not match: "
+                <<binned_maxima.n_cols<<" vs "<<maxima.n_cols<<endl;
+        cout<<"TemporalBinning "<<name<<" bin_size: "<<binning.bin_size<<" stride: "<<binning.step()
+            <<" bins: "<<nB<<" Nmaxima: "<<binned_maxima.n_cols<<endl;
+    }
+
+    Boxxer3D<float>::MatT sigma3(3,2);
+    sigma3.col(0).fill(1.2);
+    sigma3.col(1).fill(1.8);
+    Boxxer3D<float> boxxer3({20,20,12}, sigma3);
+    auto ims3 = boxxer3.make_image_stack(7);
+    for(uint32_t n=0; n<7; n++) {
+        ims3.slice(n).randu();
+        for(int dz=-3; dz<=3; dz++) for(int dy=-3; dy<=3; dy++) for(int dx=-3; dx<=3; dx++)
+            ims3(10+dx,8+n/2+dy,6+dz,n) += std::exp(-(dx*dx+dy*dy+dz*dz)/(2*1.2*1.2));
+    }
+    Boxxer3D<float>::TemporalBinningT binning3;
+    binning3.bin_size = 3;
+    binning3.stride = 2;
+    auto binned3 = boxxer3.make_image_stack(binning3.nBins(7));
+    for(uint32_t b=0; b<binned3.sN; b++) {
+        binned3.slice(b) = ims3.slice(2*b);
+        for(uint32_t k=1; k<3; k++) binned3.slice(b) += ims3.slice(2*b+k);
+    }
+    Boxxer3D<float>::IMatT maxima3, binned_maxima3;
+    Boxxer3D<float>::VecT max_vals3, binned_max_vals3;
+    boxxer3.scaleSpaceLoGMaxima(binned3, maxima3, max_vals3, 3, 3);
+    boxxer3.scaleSpaceLoGMaximaBinned(ims3, binning3, binned_maxima3, binned_max_vals3, 3, 3);
+    for(uint32_t n=0; n<maxima3.n_cols; n++) maxima3(4,n) *= 2;
+    if(maxima3.n_cols==0 || sortedMaximaCols(maxima3)!=sortedMaximaCols(binned_maxima3))
+        fail()<<"Binned 3D maxima do not match: "<<binned_maxima3.n_cols<<" vs "<<maxima3.n_cols<<endl;
+    cout<<"TemporalBinning 3D: bins: "<<binned3.sN<<" Nmaxima: "<<binned_maxima3.n_cols<<endl;
+}
+
+void testSpectralCascade()
+{
+    //Sparse emitters in [L Y X] hyperspectral frames, each with a spectral peak
+    Boxxer3D<float>::MatT sigma(3,3);
+    float sg[3] = {1.2,1.6,2.2};
+    for(int s=0; s<3; s++) {
+        sigma(0,s) = 2*sg[s];
+        sigma(1,s) = sigma(2,s) = sg[s];
+    }
+    Boxxer3D<float> boxxer({24,96,80}, sigma);
+    uint32_t nT = 4;
+    auto ims = boxxer.make_image_stack(nT);
+    for(uint32_t n=0; n<nT; n++) {
+        ims.slice(n).randu();
+        ims.slice(n) *= 0.2;
+        for(int k=0; k<3; k++) {
+            int cl = 6+5*k, cy = 8+(29*k+11*n)%80, cx = 8+(23*k+7*n)%64;
+            for(int dx=-5; dx<=5; dx++) for(int dy=-5; dy<=5; dy++) for(int dl=-6; dl<=6; dl++)
+                ims(cl+dl,cy+dy,cx+dx,n) += 4*std::exp(-(dy*dy+dx*dx)/(2*1.6*1.6) - dl*dl/(2*3.2*3.2));
+        }
+    }
+    Boxxer3D<float>::SpectralCascadeParams params;
+    params.projection_threshold = 1;
+    for(int use_DoG=0; use_DoG<2; use_DoG++) {
+        Boxxer3D<float>::IMatT maxima, cascade_maxima;
+        Boxxer3D<float>::VecT max_vals, cascade_max_vals;
+        Boxxer3D<float>::SpectralCascadeStats stats;
+        if(use_DoG) {
+            boxxer.scaleSpaceDoGMaxima(ims, maxima, max_vals, 3, 3);
+            boxxer.scaleSpaceDoGMaximaCascade(ims, params, cascade_maxima, cascade_max_vals, 3, 3, &stats);
+        } else {
+            boxxer.scaleSpaceLoGMaxima(ims, maxima, max_vals, 3, 3);
+            boxxer.scaleSpaceLoGMaximaCascade(ims, params, cascade_maxima, cascade_max_vals, 3, 3, &stats);
+        }
+        const char *name = use_DoG ? "DoG" : "LoG";
+        //Cascade maxima are full frame maxima, found once each
+        auto all = sortedMaximaCols(maxima);
+        auto found = sortedMaximaCols(cascade_maxima);
+        bool ok = !found.empty() && std::adjacent_find(found.begin(), found.end())==found.end();
+        for(auto &col: found) ok = ok && std::binary_search(all.begin(), all.end(), col);
+        if(!ok) fail()<<"Cascade "<<name<<" maxima are not distinct full frame maxima"<<endl;
+        //The strongest maxima of each frame is found
+        for(uint32_t n=0; n<nT; n++) {
+            int best = -1;
+            for(uint32_t i=0; i<maxima.n_cols; i++)
+                if(maxima(4,i)==n && (best<0 || max_vals(i)>max_vals(best))) best = i;
+            std::vector<uint32_t> col;
+            for(uint32_t r=0; r<5; r++) col.push_back(maxima(r,best));
+            if(best<0 || !std::binary_search(found.begin(), found.end(), col))
+                fail()<<"Cascade "<<name<<" missed the strongest maxima of frame "<<n<<endl;
+        }
+        if(stats.nHits==0 || 2*stats.nWindowVoxels>=ims.sX*ims.sY*ims.sZ*nT)
+            fail()<<"Cascade "<<name<<" filtered "<<stats.nWindowVoxels<<" voxels for "<<stats.nHits<<" hits"<<endl;
+        cout<<"SpectralCascade "<<name<<": Nmaxima: "<<cascade_maxima.n_cols<<" of "<<maxima.n_cols<<" hits: "
+            <<stats.nHits<<" window voxels: "<<stats.nWindowVoxels<<" of "<<ims.sX*ims.sY*ims.sZ*nT<<endl;
+    }
+}
 
 void testBoxxer3D()
 {
@@ -347,6 +2273,12 @@ void testBoxxer3D()
 //         printf("Maxima[%i]: (%i,%i,%i,%i):%.9g\n",n,maxima(0,n),maxima(1,n),maxima(2,n),maxima(3,n),max_vals(n));
 //     }
     boxxer.checkMaxima(LoG_out, maxima, max_vals);
+
+    Boxxer3D<TestFloat>::IMatT fused_maxima;
+    Boxxer3D<TestFloat>::VecT fused_max_vals;
+    Boxxer3D<TestFloat>::detectLoG(ims, sigma, fused_maxima, fused_max_vals, 3);
+    if(fused_maxima.n_cols!=maxima.n_cols || !arma::all(arma::vectorise(fused_maxima==maxima)) || !arma::all(fused_max_vals==max_vals))
+        fail()<<"Boxxer3D detectLoG does not match filterLoG+enumerateImageMaxima"<<endl;
 }
 
 
@@ -443,10 +2375,41 @@ int main(){
     testGaussFilter3D();
     testLoGFilter2D();
     testLoGFilter3D();
+    testGaussFIR3Dz();
+    testMaximaND();
+    testFilterND();
     testMaxima3D();
     testMaxima2D();
     testBoxxer2D();
     testBoxxer3D();
     testScaleSpace2D();
-    return 0;
+    testGaussCache2D();
+    testSweep2D();
+    testBatchRunner2D();
+    testMasked2D();
+    testMasked3D();
+    testTemporalSkip2D();
+    testDarkFrameSkip2D();
+    testMultiChannel2D();
+    testPSFFilter2D();
+    testWavelet2D();
+    testShape2D();
+    testDefectMap2D();
+    testComponents2D();
+    testMosaic2D();
+    testScaleSpaceView2D();
+    testInterleavedScales();
+    testAdaptiveScales();
+    testTemporalBinning();
+    testSpectralCascade();
+#ifdef BOXXER_SHARD_WORKER
+    testShardRunner();
+#endif
+#ifdef BOXXER_POSIX_TOOLS
+    testHypercubeFile();
+    testCompressedMovieFile();
+    testDetectionDaemon();
+#endif
+    if(nFailures) cout<<"*** "<<nFailures<<" checks failed"<<endl;
+    return nFailures ? 1 : 0;
 }